@@ -0,0 +1,117 @@
+#include <bench/bench.h>
+#include <bench/omnicore_state.h>
+
+#include <omnicore/dbstolist.h>
+#include <omnicore/dbtxlist.h>
+#include <omnicore/omnicore.h>
+
+#include <uint256.h>
+
+#include <univalue.h>
+
+#include <assert.h>
+#include <stdint.h>
+#include <set>
+#include <string>
+
+using namespace mastercore;
+
+//! Number of transactions recorded per block
+static const unsigned int BENCH_TXS_PER_BLOCK = 100;
+
+/** Records the transactions of a block with a single commit, like the block handlers. */
+static void RecordBlockTxs(int nBlock)
+{
+    pDbTransactionList->BeginBatch();
+    for (unsigned int n = 0; n < BENCH_TXS_PER_BLOCK; ++n) {
+        const uint256 txid = omnibench::BenchTxid(nBlock * BENCH_TXS_PER_BLOCK + n);
+        pDbTransactionList->recordTX(txid, true, nBlock, MSC_TYPE_SIMPLE_SEND, 1000 + n);
+    }
+    assert(pDbTransactionList->CommitBatch().ok());
+}
+
+// Records the transactions of blocks in the transaction database.
+static void OmniTxListRecord(benchmark::State& state)
+{
+    omnibench::OpenDatabases();
+
+    int nBlock = 0;
+    while (state.KeepRunning()) {
+        RecordBlockTxs(nBlock++);
+    }
+
+    omnibench::CloseDatabases();
+}
+
+// Looks up transactions, and scans a range of blocks of a transaction database
+// with the transactions of as many blocks as the synthetic state has addresses.
+static void OmniTxListLookup(benchmark::State& state)
+{
+    omnibench::OpenDatabases();
+    const int nBlocks = omnibench::GetStateSize().nAddresses;
+    for (int nBlock = 0; nBlock < nBlocks; ++nBlock) {
+        RecordBlockTxs(nBlock);
+    }
+
+    unsigned int nTx = 0;
+    while (state.KeepRunning()) {
+        for (unsigned int n = 0; n < BENCH_TXS_PER_BLOCK; ++n) {
+            nTx = (nTx + 7919) % (nBlocks * BENCH_TXS_PER_BLOCK);
+            assert(pDbTransactionList->exists(omnibench::BenchTxid(nTx)));
+        }
+        std::set<uint256> setTxs;
+        const int nBlockFirst = nTx % (nBlocks - 9);
+        int nFound = pDbTransactionList->GetOmniTxsInBlockRange(nBlockFirst, nBlockFirst + 9, setTxs);
+        assert(nFound == 10 * (int) BENCH_TXS_PER_BLOCK);
+    }
+
+    omnibench::CloseDatabases();
+}
+
+// Records the receivers of "send to owners" transactions, with one receiver per
+// address of the synthetic state.
+static void OmniSTOListRecord(benchmark::State& state)
+{
+    omnibench::OpenDatabases();
+    const unsigned int nAddresses = omnibench::GetStateSize().nAddresses;
+
+    int nBlock = 0;
+    while (state.KeepRunning()) {
+        const uint256 txid = omnibench::BenchTxid(nBlock);
+        pDbStoList->BeginBatch();
+        for (unsigned int n = 0; n < nAddresses; ++n) {
+            pDbStoList->recordSTOReceive(omnibench::BenchAddress(n), txid, nBlock, OMNI_PROPERTY_MSC, 1000 + n);
+        }
+        assert(pDbStoList->CommitBatch().ok());
+        ++nBlock;
+    }
+
+    omnibench::CloseDatabases();
+}
+
+// Retrieves the receivers of a "send to owners" transaction, with one receiver
+// per address of the synthetic state.
+static void OmniSTOListRecipients(benchmark::State& state)
+{
+    omnibench::OpenDatabases();
+    const unsigned int nAddresses = omnibench::GetStateSize().nAddresses;
+    const uint256 txid = omnibench::BenchTxid(0);
+    for (unsigned int n = 0; n < nAddresses; ++n) {
+        pDbStoList->recordSTOReceive(omnibench::BenchAddress(n), txid, 1, OMNI_PROPERTY_MSC, 1000 + n);
+    }
+
+    while (state.KeepRunning()) {
+        UniValue recipients(UniValue::VARR);
+        uint64_t total = 0;
+        uint64_t numRecipients = 0;
+        pDbStoList->getRecipients(txid, "*", &recipients, &total, &numRecipients);
+        assert(nAddresses == numRecipients);
+    }
+
+    omnibench::CloseDatabases();
+}
+
+BENCHMARK(OmniTxListRecord, 100);
+BENCHMARK(OmniTxListLookup, 1000);
+BENCHMARK(OmniSTOListRecord, 10);
+BENCHMARK(OmniSTOListRecipients, 50);
@@ -0,0 +1,182 @@
+#include <bench/bench.h>
+
+#include <omnicore/createpayload.h>
+#include <omnicore/encoding.h>
+#include <omnicore/omnicore.h>
+#include <omnicore/parsing.h>
+#include <omnicore/tx.h>
+
+#include <amount.h>
+#include <chainparams.h>
+#include <coins.h>
+#include <key.h>
+#include <key_io.h>
+#include <primitives/block.h>
+#include <primitives/transaction.h>
+#include <script/script.h>
+#include <script/standard.h>
+#include <streams.h>
+#include <sync.h>
+#include <version.h>
+
+#include <assert.h>
+#include <stdint.h>
+
+#include <utility>
+#include <vector>
+
+namespace block_bench {
+#include <bench/data/block413567.raw.h>
+} // namespace block_bench
+
+//! Height of the mainnet block used by the benchmarks
+static const int BENCH_BLOCK_HEIGHT = 413567;
+
+static CBlock LoadBenchBlock()
+{
+    CDataStream stream((const char*)block_bench::block413567,
+            (const char*)block_bench::block413567 + sizeof(block_bench::block413567),
+            SER_NETWORK, PROTOCOL_VERSION);
+
+    CBlock block;
+    stream >> block;
+
+    return block;
+}
+
+// Filters the transactions of a mainnet block, which is what every block and
+// every mempool transaction goes through. Almost all of them are not Omni
+// transactions, so this mostly measures the negative path.
+static void OmniMayHaveMarker(benchmark::State& state)
+{
+    SelectParams(CBaseChainParams::MAIN);
+    const CBlock block = LoadBenchBlock();
+
+    while (state.KeepRunning()) {
+        size_t nCandidates = 0;
+        for (const CTransactionRef& tx : block.vtx) {
+            if (mastercore::MayHaveMarker(*tx, BENCH_BLOCK_HEIGHT)) ++nCandidates;
+        }
+        assert(nCandidates < block.vtx.size());
+    }
+}
+
+// Classifies the transactions of a mainnet block, including the full check of
+// the transactions, which may carry a marker.
+static void OmniGetEncodingClass(benchmark::State& state)
+{
+    SelectParams(CBaseChainParams::MAIN);
+    const CBlock block = LoadBenchBlock();
+
+    while (state.KeepRunning()) {
+        size_t nOmni = 0;
+        for (const CTransactionRef& tx : block.vtx) {
+            if (mastercore::GetEncodingClass(*tx, BENCH_BLOCK_HEIGHT) != NO_MARKER) ++nOmni;
+        }
+        assert(nOmni < block.vtx.size());
+    }
+}
+
+/**
+ * Creates a transaction, which embeds the payload with the given encoding class.
+ *
+ * The input of the transaction is added to the coins view cache, so the sender
+ * can be determined without a transaction index.
+ */
+static CTransaction CreateOmniTx(const CKey& key, int encodingClass, const std::vector<unsigned char>& vchPayload)
+{
+    const CPubKey pubKey = key.GetPubKey();
+    const CTxDestination sender = pubKey.GetID();
+
+    CMutableTransaction prevTx;
+    prevTx.vout.push_back(CTxOut(COIN, GetScriptForDestination(sender)));
+    const COutPoint prevout(prevTx.GetHash(), 0);
+
+    std::vector<std::pair<CScript, int64_t> > vecOutputs;
+    if (encodingClass == OMNI_CLASS_B) {
+        assert(OmniCore_Encode_ClassB(EncodeDestination(sender), pubKey, vchPayload, vecOutputs));
+    } else {
+        assert(OmniCore_Encode_ClassC(vchPayload, vecOutputs));
+    }
+
+    CMutableTransaction mutableTx;
+    mutableTx.vin.push_back(CTxIn(prevout));
+    for (const auto& output : vecOutputs) {
+        mutableTx.vout.push_back(CTxOut(output.second, output.first));
+    }
+    // the reference output
+    mutableTx.vout.push_back(CTxOut(546, GetScriptForDestination(CKeyID(uint160(std::vector<unsigned char>(20, 0x42))))));
+
+    {
+        LOCK(mastercore::cs_tx_cache);
+        Coin coin;
+        coin.out = prevTx.vout[0];
+        mastercore::view.AddCoin(prevout, std::move(coin), true);
+    }
+
+    return CTransaction(mutableTx);
+}
+
+/** Parses a class B or class C simple send, including sender identification and payload decoding. */
+static void ParseOmniTx(benchmark::State& state, int encodingClass)
+{
+    SelectParams(CBaseChainParams::MAIN);
+
+    CKey key;
+    key.MakeNewKey(true);
+    const CTransaction tx = CreateOmniTx(key, encodingClass, CreatePayload_SimpleSend(31, 1000000));
+
+    while (state.KeepRunning()) {
+        CMPTransaction mp_obj;
+        assert(0 == ParseTransaction(tx, BENCH_BLOCK_HEIGHT, 1, mp_obj));
+        assert(mp_obj.getEncodingClass() == encodingClass);
+    }
+}
+
+// Parses a class B transaction, which embeds the payload in obfuscated multisig outputs.
+static void OmniParseClassB(benchmark::State& state)
+{
+    ParseOmniTx(state, OMNI_CLASS_B);
+}
+
+// Parses a class C transaction, which embeds the payload in an OP_RETURN output.
+static void OmniParseClassC(benchmark::State& state)
+{
+    ParseOmniTx(state, OMNI_CLASS_C);
+}
+
+// Interprets a mix of payloads, which is done for every parsed transaction.
+static void OmniInterpretTransaction(benchmark::State& state)
+{
+    SelectParams(CBaseChainParams::MAIN);
+
+    std::vector<std::vector<unsigned char> > vPayloads;
+    vPayloads.push_back(CreatePayload_SimpleSend(31, 1000000));
+    vPayloads.push_back(CreatePayload_SimpleSend(1, 1000000));
+    vPayloads.push_back(CreatePayload_SendAll(1));
+    vPayloads.push_back(CreatePayload_DExSell(1, 1000000, 2000000, 10, 10000, 1));
+    vPayloads.push_back(CreatePayload_DExAccept(1, 1000000));
+    vPayloads.push_back(CreatePayload_SendToOwners(3, 1000000, 3));
+    vPayloads.push_back(CreatePayload_MetaDExTrade(3, 1000000, 1, 2000000));
+    vPayloads.push_back(CreatePayload_MetaDExCancelEcosystem(1));
+    vPayloads.push_back(CreatePayload_IssuanceFixed(1, 2, 0, "Companies", "Bitcoin Mining", "Quantum Miner", "builder.bitwatch.co", "", 1000000));
+    vPayloads.push_back(CreatePayload_Grant(3, 1000000, "Bench grant"));
+
+    const std::string sender = EncodeDestination(CKeyID(uint160(std::vector<unsigned char>(20, 0x01))));
+    const std::string receiver = EncodeDestination(CKeyID(uint160(std::vector<unsigned char>(20, 0x02))));
+
+    while (state.KeepRunning()) {
+        for (size_t n = 0; n < vPayloads.size(); ++n) {
+            std::vector<unsigned char>& vchPayload = vPayloads[n];
+            CMPTransaction mp_obj;
+            mp_obj.Set(sender, receiver, 0, uint256(), BENCH_BLOCK_HEIGHT, n, vchPayload.data(), vchPayload.size(), OMNI_CLASS_C, 10000);
+            assert(mp_obj.interpret_Transaction());
+        }
+    }
+}
+
+BENCHMARK(OmniMayHaveMarker, 1000);
+BENCHMARK(OmniGetEncodingClass, 1000);
+BENCHMARK(OmniParseClassB, 5000);
+BENCHMARK(OmniParseClassC, 20000);
+BENCHMARK(OmniInterpretTransaction, 20000);
@@ -0,0 +1,43 @@
+#include <bench/bench.h>
+#include <bench/omnicore_state.h>
+
+#include <omnicore/mdex.h>
+#include <omnicore/omnicore.h>
+#include <omnicore/tally.h>
+
+#include <amount.h>
+#include <sync.h>
+
+#include <assert.h>
+#include <stdint.h>
+#include <string>
+
+using namespace mastercore;
+
+// Adds orders, which are fully matched by the best order of an order book with
+// the open orders of the synthetic state. The matched order is replaced after
+// each trade, so the order book keeps its size.
+static void OmniMetaDExTrade(benchmark::State& state)
+{
+    const omnibench::StateSize size = omnibench::GetStateSize();
+    omnibench::OpenDatabases();
+    omnibench::GenerateState(size);
+
+    const std::string taker = omnibench::BenchAddress(size.nAddresses);
+    const std::string maker = omnibench::BenchAddress(size.nAddresses + 1);
+    const uint32_t propertyId = omnibench::BenchProperty(0);
+    assert(update_tally_map(taker, OMNI_PROPERTY_MSC, 1000000 * COIN, BALANCE));
+    assert(update_tally_map(maker, propertyId, 1000000 * COIN, BALANCE));
+
+    unsigned int nTx = 0;
+    while (state.KeepRunning()) {
+        LOCK(cs_tally);
+        ++nTx;
+        assert(0 == MetaDEx_ADD(taker, OMNI_PROPERTY_MSC, 1000, omnibench::BENCH_STATE_HEIGHT, propertyId, 1000, omnibench::BenchTxid(2 * nTx), 2 * nTx));
+        assert(0 == MetaDEx_ADD(maker, propertyId, 1000, omnibench::BENCH_STATE_HEIGHT, OMNI_PROPERTY_MSC, 1000, omnibench::BenchTxid(2 * nTx + 1), 2 * nTx + 1));
+    }
+
+    omnibench::CloseDatabases();
+}
+
+BENCHMARK(OmniMetaDExTrade, 1000);
@@ -0,0 +1,82 @@
+#include <bench/bench.h>
+#include <bench/omnicore_state.h>
+
+#include <omnicore/omnicore.h>
+#include <omnicore/persistence.h>
+
+#include <chain.h>
+#include <sync.h>
+#include <uint256.h>
+#include <validation.h>
+
+#include <assert.h>
+
+using namespace mastercore;
+
+namespace {
+
+/** A block index, which is known while it exists, so its state files are not pruned. */
+class CBenchBlockIndex
+{
+private:
+    uint256 hashBlock;
+
+public:
+    CBlockIndex index;
+
+    CBenchBlockIndex()
+    {
+        hashBlock = omnibench::BenchTxid(0);
+        index.phashBlock = &hashBlock;
+        index.nHeight = omnibench::BENCH_STATE_HEIGHT;
+
+        LOCK(cs_main);
+        mapBlockIndex[hashBlock] = &index;
+    }
+
+    ~CBenchBlockIndex()
+    {
+        LOCK(cs_main);
+        mapBlockIndex.erase(hashBlock);
+    }
+};
+
+} // anonymous namespace
+
+// Writes a snapshot of the synthetic state, which is done every 10000 blocks and
+// after 100 consecutive journals.
+static void OmniPersistSnapshot(benchmark::State& state)
+{
+    omnibench::OpenDatabases();
+    omnibench::GenerateState(omnibench::GetStateSize());
+    CBenchBlockIndex blockIndex;
+
+    while (state.KeepRunning()) {
+        LOCK2(cs_main, cs_tally);
+        assert(0 == PersistInMemoryState(&blockIndex.index));
+    }
+
+    omnibench::CloseDatabases();
+}
+
+// Restores the synthetic state from a snapshot, which is done during startup.
+static void OmniRestoreSnapshot(benchmark::State& state)
+{
+    omnibench::OpenDatabases();
+    omnibench::GenerateState(omnibench::GetStateSize());
+    CBenchBlockIndex blockIndex;
+    {
+        LOCK2(cs_main, cs_tally);
+        assert(0 == PersistInMemoryState(&blockIndex.index));
+    }
+
+    while (state.KeepRunning()) {
+        LOCK(cs_tally);
+        assert(0 == RestoreStateFiles(&blockIndex.index));
+    }
+
+    omnibench::CloseDatabases();
+}
+
+BENCHMARK(OmniPersistSnapshot, 10);
+BENCHMARK(OmniRestoreSnapshot, 10);
@@ -0,0 +1,129 @@
+#include <bench/bench.h>
+
+#include <omnicore/omnicore.h>
+#include <omnicore/rules.h>
+#include <omnicore/sp.h>
+
+#include <chainparams.h>
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace {
+
+//! Height, at which the transactions are checked
+const int BENCH_BLOCK_HEIGHT = 562708;
+
+/** The header of a payload: transaction type, version and property. */
+struct PayloadHeader
+{
+    uint16_t txType;
+    uint16_t version;
+    uint32_t propertyId;
+};
+
+// A mix of payload headers similar to mainnet traffic, which mostly consists of
+// simple sends of property 31, followed by DEx, MetaDEx, STO and property management
+// transactions. A few headers are not allowed, because of the wildcard or type.
+const PayloadHeader vHeaders[] = {
+    { MSC_TYPE_SIMPLE_SEND,               MP_TX_PKT_V0, 31 },
+    { MSC_TYPE_SIMPLE_SEND,               MP_TX_PKT_V0, 31 },
+    { MSC_TYPE_SIMPLE_SEND,               MP_TX_PKT_V0, 31 },
+    { MSC_TYPE_SIMPLE_SEND,               MP_TX_PKT_V0, 31 },
+    { MSC_TYPE_SIMPLE_SEND,               MP_TX_PKT_V0, 1 },
+    { MSC_TYPE_SIMPLE_SEND,               MP_TX_PKT_V0, 3 },
+    { MSC_TYPE_SEND_ALL,                  MP_TX_PKT_V0, 1 },
+    { MSC_TYPE_TRADE_OFFER,               MP_TX_PKT_V1, 1 },
+    { MSC_TYPE_ACCEPT_OFFER_BTC,          MP_TX_PKT_V0, 1 },
+    { MSC_TYPE_METADEX_TRADE,             MP_TX_PKT_V0, 1 },
+    { MSC_TYPE_METADEX_CANCEL_PRICE,      MP_TX_PKT_V0, 1 },
+    { MSC_TYPE_METADEX_CANCEL_ECOSYSTEM,  MP_TX_PKT_V0, 1 },
+    { MSC_TYPE_SEND_TO_OWNERS,            MP_TX_PKT_V0, 3 },
+    { MSC_TYPE_SEND_TO_OWNERS,            MP_TX_PKT_V1, 3 },
+    { MSC_TYPE_CREATE_PROPERTY_FIXED,     MP_TX_PKT_V0, 1 },
+    { MSC_TYPE_CREATE_PROPERTY_MANUAL,    MP_TX_PKT_V0, 1 },
+    { MSC_TYPE_GRANT_PROPERTY_TOKENS,     MP_TX_PKT_V0, 3 },
+    { MSC_TYPE_SIMPLE_SEND,               MP_TX_PKT_V0, TEST_ECO_PROPERTY_1 },
+    { MSC_TYPE_SIMPLE_SEND,               MP_TX_PKT_V0, OMNI_PROPERTY_BTC },
+    { MSC_TYPE_OFFER_ACCEPT_A_BET,        MP_TX_PKT_V0, 1 },
+    { MSC_TYPE_SAVINGS_MARK,              MP_TX_PKT_V0, 1 },
+    { OMNICORE_MESSAGE_TYPE_ACTIVATION,   0xFFFF,       OMNI_PROPERTY_BTC },
+};
+
+const size_t nHeaders = sizeof(vHeaders) / sizeof(vHeaders[0]);
+
+/** The former check, which scans a fresh list of restrictions per transaction. */
+bool IsTransactionTypeAllowedLegacy(int txBlock, uint32_t txProperty, uint16_t txType, uint16_t version)
+{
+    const std::vector<mastercore::TransactionRestriction>& vTxRestrictions = mastercore::ConsensusParams().GetRestrictions();
+
+    for (std::vector<mastercore::TransactionRestriction>::const_iterator it = vTxRestrictions.begin(); it != vTxRestrictions.end(); ++it) {
+        const mastercore::TransactionRestriction& entry = *it;
+        if (entry.txType != txType || entry.txVersion != version) {
+            continue;
+        }
+        if (OMNI_PROPERTY_BTC == txProperty && !entry.allowWildcard) {
+            continue;
+        }
+        if (mastercore::isTestEcosystemProperty(txProperty)) {
+            return true;
+        }
+        if (txBlock >= entry.activationBlock) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+} // anonymous namespace
+
+// Checks the payload headers with the former linear scan over the restrictions.
+static void OmniTxTypeAllowedLegacy(benchmark::State& state)
+{
+    SelectParams(CBaseChainParams::MAIN);
+
+    while (state.KeepRunning()) {
+        size_t nAllowed = 0;
+        for (size_t n = 0; n < nHeaders; ++n) {
+            const PayloadHeader& header = vHeaders[n];
+            if (IsTransactionTypeAllowedLegacy(BENCH_BLOCK_HEIGHT, header.propertyId, header.txType, header.version)) ++nAllowed;
+        }
+        assert(nAllowed > 0 && nAllowed < nHeaders);
+    }
+}
+
+// Checks the payload headers with the compiled restriction table.
+static void OmniTxTypeAllowed(benchmark::State& state)
+{
+    SelectParams(CBaseChainParams::MAIN);
+
+    while (state.KeepRunning()) {
+        size_t nAllowed = 0;
+        for (size_t n = 0; n < nHeaders; ++n) {
+            const PayloadHeader& header = vHeaders[n];
+            if (mastercore::IsTransactionTypeAllowed(BENCH_BLOCK_HEIGHT, header.propertyId, header.txType, header.version)) ++nAllowed;
+        }
+        assert(nAllowed > 0 && nAllowed < nHeaders);
+    }
+}
+
+// Checks the feature activations, which are consulted while processing a transaction.
+static void OmniFeatureActivated(benchmark::State& state)
+{
+    SelectParams(CBaseChainParams::MAIN);
+
+    while (state.KeepRunning()) {
+        size_t nActivated = 0;
+        for (uint16_t featureId = mastercore::FEATURE_CLASS_C; featureId <= mastercore::FEATURE_FREEDEX; ++featureId) {
+            if (mastercore::IsFeatureActivated(featureId, BENCH_BLOCK_HEIGHT)) ++nActivated;
+        }
+        assert(nActivated > 0);
+    }
+}
+
+BENCHMARK(OmniTxTypeAllowedLegacy, 50 * 1000);
+BENCHMARK(OmniTxTypeAllowed, 50 * 1000);
+BENCHMARK(OmniFeatureActivated, 50 * 1000);
@@ -0,0 +1,151 @@
+#include <bench/omnicore_state.h>
+
+#include <omnicore/consensushash.h>
+#include <omnicore/dbfees.h>
+#include <omnicore/dbspinfo.h>
+#include <omnicore/dbstolist.h>
+#include <omnicore/dbtradelist.h>
+#include <omnicore/dbtransaction.h>
+#include <omnicore/dbtxlist.h>
+#include <omnicore/mdex.h>
+#include <omnicore/omnicore.h>
+#include <omnicore/sp.h>
+#include <omnicore/tally.h>
+
+#include <amount.h>
+#include <chainparams.h>
+#include <clientversion.h>
+#include <fs.h>
+#include <hash.h>
+#include <key_io.h>
+#include <pubkey.h>
+#include <streams.h>
+#include <sync.h>
+#include <tinyformat.h>
+#include <util/system.h>
+
+#include <assert.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <string>
+
+//! Path for file based persistence
+extern fs::path pathStateFiles;
+
+using namespace mastercore;
+
+namespace omnibench {
+
+//! Transaction numbers used for the generated state, to avoid collisions with the benchmarks
+static const unsigned int STATE_TXID_BASE = 0x80000000;
+
+StateSize GetStateSize()
+{
+    int64_t nScale = std::max<int64_t>(1, gArgs.GetArg("-omni-state-scale", DEFAULT_STATE_SCALE));
+
+    StateSize size;
+    size.nAddresses = 1000 * nScale;
+    size.nProperties = 10 * nScale;
+    size.nOrders = 500 * nScale;
+
+    return size;
+}
+
+std::string BenchAddress(unsigned int n)
+{
+    CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+    ssKey << std::string("address") << n;
+
+    return EncodeDestination(CKeyID(Hash160(ssKey.begin(), ssKey.end())));
+}
+
+uint256 BenchTxid(unsigned int n)
+{
+    return SerializeHash(n);
+}
+
+uint32_t BenchProperty(unsigned int n)
+{
+    return OMNI_PROPERTY_TMSC + 1 + n;
+}
+
+void OpenDatabases()
+{
+    SelectParams(CBaseChainParams::MAIN);
+
+    pDbTradeList = new CMPTradeList(GetDataDir() / "MP_tradelist", true);
+    pDbStoList = new CMPSTOList(GetDataDir() / "MP_stolist", true);
+    pDbTransactionList = new CMPTxList(GetDataDir() / "MP_txlist", true);
+    pDbSpInfo = new CMPSPInfo(GetDataDir() / "MP_spinfo", true);
+    pDbTransaction = new COmniTransactionDB(GetDataDir() / "Omni_TXDB", true);
+    pDbFeeCache = new COmniFeeCache(GetDataDir() / "OMNI_feecache", true);
+    pDbFeeHistory = new COmniFeeHistory(GetDataDir() / "OMNI_feehistory", true);
+
+    pathStateFiles = GetDataDir() / "MP_persist";
+    fs::remove_all(pathStateFiles);
+    TryCreateDirectories(pathStateFiles);
+}
+
+void CloseDatabases()
+{
+    LOCK(cs_tally);
+
+    ClearTallyMap();
+    metadex.clear();
+    ResetOrderbookCommitments();
+
+    delete pDbTradeList;
+    delete pDbStoList;
+    delete pDbTransactionList;
+    delete pDbSpInfo;
+    delete pDbTransaction;
+    delete pDbFeeCache;
+    delete pDbFeeHistory;
+    pDbTradeList = nullptr;
+    pDbStoList = nullptr;
+    pDbTransactionList = nullptr;
+    pDbSpInfo = nullptr;
+    pDbTransaction = nullptr;
+    pDbFeeCache = nullptr;
+    pDbFeeHistory = nullptr;
+}
+
+void GenerateState(const StateSize& size)
+{
+    assert(size.nAddresses > 0 && size.nProperties > 0);
+
+    LOCK(cs_tally);
+
+    for (unsigned int n = 0; n < size.nProperties; ++n) {
+        CMPSPInfo::Entry sp;
+        sp.issuer = BenchAddress(n);
+        sp.prop_type = MSC_PROPERTY_TYPE_DIVISIBLE;
+        sp.num_tokens = 1000000 * COIN;
+        sp.name = strprintf("Bench property %d", n);
+        sp.fixed = true;
+        sp.txid = BenchTxid(STATE_TXID_BASE + n);
+        uint32_t propertyId = pDbSpInfo->putSP(OMNI_PROPERTY_MSC, sp);
+        assert(propertyId == BenchProperty(n));
+    }
+
+    for (unsigned int n = 0; n < size.nAddresses; ++n) {
+        const std::string address = BenchAddress(n);
+        assert(update_tally_map(address, OMNI_PROPERTY_MSC, 1000 * COIN + n, BALANCE));
+        assert(update_tally_map(address, BenchProperty(n % size.nProperties), 100 * COIN + n, BALANCE));
+        assert(update_tally_map(address, BenchProperty((7 * n + 1) % size.nProperties), 10 * COIN + n, BALANCE));
+    }
+
+    // orders of the same property are spread over increasing price levels
+    for (unsigned int n = 0; n < size.nOrders; ++n) {
+        const std::string seller = BenchAddress(n % size.nAddresses);
+        const uint32_t propertyId = BenchProperty(n % size.nProperties);
+        const int64_t amountDesired = 1000 + n / size.nProperties;
+        const uint256 txid = BenchTxid(STATE_TXID_BASE + size.nProperties + n);
+
+        assert(update_tally_map(seller, propertyId, 1000, BALANCE));
+        assert(0 == MetaDEx_ADD(seller, propertyId, 1000, BENCH_STATE_HEIGHT, OMNI_PROPERTY_MSC, amountDesired, txid, n));
+    }
+}
+
+} // namespace omnibench
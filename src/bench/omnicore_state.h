@@ -0,0 +1,67 @@
+#ifndef BITCOIN_BENCH_OMNICORE_STATE_H
+#define BITCOIN_BENCH_OMNICORE_STATE_H
+
+#include <uint256.h>
+
+#include <stdint.h>
+#include <string>
+
+/** Helpers to set up a synthetic Omni Core state for the benchmarks. */
+namespace omnibench {
+
+//! Height, at which the synthetic state is created and transactions are processed
+static const int BENCH_STATE_HEIGHT = 562708;
+
+//! Default scaling factor of the synthetic state, see -omni-state-scale
+static const int DEFAULT_STATE_SCALE = 1;
+
+/** The dimensions of a synthetic state. */
+struct StateSize
+{
+    //! Number of addresses with balances
+    unsigned int nAddresses;
+    //! Number of created properties, besides Omni and Test Omni
+    unsigned int nProperties;
+    //! Number of open MetaDEx orders
+    unsigned int nOrders;
+};
+
+/**
+ * Returns the dimensions of the synthetic state, multiplied by -omni-state-scale.
+ *
+ * The default state consists of 1000 addresses, 10 properties and 500 open orders.
+ * A scale of 100 gets close to the state of the main network.
+ */
+StateSize GetStateSize();
+
+/** Returns a unique, valid address for the given number. */
+std::string BenchAddress(unsigned int n);
+
+/** Returns a unique transaction hash for the given number. */
+uint256 BenchTxid(unsigned int n);
+
+/** Returns the identifier of the n-th created property. */
+uint32_t BenchProperty(unsigned int n);
+
+/**
+ * Opens empty databases and selects the main network.
+ *
+ * Must be paired with CloseDatabases().
+ */
+void OpenDatabases();
+
+/** Clears the in-memory state and closes the databases. */
+void CloseDatabases();
+
+/**
+ * Creates properties, balances and open orders with the given dimensions.
+ *
+ * Every address holds Omni and two of the created properties. Each order sells
+ * one of the created properties for Omni. Orders are spread over price levels,
+ * and the best price level of each property has a price of 1.
+ */
+void GenerateState(const StateSize& size);
+
+} // namespace omnibench
+
+#endif // BITCOIN_BENCH_OMNICORE_STATE_H
@@ -0,0 +1,84 @@
+#include <bench/bench.h>
+#include <bench/omnicore_state.h>
+
+#include <omnicore/consensushash.h>
+#include <omnicore/omnicore.h>
+#include <omnicore/sto.h>
+#include <omnicore/tally.h>
+
+#include <sync.h>
+#include <uint256.h>
+
+#include <assert.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+using namespace mastercore;
+
+// Transfers tokens back and forth between addresses of a synthetic state, like
+// simple sends, which are the majority of all Omni transactions.
+static void OmniUpdateTally(benchmark::State& state)
+{
+    const omnibench::StateSize size = omnibench::GetStateSize();
+    omnibench::OpenDatabases();
+    omnibench::GenerateState(size);
+
+    std::vector<std::string> vAddresses;
+    for (unsigned int n = 0; n < 100; ++n) {
+        vAddresses.push_back(omnibench::BenchAddress((n * 7919) % size.nAddresses));
+    }
+
+    while (state.KeepRunning()) {
+        LOCK(cs_tally);
+        for (size_t n = 0; n + 1 < vAddresses.size(); ++n) {
+            assert(update_tally_map(vAddresses[n], OMNI_PROPERTY_MSC, -1000, BALANCE));
+            assert(update_tally_map(vAddresses[n + 1], OMNI_PROPERTY_MSC, 1000, BALANCE));
+        }
+        for (size_t n = vAddresses.size() - 1; n > 0; --n) {
+            assert(update_tally_map(vAddresses[n], OMNI_PROPERTY_MSC, -1000, BALANCE));
+            assert(update_tally_map(vAddresses[n - 1], OMNI_PROPERTY_MSC, 1000, BALANCE));
+        }
+    }
+
+    omnibench::CloseDatabases();
+}
+
+// Determines the receivers of a "send to owners" transaction of the property,
+// which is held by the most addresses of the synthetic state.
+static void OmniSTOGetReceivers(benchmark::State& state)
+{
+    const omnibench::StateSize size = omnibench::GetStateSize();
+    omnibench::OpenDatabases();
+    omnibench::GenerateState(size);
+
+    const std::string sender = omnibench::BenchAddress(0);
+    const uint32_t propertyId = omnibench::BenchProperty(1);
+
+    while (state.KeepRunning()) {
+        OwnerAddrType receivers = STO_GetReceivers(sender, propertyId, 1000000);
+        assert(!receivers.empty());
+    }
+
+    omnibench::CloseDatabases();
+}
+
+// Calculates the consensus hash of the synthetic state, including balances,
+// open orders and properties.
+static void OmniConsensusHash(benchmark::State& state)
+{
+    const omnibench::StateSize size = omnibench::GetStateSize();
+    omnibench::OpenDatabases();
+    omnibench::GenerateState(size);
+
+    while (state.KeepRunning()) {
+        uint256 consensusHash = GetConsensusHash();
+        assert(!consensusHash.IsNull());
+    }
+
+    omnibench::CloseDatabases();
+}
+
+BENCHMARK(OmniUpdateTally, 50);
+BENCHMARK(OmniSTOGetReceivers, 50);
+BENCHMARK(OmniConsensusHash, 10);
@@ -0,0 +1,572 @@
+#include <index/addressindex.h>
+
+#include <chainparams.h>
+#include <primitives/transaction.h>
+#include <pubkey.h>
+#include <script/standard.h>
+#include <txdb.h>
+#include <undo.h>
+#include <util/system.h>
+#include <validation.h>
+
+#include <algorithm>
+#include <map>
+#include <set>
+
+#include <boost/thread.hpp>
+
+constexpr char DB_BEST_BLOCK = 'B';
+constexpr char DB_ADDRESSINDEX = 'a';
+constexpr char DB_ADDRESSBALANCE = 'b';
+constexpr char DB_ADDRESSUNSPENTINDEX = 'u';
+constexpr char DB_SPENTINDEX = 'p';
+constexpr char DB_TIMESTAMPINDEX = 's';
+constexpr char DB_BLOCKHASHINDEX = 'z';
+
+// Prefixes of the address index of earlier versions in the block tree database
+constexpr char DB_LEGACY_ADDRESSINDEX = 'a';
+constexpr char DB_LEGACY_ADDRESSBALANCE = 'A';
+constexpr char DB_LEGACY_ADDRESSUNSPENTINDEX = 'u';
+constexpr char DB_LEGACY_SPENTINDEX = 'p';
+constexpr char DB_LEGACY_TIMESTAMPINDEX = 'S';
+constexpr char DB_LEGACY_BLOCKHASHINDEX = 'z';
+
+std::unique_ptr<AddressIndex> g_addressindex;
+
+namespace {
+
+/** The index entries of a block, which are written, or erased, when the block is disconnected. */
+struct BlockEntries
+{
+    std::vector<std::pair<CAddressIndexKey, CAmount>> address_index;
+    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue>> unspent_index;
+    std::vector<std::pair<CSpentIndexKey, CSpentIndexValue>> spent_index;
+};
+
+} // anonymous namespace
+
+/**
+ * Access to the address index database (indexes/addressindex/)
+ *
+ * The entries of a block are written in one batch, together with the block as
+ * best block, so the running balances can't be applied twice after a restart.
+ */
+class AddressIndex::DB : public BaseIndex::DB
+{
+private:
+    /// Apply the balance changes of a block to the running balances of the addresses.
+    bool UpdateAddressBalances(CDBBatch& batch, const std::vector<std::pair<CAddressIndexKey, CAmount>>& address_index, bool f_undo);
+
+public:
+    explicit DB(size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
+
+    bool ReadAddressIndex(const uint256& address_hash, int type,
+                          const std::function<bool(const CAddressIndexKey&, CAmount)>& visitor,
+                          int start, int end);
+
+    bool ReadAddressBalance(const uint256& address_hash, int type, CAddressBalanceValue& value) const;
+
+    bool ReadAddressUnspentIndex(const uint256& address_hash, int type,
+                                 std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue>>& unspent_outputs);
+
+    bool ReadSpentIndex(const CSpentIndexKey& key, CSpentIndexValue& value) const;
+
+    bool ReadTimestampIndex(unsigned int high, unsigned int low, bool f_active_only,
+                            std::vector<std::pair<uint256, unsigned int>>& hashes);
+
+    /// Write the entries of a connected block, or erase the ones of a disconnected block.
+    bool WriteBlock(const BlockEntries& entries, const CBlockIndex* pindex, bool f_undo);
+
+    /// Erase all entries and the best block.
+    bool EraseAll();
+};
+
+/** Erases all records with a prefix and a key of type K. */
+template <typename K>
+static bool EraseRecords(CDBWrapper& db, char prefix)
+{
+    const size_t batch_size = (size_t)gArgs.GetArg("-dbbatchsize", nDefaultDbBatchSize);
+    CDBBatch batch(db);
+
+    std::unique_ptr<CDBIterator> cursor(db.NewIterator());
+    for (cursor->Seek(prefix); cursor->Valid(); cursor->Next()) {
+        boost::this_thread::interruption_point();
+        std::pair<char, K> key;
+        if (!cursor->GetKey(key) || key.first != prefix) {
+            break;
+        }
+        batch.Erase(key);
+        if (batch.SizeEstimate() > batch_size) {
+            if (!db.WriteBatch(batch)) return false;
+            batch.Clear();
+        }
+    }
+
+    return db.WriteBatch(batch);
+}
+
+/** Block locator of a block, which doesn't depend on the active chain. */
+static CBlockLocator GetBlockLocator(const CBlockIndex* pindex)
+{
+    std::vector<uint256> have;
+    int step = 1;
+    while (pindex) {
+        have.push_back(pindex->GetBlockHash());
+        if (pindex->nHeight == 0) break;
+        pindex = pindex->GetAncestor(std::max(pindex->nHeight - step, 0));
+        if (have.size() > 10) step *= 2;
+    }
+    return CBlockLocator(have);
+}
+
+AddressIndex::DB::DB(size_t n_cache_size, bool f_memory, bool f_wipe) :
+    BaseIndex::DB(GetDataDir() / "indexes" / "addressindex", n_cache_size, f_memory, f_wipe)
+{}
+
+/**
+ * Passes the balance changes of an address to the visitor in the order of the
+ * index, until the visitor returns false.
+ */
+bool AddressIndex::DB::ReadAddressIndex(const uint256& address_hash, int type,
+                                        const std::function<bool(const CAddressIndexKey&, CAmount)>& visitor,
+                                        int start, int end)
+{
+    std::unique_ptr<CDBIterator> cursor(NewIterator());
+
+    if (start > 0 && end > 0) {
+        cursor->Seek(std::make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorHeightKey(type, address_hash, start)));
+    } else {
+        cursor->Seek(std::make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorKey(type, address_hash)));
+    }
+
+    for (; cursor->Valid(); cursor->Next()) {
+        boost::this_thread::interruption_point();
+        std::pair<char, CAddressIndexKey> key;
+        if (!cursor->GetKey(key) || key.first != DB_ADDRESSINDEX ||
+                key.second.type != (unsigned int)type || key.second.hashBytes != address_hash) {
+            break;
+        }
+        if (end > 0 && key.second.blockHeight > end) {
+            break;
+        }
+        CAmount value;
+        if (!cursor->GetValue(value)) {
+            return error("%s: failed to get address index value", __func__);
+        }
+        if (!visitor(key.second, value)) {
+            break;
+        }
+    }
+
+    return true;
+}
+
+bool AddressIndex::DB::ReadAddressBalance(const uint256& address_hash, int type, CAddressBalanceValue& value) const
+{
+    return Read(std::make_pair(DB_ADDRESSBALANCE, CAddressIndexIteratorKey(type, address_hash)), value);
+}
+
+bool AddressIndex::DB::ReadAddressUnspentIndex(const uint256& address_hash, int type,
+                                               std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue>>& unspent_outputs)
+{
+    std::unique_ptr<CDBIterator> cursor(NewIterator());
+
+    for (cursor->Seek(std::make_pair(DB_ADDRESSUNSPENTINDEX, CAddressIndexIteratorKey(type, address_hash))); cursor->Valid(); cursor->Next()) {
+        boost::this_thread::interruption_point();
+        std::pair<char, CAddressUnspentKey> key;
+        if (!cursor->GetKey(key) || key.first != DB_ADDRESSUNSPENTINDEX ||
+                key.second.type != (unsigned int)type || key.second.hashBytes != address_hash) {
+            break;
+        }
+        CAddressUnspentValue value;
+        if (!cursor->GetValue(value)) {
+            return error("%s: failed to get address unspent value", __func__);
+        }
+        unspent_outputs.emplace_back(key.second, value);
+    }
+
+    return true;
+}
+
+bool AddressIndex::DB::ReadSpentIndex(const CSpentIndexKey& key, CSpentIndexValue& value) const
+{
+    return Read(std::make_pair(DB_SPENTINDEX, key), value);
+}
+
+bool AddressIndex::DB::ReadTimestampIndex(unsigned int high, unsigned int low, bool f_active_only,
+                                          std::vector<std::pair<uint256, unsigned int>>& hashes)
+{
+    std::unique_ptr<CDBIterator> cursor(NewIterator());
+
+    for (cursor->Seek(std::make_pair(DB_TIMESTAMPINDEX, CTimestampIndexIteratorKey(low))); cursor->Valid(); cursor->Next()) {
+        boost::this_thread::interruption_point();
+        std::pair<char, CTimestampIndexKey> key;
+        if (!cursor->GetKey(key) || key.first != DB_TIMESTAMPINDEX || key.second.timestamp >= high) {
+            break;
+        }
+        if (f_active_only) {
+            LOCK(cs_main);
+            const CBlockIndex* pindex = LookupBlockIndex(key.second.blockHash);
+            if (!pindex || !chainActive.Contains(pindex)) {
+                continue;
+            }
+        }
+        hashes.emplace_back(key.second.blockHash, key.second.timestamp);
+    }
+
+    return true;
+}
+
+bool AddressIndex::DB::UpdateAddressBalances(CDBBatch& batch, const std::vector<std::pair<CAddressIndexKey, CAmount>>& address_index, bool f_undo)
+{
+    typedef std::pair<unsigned int, uint256> AddressId;
+    std::map<AddressId, CAddressBalanceValue> balances;
+    std::set<std::pair<AddressId, uint256>> txs;
+    int height = 0;
+
+    for (const auto& entry : address_index) {
+        const CAddressIndexKey& key = entry.first;
+        const CAmount delta = f_undo ? -entry.second : entry.second;
+        const AddressId address(key.type, key.hashBytes);
+        height = key.blockHeight;
+
+        auto it = balances.find(address);
+        if (it == balances.end()) {
+            CAddressBalanceValue value;
+            if (!ReadAddressBalance(key.hashBytes, key.type, value)) {
+                value.SetNull();
+            }
+            it = balances.emplace(address, value).first;
+        }
+
+        CAddressBalanceValue& value = it->second;
+        value.balance += delta;
+        if (entry.second > 0) {
+            value.received += delta;
+        }
+        // an address may have several inputs and outputs in one transaction
+        if (txs.emplace(address, key.txhash).second) {
+            if (!f_undo) {
+                ++value.txCount;
+            } else if (value.txCount > 0) {
+                --value.txCount;
+            }
+        }
+        if (!f_undo) {
+            value.lastHeight = std::max(value.lastHeight, key.blockHeight);
+        }
+    }
+
+    std::unique_ptr<CDBIterator> cursor;
+    for (auto& item : balances) {
+        const CAddressIndexIteratorKey address(item.first.first, item.first.second);
+        CAddressBalanceValue& value = item.second;
+
+        if (f_undo && !value.IsNull() && value.lastHeight >= height) {
+            // the entries of the disconnected block are not yet erased, so the
+            // entry before the first one of them is the previous activity
+            if (!cursor) cursor.reset(NewIterator());
+            cursor->Seek(std::make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorHeightKey(address.type, address.hashBytes, height)));
+            value.lastHeight = 0;
+            if (cursor->Valid()) {
+                cursor->Prev();
+                std::pair<char, CAddressIndexKey> key;
+                if (cursor->Valid() && cursor->GetKey(key) && key.first == DB_ADDRESSINDEX &&
+                        key.second.type == address.type && key.second.hashBytes == address.hashBytes) {
+                    value.lastHeight = key.second.blockHeight;
+                }
+            }
+        }
+
+        if (value.IsNull()) {
+            batch.Erase(std::make_pair(DB_ADDRESSBALANCE, address));
+        } else {
+            batch.Write(std::make_pair(DB_ADDRESSBALANCE, address), value);
+        }
+    }
+
+    return true;
+}
+
+bool AddressIndex::DB::WriteBlock(const BlockEntries& entries, const CBlockIndex* pindex, bool f_undo)
+{
+    const uint256 block_hash = pindex->GetBlockHash();
+    CDBBatch batch(*this);
+
+    for (const auto& entry : entries.address_index) {
+        if (f_undo) {
+            batch.Erase(std::make_pair(DB_ADDRESSINDEX, entry.first));
+        } else {
+            batch.Write(std::make_pair(DB_ADDRESSINDEX, entry.first), entry.second);
+        }
+    }
+    if (!UpdateAddressBalances(batch, entries.address_index, f_undo)) {
+        return false;
+    }
+    for (const auto& entry : entries.unspent_index) {
+        if (entry.second.IsNull()) {
+            batch.Erase(std::make_pair(DB_ADDRESSUNSPENTINDEX, entry.first));
+        } else {
+            batch.Write(std::make_pair(DB_ADDRESSUNSPENTINDEX, entry.first), entry.second);
+        }
+    }
+    for (const auto& entry : entries.spent_index) {
+        if (entry.second.IsNull()) {
+            batch.Erase(std::make_pair(DB_SPENTINDEX, entry.first));
+        } else {
+            batch.Write(std::make_pair(DB_SPENTINDEX, entry.first), entry.second);
+        }
+    }
+
+    if (!f_undo) {
+        // the logical timestamp of a block is greater than the one of its predecessor
+        unsigned int logical_ts = pindex->nTime;
+        CTimestampBlockIndexValue prev_ts;
+        if (pindex->pprev && Read(std::make_pair(DB_BLOCKHASHINDEX, pindex->pprev->GetBlockHash()), prev_ts)) {
+            logical_ts = std::max(logical_ts, prev_ts.ltimestamp + 1);
+        }
+        batch.Write(std::make_pair(DB_TIMESTAMPINDEX, CTimestampIndexKey(logical_ts, block_hash)), 0);
+        batch.Write(std::make_pair(DB_BLOCKHASHINDEX, block_hash), CTimestampBlockIndexValue(logical_ts));
+        batch.Write(DB_BEST_BLOCK, GetBlockLocator(pindex));
+    } else {
+        CTimestampBlockIndexValue ts;
+        if (Read(std::make_pair(DB_BLOCKHASHINDEX, block_hash), ts)) {
+            batch.Erase(std::make_pair(DB_TIMESTAMPINDEX, CTimestampIndexKey(ts.ltimestamp, block_hash)));
+            batch.Erase(std::make_pair(DB_BLOCKHASHINDEX, block_hash));
+        }
+        batch.Write(DB_BEST_BLOCK, GetBlockLocator(pindex->pprev));
+    }
+
+    return WriteBatch(batch);
+}
+
+bool AddressIndex::DB::EraseAll()
+{
+    return EraseRecords<CAddressIndexKey>(*this, DB_ADDRESSINDEX) &&
+           EraseRecords<CAddressIndexIteratorKey>(*this, DB_ADDRESSBALANCE) &&
+           EraseRecords<CAddressUnspentKey>(*this, DB_ADDRESSUNSPENTINDEX) &&
+           EraseRecords<CSpentIndexKey>(*this, DB_SPENTINDEX) &&
+           EraseRecords<CTimestampIndexKey>(*this, DB_TIMESTAMPINDEX) &&
+           EraseRecords<uint256>(*this, DB_BLOCKHASHINDEX) &&
+           Erase(DB_BEST_BLOCK, true);
+}
+
+/**
+ * Drops the address index of earlier versions from the block tree database,
+ * which was updated while blocks were connected, and was indicated with a flag.
+ */
+static bool EraseLegacyData(CBlockTreeDB& block_tree_db)
+{
+    bool f_legacy_flag = false;
+    block_tree_db.ReadFlag("addressindex", f_legacy_flag);
+    if (!f_legacy_flag) {
+        return true;
+    }
+
+    LogPrintf("Removing the address index of the block tree database...\n");
+    if (!EraseRecords<CAddressIndexKey>(block_tree_db, DB_LEGACY_ADDRESSINDEX) ||
+        !EraseRecords<CAddressIndexIteratorKey>(block_tree_db, DB_LEGACY_ADDRESSBALANCE) ||
+        !EraseRecords<CAddressUnspentKey>(block_tree_db, DB_LEGACY_ADDRESSUNSPENTINDEX) ||
+        !EraseRecords<CSpentIndexKey>(block_tree_db, DB_LEGACY_SPENTINDEX) ||
+        !EraseRecords<CTimestampIndexKey>(block_tree_db, DB_LEGACY_TIMESTAMPINDEX) ||
+        !EraseRecords<uint256>(block_tree_db, DB_LEGACY_BLOCKHASHINDEX)) {
+        return error("%s: failed to erase the address index", __func__);
+    }
+
+    return block_tree_db.WriteFlag("addressindex", false);
+}
+
+/** Gets the address index key of a script. Returns false, if it has no address. */
+static bool GetAddressKey(const CScript& script, int& type, uint256& hash)
+{
+    CTxDestination dest;
+    if (!ExtractDestination(script, dest)) {
+        return false;
+    }
+    std::vector<unsigned char> bytes(boost::apply_visitor(DataVisitor(), dest));
+    if (bytes.empty()) {
+        return false;
+    }
+    std::vector<unsigned char> address_bytes(32);
+    std::copy(bytes.begin(), bytes.end(), address_bytes.begin());
+    type = dest.which();
+    hash = uint256(address_bytes);
+    return true;
+}
+
+/**
+ * Collects the index entries of a block. The previous outputs spent by the
+ * block are taken from its undo data.
+ *
+ * Outputs may be spent within the same block, so the unspent index entries of
+ * a disconnected block are collected in reverse order.
+ */
+static bool GetBlockEntries(const CBlock& block, const CBlockUndo& block_undo, int height, bool f_undo, BlockEntries& entries)
+{
+    if (block_undo.vtxundo.size() + 1 != block.vtx.size()) {
+        return error("%s: block and undo data inconsistent", __func__);
+    }
+
+    for (size_t n = 0; n < block.vtx.size(); ++n) {
+        const size_t i = f_undo ? block.vtx.size() - 1 - n : n;
+        const CTransaction& tx = *block.vtx[i];
+        const uint256& txid = tx.GetHash();
+        int type;
+        uint256 hash;
+
+        auto add_inputs = [&]() {
+            const CTxUndo& tx_undo = block_undo.vtxundo[i - 1];
+            for (size_t j = 0; j < tx.vin.size(); ++j) {
+                const COutPoint& prevout = tx.vin[j].prevout;
+                const Coin& coin = tx_undo.vprevout[j];
+                if (!GetAddressKey(coin.out.scriptPubKey, type, hash)) {
+                    continue;
+                }
+                entries.address_index.emplace_back(CAddressIndexKey(type, hash, height, i, txid, j, true), -coin.out.nValue);
+                entries.unspent_index.emplace_back(CAddressUnspentKey(type, hash, prevout.hash, prevout.n),
+                        f_undo ? CAddressUnspentValue(coin.out.nValue, coin.out.scriptPubKey, coin.nHeight, coin.fCoinBase) : CAddressUnspentValue());
+                entries.spent_index.emplace_back(CSpentIndexKey(prevout.hash, prevout.n),
+                        f_undo ? CSpentIndexValue() : CSpentIndexValue(txid, j, height, coin.out.nValue, type, hash));
+            }
+        };
+
+        auto add_outputs = [&]() {
+            for (size_t k = 0; k < tx.vout.size(); ++k) {
+                const CTxOut& out = tx.vout[k];
+                if (!GetAddressKey(out.scriptPubKey, type, hash)) {
+                    continue;
+                }
+                entries.address_index.emplace_back(CAddressIndexKey(type, hash, height, i, txid, k, false), out.nValue);
+                entries.unspent_index.emplace_back(CAddressUnspentKey(type, hash, txid, k),
+                        f_undo ? CAddressUnspentValue() : CAddressUnspentValue(out.nValue, out.scriptPubKey, height, tx.IsCoinBase()));
+            }
+        };
+
+        if (!tx.IsCoinBase() && block_undo.vtxundo[i - 1].vprevout.size() != tx.vin.size()) {
+            return error("%s: transaction and undo data inconsistent", __func__);
+        }
+
+        if (f_undo) {
+            add_outputs();
+            if (!tx.IsCoinBase()) add_inputs();
+        } else {
+            if (!tx.IsCoinBase()) add_inputs();
+            add_outputs();
+        }
+    }
+
+    return true;
+}
+
+AddressIndex::AddressIndex(size_t n_cache_size, bool f_memory, bool f_wipe)
+    : m_db(MakeUnique<AddressIndex::DB>(n_cache_size, f_memory, f_wipe))
+{}
+
+AddressIndex::~AddressIndex() {}
+
+bool AddressIndex::Init()
+{
+    {
+        LOCK(cs_main);
+
+        // After an unclean shutdown the index may be ahead of the known blocks,
+        // and the running balances can't be rewound without them.
+        CBlockLocator locator;
+        if (m_db->ReadBestBlock(locator) && !locator.IsNull() && !LookupBlockIndex(locator.vHave.front())) {
+            LogPrintf("%s: best block of the index is unknown, rebuilding it\n", GetName());
+            if (!m_db->EraseAll()) {
+                return false;
+            }
+        }
+    }
+
+    return BaseIndex::Init();
+}
+
+bool AddressIndex::Prepare()
+{
+    return EraseLegacyData(*pblocktree);
+}
+
+bool AddressIndex::WriteBlock(const CBlock& block, const CBlockIndex* pindex, bool f_undo)
+{
+    CBlockUndo block_undo;
+    if (!UndoReadFromDisk(block_undo, pindex)) {
+        return error("%s: failed to read undo data of block %s", __func__, pindex->GetBlockHash().ToString());
+    }
+
+    BlockEntries entries;
+    if (!GetBlockEntries(block, block_undo, pindex->nHeight, f_undo, entries)) {
+        return false;
+    }
+
+    return m_db->WriteBlock(entries, pindex, f_undo);
+}
+
+bool AddressIndex::WriteBlock(const CBlock& block, const CBlockIndex* pindex)
+{
+    // Exclude genesis block transaction because outputs are not spendable.
+    if (pindex->nHeight == 0) return true;
+
+    return WriteBlock(block, pindex, false);
+}
+
+bool AddressIndex::Rewind(const CBlockIndex* current_tip, const CBlockIndex* new_tip)
+{
+    const Consensus::Params& consensus_params = Params().GetConsensus();
+
+    for (const CBlockIndex* pindex = current_tip; pindex != new_tip; pindex = pindex->pprev) {
+        if (pindex->nHeight == 0) break;
+
+        CBlock block;
+        if (!ReadBlockFromDisk(block, pindex, consensus_params)) {
+            return error("%s: failed to read block %s from disk", __func__, pindex->GetBlockHash().ToString());
+        }
+        if (!WriteBlock(block, pindex, true)) {
+            return false;
+        }
+    }
+
+    return BaseIndex::Rewind(current_tip, new_tip);
+}
+
+BaseIndex::DB& AddressIndex::GetDB() const { return *m_db; }
+
+bool AddressIndex::ReadAddressIndex(const uint256& address_hash, int type,
+                                    std::vector<std::pair<CAddressIndexKey, CAmount>>& address_index,
+                                    int start, int end)
+{
+    return m_db->ReadAddressIndex(address_hash, type, [&address_index](const CAddressIndexKey& key, CAmount value) {
+        address_index.emplace_back(key, value);
+        return true;
+    }, start, end);
+}
+
+bool AddressIndex::ReadAddressIndex(const uint256& address_hash, int type,
+                                    const std::function<bool(const CAddressIndexKey&, CAmount)>& visitor,
+                                    int start, int end)
+{
+    return m_db->ReadAddressIndex(address_hash, type, visitor, start, end);
+}
+
+bool AddressIndex::ReadAddressBalance(const uint256& address_hash, int type, CAddressBalanceValue& value)
+{
+    return m_db->ReadAddressBalance(address_hash, type, value);
+}
+
+bool AddressIndex::ReadAddressUnspentIndex(const uint256& address_hash, int type,
+                                           std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue>>& unspent_outputs)
+{
+    return m_db->ReadAddressUnspentIndex(address_hash, type, unspent_outputs);
+}
+
+bool AddressIndex::ReadSpentIndex(const CSpentIndexKey& key, CSpentIndexValue& value)
+{
+    return m_db->ReadSpentIndex(key, value);
+}
+
+bool AddressIndex::ReadTimestampIndex(unsigned int high, unsigned int low, bool f_active_only,
+                                      std::vector<std::pair<uint256, unsigned int>>& hashes)
+{
+    return m_db->ReadTimestampIndex(high, low, f_active_only, hashes);
+}
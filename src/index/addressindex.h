@@ -0,0 +1,91 @@
+#ifndef BITCOIN_INDEX_ADDRESSINDEX_H
+#define BITCOIN_INDEX_ADDRESSINDEX_H
+
+#include <amount.h>
+#include <chain.h>
+#include <index/base.h>
+
+#include <functional>
+#include <utility>
+#include <vector>
+
+struct CAddressBalanceValue;
+struct CAddressIndexKey;
+struct CAddressUnspentKey;
+struct CAddressUnspentValue;
+struct CSpentIndexKey;
+struct CSpentIndexValue;
+
+/**
+ * AddressIndex is used to look up the balance changes, unspent outputs and
+ * running balances of addresses, the inputs spending outputs, and blocks by
+ * timestamp. The index is written to a LevelDB database, which is built from
+ * the block and undo data, and rewound, when blocks are disconnected.
+ */
+class AddressIndex final : public BaseIndex
+{
+protected:
+    class DB;
+
+private:
+    const std::unique_ptr<DB> m_db;
+
+    /// Write or erase the index entries of a block.
+    bool WriteBlock(const CBlock& block, const CBlockIndex* pindex, bool f_undo);
+
+protected:
+    /// Override base class init to rebuild the index, if its best block is unknown.
+    bool Init() override;
+
+    /// Drop the index of earlier versions from the block tree database, which
+    /// can take a while, so it's not done during init.
+    bool Prepare() override;
+
+    bool WriteBlock(const CBlock& block, const CBlockIndex* pindex) override;
+
+    bool Rewind(const CBlockIndex* current_tip, const CBlockIndex* new_tip) override;
+
+    /// The best block is written together with the entries of each block, so
+    /// the locator of the chain state is not used.
+    void ChainStateFlushed(const CBlockLocator& locator) override {}
+
+    BaseIndex::DB& GetDB() const override;
+
+    const char* GetName() const override { return "addressindex"; }
+
+public:
+    /// Constructs the index, which becomes available to be queried.
+    explicit AddressIndex(size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
+
+    // Destructor is declared because this class contains a unique_ptr to an incomplete type.
+    virtual ~AddressIndex() override;
+
+    /// Look up the balance changes of an address, optionally within a range of blocks.
+    bool ReadAddressIndex(const uint256& address_hash, int type,
+                          std::vector<std::pair<CAddressIndexKey, CAmount>>& address_index,
+                          int start = 0, int end = 0);
+
+    /// Pass the balance changes of an address to the visitor, until it returns false.
+    bool ReadAddressIndex(const uint256& address_hash, int type,
+                          const std::function<bool(const CAddressIndexKey&, CAmount)>& visitor,
+                          int start = 0, int end = 0);
+
+    /// Look up the running balance of an address. Returns false, if the address has no activity.
+    bool ReadAddressBalance(const uint256& address_hash, int type, CAddressBalanceValue& value);
+
+    /// Look up the unspent outputs of an address.
+    bool ReadAddressUnspentIndex(const uint256& address_hash, int type,
+                                 std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue>>& unspent_outputs);
+
+    /// Look up the input, which spends an output.
+    bool ReadSpentIndex(const CSpentIndexKey& key, CSpentIndexValue& value);
+
+    /// Look up the blocks with a logical timestamp in the range [low, high).
+    bool ReadTimestampIndex(unsigned int high, unsigned int low, bool f_active_only,
+                            std::vector<std::pair<uint256, unsigned int>>& hashes);
+};
+
+/// The global address index, used by the address RPCs. May be null.
+extern std::unique_ptr<AddressIndex> g_addressindex;
+
+#endif // BITCOIN_INDEX_ADDRESSINDEX_H
@@ -66,9 +66,17 @@ protected:
     /// Initialize internal state from the database and block index.
     virtual bool Init();
 
+    /// Perform maintenance, which would otherwise delay the startup, before the
+    /// index is synced. Runs in the sync thread.
+    virtual bool Prepare() { return true; }
+
     /// Write update index entries for a newly connected block.
     virtual bool WriteBlock(const CBlock& block, const CBlockIndex* pindex) { return true; }
 
+    /// Rewind index to an earlier chain tip during a chain reorg. The tip must
+    /// be an ancestor of the current best block.
+    virtual bool Rewind(const CBlockIndex* current_tip, const CBlockIndex* new_tip);
+
     virtual DB& GetDB() const = 0;
 
     /// Get the name of the index for display in logs.
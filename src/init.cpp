@@ -21,6 +21,7 @@
 #include <httpserver.h>
 #include <httprpc.h>
 #include <interfaces/chain.h>
+#include <index/addressindex.h>
 #include <index/txindex.h>
 #include <key.h>
 #include <validation.h>
@@ -196,6 +197,9 @@ void Interrupt()
     if (g_txindex) {
         g_txindex->Interrupt();
     }
+    if (g_addressindex) {
+        g_addressindex->Interrupt();
+    }
 }
 
 void Shutdown(InitInterfaces& interfaces)
@@ -227,6 +231,7 @@ void Shutdown(InitInterfaces& interfaces)
     if (peerLogic) UnregisterValidationInterface(peerLogic.get());
     if (g_connman) g_connman->Stop();
     if (g_txindex) g_txindex->Stop();
+    if (g_addressindex) g_addressindex->Stop();
 
     StopTorControl();
 
@@ -241,6 +246,7 @@ void Shutdown(InitInterfaces& interfaces)
     g_connman.reset();
     g_banman.reset();
     g_txindex.reset();
+    g_addressindex.reset();
 
     if (g_is_mempool_loaded && gArgs.GetArg("-persistmempool", DEFAULT_PERSIST_MEMPOOL)) {
         DumpMempool();
@@ -556,11 +562,18 @@ void SetupServerArgs()
     // TODO: append help messages somewhere else
     // TODO: translation
     gArgs.AddArg("-startclean", "Clear all persistence files on startup; triggers reparsing of Omni transactions (default: 0)", false, OptionsCategory::OMNI);
-    gArgs.AddArg("-omnitxcache", "The maximum number of transactions in the input transaction cache (default: 500000)", false, OptionsCategory::OMNI);
+    gArgs.AddArg("-omniprevoutcache=<n>", "The maximum size of the cache of previous transaction outputs in megabytes (default: 64)", false, OptionsCategory::OMNI);
+    gArgs.AddArg("-omnitxcache=<n>", "Deprecated and ignored, use -omniprevoutcache instead", true, OptionsCategory::OMNI);
     gArgs.AddArg("-omniprogressfrequency", "Time in seconds after which the initial scanning progress is reported (default: 30)", false, OptionsCategory::OMNI);
     gArgs.AddArg("-omniseedblockfilter", "Set skipping of blocks without Omni transactions during initial scan (default: 1)", false, OptionsCategory::OMNI);
+    gArgs.AddArg("-omniscanlookahead=<n>", "The number of blocks, which are read and classified ahead of processing during initial scan, 0 to scan serially (default: 32)", false, OptionsCategory::OMNI);
+    gArgs.AddArg("-omniscanthreads=<n>", "The number of threads to read and classify blocks during initial scan (default: number of cores, at most 4)", false, OptionsCategory::OMNI);
     gArgs.AddArg("-omnilogfile", "The path of the log file (default: omnicore.log)", false, OptionsCategory::OMNI);
     gArgs.AddArg("-omnidebug=<category>", "Enable or disable log categories, can be \"all\" or \"none\"", false, OptionsCategory::OMNI);
+    gArgs.AddArg("-omnilogflush=<mode>", "When pending log messages are written, can be \"always\", \"interval\" or \"shutdown\" (default: interval)", false, OptionsCategory::OMNI);
+    gArgs.AddArg("-omnilogflushinterval=<n>", "The interval in milliseconds, in which pending log messages are written (default: 1000)", false, OptionsCategory::OMNI);
+    gArgs.AddArg("-omnilogbuffer=<n>", "The size of the buffer for pending log messages in kilobytes (default: 4096)", false, OptionsCategory::OMNI);
+    gArgs.AddArg("-omnilogoverflow=<mode>", "Whether to wait for the log writer, or to drop messages, when the log buffer is full, can be \"block\" or \"drop\" (default: block)", false, OptionsCategory::OMNI);
     gArgs.AddArg("-autocommit", "Enable or disable broadcasting of transactions, when creating transactions (default: 1)", false, OptionsCategory::OMNI);
     gArgs.AddArg("-overrideforcedshutdown", "Overwrite shutdown, triggered by an alert (default: 0)", false, OptionsCategory::OMNI);
     gArgs.AddArg("-omnialertallowsender", "Whitelist senders of alerts, can be \"any\")", false, OptionsCategory::OMNI);
@@ -987,10 +1000,14 @@ bool AppInitParameterInteraction()
         return InitError(strprintf(_("Specified blocks directory \"%s\" does not exist."), gArgs.GetArg("-blocksdir", "").c_str()));
     }
 
-    // if using block pruning, then disallow txindex
+    fAddressIndex = gArgs.GetBoolArg("-experimental-btc-balances", DEFAULT_ADDRINDEX);
+
+    // if using block pruning, then disallow txindex and the address index
     if (gArgs.GetArg("-prune", 0)) {
         if (gArgs.GetBoolArg("-txindex", DEFAULT_TXINDEX))
             return InitError(_("Prune mode is incompatible with -txindex."));
+        if (fAddressIndex)
+            return InitError(_("Prune mode is incompatible with -experimental-btc-balances."));
     }
 
     // -bind and -whitebind can't be set when not listening
@@ -1488,11 +1505,10 @@ bool AppInitMain(InitInterfaces& interfaces)
     nTotalCache = std::max(nTotalCache, nMinDbCache << 20); // total cache cannot be less than nMinDbCache
     nTotalCache = std::min(nTotalCache, nMaxDbCache << 20); // total cache cannot be greater than nMaxDbcache
     int64_t nBlockTreeDBCache = std::min(nTotalCache / 8, nMaxBlockDBCache << 20);
-    if (gArgs.GetBoolArg("-experimental-btc-balances", DEFAULT_ADDRINDEX)) {
-        // enable 3/4 of the cache if addressindex is enabled
-        nBlockTreeDBCache = nTotalCache * 3 / 4;
-    }
     nTotalCache -= nBlockTreeDBCache;
+    // the address index is written and read a lot, so it gets the largest share
+    int64_t nAddressIndexCache = fAddressIndex ? nTotalCache * 3 / 4 : 0;
+    nTotalCache -= nAddressIndexCache;
     int64_t nTxIndexCache = std::min(nTotalCache / 8, gArgs.GetBoolArg("-txindex", DEFAULT_TXINDEX) ? nMaxTxIndexCache << 20 : 0);
     nTotalCache -= nTxIndexCache;
     int64_t nCoinDBCache = std::min(nTotalCache / 2, (nTotalCache / 4) + (1 << 23)); // use 25%-50% of the remainder for disk cache
@@ -1505,6 +1521,9 @@ bool AppInitMain(InitInterfaces& interfaces)
     if (gArgs.GetBoolArg("-txindex", DEFAULT_TXINDEX)) {
         LogPrintf("* Using %.1f MiB for transaction index database\n", nTxIndexCache * (1.0 / 1024 / 1024));
     }
+    if (fAddressIndex) {
+        LogPrintf("* Using %.1f MiB for address index database\n", nAddressIndexCache * (1.0 / 1024 / 1024));
+    }
     LogPrintf("* Using %.1f MiB for chain state database\n", nCoinDBCache * (1.0 / 1024 / 1024));
     LogPrintf("* Using %.1f MiB for in-memory UTXO set (plus up to %.1f MiB of unused mempool space)\n", nCoinCacheUsage * (1.0 / 1024 / 1024), nMempoolSizeMax * (1.0 / 1024 / 1024));
 
@@ -1606,11 +1625,6 @@ bool AppInitMain(InitInterfaces& interfaces)
                 break;
             }
 
-            if (fAddressIndex != gArgs.GetBoolArg("-experimental-btc-balances", DEFAULT_ADDRINDEX)) {
-                strLoadError = _("You need to rebuild the database using -reindex-chainstate to change -experimental-btc-balances");
-                break;
-            }
-
             if (!fReset) {
                 // Note that RewindBlockIndex MUST run even if we're about to -reindex-chainstate.
                 // It both disconnects blocks based on chainActive, and drops block data in
@@ -1696,6 +1710,10 @@ bool AppInitMain(InitInterfaces& interfaces)
         g_txindex = MakeUnique<TxIndex>(nTxIndexCache, false, fReindex);
         g_txindex->Start();
     }
+    if (fAddressIndex) {
+        g_addressindex = MakeUnique<AddressIndex>(nAddressIndexCache, false, fReindex);
+        g_addressindex->Start();
+    }
 
     // ********************************************************* Step 8.5: load omni core
 
@@ -1734,6 +1752,10 @@ bool AppInitMain(InitInterfaces& interfaces)
         }
     }
 
+    if (gArgs.IsArgSet("-omnitxcache")) {
+        InitWarning(_("-omnitxcache is deprecated and ignored, use -omniprevoutcache to set the size of the input cache in megabytes."));
+    }
+
     uiInterface.InitMessage(_("Parsing Omni Layer transactions..."));
 
     mastercore_init();
@@ -9,6 +9,7 @@
 #include <omnicore/activation.h>
 
 #include <omnicore/log.h>
+#include <omnicore/undo.h>
 #include <omnicore/version.h>
 
 #include <fs.h>
@@ -49,6 +50,7 @@ static void DeletePendingActivation(uint16_t featureId)
  */
 static void PendingActivationCompleted(const FeatureActivation& activation)
 {
+    RecordActivationUndo();
     DeletePendingActivation(activation.featureId);
     vecCompletedActivations.push_back(activation);
     uiInterface.OmniStateChanged();
@@ -61,6 +63,7 @@ static void PendingActivationCompleted(const FeatureActivation& activation)
  */
 void AddPendingActivation(uint16_t featureId, int activationBlock, uint32_t minClientVersion, const std::string& featureName)
 {
+    RecordActivationUndo();
     DeletePendingActivation(featureId);
 
     FeatureActivation featureActivation;
@@ -128,6 +131,18 @@ void ClearActivations()
     uiInterface.OmniStateChanged();
 }
 
+/**
+ * Replaces the pending and completed activations, when blocks are reverted.
+ *
+ * A signal is fired to notify the UI about the status update.
+ */
+void RestoreActivations(const std::vector<FeatureActivation>& pendingActivations, const std::vector<FeatureActivation>& completedActivations)
+{
+    vecPendingActivations = pendingActivations;
+    vecCompletedActivations = completedActivations;
+    uiInterface.OmniStateChanged();
+}
+
 /**
  * Determines whether the sender is an authorized source for Omni Core feature activation.
  *
@@ -27,6 +27,8 @@ std::vector<FeatureActivation> GetPendingActivations();
 std::vector<FeatureActivation> GetCompletedActivations();
 /** Removes all pending or completed activations. */
 void ClearActivations();
+/** Replaces the pending and completed activations, when blocks are reverted. */
+void RestoreActivations(const std::vector<FeatureActivation>& pendingActivations, const std::vector<FeatureActivation>& completedActivations);
 /** Checks if any activations went live in the block */
 void CheckLiveActivations(int blockHeight);
 /** Adds a pending activation */
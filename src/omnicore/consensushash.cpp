@@ -13,15 +13,117 @@
 #include <omnicore/sp.h>
 
 #include <arith_uint256.h>
+#include <crypto/sha256.h>
 #include <uint256.h>
 
+#include <assert.h>
 #include <stdint.h>
 #include <algorithm>
+#include <map>
+#include <set>
 #include <string>
 #include <vector>
 
+/** Hashes a consensus string into a number to accumulate. */
+static arith_uint256 HashConsensusString(const std::string& entry)
+{
+    uint256 hash;
+    CSHA256().Write((const unsigned char*)entry.data(), entry.size()).Finalize(hash.begin());
+    return UintToArith256(hash);
+}
+
+void CConsensusAccumulator::Add(const std::string& entry)
+{
+    sum += HashConsensusString(entry);
+}
+
+void CConsensusAccumulator::Remove(const std::string& entry)
+{
+    sum -= HashConsensusString(entry);
+}
+
+void CConsensusAccumulator::Clear()
+{
+    sum = 0;
+}
+
+uint256 CConsensusAccumulator::GetHash() const
+{
+    return ArithToUint256(sum);
+}
+
 namespace mastercore
 {
+//! Commitment of all non-empty balances, maintained by update_tally_map()
+static CConsensusAccumulator balanceCommitment;
+
+/**
+ * Consensus strings of one part of the orderbooks, and their commitment.
+ *
+ * The entries are ordered by the same key as in the consensus hash, so the hash can
+ * be generated without sorting. Entries are identified by the key of the orderbook
+ * map they stem from, and entries marked as changed are generated again, before the
+ * stage is used.
+ */
+template <typename SortKey>
+struct COrderbookStage
+{
+    //! Consensus strings, ordered as in the consensus hash
+    std::map<SortKey, std::string> entries;
+    //! Sort keys of the entries, indexed by their key in the orderbook map
+    std::map<std::string, SortKey> sortKeys;
+    //! Keys of entries, which were modified since the stage was last updated
+    std::set<std::string> setChanged;
+    //! Whether the stage must be rebuilt from the orderbook map
+    bool fStale;
+    //! Order-independent commitment of the entries
+    CConsensusAccumulator commitment;
+
+    COrderbookStage() : fStale(true) {}
+
+    void Set(const std::string& key, const SortKey& sortKey, const std::string& dataStr)
+    {
+        Erase(key);
+        entries.insert(std::make_pair(sortKey, dataStr));
+        sortKeys.insert(std::make_pair(key, sortKey));
+        commitment.Add(dataStr);
+    }
+
+    void Erase(const std::string& key)
+    {
+        typename std::map<std::string, SortKey>::iterator it = sortKeys.find(key);
+        if (it == sortKeys.end()) return;
+        typename std::map<SortKey, std::string>::iterator itEntry = entries.find(it->second);
+        assert(itEntry != entries.end());
+        commitment.Remove(itEntry->second);
+        entries.erase(itEntry);
+        sortKeys.erase(it);
+    }
+
+    void MarkChanged(const std::string& key)
+    {
+        if (!fStale) setChanged.insert(key);
+    }
+
+    void Reset()
+    {
+        entries.clear();
+        sortKeys.clear();
+        setChanged.clear();
+        commitment.Clear();
+        fStale = true;
+    }
+};
+
+//! DEx sell offers, ordered by txid
+static COrderbookStage<arith_uint256> offersStage;
+//! DEx accepts, ordered by the txid of the sell offer and buyer
+static COrderbookStage<std::string> acceptsStage;
+//! MetaDEx trades, ordered by txid
+static COrderbookStage<arith_uint256> tradesStage;
+//! Crowdsales, ordered by property identifier
+static COrderbookStage<uint32_t> crowdsStage;
+
 bool ShouldConsensusHashBlock(int block) {
     if (msc_debug_consensus_hash_every_block) {
         return true;
@@ -96,6 +198,107 @@ std::string GenerateConsensusString(const uint32_t propertyId, const std::string
     return strprintf("%d|%s", propertyId, address);
 }
 
+/** Generates the consensus string and sort key of a sell offer, keyed by "seller-propertyid". */
+static void GenerateStageEntry(const std::string& key, const CMPOffer& offerObj, arith_uint256& sortKey, std::string& dataStr)
+{
+    const std::string seller = key.substr(0, key.size() - 2);
+    sortKey = UintToArith256(offerObj.getHash());
+    dataStr = GenerateConsensusString(offerObj, seller);
+}
+
+/** Generates the consensus string and sort key of an accept, keyed by "seller-propertyid+buyer". */
+static void GenerateStageEntry(const std::string& key, const CMPAccept& acceptObj, std::string& sortKey, std::string& dataStr)
+{
+    const std::string buyer = key.substr(key.find("+") + 1);
+    sortKey = strprintf("%s-%s", acceptObj.getHash().GetHex(), buyer);
+    dataStr = GenerateConsensusString(acceptObj, buyer);
+}
+
+/** Generates the consensus string and sort key of a crowdsale, keyed by the issuer. */
+static void GenerateStageEntry(const std::string& key, const CMPCrowd& crowdObj, uint32_t& sortKey, std::string& dataStr)
+{
+    sortKey = crowdObj.getPropertyId();
+    dataStr = GenerateConsensusString(crowdObj);
+}
+
+/**
+ * Brings a stage up to date with its orderbook map.
+ *
+ * Only the entries marked as changed are generated again, unless the stage is stale,
+ * in which case it is rebuilt from the whole map.
+ */
+template <typename Map, typename SortKey>
+static void UpdateStage(COrderbookStage<SortKey>& stage, const Map& map)
+{
+    SortKey sortKey;
+    std::string dataStr;
+
+    if (stage.fStale) {
+        stage.Reset();
+        for (typename Map::const_iterator it = map.begin(); it != map.end(); ++it) {
+            GenerateStageEntry(it->first, it->second, sortKey, dataStr);
+            stage.Set(it->first, sortKey, dataStr);
+        }
+        stage.fStale = false;
+        return;
+    }
+
+    for (std::set<std::string>::const_iterator it = stage.setChanged.begin(); it != stage.setChanged.end(); ++it) {
+        stage.Erase(*it);
+        typename Map::const_iterator itEntry = map.find(*it);
+        if (itEntry != map.end()) {
+            GenerateStageEntry(itEntry->first, itEntry->second, sortKey, dataStr);
+            stage.Set(itEntry->first, sortKey, dataStr);
+        }
+    }
+    stage.setChanged.clear();
+}
+
+/** Adds or removes a MetaDEx trade, which is identified by its txid. */
+static void UpdateTradesStage(const CMPMetaDEx& tradeObj, bool fAdded)
+{
+    if (fAdded) {
+        tradesStage.Set(tradeObj.getHash().GetHex(), UintToArith256(tradeObj.getHash()), GenerateConsensusString(tradeObj));
+    } else {
+        tradesStage.Erase(tradeObj.getHash().GetHex());
+    }
+}
+
+/** Brings all orderbook stages up to date. */
+static void UpdateOrderbookStages()
+{
+    UpdateStage(offersStage, my_offers);
+    UpdateStage(acceptsStage, my_accepts);
+    UpdateStage(crowdsStage, my_crowds);
+
+    // MetaDEx trades are updated as they are added or removed, and only rebuilt, if stale
+    if (tradesStage.fStale) {
+        tradesStage.Reset();
+        for (md_PropertiesMap::const_iterator itPair = metadex.begin(); itPair != metadex.end(); ++itPair) {
+            const md_PricesMap& prices = itPair->second;
+            for (md_PricesMap::const_iterator itPrice = prices.begin(); itPrice != prices.end(); ++itPrice) {
+                const md_Set& indexes = itPrice->second;
+                for (md_Set::const_iterator itTrade = indexes.begin(); itTrade != indexes.end(); ++itTrade) {
+                    UpdateTradesStage(*itTrade, true);
+                }
+            }
+        }
+        tradesStage.fStale = false;
+    }
+}
+
+/** Feeds the consensus strings of a stage into the hasher, in the order of the consensus hash. */
+template <typename SortKey>
+static void HashStage(CSHA256& hasher, const COrderbookStage<SortKey>& stage, const char* strType)
+{
+    typename std::map<SortKey, std::string>::const_iterator it;
+    for (it = stage.entries.begin(); it != stage.entries.end(); ++it) {
+        const std::string& dataStr = it->second;
+        if (msc_debug_consensus_hash) PrintToLog("Adding %s to consensus hash: %s\n", strType, dataStr);
+        hasher.Write((unsigned char*)dataStr.c_str(), dataStr.length());
+    }
+}
+
 /**
  * Obtains a hash of the active state to use for consensus verification and checkpointing.
  *
@@ -155,14 +358,11 @@ uint256 GetConsensusHash()
 
     // Balances - loop through the tally map, updating the sha context with the data from each balance and tally type
     // Placeholders:  "address|propertyid|balance|selloffer_reserve|accept_reserve|metadex_reserve"
-    // Sort alphabetically first
-    std::map<std::string, CMPTally> tallyMapSorted;
-    for (std::unordered_map<std::string, CMPTally>::iterator uoit = mp_tally_map.begin(); uoit != mp_tally_map.end(); ++uoit) {
-        tallyMapSorted.insert(std::make_pair(uoit->first,uoit->second));
-    }
-    for (std::map<std::string, CMPTally>::iterator my_it = tallyMapSorted.begin(); my_it != tallyMapSorted.end(); ++my_it) {
-        const std::string& address = my_it->first;
-        CMPTally& tally = my_it->second;
+    // The tally map keeps the order of the addresses, so only new addresses need to be sorted
+    const std::vector<uint32_t>& vOrderedIds = mp_tally_map.getOrderedIds();
+    for (std::vector<uint32_t>::const_iterator itId = vOrderedIds.begin(); itId != vOrderedIds.end(); ++itId) {
+        const std::string& address = mp_tally_map.getAddress(*itId);
+        CMPTally& tally = mp_tally_map.getTally(*itId);
         tally.init();
         uint32_t propertyId = 0;
         while (0 != (propertyId = (tally.next()))) {
@@ -173,93 +373,39 @@ uint256 GetConsensusHash()
         }
     }
 
-    // DEx sell offers - loop through the DEx and add each sell offer to the consensus hash (ordered by txid)
+    // The orderbook stages are maintained in the order of the consensus hash
+    UpdateOrderbookStages();
+
+    // DEx sell offers - add each sell offer to the consensus hash (ordered by txid)
     // Placeholders: "txid|address|propertyid|offeramount|btcdesired|minfee|timelimit"
-    std::vector<std::pair<arith_uint256, std::string> > vecDExOffers;
-    for (OfferMap::iterator it = my_offers.begin(); it != my_offers.end(); ++it) {
-        const CMPOffer& selloffer = it->second;
-        const std::string& sellCombo = it->first;
-        std::string seller = sellCombo.substr(0, sellCombo.size() - 2);
-        std::string dataStr = GenerateConsensusString(selloffer, seller);
-        vecDExOffers.push_back(std::make_pair(arith_uint256(selloffer.getHash().ToString()), dataStr));
-    }
-    std::sort (vecDExOffers.begin(), vecDExOffers.end());
-    for (std::vector<std::pair<arith_uint256, std::string> >::iterator it = vecDExOffers.begin(); it != vecDExOffers.end(); ++it) {
-        const std::string& dataStr = it->second;
-        if (msc_debug_consensus_hash) PrintToLog("Adding DEx offer data to consensus hash: %s\n", dataStr);
-        hasher.Write((unsigned char*)dataStr.c_str(), dataStr.length());
-    }
+    HashStage(hasher, offersStage, "DEx offer data");
 
-    // DEx accepts - loop through the accepts map and add each accept to the consensus hash (ordered by matchedtxid then buyer)
+    // DEx accepts - add each accept to the consensus hash (ordered by matchedtxid then buyer)
     // Placeholders: "matchedselloffertxid|buyer|acceptamount|acceptamountremaining|acceptblock"
-    std::vector<std::pair<std::string, std::string> > vecAccepts;
-    for (AcceptMap::const_iterator it = my_accepts.begin(); it != my_accepts.end(); ++it) {
-        const CMPAccept& accept = it->second;
-        const std::string& acceptCombo = it->first;
-        std::string buyer = acceptCombo.substr((acceptCombo.find("+") + 1), (acceptCombo.size()-(acceptCombo.find("+") + 1)));
-        std::string dataStr = GenerateConsensusString(accept, buyer);
-        std::string sortKey = strprintf("%s-%s", accept.getHash().GetHex(), buyer);
-        vecAccepts.push_back(std::make_pair(sortKey, dataStr));
-    }
-    std::sort (vecAccepts.begin(), vecAccepts.end());
-    for (std::vector<std::pair<std::string, std::string> >::iterator it = vecAccepts.begin(); it != vecAccepts.end(); ++it) {
-        const std::string& dataStr = it->second;
-        if (msc_debug_consensus_hash) PrintToLog("Adding DEx accept to consensus hash: %s\n", dataStr);
-        hasher.Write((unsigned char*)dataStr.c_str(), dataStr.length());
-    }
+    HashStage(hasher, acceptsStage, "DEx accept");
 
-    // MetaDEx trades - loop through the MetaDEx maps and add each open trade to the consensus hash (ordered by txid)
+    // MetaDEx trades - add each open trade to the consensus hash (ordered by txid)
     // Placeholders: "txid|address|propertyidforsale|amountforsale|propertyiddesired|amountdesired|amountremaining"
-    std::vector<std::pair<arith_uint256, std::string> > vecMetaDExTrades;
-    for (md_PropertiesMap::const_iterator my_it = metadex.begin(); my_it != metadex.end(); ++my_it) {
-        const md_PricesMap& prices = my_it->second;
-        for (md_PricesMap::const_iterator it = prices.begin(); it != prices.end(); ++it) {
-            const md_Set& indexes = it->second;
-            for (md_Set::const_iterator it = indexes.begin(); it != indexes.end(); ++it) {
-                const CMPMetaDEx& obj = *it;
-                std::string dataStr = GenerateConsensusString(obj);
-                vecMetaDExTrades.push_back(std::make_pair(arith_uint256(obj.getHash().ToString()), dataStr));
-            }
-        }
-    }
-    std::sort (vecMetaDExTrades.begin(), vecMetaDExTrades.end());
-    for (std::vector<std::pair<arith_uint256, std::string> >::iterator it = vecMetaDExTrades.begin(); it != vecMetaDExTrades.end(); ++it) {
-        const std::string& dataStr = it->second;
-        if (msc_debug_consensus_hash) PrintToLog("Adding MetaDEx trade data to consensus hash: %s\n", dataStr);
-        hasher.Write((unsigned char*)dataStr.c_str(), dataStr.length());
-    }
+    HashStage(hasher, tradesStage, "MetaDEx trade data");
 
-    // Crowdsales - loop through open crowdsales and add to the consensus hash (ordered by property ID)
+    // Crowdsales - add each open crowdsale to the consensus hash (ordered by property ID)
     // Note: the variables of the crowdsale (amount, bonus etc) are not part of the crowdsale map and not included here to
     // avoid additionalal loading of SP entries from the database
     // Placeholders: "propertyid|propertyiddesired|deadline|usertokens|issuertokens"
-    std::vector<std::pair<uint32_t, std::string> > vecCrowds;
-    for (CrowdMap::const_iterator it = my_crowds.begin(); it != my_crowds.end(); ++it) {
-        const CMPCrowd& crowd = it->second;
-        uint32_t propertyId = crowd.getPropertyId();
-        std::string dataStr = GenerateConsensusString(crowd);
-        vecCrowds.push_back(std::make_pair(propertyId, dataStr));
-    }
-    std::sort (vecCrowds.begin(), vecCrowds.end());
-    for (std::vector<std::pair<uint32_t, std::string> >::iterator it = vecCrowds.begin(); it != vecCrowds.end(); ++it) {
-        std::string dataStr = (*it).second;
-        if (msc_debug_consensus_hash) PrintToLog("Adding Crowdsale entry to consensus hash: %s\n", dataStr);
-        hasher.Write((unsigned char*)dataStr.c_str(), dataStr.length());
-    }
+    HashStage(hasher, crowdsStage, "Crowdsale entry");
 
     // Properties - loop through each property and store the issuer (to capture state changes via change issuer transactions)
-    // Note: we are loading every SP from the DB to check the issuer, if using consensus_hash_every_block debug option this
-    //       will slow things down dramatically.  Not an issue to do it once every 10,000 blocks for checkpoint verification.
+    // Note: properties are served from the cache of decoded entries, if possible
     // Placeholders: "propertyid|issueraddress"
     for (uint8_t ecosystem = 1; ecosystem <= 2; ecosystem++) {
         uint32_t startPropertyId = (ecosystem == 1) ? 1 : TEST_ECO_PROPERTY_1;
         for (uint32_t propertyId = startPropertyId; propertyId < pDbSpInfo->peekNextSPID(ecosystem); propertyId++) {
-            CMPSPInfo::Entry sp;
-            if (!pDbSpInfo->getSP(propertyId, sp)) {
-                PrintToLog("Error loading property ID %d for consensus hashing, hash should not be trusted!\n");
+            CMPSPInfo::EntryPtr sp = pDbSpInfo->getSPEntry(propertyId);
+            if (!sp) {
+                PrintToLog("Error loading property ID %d for consensus hashing, hash should not be trusted!\n", propertyId);
                 continue;
             }
-            std::string dataStr = GenerateConsensusString(propertyId, sp.issuer);
+            std::string dataStr = GenerateConsensusString(propertyId, sp->issuer);
             if (msc_debug_consensus_hash) PrintToLog("Adding property to consensus hash: %s\n", dataStr);
             hasher.Write((unsigned char*)dataStr.c_str(), dataStr.length());
         }
@@ -279,16 +425,27 @@ uint256 GetMetaDExHash(const uint32_t propertyId)
 
     LOCK(cs_tally);
 
+    // the hash of the whole orderbook is served from the maintained trades stage
+    if (propertyId == 0) {
+        UpdateOrderbookStages();
+        HashStage(hasher, tradesStage, "MetaDEx trade data");
+
+        uint256 metadexHash;
+        hasher.Finalize(metadexHash.begin());
+
+        return metadexHash;
+    }
+
     std::vector<std::pair<arith_uint256, std::string> > vecMetaDExTrades;
     for (md_PropertiesMap::const_iterator my_it = metadex.begin(); my_it != metadex.end(); ++my_it) {
-        if (propertyId == 0 || propertyId == my_it->first) {
+        if (propertyId == my_it->first.first) {
             const md_PricesMap& prices = my_it->second;
-            for (md_PricesMap::const_iterator it = prices.begin(); it != prices.end(); ++it) {
-                const md_Set& indexes = it->second;
-                for (md_Set::const_iterator it = indexes.begin(); it != indexes.end(); ++it) {
-                    const CMPMetaDEx& obj = *it;
+            for (md_PricesMap::const_iterator itPrice = prices.begin(); itPrice != prices.end(); ++itPrice) {
+                const md_Set& indexes = itPrice->second;
+                for (md_Set::const_iterator itTrade = indexes.begin(); itTrade != indexes.end(); ++itTrade) {
+                    const CMPMetaDEx& obj = *itTrade;
                     std::string dataStr = GenerateConsensusString(obj);
-                    vecMetaDExTrades.push_back(std::make_pair(arith_uint256(obj.getHash().ToString()), dataStr));
+                    vecMetaDExTrades.push_back(std::make_pair(UintToArith256(obj.getHash()), dataStr));
                 }
             }
         }
@@ -312,22 +469,16 @@ uint256 GetBalancesHash(const uint32_t hashPropertyId)
 
     LOCK(cs_tally);
 
-    std::map<std::string, CMPTally> tallyMapSorted;
-    for (std::unordered_map<std::string, CMPTally>::iterator uoit = mp_tally_map.begin(); uoit != mp_tally_map.end(); ++uoit) {
-        tallyMapSorted.insert(std::make_pair(uoit->first,uoit->second));
-    }
-    for (std::map<std::string, CMPTally>::iterator my_it = tallyMapSorted.begin(); my_it != tallyMapSorted.end(); ++my_it) {
-        const std::string& address = my_it->first;
-        CMPTally& tally = my_it->second;
-        tally.init();
-        uint32_t propertyId = 0;
-        while (0 != (propertyId = (tally.next()))) {
-            if (propertyId != hashPropertyId) continue;
-            std::string dataStr = GenerateConsensusString(tally, address, propertyId);
-            if (dataStr.empty()) continue;
-            if (msc_debug_consensus_hash) PrintToLog("Adding data to balances hash: %s\n", dataStr);
-            hasher.Write((unsigned char*)dataStr.c_str(), dataStr.length());
-        }
+    // the holders of the property are already ordered by address
+    const std::set<std::string>& holders = GetPropertyHolders(hashPropertyId);
+    for (std::set<std::string>::const_iterator it = holders.begin(); it != holders.end(); ++it) {
+        const std::string& address = *it;
+        const CMPTally* tally = getTally(address);
+        assert(tally != nullptr);
+        std::string dataStr = GenerateConsensusString(*tally, address, hashPropertyId);
+        if (dataStr.empty()) continue;
+        if (msc_debug_consensus_hash) PrintToLog("Adding data to balances hash: %s\n", dataStr);
+        hasher.Write((unsigned char*)dataStr.c_str(), dataStr.length());
     }
 
     uint256 balancesHash;
@@ -336,4 +487,116 @@ uint256 GetBalancesHash(const uint32_t hashPropertyId)
     return balancesHash;
 }
 
+/**
+ * Replaces the consensus string of a balance in the balance commitment.
+ *
+ * Empty strings represent empty balances, which are not part of the commitment.
+ */
+void UpdateBalanceCommitment(const std::string& strBefore, const std::string& strAfter)
+{
+    LOCK(cs_tally);
+
+    if (!strBefore.empty()) balanceCommitment.Remove(strBefore);
+    if (!strAfter.empty()) balanceCommitment.Add(strAfter);
+}
+
+/** Resets the balance commitment. */
+void ClearBalanceCommitment()
+{
+    LOCK(cs_tally);
+
+    balanceCommitment.Clear();
+}
+
+/** Returns the order-independent commitment of all balances. */
+uint256 GetBalanceCommitment()
+{
+    LOCK(cs_tally);
+
+    return balanceCommitment.GetHash();
+}
+
+/** Marks a sell offer as modified, so its consensus string is generated again. */
+void MarkOfferChanged(const std::string& key)
+{
+    LOCK(cs_tally);
+
+    offersStage.MarkChanged(key);
+}
+
+/** Marks an accept as modified, so its consensus string is generated again. */
+void MarkAcceptChanged(const std::string& key)
+{
+    LOCK(cs_tally);
+
+    acceptsStage.MarkChanged(key);
+}
+
+/** Marks a crowdsale as modified, so its consensus string is generated again. */
+void MarkCrowdChanged(const std::string& address)
+{
+    LOCK(cs_tally);
+
+    crowdsStage.MarkChanged(address);
+}
+
+/** Updates the MetaDEx commitment, after an order was added to, or removed from the orderbook. */
+void UpdateMetaDExCommitment(const CMPMetaDEx& order, bool fAdded)
+{
+    LOCK(cs_tally);
+
+    if (!tradesStage.fStale) UpdateTradesStage(order, fAdded);
+}
+
+/** Rebuilds the orderbook commitments, when they are used next, after the orderbooks were replaced as a whole. */
+void ResetOrderbookCommitments()
+{
+    LOCK(cs_tally);
+
+    offersStage.Reset();
+    acceptsStage.Reset();
+    tradesStage.Reset();
+    crowdsStage.Reset();
+}
+
+/**
+ * Obtains an incrementally maintained commitment of the active state.
+ *
+ * The commitment covers the same entries as the consensus hash, but each stage is
+ * accumulated independent of the order of its entries:
+ *
+ *   SHA256(balances|dexoffers|dexaccepts|metadextrades|crowdsales|properties)
+ *
+ * Every stage is updated, whenever its entries change, so the cost of obtaining the
+ * commitment is bound by the number of entries modified since it was last obtained,
+ * instead of the size of the state. Unlike GetConsensusHash() no sorting and no
+ * database access is required, which makes it suitable to be calculated for every block.
+ */
+uint256 GetStateCommitment()
+{
+    LOCK(cs_tally);
+
+    UpdateOrderbookStages();
+
+    const uint256 stages[] = {
+        balanceCommitment.GetHash(),
+        offersStage.commitment.GetHash(),
+        acceptsStage.commitment.GetHash(),
+        tradesStage.commitment.GetHash(),
+        crowdsStage.commitment.GetHash(),
+        pDbSpInfo->GetIssuerCommitment()
+    };
+
+    CSHA256 hasher;
+    for (size_t n = 0; n < sizeof(stages) / sizeof(stages[0]); ++n) {
+        hasher.Write(stages[n].begin(), stages[n].size());
+    }
+
+    uint256 stateCommitment;
+    hasher.Finalize(stateCommitment.begin());
+    if (msc_debug_consensus_hash) PrintToLog("Obtained state commitment: %s\n", stateCommitment.GetHex());
+
+    return stateCommitment;
+}
+
 } // namespace mastercore
@@ -1,13 +1,91 @@
 #ifndef BITCOIN_OMNICORE_CONSENSUSHASH_H
 #define BITCOIN_OMNICORE_CONSENSUSHASH_H
 
+#include <arith_uint256.h>
 #include <uint256.h>
 
+#include <stdint.h>
+#include <string>
+
+class CMPAccept;
+class CMPCrowd;
+class CMPMetaDEx;
+class CMPOffer;
+class CMPTally;
+
+/** Order-independent accumulator of consensus strings.
+ *
+ * Each entry is hashed with SHA256 and the hashes are summed up modulo 2^256,
+ * so entries can be added and removed in any order. The result is a cheap
+ * commitment for comparing states, but not a replacement for the consensus
+ * hash used by checkpoints.
+ */
+class CConsensusAccumulator
+{
+private:
+    arith_uint256 sum;
+
+public:
+    /** Adds an entry to the accumulator. */
+    void Add(const std::string& entry);
+    /** Removes a previously added entry from the accumulator. */
+    void Remove(const std::string& entry);
+    /** Resets the accumulator. */
+    void Clear();
+    /** Returns the current state of the accumulator. */
+    uint256 GetHash() const;
+};
+
 namespace mastercore
 {
 /** Checks if a given block should be consensus hashed. */
 bool ShouldConsensusHashBlock(int block);
 
+/** Generates a consensus string for hashing based on a tally object. */
+std::string GenerateConsensusString(const CMPTally& tallyObj, const std::string& address, const uint32_t propertyId);
+
+/** Generates a consensus string for hashing based on a DEx sell offer object. */
+std::string GenerateConsensusString(const CMPOffer& offerObj, const std::string& address);
+
+/** Generates a consensus string for hashing based on a DEx accept object. */
+std::string GenerateConsensusString(const CMPAccept& acceptObj, const std::string& address);
+
+/** Generates a consensus string for hashing based on a MetaDEx object. */
+std::string GenerateConsensusString(const CMPMetaDEx& tradeObj);
+
+/** Generates a consensus string for hashing based on a crowdsale object. */
+std::string GenerateConsensusString(const CMPCrowd& crowdObj);
+
+/** Generates a consensus string for hashing based on a property issuer. */
+std::string GenerateConsensusString(const uint32_t propertyId, const std::string& address);
+
+/** Replaces the consensus string of a balance in the balance commitment. */
+void UpdateBalanceCommitment(const std::string& strBefore, const std::string& strAfter);
+
+/** Resets the balance commitment. */
+void ClearBalanceCommitment();
+
+/** Returns the order-independent commitment of all balances. */
+uint256 GetBalanceCommitment();
+
+/** Marks a sell offer as modified, so its consensus string is generated again. */
+void MarkOfferChanged(const std::string& key);
+
+/** Marks an accept as modified, so its consensus string is generated again. */
+void MarkAcceptChanged(const std::string& key);
+
+/** Marks a crowdsale as modified, so its consensus string is generated again. */
+void MarkCrowdChanged(const std::string& address);
+
+/** Updates the MetaDEx commitment, after an order was added to, or removed from the orderbook. */
+void UpdateMetaDExCommitment(const CMPMetaDEx& order, bool fAdded);
+
+/** Rebuilds the orderbook commitments, when they are used next, after the orderbooks were replaced as a whole. */
+void ResetOrderbookCommitments();
+
+/** Obtains an incrementally maintained commitment of the active state. */
+uint256 GetStateCommitment();
+
 /** Obtains a hash of all balances to use for consensus verification and checkpointing. */
 uint256 GetConsensusHash();
 
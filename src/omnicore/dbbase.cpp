@@ -10,6 +10,215 @@
 
 #include <stdint.h>
 
+#include <iterator>
+#include <memory>
+#include <string>
+#include <utility>
+
+namespace
+{
+/**
+ * Adds the operations of a write batch to the pending entries of a block batch.
+ */
+class COverlayWriter : public leveldb::WriteBatch::Handler
+{
+private:
+    DBOverlay& overlay;
+
+public:
+    explicit COverlayWriter(DBOverlay& overlayIn) : overlay(overlayIn) {}
+
+    void Put(const leveldb::Slice& key, const leveldb::Slice& value) override
+    {
+        overlay[key.ToString()] = value.ToString();
+    }
+
+    void Delete(const leveldb::Slice& key) override
+    {
+        overlay[key.ToString()] = nullopt;
+    }
+};
+
+/**
+ * Iterates over the entries of the database, merged with the pending entries of
+ * a block batch.
+ *
+ * Pending entries take precedence over entries with the same key of the database,
+ * and erased entries are skipped. The iterator keeps the pending entries alive,
+ * which are not modified, while they are shared.
+ */
+class COverlayIterator : public leveldb::Iterator
+{
+private:
+    std::unique_ptr<leveldb::Iterator> base;
+    std::shared_ptr<const DBOverlay> overlay;
+    DBOverlay::const_iterator pending;
+    bool fForward;
+    bool fPendingCurrent;
+    bool fValid;
+
+    bool PendingValid() const
+    {
+        return pending != overlay->end();
+    }
+
+    void PendingNext()
+    {
+        ++pending;
+    }
+
+    void PendingPrev()
+    {
+        pending = (pending == overlay->begin()) ? overlay->end() : std::prev(pending);
+    }
+
+    /** Positions on the smallest entry of both sides, skipping erased entries. */
+    void FindForward()
+    {
+        fForward = true;
+        while (true) {
+            bool fBase = base->Valid();
+            bool fPending = PendingValid();
+            fValid = fBase || fPending;
+            if (!fValid) return;
+
+            int cmp = !fBase ? 1 : !fPending ? -1 : base->key().compare(pending->first);
+            if (cmp < 0) {
+                fPendingCurrent = false;
+                return;
+            }
+            if (cmp == 0) base->Next();
+            if (!pending->second) {
+                PendingNext();
+                continue;
+            }
+            fPendingCurrent = true;
+            return;
+        }
+    }
+
+    /** Positions on the largest entry of both sides, skipping erased entries. */
+    void FindReverse()
+    {
+        fForward = false;
+        while (true) {
+            bool fBase = base->Valid();
+            bool fPending = PendingValid();
+            fValid = fBase || fPending;
+            if (!fValid) return;
+
+            int cmp = !fBase ? -1 : !fPending ? 1 : base->key().compare(pending->first);
+            if (cmp > 0) {
+                fPendingCurrent = false;
+                return;
+            }
+            if (cmp == 0) base->Prev();
+            if (!pending->second) {
+                PendingPrev();
+                continue;
+            }
+            fPendingCurrent = true;
+            return;
+        }
+    }
+
+public:
+    COverlayIterator(leveldb::Iterator* baseIn, std::shared_ptr<const DBOverlay> overlayIn)
+        : base(baseIn), overlay(std::move(overlayIn)), pending(overlay->end()),
+          fForward(true), fPendingCurrent(false), fValid(false) {}
+
+    bool Valid() const override
+    {
+        return fValid;
+    }
+
+    void SeekToFirst() override
+    {
+        base->SeekToFirst();
+        pending = overlay->begin();
+        FindForward();
+    }
+
+    void SeekToLast() override
+    {
+        base->SeekToLast();
+        pending = overlay->empty() ? overlay->end() : std::prev(overlay->end());
+        FindReverse();
+    }
+
+    void Seek(const leveldb::Slice& target) override
+    {
+        base->Seek(target);
+        pending = overlay->lower_bound(target.ToString());
+        FindForward();
+    }
+
+    void Next() override
+    {
+        assert(fValid);
+        if (!fForward) {
+            // position the other side after the current entry
+            std::string strKey = key().ToString();
+            if (fPendingCurrent) {
+                base->Seek(strKey);
+                if (base->Valid() && base->key() == leveldb::Slice(strKey)) base->Next();
+            } else {
+                pending = overlay->upper_bound(strKey);
+            }
+        }
+        if (fPendingCurrent) {
+            PendingNext();
+        } else {
+            base->Next();
+        }
+        FindForward();
+    }
+
+    void Prev() override
+    {
+        assert(fValid);
+        if (fForward) {
+            // position the other side before the current entry
+            std::string strKey = key().ToString();
+            if (fPendingCurrent) {
+                base->Seek(strKey);
+                if (base->Valid()) {
+                    base->Prev();
+                } else {
+                    base->SeekToLast();
+                }
+            } else {
+                pending = overlay->lower_bound(strKey);
+                PendingPrev();
+            }
+        }
+        if (fPendingCurrent) {
+            PendingPrev();
+        } else {
+            base->Prev();
+        }
+        FindReverse();
+    }
+
+    leveldb::Slice key() const override
+    {
+        assert(fValid);
+        return fPendingCurrent ? leveldb::Slice(pending->first) : base->key();
+    }
+
+    leveldb::Slice value() const override
+    {
+        assert(fValid);
+        return fPendingCurrent ? leveldb::Slice(*pending->second) : base->value();
+    }
+
+    leveldb::Status status() const override
+    {
+        return base->status();
+    }
+};
+} // anonymous namespace
+
 /**
  * Opens or creates a LevelDB based database.
  */
@@ -42,7 +251,7 @@ void CDBBase::Clear()
 
     delete it;
 
-    leveldb::Status status = pdb->Write(writeoptions, &batch);
+    leveldb::Status status = Apply(batch);
     nRead = 0;
     nWritten = 0;
 
@@ -57,12 +266,122 @@ void CDBBase::Clear()
  */
 void CDBBase::Close()
 {
+    {
+        LOCK(cs_batch);
+        if (fBatching && pOverlay && !pOverlay->empty()) {
+            PrintToLog("%s(): discarding %d uncommitted entries\n", __func__, pOverlay->size());
+        }
+        fBatching = false;
+        fBatchSync = false;
+        pOverlay.reset();
+    }
     if (pdb) {
         delete pdb;
         pdb = NULL;
     }
 }
 
+/**
+ * Creates and returns a new LevelDB iterator, which includes pending entries.
+ */
+leveldb::Iterator* CDBBase::NewIterator() const
+{
+    assert(pdb != NULL);
+    std::shared_ptr<const DBOverlay> overlay;
+    {
+        LOCK(cs_batch);
+        if (fBatching && pOverlay && !pOverlay->empty()) overlay = pOverlay;
+    }
+    leveldb::Iterator* it = pdb->NewIterator(iteroptions);
+    if (!overlay) return it;
+
+    return new COverlayIterator(it, std::move(overlay));
+}
+
+/**
+ * Retrieves the raw value stored under a key, including pending entries.
+ */
+leveldb::Status CDBBase::Get(const leveldb::Slice& key, std::string* value) const
+{
+    assert(pdb != NULL);
+    {
+        LOCK(cs_batch);
+        if (fBatching && pOverlay) {
+            DBOverlay::const_iterator it = pOverlay->find(key.ToString());
+            if (it != pOverlay->end()) {
+                if (!it->second) return leveldb::Status::NotFound(key);
+                *value = *it->second;
+                return leveldb::Status::OK();
+            }
+        }
+    }
+    return pdb->Get(readoptions, key, value);
+}
+
+/**
+ * Writes a batch to the database, or adds it to the active block batch.
+ */
+leveldb::Status CDBBase::Apply(leveldb::WriteBatch& batch, bool fSync)
+{
+    assert(pdb != NULL);
+    {
+        LOCK(cs_batch);
+        if (fBatching) {
+            // iterators may still refer to the pending entries
+            if (!pOverlay) {
+                pOverlay = std::make_shared<DBOverlay>();
+            } else if (pOverlay.use_count() > 1) {
+                pOverlay = std::make_shared<DBOverlay>(*pOverlay);
+            }
+            COverlayWriter writer(*pOverlay);
+            fBatchSync |= fSync;
+            return batch.Iterate(&writer);
+        }
+    }
+    return pdb->Write(fSync ? syncoptions : writeoptions, &batch);
+}
+
+/**
+ * Starts collecting writes in a block batch.
+ */
+void CDBBase::BeginBatch()
+{
+    assert(pdb != NULL);
+    CommitBatch();
+
+    LOCK(cs_batch);
+    fBatching = true;
+}
+
+/**
+ * Commits the pending entries of the block batch at once, and stops batching.
+ */
+leveldb::Status CDBBase::CommitBatch()
+{
+    assert(pdb != NULL);
+    LOCK(cs_batch);
+    leveldb::Status status;
+    if (fBatching && pOverlay && !pOverlay->empty()) {
+        leveldb::WriteBatch batch;
+        for (const auto& entry : *pOverlay) {
+            if (entry.second) {
+                batch.Put(entry.first, *entry.second);
+            } else {
+                batch.Delete(entry.first);
+            }
+        }
+        status = pdb->Write(fBatchSync ? syncoptions : writeoptions, &batch);
+        if (!status.ok()) {
+            PrintToLog("%s(): ERROR: failed to commit %d entries: %s\n", __func__, pOverlay->size(), status.ToString());
+        }
+    }
+    fBatching = false;
+    fBatchSync = false;
+    pOverlay.reset();
+
+    return status;
+}
+
 
 /**
 @todo  Move initialization and deinitialization of databases into this file (?)
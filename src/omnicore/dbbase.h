@@ -2,13 +2,60 @@
 #define BITCOIN_OMNICORE_DBBASE_H
 
 #include <leveldb/db.h>
+#include <leveldb/slice.h>
+#include <leveldb/write_batch.h>
 
+#include <clientversion.h>
 #include <fs.h>
+#include <optional.h>
+#include <serialize.h>
+#include <streams.h>
+#include <sync.h>
 
 #include <assert.h>
 #include <stddef.h>
 
+#include <exception>
+#include <map>
+#include <memory>
+#include <string>
+
+/**
+ * Serializes a key or value into its binary database representation.
+ */
+template <typename T>
+std::string EncodeDBEntry(const T& obj)
+{
+    CDataStream ssObj(SER_DISK, CLIENT_VERSION);
+    ssObj.reserve(::GetSerializeSize(obj, CLIENT_VERSION));
+    ssObj << obj;
+    return std::string(ssObj.begin(), ssObj.end());
+}
+
+/**
+ * Deserializes a key or value from its binary database representation.
+ *
+ * @return True, if the object was decoded and no data is left
+ */
+template <typename T>
+bool DecodeDBEntry(const leveldb::Slice& slice, T& obj)
+{
+    try {
+        CDataStream ssObj(slice.data(), slice.data() + slice.size(), SER_DISK, CLIENT_VERSION);
+        ssObj >> obj;
+        return ssObj.empty();
+    } catch (const std::exception&) {
+        return false;
+    }
+}
+
+/** Pending entries of a block batch, mapped to their new value, or none, if erased. */
+typedef std::map<std::string, Optional<std::string>> DBOverlay;
+
 /** Base class for LevelDB based storage.
+ *
+ * While a block batch is active, all writes are collected in memory and committed
+ * to the database at once. Reads and iterators see the pending entries.
  */
 class CDBBase
 {
@@ -16,6 +63,18 @@ private:
     //! Options used when iterating over values of the database
     leveldb::ReadOptions iteroptions;
 
+    //! Guards the state of the block batch
+    mutable CCriticalSection cs_batch;
+
+    //! Whether writes are currently collected in a block batch
+    bool fBatching;
+
+    //! Whether any write of the block batch requested a sync write
+    bool fBatchSync;
+
+    //! Pending entries of the block batch, copied on write when shared with an iterator
+    std::shared_ptr<DBOverlay> pOverlay;
+
 protected:
     //! Database options used
     leveldb::Options options;
@@ -38,7 +97,7 @@ protected:
     //! Number of entries written
     unsigned int nWritten;
 
-    CDBBase() : pdb(NULL), nRead(0), nWritten(0)
+    CDBBase() : fBatching(false), fBatchSync(false), pdb(NULL), nRead(0), nWritten(0)
     {
         options.paranoid_checks = true;
         options.create_if_missing = true;
@@ -59,14 +118,72 @@ protected:
      * Creates and returns a new LevelDB iterator.
      *
      * It is expected that the database is not closed. The iterator is owned by the
-     * caller, and the object has to be deleted explicitly.
+     * caller, and the object has to be deleted explicitly. If a block batch is
+     * active, the pending entries are merged into the iteration.
      *
      * @return A new LevelDB iterator
      */
-    leveldb::Iterator* NewIterator() const
+    leveldb::Iterator* NewIterator() const;
+
+    /**
+     * Retrieves the raw value stored under a key, including pending entries.
+     */
+    leveldb::Status Get(const leveldb::Slice& key, std::string* value) const;
+
+    /**
+     * Writes a batch to the database, or adds it to the active block batch.
+     */
+    leveldb::Status Apply(leveldb::WriteBatch& batch, bool fSync = false);
+
+    /**
+     * Stores a serialized value under a serialized key.
+     */
+    template <typename K, typename V>
+    leveldb::Status Write(const K& key, const V& value, bool fSync = false)
     {
         assert(pdb != NULL);
-        return pdb->NewIterator(iteroptions);
+        leveldb::WriteBatch batch;
+        batch.Put(EncodeDBEntry(key), EncodeDBEntry(value));
+        ++nWritten;
+        return Apply(batch, fSync);
+    }
+
+    /**
+     * Retrieves and deserializes the value stored under a serialized key.
+     *
+     * @return True, if the entry was found and could be decoded
+     */
+    template <typename K, typename V>
+    bool Read(const K& key, V& value)
+    {
+        assert(pdb != NULL);
+        std::string strValue;
+        leveldb::Status status = Get(EncodeDBEntry(key), &strValue);
+        ++nRead;
+        return status.ok() && DecodeDBEntry(strValue, value);
+    }
+
+    /**
+     * Checks whether an entry is stored under a serialized key.
+     */
+    template <typename K>
+    bool Exists(const K& key) const
+    {
+        assert(pdb != NULL);
+        std::string strValue;
+        return Get(EncodeDBEntry(key), &strValue).ok();
+    }
+
+    /**
+     * Removes the entry stored under a serialized key.
+     */
+    template <typename K>
+    leveldb::Status Erase(const K& key)
+    {
+        assert(pdb != NULL);
+        leveldb::WriteBatch batch;
+        batch.Delete(EncodeDBEntry(key));
+        return Apply(batch);
     }
 
     /**
@@ -83,6 +200,8 @@ protected:
 
     /**
      * Deinitializes and closes the database.
+     *
+     * Entries of a block batch, which was not committed, are discarded.
      */
     void Close();
 
@@ -91,6 +210,22 @@ public:
      * Deletes all entries of the database, and resets the counters.
      */
     void Clear();
+
+    /**
+     * Starts collecting writes in a block batch.
+     *
+     * A block batch, which is still active, is committed first.
+     */
+    void BeginBatch();
+
+    /**
+     * Commits the pending entries of the block batch at once, and stops batching.
+     *
+     * The commit is synced, if any of the collected writes requested a sync write.
+     *
+     * @return A Status object, indicating success or failure
+     */
+    leveldb::Status CommitBatch();
 };
 
 
@@ -11,15 +11,23 @@
 #include <omnicore/sp.h>
 #include <omnicore/sto.h>
 
+#include <clientversion.h>
+#include <serialize.h>
+#include <util/strencodings.h>
+#include <util/time.h>
 #include <validation.h>
 
 #include <leveldb/db.h>
+#include <leveldb/iterator.h>
+#include <leveldb/write_batch.h>
 
 #include <boost/algorithm/string.hpp>
 #include <boost/lexical_cast.hpp>
 
 #include <stdint.h>
 
+#include <algorithm>
+#include <ios>
 #include <limits>
 #include <map>
 #include <string>
@@ -29,6 +37,137 @@ using namespace mastercore;
 
 std::map<uint32_t, int64_t> distributionThresholds;
 
+namespace {
+
+//! Key prefix of fee cache entries
+const char FEE_CACHE = 'c';
+//! Key prefix of the most recent fee cache entry of a property
+const char FEE_CACHE_HEAD = 'h';
+//! Key prefix of the properties with fee cache entries in a block
+const char FEE_CACHE_BLOCK = 'b';
+//! Key prefix of fee distributions
+const char FEE_DISTRIBUTION = 'd';
+
+//! Number of entries converted from the legacy format, before a batch is written
+const int CONVERT_BATCH_SIZE = 10000;
+
+/** Key with a prefix and a property or distribution identifier. */
+struct CFeeKey
+{
+    char prefix;
+    uint32_t id;
+
+    CFeeKey() : prefix(0), id(0) {}
+    CFeeKey(char prefixIn, uint32_t idIn) : prefix(prefixIn), id(idIn) {}
+
+    template <typename Stream>
+    void Serialize(Stream& s) const
+    {
+        ser_writedata8(s, prefix);
+        // Identifiers are stored big-endian for key sorting in LevelDB
+        ser_writedata32be(s, id);
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s)
+    {
+        prefix = ser_readdata8(s);
+        if (prefix != FEE_CACHE && prefix != FEE_CACHE_HEAD && prefix != FEE_DISTRIBUTION) {
+            throw std::ios_base::failure("unknown fee key prefix");
+        }
+        id = ser_readdata32be(s);
+    }
+};
+
+/** Key of a fee cache entry: property identifier and block. */
+struct CFeeCacheKey
+{
+    uint32_t propertyId;
+    int32_t block;
+
+    CFeeCacheKey() : propertyId(0), block(0) {}
+    CFeeCacheKey(uint32_t propertyIdIn, int blockIn) : propertyId(propertyIdIn), block(blockIn) {}
+
+    template <typename Stream>
+    void Serialize(Stream& s) const
+    {
+        ser_writedata8(s, FEE_CACHE);
+        // Identifiers and heights are stored big-endian for key sorting in LevelDB
+        ser_writedata32be(s, propertyId);
+        ser_writedata32be(s, block);
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s)
+    {
+        if (ser_readdata8(s) != FEE_CACHE) {
+            throw std::ios_base::failure("not a fee cache key");
+        }
+        propertyId = ser_readdata32be(s);
+        block = ser_readdata32be(s);
+    }
+};
+
+/** Key of a property with fee cache entries in a block: block and property identifier. */
+struct CFeeCacheBlockKey
+{
+    int32_t block;
+    uint32_t propertyId;
+
+    CFeeCacheBlockKey() : block(0), propertyId(0) {}
+    CFeeCacheBlockKey(int blockIn, uint32_t propertyIdIn) : block(blockIn), propertyId(propertyIdIn) {}
+
+    template <typename Stream>
+    void Serialize(Stream& s) const
+    {
+        ser_writedata8(s, FEE_CACHE_BLOCK);
+        // Heights and identifiers are stored big-endian for key sorting in LevelDB
+        ser_writedata32be(s, block);
+        ser_writedata32be(s, propertyId);
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s)
+    {
+        if (ser_readdata8(s) != FEE_CACHE_BLOCK) {
+            throw std::ios_base::failure("not a fee cache block key");
+        }
+        block = ser_readdata32be(s);
+        propertyId = ser_readdata32be(s);
+    }
+};
+
+/** A fee distribution of a property to the holders of OMNI or TOMNI. */
+struct CFeeDistribution
+{
+    int32_t block;
+    uint32_t propertyId;
+    int64_t total;
+    std::set<feeHistoryItem> recipients;
+
+    CFeeDistribution() : block(0), propertyId(0), total(0) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(block);
+        READWRITE(propertyId);
+        READWRITE(total);
+        READWRITE(recipients);
+    }
+};
+
+/** Adds a fee cache entry, and updates the most recent entry of the property and the block index. */
+void BatchWriteCacheEntry(leveldb::WriteBatch& batch, uint32_t propertyId, int block, int64_t amount)
+{
+    batch.Put(EncodeDBEntry(CFeeCacheKey(propertyId, block)), EncodeDBEntry(amount));
+    batch.Put(EncodeDBEntry(CFeeKey(FEE_CACHE_HEAD, propertyId)), EncodeDBEntry(feeCacheItem(block, amount)));
+    batch.Put(EncodeDBEntry(CFeeCacheBlockKey(block, propertyId)), leveldb::Slice());
+}
+
+} // anonymous namespace
+
 COmniFeeCache::COmniFeeCache(const fs::path& path, bool fWipe)
 {
     leveldb::Status status = Open(path, fWipe);
@@ -61,39 +200,23 @@ void COmniFeeCache::UpdateDistributionThresholds(uint32_t propertyId)
 int64_t COmniFeeCache::GetCachedAmount(const uint32_t &propertyId)
 {
     assert(pdb);
-    // Get the fee history, set is sorted by block so last entry is most recent
-    std::set<feeCacheItem> sCacheHistoryItems = GetCacheHistory(propertyId);
-    if (!sCacheHistoryItems.empty()) {
-        std::set<feeCacheItem>::iterator endIt = sCacheHistoryItems.end();
-        --endIt;
-        feeCacheItem mostRecentItem = *endIt;
-        return mostRecentItem.second;
-    } else {
+    // The head record holds the most recent entry
+    feeCacheItem mostRecentItem;
+    if (!Read(CFeeKey(FEE_CACHE_HEAD, propertyId), mostRecentItem)) {
         return 0; // property has never generated a fee
     }
+    return mostRecentItem.second;
 }
 
 // Zeros a property in the fee cache
 void COmniFeeCache::ClearCache(const uint32_t &propertyId, int block)
 {
+    assert(pdb);
     if (msc_debug_fees) PrintToLog("ClearCache starting (block %d, property ID %d)...\n", block, propertyId);
-    const std::string key = strprintf("%010d", propertyId);
-    std::set<feeCacheItem> sCacheHistoryItems = GetCacheHistory(propertyId);
-    if (msc_debug_fees) PrintToLog("   Iterating cache history (%d items)...\n",sCacheHistoryItems.size());
-    std::string newValue;
-    if (!sCacheHistoryItems.empty()) {
-        for (std::set<feeCacheItem>::iterator it = sCacheHistoryItems.begin(); it != sCacheHistoryItems.end(); it++) {
-            feeCacheItem tempItem = *it;
-            if (tempItem.first == block) continue;
-            if (!newValue.empty()) newValue += ",";
-            newValue += strprintf("%d:%d", tempItem.first, tempItem.second);
-            if (msc_debug_fees) PrintToLog("      Readding entry: block %d amount %d\n", tempItem.first, tempItem.second);
-        }
-        if (!newValue.empty()) newValue += ",";
-    }
-    if (msc_debug_fees) PrintToLog("   Adding zero valued entry: block %d\n", block);
-    newValue += strprintf("%d:%d", block, 0);
-    leveldb::Status status = pdb->Put(writeoptions, key, newValue);
+
+    leveldb::WriteBatch batch;
+    BatchWriteCacheEntry(batch, propertyId, block, 0);
+    leveldb::Status status = Apply(batch);
     assert(status.ok());
     ++nWritten;
 
@@ -105,13 +228,23 @@ void COmniFeeCache::ClearCache(const uint32_t &propertyId, int block)
 // Adds a fee to the cache (eg on a completed trade)
 void COmniFeeCache::AddFee(const uint32_t &propertyId, int block, const int64_t &amount)
 {
+    CacheFee(propertyId, block, amount);
+
+    // Call for cache evaluation (we only need to do this each time a fee cache is increased)
+    EvalCache(propertyId, block);
+}
+
+// Adds a fee to the cache without evaluating the cache for distribution
+int64_t COmniFeeCache::CacheFee(const uint32_t &propertyId, int block, const int64_t &amount)
+{
+    assert(pdb);
     if (msc_debug_fees) PrintToLog("Starting AddFee for prop %d (block %d amount %d)...\n", propertyId, block, amount);
 
     // Get current cached fee
     int64_t currentCachedAmount = GetCachedAmount(propertyId);
     if (msc_debug_fees) PrintToLog("   Current cached amount %d\n", currentCachedAmount);
 
-    // Add new fee and rewrite record
+    // Add new fee and write the entry of the block, an older entry for the same block is replaced
     if ((currentCachedAmount > 0) && (amount > std::numeric_limits<int64_t>::max() - currentCachedAmount)) {
         // overflow - there is no way the fee cache should exceed the maximum possible number of tokens, not safe to continue
         const std::string& msg = strprintf("Shutting down due to fee cache overflow (block %d property %d current %d amount %d)\n", block, propertyId, currentCachedAmount, amount);
@@ -124,64 +257,75 @@ void COmniFeeCache::AddFee(const uint32_t &propertyId, int block, const int64_t
     }
     int64_t newCachedAmount = currentCachedAmount + amount;
 
-    if (msc_debug_fees) PrintToLog("   New cached amount %d\n", newCachedAmount);
-    const std::string key = strprintf("%010d", propertyId);
-    std::set<feeCacheItem> sCacheHistoryItems = GetCacheHistory(propertyId);
-    if (msc_debug_fees) PrintToLog("   Iterating cache history (%d items)...\n",sCacheHistoryItems.size());
-    std::string newValue;
-    if (!sCacheHistoryItems.empty()) {
-        for (std::set<feeCacheItem>::iterator it = sCacheHistoryItems.begin(); it != sCacheHistoryItems.end(); it++) {
-            feeCacheItem tempItem = *it;
-            if (tempItem.first == block) continue; // this is an older entry for the same block, discard it
-            if (!newValue.empty()) newValue += ",";
-            newValue += strprintf("%d:%d", tempItem.first, tempItem.second);
-            if (msc_debug_fees) PrintToLog("      Readding entry: block %d amount %d\n", tempItem.first, tempItem.second);
-        }
-        if (!newValue.empty()) newValue += ",";
-    }
-    if (msc_debug_fees) PrintToLog("   Adding requested entry: block %d new amount %d\n", block, newCachedAmount);
-    newValue += strprintf("%d:%d", block, newCachedAmount);
-    leveldb::Status status = pdb->Put(writeoptions, key, newValue);
+    leveldb::WriteBatch batch;
+    BatchWriteCacheEntry(batch, propertyId, block, newCachedAmount);
+    leveldb::Status status = Apply(batch);
     assert(status.ok());
     ++nWritten;
-    if (msc_debug_fees) PrintToLog("AddFee completed for property %d (new=%s [%s])\n", propertyId, newValue, status.ToString());
+    if (msc_debug_fees) PrintToLog("AddFee completed for property %d (block %d new amount %d [%s])\n", propertyId, block, newCachedAmount, status.ToString());
 
     // Call for pruning (we only prune when we update a record)
     PruneCache(propertyId, block);
 
-    // Call for cache evaluation (we only need to do this each time a fee cache is increased)
-    EvalCache(propertyId, block);
-
-    return;
+    return newCachedAmount;
 }
 
-// Rolls back the cache to an earlier state (eg in event of a reorg) - block is *inclusive* (ie entries=block will get deleted)
+/**
+ * Rolls back the cache to an earlier state (eg in event of a reorg) - block is *inclusive* (ie entries=block will get deleted)
+ *
+ * Only properties with entries in the rolled back blocks are visited, as recorded in the block index.
+ */
 void COmniFeeCache::RollBackCache(int block)
 {
     assert(pdb);
-    for (uint8_t ecosystem = 1; ecosystem <= 2; ecosystem++) {
-        uint32_t startPropertyId = (ecosystem == 1) ? 1 : TEST_ECO_PROPERTY_1;
-        for (uint32_t propertyId = startPropertyId; propertyId < mastercore::pDbSpInfo->peekNextSPID(ecosystem); propertyId++) {
-            const std::string key = strprintf("%010d", propertyId);
-            std::set<feeCacheItem> sCacheHistoryItems = GetCacheHistory(propertyId);
-            if (!sCacheHistoryItems.empty()) {
-                std::set<feeCacheItem>::iterator mostRecentIt = sCacheHistoryItems.end();
-                std::string newValue;
-                --mostRecentIt;
-                feeCacheItem mostRecentItem = *mostRecentIt;
-                if (mostRecentItem.first < block) continue; // all entries are unaffected by this rollback, nothing to do
-                for (std::set<feeCacheItem>::iterator it = sCacheHistoryItems.begin(); it != sCacheHistoryItems.end(); it++) {
-                    feeCacheItem tempItem = *it;
-                    if (tempItem.first >= block) continue; // discard this entry
-                    if (!newValue.empty()) newValue += ",";
-                    newValue += strprintf("%d:%d", tempItem.first, tempItem.second);
+
+    leveldb::WriteBatch batch;
+    std::set<uint32_t> affectedProperties;
+    leveldb::Iterator* it = NewIterator();
+
+    // collect and remove the affected properties of the rolled back blocks
+    for (it->Seek(EncodeDBEntry(CFeeCacheBlockKey(std::max(block, 0), 0))); it->Valid(); it->Next()) {
+        CFeeCacheBlockKey blockKey;
+        if (!DecodeDBEntry(it->key(), blockKey)) break;
+        affectedProperties.insert(blockKey.propertyId);
+        batch.Delete(it->key());
+    }
+
+    for (std::set<uint32_t>::const_iterator itProperty = affectedProperties.begin(); itProperty != affectedProperties.end(); ++itProperty) {
+        const uint32_t propertyId = *itProperty;
+        CFeeCacheKey key;
+        int64_t amount = 0;
+        feeCacheItem mostRecentItem;
+        bool fHasEntries = false;
+        int nRemoved = 0;
+
+        // remove the entries of the property, starting with the block, the preceding entry becomes the most recent one
+        for (it->Seek(EncodeDBEntry(CFeeCacheKey(propertyId, 0))); it->Valid(); it->Next()) {
+            if (!DecodeDBEntry(it->key(), key) || key.propertyId != propertyId) break;
+            if (key.block < block) {
+                if (DecodeDBEntry(it->value(), amount)) {
+                    mostRecentItem = std::make_pair(key.block, amount);
+                    fHasEntries = true;
                 }
-                leveldb::Status status = pdb->Put(writeoptions, key, newValue);
-                assert(status.ok());
-                PrintToLog("Rolling back fee cache for property %d, new=%s [%s])\n", propertyId, newValue, status.ToString());
+                continue;
             }
+            batch.Delete(it->key());
+            ++nRemoved;
         }
+
+        if (fHasEntries) {
+            batch.Put(EncodeDBEntry(CFeeKey(FEE_CACHE_HEAD, propertyId)), EncodeDBEntry(mostRecentItem));
+        } else {
+            batch.Delete(EncodeDBEntry(CFeeKey(FEE_CACHE_HEAD, propertyId)));
+        }
+        PrintToLog("Rolling back fee cache for property %d, removed %d entries, new=%s\n", propertyId, nRemoved,
+                fHasEntries ? strprintf("%d:%d", mostRecentItem.first, mostRecentItem.second) : "empty");
     }
+
+    delete it;
+
+    leveldb::Status status = Apply(batch);
+    assert(status.ok());
 }
 
 // Evaluates fee caches for the property against threshold and executes distribution if threshold met
@@ -235,7 +379,13 @@ void COmniFeeCache::DistributeCache(const uint32_t &propertyId, int block)
     ClearCache(propertyId, block);
 }
 
-// Prunes entries over MAX_STATE_HISTORY blocks old from the entry for a property
+/**
+ * Prunes entries over MAX_STATE_HISTORY blocks old from the entry for a property.
+ *
+ * The newest of the matured entries is kept, because it holds the cached amount
+ * of the blocks up to the next entry, which is restored by a rollback to any block
+ * within MAX_STATE_HISTORY. This also keeps the most recent entry.
+ */
 void COmniFeeCache::PruneCache(const uint32_t &propertyId, int block)
 {
     if (msc_debug_fees) PrintToLog("Starting PruneCache for prop %d block %d...\n", propertyId, block);
@@ -243,43 +393,36 @@ void COmniFeeCache::PruneCache(const uint32_t &propertyId, int block)
 
     int pruneBlock = block - MAX_STATE_HISTORY;
     if (msc_debug_fees) PrintToLog("Removing entries prior to block %d...\n", pruneBlock);
-    const std::string key = strprintf("%010d", propertyId);
-    std::set<feeCacheItem> sCacheHistoryItems = GetCacheHistory(propertyId);
-    if (msc_debug_fees) PrintToLog("   Iterating cache history (%d items)...\n",sCacheHistoryItems.size());
-    if (!sCacheHistoryItems.empty()) {
-        std::set<feeCacheItem>::iterator startIt = sCacheHistoryItems.begin();
-        feeCacheItem firstItem = *startIt;
-        if (firstItem.first >= pruneBlock) {
-            if (msc_debug_fees) PrintToLog("Endingg PruneCache - no matured entries found.\n");
-            return; // all entries are above supplied block value, nothing to do
-        }
-        std::string newValue;
-        for (std::set<feeCacheItem>::iterator it = sCacheHistoryItems.begin(); it != sCacheHistoryItems.end(); it++) {
-            feeCacheItem tempItem = *it;
-            if (tempItem.first < pruneBlock) {
-                if (msc_debug_fees) {
-                    PrintToLog("      Skipping matured entry: block %d amount %d\n", tempItem.first, tempItem.second);
-                    continue; // discard this entry
-                }
-            }
-            if (!newValue.empty()) newValue += ",";
-            newValue += strprintf("%d:%d", tempItem.first, tempItem.second);
-            if (msc_debug_fees) PrintToLog("      Readding immature entry: block %d amount %d\n", tempItem.first, tempItem.second);
-        }
-        // make sure the pruned cache isn't completely empty, if it is, prune down to just the most recent entry
-        if (newValue.empty()) {
-            std::set<feeCacheItem>::iterator mostRecentIt = sCacheHistoryItems.end();
-            --mostRecentIt;
-            feeCacheItem mostRecentItem = *mostRecentIt;
-            newValue = strprintf("%d:%d", mostRecentItem.first, mostRecentItem.second);
-            if (msc_debug_fees) PrintToLog("   All entries matured and pruned - readding most recent entry: block %d amount %d\n", mostRecentItem.first, mostRecentItem.second);
+
+    leveldb::WriteBatch batch;
+    int nPruned = 0;
+    CFeeCacheKey key;
+    CFeeCacheKey maturedKey;
+    bool fHasMatured = false;
+    leveldb::Iterator* it = NewIterator();
+    for (it->Seek(EncodeDBEntry(CFeeCacheKey(propertyId, 0))); it->Valid(); it->Next()) {
+        if (!DecodeDBEntry(it->key(), key) || key.propertyId != propertyId) break;
+        if (key.block >= pruneBlock) break;
+        // a matured entry is only removed, once a newer matured entry replaces it
+        if (fHasMatured) {
+            if (msc_debug_fees) PrintToLog("      Removing matured entry: block %d\n", maturedKey.block);
+            batch.Delete(EncodeDBEntry(maturedKey));
+            batch.Delete(EncodeDBEntry(CFeeCacheBlockKey(maturedKey.block, propertyId)));
+            ++nPruned;
         }
-        leveldb::Status status = pdb->Put(writeoptions, key, newValue);
-        assert(status.ok());
-        if (msc_debug_fees) PrintToLog("PruneCache completed for property %d (new=%s [%s])\n", propertyId, newValue, status.ToString());
-    } else {
-        return; // nothing to do
+        maturedKey = key;
+        fHasMatured = true;
     }
+    delete it;
+
+    if (nPruned == 0) {
+        if (msc_debug_fees) PrintToLog("Ending PruneCache - no matured entries found.\n");
+        return; // all entries are above supplied block value, nothing to do
+    }
+
+    leveldb::Status status = Apply(batch);
+    assert(status.ok());
+    if (msc_debug_fees) PrintToLog("PruneCache completed for property %d (pruned %d entries [%s])\n", propertyId, nPruned, status.ToString());
 }
 
 // Show Fee Cache DB statistics
@@ -292,10 +435,17 @@ void COmniFeeCache::printStats()
 void COmniFeeCache::printAll()
 {
     int count = 0;
+    CFeeCacheKey key;
+    int64_t amount = 0;
     leveldb::Iterator* it = NewIterator();
-    for(it->SeekToFirst(); it->Valid(); it->Next()) {
+    for (it->Seek(std::string(1, FEE_CACHE)); it->Valid(); it->Next()) {
+        if (!DecodeDBEntry(it->key(), key)) break;
         ++count;
-        PrintToConsole("entry #%8d= %s:%s\n", count, it->key().ToString(), it->value().ToString());
+        if (DecodeDBEntry(it->value(), amount)) {
+            PrintToConsole("entry #%8d= %010d:%d:%d\n", count, key.propertyId, key.block, amount);
+        } else {
+            PrintToConsole("entry #%8d= %s:%s\n", count, HexStr(it->key().ToString()), HexStr(it->value().ToString()));
+        }
     }
     delete it;
 }
@@ -305,33 +455,131 @@ std::set<feeCacheItem> COmniFeeCache::GetCacheHistory(const uint32_t &propertyId
 {
     assert(pdb);
 
-    const std::string key = strprintf("%010d", propertyId);
-
     std::set<feeCacheItem> sCacheHistoryItems;
-    std::string strValue;
-    leveldb::Status status = pdb->Get(readoptions, key, &strValue);
-    if (status.IsNotFound()) {
-        return sCacheHistoryItems; // no cache, return empty set
-    }
-    assert(status.ok());
-    std::vector<std::string> vCacheHistoryItems;
-    boost::split(vCacheHistoryItems, strValue, boost::is_any_of(","), boost::token_compress_on);
-    for (std::vector<std::string>::iterator it = vCacheHistoryItems.begin(); it != vCacheHistoryItems.end(); ++it) {
-        std::vector<std::string> vCacheHistoryItem;
-        boost::split(vCacheHistoryItem, *it, boost::is_any_of(":"), boost::token_compress_on);
-        if (2 != vCacheHistoryItem.size()) {
-            PrintToConsole("ERROR: vCacheHistoryItem has unexpected number of elements: %d (raw %s)!\n", vCacheHistoryItem.size(), *it);
-            printAll();
-            continue;
+    CFeeCacheKey key;
+    int64_t amount = 0;
+    leveldb::Iterator* it = NewIterator();
+    for (it->Seek(EncodeDBEntry(CFeeCacheKey(propertyId, 0))); it->Valid(); it->Next()) {
+        if (!DecodeDBEntry(it->key(), key) || key.propertyId != propertyId) break;
+        if (DecodeDBEntry(it->value(), amount)) {
+            sCacheHistoryItems.insert(std::make_pair(key.block, amount));
         }
-        int64_t cacheItemBlock = boost::lexical_cast<int64_t>(vCacheHistoryItem[0]);
-        int64_t cacheItemAmount = boost::lexical_cast<int64_t>(vCacheHistoryItem[1]);
-        sCacheHistoryItems.insert(std::make_pair(cacheItemBlock, cacheItemAmount));
     }
+    delete it;
 
     return sCacheHistoryItems;
 }
 
+/**
+ * Converts records of the legacy string based format into the binary format.
+ *
+ * Legacy keys are zero padded property identifiers, and values are comma separated
+ * lists of "block:amount" items.
+ *
+ * @return The number of converted records, or -1 on failure
+ */
+int COmniFeeCache::ConvertLegacyRecords()
+{
+    assert(pdb);
+
+    int64_t nTimeStart = GetTimeMicros();
+    int nConverted = 0;
+    leveldb::WriteBatch batch;
+
+    // the iterator operates on a snapshot, so converted entries are not visited again
+    leveldb::Iterator* it = NewIterator();
+
+    for (it->SeekToFirst(); it->Valid(); it->Next()) {
+        const std::string strKey = it->key().ToString();
+        const std::string strValue = it->value().ToString();
+        uint32_t propertyId = 0;
+        if (strKey.size() != 10 || !ParseUInt32(strKey, &propertyId)) continue; // not a legacy record
+
+        std::set<feeCacheItem> sCacheHistoryItems;
+        std::vector<std::string> vCacheHistoryItems;
+        boost::split(vCacheHistoryItems, strValue, boost::is_any_of(","), boost::token_compress_on);
+        for (std::vector<std::string>::iterator itItem = vCacheHistoryItems.begin(); itItem != vCacheHistoryItems.end(); ++itItem) {
+            std::vector<std::string> vCacheHistoryItem;
+            boost::split(vCacheHistoryItem, *itItem, boost::is_any_of(":"), boost::token_compress_on);
+            if (2 != vCacheHistoryItem.size()) continue;
+            try {
+                int cacheItemBlock = boost::lexical_cast<int>(vCacheHistoryItem[0]);
+                int64_t cacheItemAmount = boost::lexical_cast<int64_t>(vCacheHistoryItem[1]);
+                sCacheHistoryItems.insert(std::make_pair(cacheItemBlock, cacheItemAmount));
+            } catch (const boost::bad_lexical_cast&) {
+                PrintToLog("%s(): failed to parse fee cache item %s of property %d\n", __func__, *itItem, propertyId);
+            }
+        }
+
+        batch.Put(EncodeDBEntry(CFeeKey(FEE_CACHE, propertyId)), EncodeDBEntry(sCacheHistoryItems));
+        batch.Delete(it->key());
+        ++nConverted;
+    }
+
+    delete it;
+
+    leveldb::Status status = Apply(batch, true);
+
+    PrintToLog("%s(): converted %d records: %s [%.3f ms total]\n",
+            __func__, nConverted, status.ToString(), 0.001 * (GetTimeMicros() - nTimeStart));
+
+    return status.ok() ? nConverted : -1;
+}
+
+/**
+ * Converts the fee cache histories of database version 10 to 12 into separate entries per block.
+ *
+ * @return The number of converted histories, or -1 on failure
+ */
+int COmniFeeCache::ConvertCacheHistories()
+{
+    assert(pdb);
+
+    int64_t nTimeStart = GetTimeMicros();
+    int nConverted = 0;
+    int nBatched = 0;
+    leveldb::WriteBatch batch;
+    leveldb::Status status;
+    CFeeKey key;
+    std::set<feeCacheItem> sCacheHistoryItems;
+
+    // the iterator operates on a snapshot, so converted entries are not visited again
+    leveldb::Iterator* it = NewIterator();
+
+    for (it->Seek(std::string(1, FEE_CACHE)); it->Valid() && status.ok(); it->Next()) {
+        if (it->key().size() == 0 || it->key()[0] != FEE_CACHE) break;
+        if (!DecodeDBEntry(it->key(), key)) continue; // not a history
+        if (!DecodeDBEntry(it->value(), sCacheHistoryItems)) {
+            PrintToLog("%s(): failed to decode fee cache history of property %d\n", __func__, key.id);
+        } else {
+            // the set is sorted by block, so the last entry becomes the most recent one
+            for (std::set<feeCacheItem>::const_iterator itItem = sCacheHistoryItems.begin(); itItem != sCacheHistoryItems.end(); ++itItem) {
+                BatchWriteCacheEntry(batch, key.id, itItem->first, itItem->second);
+            }
+        }
+
+        batch.Delete(it->key());
+        ++nConverted;
+
+        if (++nBatched >= CONVERT_BATCH_SIZE) {
+            status = Apply(batch);
+            batch.Clear();
+            nBatched = 0;
+        }
+    }
+
+    delete it;
+
+    if (status.ok()) {
+        status = Apply(batch, true);
+    }
+
+    PrintToLog("%s(): converted %d records: %s [%.3f ms total]\n",
+            __func__, nConverted, status.ToString(), 0.001 * (GetTimeMicros() - nTimeStart));
+
+    return status.ok() ? nConverted : -1;
+}
+
 COmniFeeHistory::COmniFeeHistory(const fs::path& path, bool fWipe)
 {
     leveldb::Status status = Open(path, fWipe);
@@ -353,11 +601,24 @@ void COmniFeeHistory::printStats()
 void COmniFeeHistory::printAll()
 {
     int count = 0;
+    CFeeKey key;
+    CFeeDistribution distribution;
     leveldb::Iterator* it = NewIterator();
     for(it->SeekToFirst(); it->Valid(); it->Next()) {
         ++count;
-        PrintToConsole("entry #%8d= %s-%s\n", count, it->key().ToString(), it->value().ToString());
-        PrintToLog("entry #%8d= %s-%s\n", count, it->key().ToString(), it->value().ToString());
+        std::string strEntry;
+        if (DecodeDBEntry(it->key(), key) && DecodeDBEntry(it->value(), distribution)) {
+            std::string feeRecipientsStr;
+            for (std::set<feeHistoryItem>::iterator itRecipient = distribution.recipients.begin(); itRecipient != distribution.recipients.end(); ++itRecipient) {
+                if (!feeRecipientsStr.empty()) feeRecipientsStr += ",";
+                feeRecipientsStr += strprintf("%s=%d", itRecipient->first, itRecipient->second);
+            }
+            strEntry = strprintf("%d-%d:%d:%d:%s", key.id, distribution.block, distribution.propertyId, distribution.total, feeRecipientsStr);
+        } else {
+            strEntry = strprintf("%s-%s", HexStr(it->key().ToString()), HexStr(it->value().ToString()));
+        }
+        PrintToConsole("entry #%8d= %s\n", count, strEntry);
+        PrintToLog("entry #%8d= %s\n", count, strEntry);
     }
     delete it;
 }
@@ -380,24 +641,24 @@ void COmniFeeHistory::RollBackHistory(int block)
 {
     assert(pdb);
 
-    std::set<int> sDistributions;
+    CFeeKey key;
+    CFeeDistribution distribution;
+    leveldb::WriteBatch batch;
     leveldb::Iterator* it = NewIterator();
     for (it->SeekToFirst(); it->Valid(); it->Next()) {
-        std::string strValue = it->value().ToString();
-        std::string strKey = it->key().ToString();
-        std::vector<std::string> vFeeHistoryDetail;
-        boost::split(vFeeHistoryDetail, strValue, boost::is_any_of(":"), boost::token_compress_on);
-        if (4 != vFeeHistoryDetail.size()) {
-            PrintToLog("ERROR: vFeeHistoryDetail has unexpected number of elements: %d !\n", vFeeHistoryDetail.size());
+        if (!DecodeDBEntry(it->key(), key) || !DecodeDBEntry(it->value(), distribution)) {
+            PrintToLog("ERROR: fee history entry could not be decoded!\n");
             continue; // bad data
         }
-        int feeBlock = boost::lexical_cast<int>(vFeeHistoryDetail[0]);
-        if (feeBlock >= block) {
-            PrintToLog("%s() deleting from fee history DB: %s %s\n", __FUNCTION__, strKey, strValue);
-            pdb->Delete(writeoptions, strKey);
+        if (distribution.block >= block) {
+            PrintToLog("%s() deleting from fee history DB: %d (block %d, property %d)\n", __FUNCTION__, key.id, distribution.block, distribution.propertyId);
+            batch.Delete(it->key());
         }
     }
     delete it;
+
+    leveldb::Status status = Apply(batch);
+    assert(status.ok());
 }
 
 // Retrieve fee distributions for a property
@@ -405,22 +666,18 @@ std::set<int> COmniFeeHistory::GetDistributionsForProperty(const uint32_t &prope
 {
     assert(pdb);
 
+    CFeeKey key;
+    CFeeDistribution distribution;
     std::set<int> sDistributions;
     leveldb::Iterator* it = NewIterator();
     for (it->SeekToFirst(); it->Valid(); it->Next()) {
-        std::string strValue = it->value().ToString();
-        std::vector<std::string> vFeeHistoryDetail;
-        boost::split(vFeeHistoryDetail, strValue, boost::is_any_of(":"), boost::token_compress_on);
-        if (4 != vFeeHistoryDetail.size()) {
-            PrintToConsole("ERROR: vFeeHistoryDetail has unexpected number of elements: %d !\n", vFeeHistoryDetail.size());
+        if (!DecodeDBEntry(it->key(), key) || !DecodeDBEntry(it->value(), distribution)) {
+            PrintToConsole("ERROR: fee history entry could not be decoded!\n");
             printAll();
             continue; // bad data
         }
-        uint32_t prop = boost::lexical_cast<uint32_t>(vFeeHistoryDetail[1]);
-        if (prop == propertyId) {
-            std::string key = it->key().ToString();
-            int id = boost::lexical_cast<int>(key);
-            sDistributions.insert(id);
+        if (distribution.propertyId == propertyId) {
+            sDistributions.insert(key.id);
         }
     }
     delete it;
@@ -432,23 +689,13 @@ bool COmniFeeHistory::GetDistributionData(int id, uint32_t *propertyId, int *blo
 {
     assert(pdb);
 
-    const std::string key = strprintf("%d", id);
-    std::string strValue;
-    leveldb::Status status = pdb->Get(readoptions, key, &strValue);
-    if (status.IsNotFound()) {
+    CFeeDistribution distribution;
+    if (!Read(CFeeKey(FEE_DISTRIBUTION, id), distribution)) {
         return false; // fee distribution not found
     }
-    assert(status.ok());
-    std::vector<std::string> vFeeHistoryDetail;
-    boost::split(vFeeHistoryDetail, strValue, boost::is_any_of(":"), boost::token_compress_on);
-    if (4 != vFeeHistoryDetail.size()) {
-        PrintToConsole("ERROR: vFeeHistoryDetail has unexpected number of elements: %d !\n", vFeeHistoryDetail.size());
-        printAll();
-        return false; // bad data
-    }
-    *block = boost::lexical_cast<int>(vFeeHistoryDetail[0]);
-    *propertyId = boost::lexical_cast<uint32_t>(vFeeHistoryDetail[1]);
-    *total = boost::lexical_cast<int64_t>(vFeeHistoryDetail[2]);
+    *block = distribution.block;
+    *propertyId = distribution.propertyId;
+    *total = distribution.total;
     return true;
 }
 
@@ -457,36 +704,12 @@ std::set<feeHistoryItem> COmniFeeHistory::GetFeeDistribution(int id)
 {
     assert(pdb);
 
-    const std::string key = strprintf("%d", id);
-    std::set<feeHistoryItem> sFeeHistoryItems;
-    std::string strValue;
-    leveldb::Status status = pdb->Get(readoptions, key, &strValue);
-    if (status.IsNotFound()) {
-        return sFeeHistoryItems; // fee distribution not found, return empty set
-    }
-    assert(status.ok());
-    std::vector<std::string> vFeeHistoryDetail;
-    boost::split(vFeeHistoryDetail, strValue, boost::is_any_of(":"), boost::token_compress_on);
-    if (4 != vFeeHistoryDetail.size()) {
-        PrintToConsole("ERROR: vFeeHistoryDetail has unexpected number of elements: %d !\n", vFeeHistoryDetail.size());
-        printAll();
-        return sFeeHistoryItems; // bad data, return empty set
-    }
-    std::vector<std::string> vFeeHistoryItems;
-    boost::split(vFeeHistoryItems, vFeeHistoryDetail[3], boost::is_any_of(","), boost::token_compress_on);
-    for (std::vector<std::string>::iterator it = vFeeHistoryItems.begin(); it != vFeeHistoryItems.end(); ++it) {
-        std::vector<std::string> vFeeHistoryItem;
-        boost::split(vFeeHistoryItem, *it, boost::is_any_of("="), boost::token_compress_on);
-        if (2 != vFeeHistoryItem.size()) {
-            PrintToConsole("ERROR: vFeeHistoryItem has unexpected number of elements: %d (raw %s)!\n", vFeeHistoryItem.size(), *it);
-            printAll();
-            continue;
-        }
-        int64_t feeHistoryItemAmount = boost::lexical_cast<int64_t>(vFeeHistoryItem[1]);
-        sFeeHistoryItems.insert(std::make_pair(vFeeHistoryItem[0], feeHistoryItemAmount));
+    CFeeDistribution distribution;
+    if (!Read(CFeeKey(FEE_DISTRIBUTION, id), distribution)) {
+        return std::set<feeHistoryItem>(); // fee distribution not found, return empty set
     }
 
-    return sFeeHistoryItems;
+    return distribution.recipients;
 }
 
 // Record a fee distribution
@@ -495,21 +718,78 @@ void COmniFeeHistory::RecordFeeDistribution(const uint32_t &propertyId, int bloc
     assert(pdb);
 
     int count = CountRecords() + 1;
-    std::string key = strprintf("%d", count);
-    std::string feeRecipientsStr;
+    CFeeDistribution distribution;
+    distribution.block = block;
+    distribution.propertyId = propertyId;
+    distribution.total = total;
+    distribution.recipients = feeRecipients;
+
+    leveldb::Status status = Write(CFeeKey(FEE_DISTRIBUTION, count), distribution);
+    if (msc_debug_fees) PrintToLog("Added fee distribution to feeCacheHistory - id=%d block=%d property=%d total=%d recipients=%d [%s]\n",
+            count, block, propertyId, total, feeRecipients.size(), status.ToString());
+}
+
+/**
+ * Converts records of the legacy string based format into the binary format.
+ *
+ * Legacy keys are distribution identifiers, and values are strings of the format
+ * "block:propertyId:total:address=amount,address=amount".
+ *
+ * @return The number of converted records, or -1 on failure
+ */
+int COmniFeeHistory::ConvertLegacyRecords()
+{
+    assert(pdb);
+
+    int64_t nTimeStart = GetTimeMicros();
+    int nConverted = 0;
+    leveldb::WriteBatch batch;
 
-    if (!feeRecipients.empty()) {
-        for (std::set<feeHistoryItem>::iterator it = feeRecipients.begin(); it != feeRecipients.end(); it++) {
-            feeHistoryItem tempRecipient = *it;
-            feeRecipientsStr += strprintf("%s=%d,", tempRecipient.first, tempRecipient.second);
+    // the iterator operates on a snapshot, so converted entries are not visited again
+    leveldb::Iterator* it = NewIterator();
+
+    for (it->SeekToFirst(); it->Valid(); it->Next()) {
+        const std::string strKey = it->key().ToString();
+        const std::string strValue = it->value().ToString();
+        uint32_t id = 0;
+        if (!ParseUInt32(strKey, &id)) continue; // not a legacy record
+
+        std::vector<std::string> vFeeHistoryDetail;
+        boost::split(vFeeHistoryDetail, strValue, boost::is_any_of(":"), boost::token_compress_on);
+        if (4 != vFeeHistoryDetail.size()) {
+            PrintToLog("%s(): unexpected fee distribution %s=%s\n", __func__, strKey, strValue);
+            continue;
         }
-        if (feeRecipientsStr.size() > 0) {
-            feeRecipientsStr.resize(feeRecipientsStr.size() - 1);
+
+        CFeeDistribution distribution;
+        try {
+            distribution.block = boost::lexical_cast<int32_t>(vFeeHistoryDetail[0]);
+            distribution.propertyId = boost::lexical_cast<uint32_t>(vFeeHistoryDetail[1]);
+            distribution.total = boost::lexical_cast<int64_t>(vFeeHistoryDetail[2]);
+            std::vector<std::string> vFeeHistoryItems;
+            boost::split(vFeeHistoryItems, vFeeHistoryDetail[3], boost::is_any_of(","), boost::token_compress_on);
+            for (std::vector<std::string>::iterator itItem = vFeeHistoryItems.begin(); itItem != vFeeHistoryItems.end(); ++itItem) {
+                std::vector<std::string> vFeeHistoryItem;
+                boost::split(vFeeHistoryItem, *itItem, boost::is_any_of("="), boost::token_compress_on);
+                if (2 != vFeeHistoryItem.size()) continue;
+                distribution.recipients.insert(std::make_pair(vFeeHistoryItem[0], boost::lexical_cast<int64_t>(vFeeHistoryItem[1])));
+            }
+        } catch (const boost::bad_lexical_cast&) {
+            PrintToLog("%s(): failed to parse fee distribution %s=%s\n", __func__, strKey, strValue);
+            continue;
         }
+
+        batch.Put(EncodeDBEntry(CFeeKey(FEE_DISTRIBUTION, id)), EncodeDBEntry(distribution));
+        batch.Delete(it->key());
+        ++nConverted;
     }
 
-    std::string value = strprintf("%d:%d:%d:%s", block, propertyId, total, feeRecipientsStr);
-    leveldb::Status status = pdb->Put(writeoptions, key, value);
-    if (msc_debug_fees) PrintToLog("Added fee distribution to feeCacheHistory - key=%s value=%s [%s]\n", key, value, status.ToString());
-}
+    delete it;
+
+    leveldb::Status status = Apply(batch, true);
 
+    PrintToLog("%s(): converted %d records: %s [%.3f ms total]\n",
+            __func__, nConverted, status.ToString(), 0.001 * (GetTimeMicros() - nTimeStart));
+
+    return status.ok() ? nConverted : -1;
+}
@@ -14,6 +14,33 @@ typedef std::pair<int, int64_t> feeCacheItem;
 typedef std::pair<std::string, int64_t> feeHistoryItem;
 
 /** LevelDB based storage for the MetaDEx fee cache.
+ *
+ * Each update of the cached amount of a property is stored as separate entry of
+ * the block. The most recent entry of a property is kept as head record, and the
+ * properties with entries in a block are indexed by block, so that a rollback only
+ * visits the affected properties.
+ *
+ * DB Schema:
+ *
+ *  Key:
+ *      char 'c'
+ *      uint32_t propertyId (big-endian)
+ *      int32_t block (big-endian)
+ *  Value:
+ *      int64_t amount
+ *
+ *  Key:
+ *      char 'h'
+ *      uint32_t propertyId (big-endian)
+ *  Value:
+ *      int32_t block, int64_t amount
+ *
+ *  Key:
+ *      char 'b'
+ *      int32_t block (big-endian)
+ *      uint32_t propertyId (big-endian)
+ *  Value:
+ *      (empty)
  */
 class COmniFeeCache : public CDBBase
 {
@@ -34,7 +61,7 @@ public:
     std::set<feeCacheItem> GetCacheHistory(const uint32_t &propertyId);
     /** Gets the current amount of the fee cache for a property */
     int64_t GetCachedAmount(const uint32_t &propertyId);
-    /** Prunes entries over 50 blocks old from the entry for a property */
+    /** Prunes entries over MAX_STATE_HISTORY blocks old from the entries of a property */
     void PruneCache(const uint32_t &propertyId, int block);
     /** Rolls back the cache to an earlier state (eg in event of a reorg) - block is *inclusive* (ie entries=block will get deleted) */
     void RollBackCache(int block);
@@ -42,13 +69,28 @@ public:
     void ClearCache(const uint32_t &propertyId, int block);
     /** Adds a fee to the cache (eg on a completed trade) */
     void AddFee(const uint32_t &propertyId, int block, const int64_t &amount);
+    /** Adds a fee to the cache without evaluating the cache for distribution, returns the new cached amount */
+    int64_t CacheFee(const uint32_t &propertyId, int block, const int64_t &amount);
     /** Evaluates fee caches for all properties against threshold and executes distribution if threshold met */
     void EvalCache(const uint32_t &propertyId, int block);
     /** Performs distribution of fees */
     void DistributeCache(const uint32_t &propertyId, int block);
+    /** Converts records of the legacy string based format into the binary format */
+    int ConvertLegacyRecords();
+    /** Converts the fee cache histories of database version 10 to 12 into separate entries per block */
+    int ConvertCacheHistories();
 };
 
 /** LevelDB based storage for the MetaDEx fee distributions.
+ *
+ * DB Schema:
+ *
+ *  Key:
+ *      char 'd'
+ *      uint32_t distributionId (big-endian)
+ *  Value:
+ *      int32_t block, uint32_t propertyId, int64_t total,
+ *      std::set<(std::string address, int64_t amount)> recipients
  */
 class COmniFeeHistory : public CDBBase
 {
@@ -73,6 +115,8 @@ public:
     std::set<int> GetDistributionsForProperty(const uint32_t &propertyId);
     /** Populate data about a fee distribution */
     bool GetDistributionData(int id, uint32_t *propertyId, int *block, int64_t *total);
+    /** Converts records of the legacy string based format into the binary format */
+    int ConvertLegacyRecords();
 };
 
 namespace mastercore
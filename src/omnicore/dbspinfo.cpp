@@ -9,6 +9,7 @@
 #include <key_io.h>
 #include <serialize.h>
 #include <streams.h>
+#include <sync.h>
 #include <tinyformat.h>
 #include <uint256.h>
 
@@ -17,8 +18,13 @@
 
 #include <stdint.h>
 
+#include <memory>
 #include <string>
+#include <unordered_map>
+#include <utility>
 
+//! Maximal number of cached property entries, the cache is emptied, when it's full
+static const size_t MAX_CACHED_PROPERTIES = 10000;
 
 CMPSPInfo::Entry::Entry()
   : prop_type(0), prev_prop_id(0), num_tokens(0), property_desired(0),
@@ -90,25 +96,29 @@ CMPSPInfo::CMPSPInfo(const fs::path& path, bool fWipe)
     PrintToConsole("Loading smart property database: %s\n", status.ToString());
 
     // special cases for constant SPs OMN and TOMN
-    implied_omni.issuer = EncodeDestination(ExodusAddress());
-    implied_omni.updateIssuer(0, 0, implied_omni.issuer);
-    implied_omni.prop_type = MSC_PROPERTY_TYPE_DIVISIBLE;
-    implied_omni.num_tokens = 700000;
-    implied_omni.category = "N/A";
-    implied_omni.subcategory = "N/A";
-    implied_omni.name = "Omni tokens";
-    implied_omni.url = "http://www.omnilayer.org";
-    implied_omni.data = "Omni tokens serve as the binding between Bitcoin, smart properties and contracts created on the Omni Layer.";
-
-    implied_tomni.issuer = EncodeDestination(ExodusAddress());
-    implied_tomni.updateIssuer(0, 0, implied_tomni.issuer);
-    implied_tomni.prop_type = MSC_PROPERTY_TYPE_DIVISIBLE;
-    implied_tomni.num_tokens = 700000;
-    implied_tomni.category = "N/A";
-    implied_tomni.subcategory = "N/A";
-    implied_tomni.name = "Test Omni tokens";
-    implied_tomni.url = "http://www.omnilayer.org";
-    implied_tomni.data = "Test Omni tokens serve as the binding between Bitcoin, smart properties and contracts created on the Omni Layer.";
+    Entry omni;
+    omni.issuer = EncodeDestination(ExodusAddress());
+    omni.updateIssuer(0, 0, omni.issuer);
+    omni.prop_type = MSC_PROPERTY_TYPE_DIVISIBLE;
+    omni.num_tokens = 700000;
+    omni.category = "N/A";
+    omni.subcategory = "N/A";
+    omni.name = "Omni tokens";
+    omni.url = "http://www.omnilayer.org";
+    omni.data = "Omni tokens serve as the binding between Bitcoin, smart properties and contracts created on the Omni Layer.";
+    implied_omni = MakeHotFields(OMNI_PROPERTY_MSC, std::make_shared<const Entry>(omni));
+
+    Entry tomni;
+    tomni.issuer = EncodeDestination(ExodusAddress());
+    tomni.updateIssuer(0, 0, tomni.issuer);
+    tomni.prop_type = MSC_PROPERTY_TYPE_DIVISIBLE;
+    tomni.num_tokens = 700000;
+    tomni.category = "N/A";
+    tomni.subcategory = "N/A";
+    tomni.name = "Test Omni tokens";
+    tomni.url = "http://www.omnilayer.org";
+    tomni.data = "Test Omni tokens serve as the binding between Bitcoin, smart properties and contracts created on the Omni Layer.";
+    implied_tomni = MakeHotFields(OMNI_PROPERTY_TMSC, std::make_shared<const Entry>(tomni));
 
     init();
 }
@@ -122,6 +132,8 @@ void CMPSPInfo::Clear()
 {
     // wipe database via parent class
     CDBBase::Clear();
+    // drop the decoded entries
+    clearCache();
     // reset "next property identifiers"
     init();
 }
@@ -130,6 +142,7 @@ void CMPSPInfo::init(uint32_t nextSPID, uint32_t nextTestSPID)
 {
     next_spid = nextSPID;
     next_test_spid = nextTestSPID;
+    fIssuerCommitmentValid = false;
 }
 
 uint32_t CMPSPInfo::peekNextSPID(uint8_t ecosystem) const
@@ -179,17 +192,29 @@ bool CMPSPInfo::updateSP(uint32_t propertyId, const Entry& info)
     std::string strSpPrevValue;
 
     // if a value exists move it to the old key
-    if (!pdb->Get(readoptions, slSpKey, &strSpPrevValue).IsNotFound()) {
+    bool fPrevExists = !Get(slSpKey, &strSpPrevValue).IsNotFound();
+    if (fPrevExists) {
         batch.Put(slSpPrevKey, strSpPrevValue);
     }
     batch.Put(slSpKey, slSpValue);
-    leveldb::Status status = pdb->Write(syncoptions, &batch);
+    leveldb::Status status = Apply(batch, true);
+    uncacheSP(propertyId);
 
     if (!status.ok()) {
         PrintToLog("%s(): ERROR for SP %d: %s\n", __func__, propertyId, status.ToString());
+        fIssuerCommitmentValid = false;
         return false;
     }
 
+    // replace the previous issuer in the commitment
+    Entry prevInfo;
+    if (fPrevExists && DecodeDBEntry(strSpPrevValue, prevInfo)) {
+        issuerCommitment.Remove(mastercore::GenerateConsensusString(propertyId, prevInfo.issuer));
+        issuerCommitment.Add(mastercore::GenerateConsensusString(propertyId, info.issuer));
+    } else {
+        fIssuerCommitmentValid = false;
+    }
+
     PrintToLog("%s(): updated entry for SP %d successfully\n", __func__, propertyId);
     return true;
 }
@@ -233,10 +258,11 @@ uint32_t CMPSPInfo::putSP(uint8_t ecosystem, const Entry& info)
 
     // sanity checking
     std::string existingEntry;
-    if (!pdb->Get(readoptions, slSpKey, &existingEntry).IsNotFound() && slSpValue.compare(existingEntry) != 0) {
+    bool fExists = !Get(slSpKey, &existingEntry).IsNotFound();
+    if (fExists && slSpValue.compare(existingEntry) != 0) {
         std::string strError = strprintf("writing SP %d to DB, when a different SP already exists for that identifier", propertyId);
         PrintToLog("%s() ERROR: %s\n", __func__, strError);
-    } else if (!pdb->Get(readoptions, slTxIndexKey, &existingEntry).IsNotFound() && slTxValue.compare(existingEntry) != 0) {
+    } else if (!Get(slTxIndexKey, &existingEntry).IsNotFound() && slTxValue.compare(existingEntry) != 0) {
         std::string strError = strprintf("writing index txid %s : SP %d is overwriting a different value", info.txid.ToString(), propertyId);
         PrintToLog("%s() ERROR: %s\n", __func__, strError);
     }
@@ -246,23 +272,57 @@ uint32_t CMPSPInfo::putSP(uint8_t ecosystem, const Entry& info)
     batch.Put(slSpKey, slSpValue);
     batch.Put(slTxIndexKey, slTxValue);
 
-    leveldb::Status status = pdb->Write(syncoptions, &batch);
+    leveldb::Status status = Apply(batch, true);
+    uncacheSP(propertyId);
 
     if (!status.ok()) {
         PrintToLog("%s(): ERROR for SP %d: %s\n", __func__, propertyId, status.ToString());
     }
 
+    // an overwritten entry is already part of the commitment, so it's rebuilt instead
+    if (status.ok() && !fExists) {
+        issuerCommitment.Add(mastercore::GenerateConsensusString(propertyId, info.issuer));
+    } else {
+        fIssuerCommitmentValid = false;
+    }
+
     return propertyId;
 }
 
-bool CMPSPInfo::getSP(uint32_t propertyId, Entry& info) const
+CMPSPInfo::HotFields CMPSPInfo::MakeHotFields(uint32_t propertyId, const EntryPtr& entry)
+{
+    HotFields fields;
+    fields.divisible = entry->isDivisible();
+    fields.fixed = entry->fixed;
+    fields.manual = entry->manual;
+    fields.ecosystem = mastercore::isTestEcosystemProperty(propertyId) ? OMNI_PROPERTY_TMSC : OMNI_PROPERTY_MSC;
+    fields.entry = entry;
+
+    return fields;
+}
+
+/**
+ * Retrieves a property from the cache, or from the database, if it isn't cached.
+ *
+ * The cache lock is held while the entry is read from the database, so an entry,
+ * which is written and uncached at the same time, can't be cached in its old state.
+ */
+bool CMPSPInfo::lookupSP(uint32_t propertyId, HotFields& fields) const
 {
     // special cases for constant SPs MSC and TMSC
     if (OMNI_PROPERTY_MSC == propertyId) {
-        info = implied_omni;
+        fields = implied_omni;
         return true;
     } else if (OMNI_PROPERTY_TMSC == propertyId) {
-        info = implied_tomni;
+        fields = implied_tomni;
+        return true;
+    }
+
+    LOCK(cs_cache);
+
+    std::unordered_map<uint32_t, HotFields>::const_iterator it = cacheEntries.find(propertyId);
+    if (it != cacheEntries.end()) {
+        fields = it->second;
         return true;
     }
 
@@ -273,7 +333,7 @@ bool CMPSPInfo::getSP(uint32_t propertyId, Entry& info) const
 
     // DB value for property entry
     std::string strSpValue;
-    leveldb::Status status = pdb->Get(readoptions, slSpKey, &strSpValue);
+    leveldb::Status status = Get(slSpKey, &strSpValue);
     if (!status.ok()) {
         if (!status.IsNotFound()) {
             PrintToLog("%s(): ERROR for SP %d: %s\n", __func__, propertyId, status.ToString());
@@ -281,17 +341,62 @@ bool CMPSPInfo::getSP(uint32_t propertyId, Entry& info) const
         return false;
     }
 
+    std::shared_ptr<Entry> info = std::make_shared<Entry>();
     try {
         CDataStream ssSpValue(strSpValue.data(), strSpValue.data() + strSpValue.size(), SER_DISK, CLIENT_VERSION);
-        ssSpValue >> info;
+        ssSpValue >> *info;
     } catch (const std::exception& e) {
         PrintToLog("%s(): ERROR for SP %d: %s\n", __func__, propertyId, e.what());
         return false;
     }
 
+    if (cacheEntries.size() >= MAX_CACHED_PROPERTIES) {
+        cacheEntries.clear();
+    }
+    fields = MakeHotFields(propertyId, info);
+    cacheEntries.insert(std::make_pair(propertyId, fields));
+
     return true;
 }
 
+void CMPSPInfo::uncacheSP(uint32_t propertyId)
+{
+    LOCK(cs_cache);
+    cacheEntries.erase(propertyId);
+}
+
+void CMPSPInfo::clearCache()
+{
+    LOCK(cs_cache);
+    cacheEntries.clear();
+}
+
+bool CMPSPInfo::getSP(uint32_t propertyId, Entry& info) const
+{
+    HotFields fields;
+    if (!lookupSP(propertyId, fields)) {
+        return false;
+    }
+
+    info = *fields.entry;
+    return true;
+}
+
+CMPSPInfo::EntryPtr CMPSPInfo::getSPEntry(uint32_t propertyId) const
+{
+    HotFields fields;
+    if (!lookupSP(propertyId, fields)) {
+        return nullptr;
+    }
+
+    return fields.entry;
+}
+
+bool CMPSPInfo::getSPHotFields(uint32_t propertyId, HotFields& fields) const
+{
+    return lookupSP(propertyId, fields);
+}
+
 bool CMPSPInfo::hasSP(uint32_t propertyId) const
 {
     // Special cases for constant SPs MSC and TMSC
@@ -299,6 +404,13 @@ bool CMPSPInfo::hasSP(uint32_t propertyId) const
         return true;
     }
 
+    {
+        LOCK(cs_cache);
+        if (cacheEntries.count(propertyId)) {
+            return true;
+        }
+    }
+
     // DB key for property entry
     CDataStream ssSpKey(SER_DISK, CLIENT_VERSION);
     ssSpKey << std::make_pair('s', propertyId);
@@ -306,7 +418,7 @@ bool CMPSPInfo::hasSP(uint32_t propertyId) const
 
     // DB value for property entry
     std::string strSpValue;
-    leveldb::Status status = pdb->Get(readoptions, slSpKey, &strSpValue);
+    leveldb::Status status = Get(slSpKey, &strSpValue);
 
     return status.ok();
 }
@@ -322,7 +434,7 @@ uint32_t CMPSPInfo::findSPByTX(const uint256& txid) const
 
     // DB value for identifier
     std::string strTxIndexValue;
-    if (!pdb->Get(readoptions, slTxIndexKey, &strTxIndexValue).ok()) {
+    if (!Get(slTxIndexKey, &strTxIndexValue).ok()) {
         std::string strError = strprintf("failed to find property created with %s", txid.GetHex());
         PrintToLog("%s(): ERROR: %s", __func__, strError);
         return 0;
@@ -389,7 +501,7 @@ int64_t CMPSPInfo::popBlock(const uint256& block_hash)
                 leveldb::Slice slSpPrevKey(&ssSpPrevKey[0], ssSpPrevKey.size());
 
                 std::string strSpPrevValue;
-                if (!pdb->Get(readoptions, slSpPrevKey, &strSpPrevValue).IsNotFound()) {
+                if (!Get(slSpPrevKey, &strSpPrevValue).IsNotFound()) {
                     // copy the prev state to the current state and delete the old state
                     commitBatch.Put(slSpKey, strSpPrevValue);
                     commitBatch.Delete(slSpPrevKey);
@@ -408,7 +520,11 @@ int64_t CMPSPInfo::popBlock(const uint256& block_hash)
     // clean up the iterator
     delete iter;
 
-    leveldb::Status status = pdb->Write(syncoptions, &commitBatch);
+    leveldb::Status status = Apply(commitBatch, true);
+
+    // popping blocks is rare, so the cache is emptied, and the issuer commitment is simply rebuilt when needed
+    clearCache();
+    fIssuerCommitmentValid = false;
 
     if (!status.ok()) {
         PrintToLog("%s(): ERROR: %s\n", __func__, status.ToString());
@@ -418,6 +534,33 @@ int64_t CMPSPInfo::popBlock(const uint256& block_hash)
     return remainingSPs;
 }
 
+/**
+ * Returns the order-independent commitment of the issuers of all properties.
+ *
+ * The commitment is built once from the database, and is then updated, whenever
+ * a property is created or updated.
+ */
+uint256 CMPSPInfo::GetIssuerCommitment()
+{
+    if (!fIssuerCommitmentValid) {
+        issuerCommitment.Clear();
+        for (uint8_t ecosystem = 1; ecosystem <= 2; ecosystem++) {
+            uint32_t startPropertyId = (ecosystem == 1) ? 1 : TEST_ECO_PROPERTY_1;
+            for (uint32_t propertyId = startPropertyId; propertyId < peekNextSPID(ecosystem); propertyId++) {
+                EntryPtr sp = getSPEntry(propertyId);
+                if (!sp) {
+                    PrintToLog("Error loading property ID %d for the issuer commitment, commitment should not be trusted!\n", propertyId);
+                    continue;
+                }
+                issuerCommitment.Add(mastercore::GenerateConsensusString(propertyId, sp->issuer));
+            }
+        }
+        fIssuerCommitmentValid = true;
+    }
+
+    return issuerCommitment.GetHash();
+}
+
 void CMPSPInfo::setWatermark(const uint256& watermark)
 {
     leveldb::WriteBatch batch;
@@ -434,7 +577,7 @@ void CMPSPInfo::setWatermark(const uint256& watermark)
     batch.Delete(slKey);
     batch.Put(slKey, slValue);
 
-    leveldb::Status status = pdb->Write(syncoptions, &batch);
+    leveldb::Status status = Apply(batch, true);
     if (!status.ok()) {
         PrintToLog("%s(): ERROR: failed to write watermark: %s\n", __func__, status.ToString());
     }
@@ -447,7 +590,7 @@ bool CMPSPInfo::getWatermark(uint256& watermark) const
     leveldb::Slice slKey(&ssKey[0], ssKey.size());
 
     std::string strValue;
-    leveldb::Status status = pdb->Get(readoptions, slKey, &strValue);
+    leveldb::Status status = Get(slKey, &strValue);
     if (!status.ok()) {
         if (!status.IsNotFound()) {
             PrintToLog("%s(): ERROR: failed to retrieve watermark: %s\n", __func__, status.ToString());
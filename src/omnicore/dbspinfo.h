@@ -1,18 +1,22 @@
 #ifndef BITCOIN_OMNICORE_DBSPINFO_H
 #define BITCOIN_OMNICORE_DBSPINFO_H
 
+#include <omnicore/consensushash.h>
 #include <omnicore/dbbase.h>
 #include <omnicore/log.h>
 #include <omnicore/omnicore.h>
 
 #include <fs.h>
 #include <serialize.h>
+#include <sync.h>
 #include <uint256.h>
 
 #include <stdint.h>
 
 #include <map>
+#include <memory>
 #include <string>
+#include <unordered_map>
 
 /** LevelDB based storage for currencies, smart properties and tokens.
  *
@@ -41,6 +45,9 @@
  *      uint32_t propertyId
  *  Value:
  *      CMPSPInfo::Entry info
+ *
+ * Decoded property entries are kept in a read-through cache, which is
+ * invalidated, whenever an entry is written or a block is popped.
  */
 class CMPSPInfo : public CDBBase
 {
@@ -130,14 +137,52 @@ public:
         std::string getIssuer(int block) const;
     };
 
+    //! Decoded property entry, which is shared with the cache
+    typedef std::shared_ptr<const Entry> EntryPtr;
+
+    /** Frequently used fields of a property, which are available without copying the entry. */
+    struct HotFields
+    {
+        bool divisible;
+        bool fixed;
+        bool manual;
+        uint8_t ecosystem;
+        //! The whole entry, which also keeps the issuer alive
+        EntryPtr entry;
+
+        const std::string& issuer() const { return entry->issuer; }
+    };
+
 private:
     // implied version of OMN and TOMN so they don't hit the leveldb
-    Entry implied_omni;
-    Entry implied_tomni;
+    HotFields implied_omni;
+    HotFields implied_tomni;
+
+    //! Guards the cache, and is held while an entry is read from the database and cached
+    mutable CCriticalSection cs_cache;
+    //! Cache of decoded property entries
+    mutable std::unordered_map<uint32_t, HotFields> cacheEntries;
+
+    /** Creates the hot fields of an entry. */
+    static HotFields MakeHotFields(uint32_t propertyId, const EntryPtr& entry);
+
+    /** Retrieves a property from the cache, or from the database, if it isn't cached. */
+    bool lookupSP(uint32_t propertyId, HotFields& fields) const;
+
+    /** Removes a property from the cache. */
+    void uncacheSP(uint32_t propertyId);
+
+    /** Removes all properties from the cache. */
+    void clearCache();
 
     uint32_t next_spid;
     uint32_t next_test_spid;
 
+    //! Order-independent commitment of the issuers of all properties
+    CConsensusAccumulator issuerCommitment;
+    //! Whether the issuer commitment reflects the current state
+    bool fIssuerCommitmentValid;
+
 public:
     CMPSPInfo(const fs::path& path, bool fWipe);
     virtual ~CMPSPInfo();
@@ -151,6 +196,10 @@ public:
     bool updateSP(uint32_t propertyId, const Entry& info);
     uint32_t putSP(uint8_t ecosystem, const Entry& info);
     bool getSP(uint32_t propertyId, Entry& info) const;
+    /** Returns the shared, cached entry of a property, or nullptr, if the property doesn't exist. */
+    EntryPtr getSPEntry(uint32_t propertyId) const;
+    /** Returns the frequently used fields of a property, without copying the entry. */
+    bool getSPHotFields(uint32_t propertyId, HotFields& fields) const;
     bool hasSP(uint32_t propertyId) const;
     uint32_t findSPByTX(const uint256& txid) const;
 
@@ -159,6 +208,9 @@ public:
     void setWatermark(const uint256& watermark);
     bool getWatermark(uint256& watermark) const;
 
+    /** Returns the order-independent commitment of the issuers of all properties. */
+    uint256 GetIssuerCommitment();
+
     void printAll() const;
 };
 
@@ -4,10 +4,13 @@
 #include <omnicore/sp.h>
 #include <omnicore/walletutils.h>
 
+#include <clientversion.h>
 #include <fs.h>
 #include <interfaces/wallet.h>
+#include <serialize.h>
 #include <uint256.h>
 #include <util/strencodings.h>
+#include <util/time.h>
 #include <tinyformat.h>
 
 #include <univalue.h>
@@ -15,6 +18,7 @@
 #include <leveldb/iterator.h>
 #include <leveldb/slice.h>
 #include <leveldb/status.h>
+#include <leveldb/write_batch.h>
 
 #include <boost/algorithm/string.hpp>
 #include <boost/lexical_cast.hpp>
@@ -22,12 +26,193 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include <algorithm>
+#include <ios>
+#include <set>
 #include <string>
+#include <utility>
 #include <vector>
 
 using mastercore::IsMyAddress;
 using mastercore::isPropertyDivisible;
 
+namespace {
+
+//! Key prefix of the recipients of a transaction
+const char STO_RECIPIENTS = 't';
+//! Key prefix of the receipts of an address
+const char STO_RECEIPTS = 'a';
+//! Key prefix of the receipt lists of addresses of database version 10 and 11
+const char STO_RECEIPT_LIST = 'r';
+
+//! Number of entries converted from the legacy format, before a batch is written
+const int CONVERT_BATCH_SIZE = 10000;
+
+/** Key of a recipient of a send to owners transaction: txid and recipient address. */
+struct CSTORecipientKey
+{
+    uint256 txid;
+    std::string address;
+
+    CSTORecipientKey() {}
+    CSTORecipientKey(const uint256& txidIn, const std::string& addressIn) : txid(txidIn), address(addressIn) {}
+
+    template <typename Stream>
+    void Serialize(Stream& s) const
+    {
+        ser_writedata8(s, STO_RECIPIENTS);
+        txid.Serialize(s);
+        s << address;
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s)
+    {
+        if (ser_readdata8(s) != STO_RECIPIENTS) {
+            throw std::ios_base::failure("not a recipient key");
+        }
+        txid.Unserialize(s);
+        s >> address;
+    }
+};
+
+/** A single receipt of a send to owners transaction. */
+struct CSTOReceipt
+{
+    int32_t block;
+    uint32_t propertyId;
+    uint64_t amount;
+
+    CSTOReceipt() : block(0), propertyId(0), amount(0) {}
+    CSTOReceipt(int blockIn, uint32_t propertyIdIn, uint64_t amountIn)
+      : block(blockIn), propertyId(propertyIdIn), amount(amountIn) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(block);
+        READWRITE(propertyId);
+        READWRITE(amount);
+    }
+};
+
+/** Key of a receipt of an address: recipient address, block and txid. */
+struct CSTOReceiptKey
+{
+    std::string address;
+    int nBlock;
+    uint256 txid;
+
+    CSTOReceiptKey() : nBlock(0) {}
+    CSTOReceiptKey(const std::string& addressIn, int nBlockIn, const uint256& txidIn)
+      : address(addressIn), nBlock(nBlockIn), txid(txidIn) {}
+
+    template <typename Stream>
+    void Serialize(Stream& s) const
+    {
+        ser_writedata8(s, STO_RECEIPTS);
+        s << address;
+        // Heights are stored big-endian for key sorting in LevelDB
+        ser_writedata32be(s, nBlock);
+        txid.Serialize(s);
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s)
+    {
+        if (ser_readdata8(s) != STO_RECEIPTS) {
+            throw std::ios_base::failure("not a receipt key");
+        }
+        s >> address;
+        nBlock = ser_readdata32be(s);
+        txid.Unserialize(s);
+    }
+};
+
+/** Key of the receipt list of an address of database version 10 and 11. */
+struct CSTOReceiptListKey
+{
+    std::string address;
+
+    CSTOReceiptListKey() {}
+
+    template <typename Stream>
+    void Unserialize(Stream& s)
+    {
+        if (ser_readdata8(s) != STO_RECEIPT_LIST) {
+            throw std::ios_base::failure("not a receipt list key");
+        }
+        s >> address;
+    }
+};
+
+/** A receipt of the receipt list of an address of database version 10 and 11. */
+struct CSTOReceiptListEntry
+{
+    uint256 txid;
+    int32_t block;
+    uint32_t propertyId;
+    uint64_t amount;
+
+    CSTOReceiptListEntry() : block(0), propertyId(0), amount(0) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(txid);
+        READWRITE(block);
+        READWRITE(propertyId);
+        READWRITE(amount);
+    }
+};
+
+/** Returns the position of the first recipient of the given transaction. */
+std::string GetRecipientSeekKey(const uint256& txid)
+{
+    CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+    ser_writedata8(ssKey, STO_RECIPIENTS);
+    txid.Serialize(ssKey);
+    return std::string(ssKey.begin(), ssKey.end());
+}
+
+/** Returns the position of the first receipt of the given address. */
+std::string GetReceiptSeekKey(const std::string& address)
+{
+    CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+    ser_writedata8(ssKey, STO_RECEIPTS);
+    ssKey << address;
+    return std::string(ssKey.begin(), ssKey.end());
+}
+
+/** Returns the position of the first receipt of the given address in or after the given block. */
+std::string GetReceiptSeekKey(const std::string& address, int nBlock)
+{
+    CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+    ser_writedata8(ssKey, STO_RECEIPTS);
+    ssKey << address;
+    ser_writedata32be(ssKey, std::max(nBlock, 0));
+    return std::string(ssKey.begin(), ssKey.end());
+}
+
+/** Returns the position after the last receipt of the given address. */
+std::string GetReceiptEndKey(const std::string& address)
+{
+    std::string strKey = GetReceiptSeekKey(address);
+    strKey.push_back('\xff');
+    return strKey;
+}
+
+/** Stores a receipt under the transaction and the address. */
+void BatchWriteReceipt(leveldb::WriteBatch& batch, const std::string& address, const uint256& txid, const CSTOReceipt& receipt)
+{
+    batch.Put(EncodeDBEntry(CSTORecipientKey(txid, address)), EncodeDBEntry(receipt));
+    batch.Put(EncodeDBEntry(CSTOReceiptKey(address, receipt.block, txid)), EncodeDBEntry(receipt));
+}
+
+} // anonymous namespace
+
 CMPSTOList::CMPSTOList(const fs::path& path, bool fWipe)
 {
     leveldb::Status status = Open(path, fWipe);
@@ -39,152 +224,174 @@ CMPSTOList::~CMPSTOList()
     if (msc_debug_persistence) PrintToLog("CMPSTOList closed\n");
 }
 
-void CMPSTOList::getRecipients(const uint256 txid, std::string filterAddress, UniValue* recipientArray, uint64_t* total, uint64_t* numRecipients, interfaces::Wallet* iWallet)
+/**
+ * Obtains the recipients of a send to owners transaction.
+ *
+ * Only the recipient records of the transaction are visited. All recipients are counted,
+ * so the fee can be determined, but only those matching the filter and within the requested
+ * page are added to the array. Recipient keys are only decoded while the page isn't full,
+ * and not at all, when filtering by address.
+ *
+ * @param txid            The hash of the send to owners transaction
+ * @param filterAddress   A recipient address, "*" for all, or empty for addresses of the wallet
+ * @param recipientArray  The recipients are added to this array
+ * @param total           The amounts of the added recipients are added to this value
+ * @param numRecipients   The total number of recipients
+ * @param iWallet         The wallet used for filtering (optional)
+ * @param offset          The number of matching recipients to skip first (optional)
+ * @param limit           The maximal number of recipients to add, or 0 for all (optional)
+ */
+void CMPSTOList::getRecipients(const uint256 txid, std::string filterAddress, UniValue* recipientArray, uint64_t* total, uint64_t* numRecipients, interfaces::Wallet* iWallet, uint64_t offset, uint64_t limit)
 {
     if (!pdb) return;
 
     bool filter = true; //default
-    bool filterByWallet = true; //default
     bool filterByAddress = false; //default
 
     if (filterAddress == "*") filter = false;
-    if ((filterAddress != "") && (filterAddress != "*")) {
-        filterByWallet = false;
-        filterByAddress = true;
-    }
+    if ((filterAddress != "") && (filterAddress != "*")) filterByAddress = true;
 
-    // iterate through SDB, dropping all records where key is not filterAddress (if filtering)
-    int count = 0;
+    // iterate through the recipients of the transaction, dropping all records where the address is not filterAddress (if filtering)
+    uint64_t count = 0;
+    uint64_t skipped = 0;
 
     // the fee is variable based on version of STO - provide number of recipients and allow calling function to work out fee
     *numRecipients = 0;
 
-    leveldb::Slice skey, svalue;
+    const std::string strSeekKey = GetRecipientSeekKey(txid);
+    const std::string strFilterKey = filterByAddress ? EncodeDBEntry(CSTORecipientKey(txid, filterAddress)) : std::string();
+    CSTORecipientKey key;
+    CSTOReceipt receipt;
     leveldb::Iterator* it = NewIterator();
-    for (it->SeekToFirst(); it->Valid(); it->Next()) {
-        skey = it->key();
-        std::string recipientAddress = skey.ToString();
-        svalue = it->value();
-        std::string strValue = svalue.ToString();
-        // see if txid is in the data
-        size_t txidMatch = strValue.find(txid.ToString());
-        if (txidMatch != std::string::npos) {
-            ++*numRecipients;
-            // the txid exists inside the data, this address was a recipient of this STO, check filter and add the details
-            if (filter) {
-                if (((filterByAddress) && (filterAddress == recipientAddress)) || ((filterByWallet) && (IsMyAddress(recipientAddress, iWallet)))) {
-                } else {
-                    continue;
-                } // move on if no filter match (but counter still increased for fee)
-            }
-            std::vector<std::string> vstr;
-            boost::split(vstr, strValue, boost::is_any_of(","), boost::token_compress_on);
-            for (uint32_t i = 0; i < vstr.size(); i++) {
-                std::vector<std::string> svstr;
-                boost::split(svstr, vstr[i], boost::is_any_of(":"), boost::token_compress_on);
-                if (4 == svstr.size()) {
-                    if (svstr[0] == txid.ToString()) {
-                        //add data to array
-                        uint64_t amount = 0;
-                        uint64_t propertyId = 0;
-                        try {
-                            amount = boost::lexical_cast<uint64_t>(svstr[3]);
-                            propertyId = boost::lexical_cast<uint64_t>(svstr[2]);
-                        } catch (const boost::bad_lexical_cast &e) {
-                            PrintToLog("DEBUG STO - error in converting values from leveldb\n");
-                            delete it;
-                            return; //(something went wrong)
-                        }
-                        UniValue recipient(UniValue::VOBJ);
-                        recipient.pushKV("address", recipientAddress);
-                        if (isPropertyDivisible(propertyId)) {
-                            recipient.pushKV("amount", FormatDivisibleMP(amount));
-                        } else {
-                            recipient.pushKV("amount", FormatIndivisibleMP(amount));
-                        }
-                        *total += amount;
-                        recipientArray->push_back(recipient);
-                        ++count;
-                    }
-                }
-            }
+    for (it->Seek(strSeekKey); it->Valid(); it->Next()) {
+        if (!it->key().starts_with(strSeekKey)) break;
+
+        // all recipients are counted for the fee, but only decoded, if they may be added to the page
+        ++*numRecipients;
+        if (limit != 0 && count >= limit) continue;
+
+        std::string recipientAddress = filterAddress;
+        if (filterByAddress) {
+            if (it->key() != strFilterKey) continue;
+        } else {
+            if (!DecodeDBEntry(it->key(), key)) break;
+            recipientAddress = key.address;
+            if (filter && !IsMyAddress(recipientAddress, iWallet)) continue;
+        }
+        if (skipped < offset) {
+            ++skipped;
+            continue;
         }
+        if (!DecodeDBEntry(it->value(), receipt)) {
+            PrintToLog("DEBUG STO - error in decoding receipt of %s from leveldb\n", recipientAddress);
+            continue;
+        }
+        //add data to array
+        uint64_t amount = receipt.amount;
+        uint64_t propertyId = receipt.propertyId;
+        UniValue recipient(UniValue::VOBJ);
+        recipient.pushKV("address", recipientAddress);
+        if (isPropertyDivisible(propertyId)) {
+            recipient.pushKV("amount", FormatDivisibleMP(amount));
+        } else {
+            recipient.pushKV("amount", FormatIndivisibleMP(amount));
+        }
+        *total += amount;
+        recipientArray->push_back(recipient);
+        ++count;
     }
 
     delete it;
     return;
 }
 
-std::string CMPSTOList::getMySTOReceipts(std::string filterAddress, interfaces::Wallet &iWallet)
+/**
+ * Returns the blocks and transactions of the receipts of the wallet, or of one of its addresses.
+ *
+ * Each transaction is returned once, even if several addresses of the wallet received tokens.
+ */
+std::vector<std::pair<int, uint256> > CMPSTOList::GetWalletReceipts(interfaces::Wallet& iWallet, const std::string& filterAddress)
 {
-    if (!pdb) return "";
-    std::string mySTOReceipts = "";
-    leveldb::Slice skey, svalue;
+    std::vector<std::pair<int, uint256> > vReceipts;
+    if (!pdb) return vReceipts;
+    std::set<uint256> setReceiptTxids;
+    CSTOReceiptKey key;
     leveldb::Iterator* it = NewIterator();
-    for (it->SeekToFirst(); it->Valid(); it->Next()) {
-        skey = it->key();
-        std::string recipientAddress = skey.ToString();
-        if (!IsMyAddress(recipientAddress, &iWallet)) continue; // not ours, not interested
-        if ((!filterAddress.empty()) && (filterAddress != recipientAddress)) continue; // not the filtered address
-        // ours, get info
-        svalue = it->value();
-        std::string strValue = svalue.ToString();
-        // break into individual receipts
-        std::vector<std::string> vstr;
-        boost::split(vstr, strValue, boost::is_any_of(","), boost::token_compress_on);
-        for (uint32_t i = 0; i < vstr.size(); i++) {
-            // add to array
-            std::vector<std::string> svstr;
-            boost::split(svstr, vstr[i], boost::is_any_of(":"), boost::token_compress_on);
-            if (4 == svstr.size()) {
-                size_t txidMatch = mySTOReceipts.find(svstr[0]);
-                if (txidMatch == std::string::npos) mySTOReceipts += svstr[0] + ":" + svstr[1] + ":" + recipientAddress + ":" + svstr[2] + ",";
-            }
+    it->Seek(filterAddress.empty() ? std::string(1, STO_RECEIPTS) : GetReceiptSeekKey(filterAddress));
+    while (it->Valid()) {
+        if (!DecodeDBEntry(it->key(), key)) break;
+        const std::string& recipientAddress = key.address;
+        if ((!filterAddress.empty()) && (filterAddress != recipientAddress)) break; // past the filtered address
+        if (!IsMyAddress(recipientAddress, &iWallet)) { // not ours, skip all receipts of this address
+            it->Seek(GetReceiptEndKey(recipientAddress));
+            continue;
+        }
+        // ours, the block is part of the key
+        if (setReceiptTxids.insert(key.txid).second) {
+            vReceipts.push_back(std::make_pair(key.nBlock, key.txid));
         }
+        it->Next();
+    }
+    delete it;
+    return vReceipts;
+}
+
+/**
+ * Returns the recipient addresses of a send to owners transaction.
+ */
+std::vector<std::string> CMPSTOList::GetRecipientAddresses(const uint256& txid)
+{
+    std::vector<std::string> vAddresses;
+    if (!pdb) return vAddresses;
+    const std::string strSeekKey = GetRecipientSeekKey(txid);
+    CSTORecipientKey key;
+    leveldb::Iterator* it = NewIterator();
+    for (it->Seek(strSeekKey); it->Valid(); it->Next()) {
+        if (!it->key().starts_with(strSeekKey) || !DecodeDBEntry(it->key(), key)) break;
+        vAddresses.push_back(key.address);
     }
     delete it;
-    // above code will leave a trailing comma - strip it
-    if (mySTOReceipts.size() > 0) mySTOReceipts.resize(mySTOReceipts.size() - 1);
-    return mySTOReceipts;
+    return vAddresses;
 }
 
 /**
  * This function deletes records of STO receivers above/equal to a specific block from the STO database.
  *
+ * The receipts of each address are ordered by block, so only the receipts to delete are visited,
+ * besides one seek per address.
+ *
  * Returns the number of records changed.
  */
 int CMPSTOList::deleteAboveBlock(int blockNum)
 {
     unsigned int n_found = 0;
-    std::vector<std::string> vecSTORecords;
+    CSTOReceiptKey key;
+    leveldb::WriteBatch batch;
     leveldb::Iterator* it = NewIterator();
-    for (it->SeekToFirst(); it->Valid(); it->Next()) {
-        std::string newValue;
-        std::string oldValue = it->value().ToString();
-        bool needsUpdate = false;
-        boost::split(vecSTORecords, oldValue, boost::is_any_of(","), boost::token_compress_on);
-        for (uint32_t i = 0; i < vecSTORecords.size(); i++) {
-            std::vector<std::string> vecSTORecordFields;
-            boost::split(vecSTORecordFields, vecSTORecords[i], boost::is_any_of(":"), boost::token_compress_on);
-            if (4 != vecSTORecordFields.size()) continue;
-            if (atoi(vecSTORecordFields[1]) < blockNum) {
-                newValue += vecSTORecords[i].append(","); // STO before the reorg, add data back to new value string
-            } else {
-                needsUpdate = true;
-            }
-        }
-        if (needsUpdate) { // rewrite record with existing key and new value
-            ++n_found;
-            leveldb::Status status = pdb->Put(writeoptions, it->key().ToString(), newValue);
-            PrintToLog("DEBUG STO - rewriting STO data after reorg\n");
-            PrintToLog("STODBDEBUG : %s(): %s, line %d, file: %s\n", __FUNCTION__, status.ToString(), __LINE__, __FILE__);
+    it->Seek(std::string(1, STO_RECEIPTS));
+    while (it->Valid()) {
+        if (!DecodeDBEntry(it->key(), key)) break;
+        if (key.nBlock < blockNum) {
+            // STO before the reorg, skip to the receipts to delete, or the next address
+            it->Seek(GetReceiptSeekKey(key.address, blockNum));
+            continue;
         }
+        ++n_found;
+        batch.Delete(it->key());
+        batch.Delete(EncodeDBEntry(CSTORecipientKey(key.txid, key.address)));
+        PrintToLog("DEBUG STO - deleting STO receipt %s of %s after reorg\n", key.txid.ToString(), key.address);
+        it->Next();
     }
 
-    PrintToLog("%s(%d); stodb updated records= %d\n", __FUNCTION__, blockNum, n_found);
-
     delete it;
 
+    if (n_found > 0) {
+        leveldb::Status status = Apply(batch);
+        PrintToLog("STODBDEBUG : %s(): %s, line %d, file: %s\n", __FUNCTION__, status.ToString(), __LINE__, __FILE__);
+    }
+
+    PrintToLog("%s(%d); stodb updated records= %d\n", __FUNCTION__, blockNum, n_found);
+
     return (n_found);
 }
 
@@ -196,14 +403,18 @@ void CMPSTOList::printStats()
 void CMPSTOList::printAll()
 {
     int count = 0;
-    leveldb::Slice skey, svalue;
+    CSTOReceiptKey key;
+    CSTOReceipt receipt;
     leveldb::Iterator* it = NewIterator();
 
     for (it->SeekToFirst(); it->Valid(); it->Next()) {
-        skey = it->key();
-        svalue = it->value();
+        if (!it->key().empty() && it->key()[0] == STO_RECIPIENTS) continue; // same receipts as by address
         ++count;
-        PrintToConsole("entry #%8d= %s:%s\n", count, skey.ToString(), svalue.ToString());
+        if (!DecodeDBEntry(it->key(), key) || !DecodeDBEntry(it->value(), receipt)) {
+            PrintToConsole("entry #%8d= %s:%s\n", count, HexStr(it->key().ToString()), HexStr(it->value().ToString()));
+            continue;
+        }
+        PrintToConsole("entry #%8d= %s:%s:%d:%u:%lu\n", count, key.address, key.txid.ToString(), receipt.block, receipt.propertyId, receipt.amount);
     }
 
     delete it;
@@ -213,49 +424,148 @@ bool CMPSTOList::exists(std::string address)
 {
     if (!pdb) return false;
 
-    std::string strValue;
-    leveldb::Status status = pdb->Get(readoptions, address, &strValue);
-
-    if (!status.ok()) {
-        if (status.IsNotFound()) return false;
-    }
+    const std::string strSeekKey = GetReceiptSeekKey(address);
+    leveldb::Iterator* it = NewIterator();
+    it->Seek(strSeekKey);
+    bool fExists = it->Valid() && it->key().starts_with(strSeekKey);
+    delete it;
 
-    return true;
+    return fExists;
 }
 
 void CMPSTOList::recordSTOReceive(std::string address, const uint256 &txid, int nBlock, unsigned int propertyId, uint64_t amount)
 {
     if (!pdb) return;
 
-    bool addressExists = exists(address);
-    if (addressExists) {
-        // retrieve existing record
-        std::vector<std::string> vstr;
-        std::string strValue;
-        leveldb::Status status = pdb->Get(readoptions, address, &strValue);
-        if (status.ok()) {
-            // add details to record
-            // see if we are overwriting (check)
-            size_t txidMatch = strValue.find(txid.ToString());
-            if (txidMatch != std::string::npos) PrintToLog("STODEBUG : Duplicating entry for %s : %s\n", address, txid.ToString());
-
-            const std::string key = address;
-            const std::string newValue = strprintf("%s:%d:%u:%lu,", txid.ToString(), nBlock, propertyId, amount);
-            strValue += newValue;
-            // write updated record
-            leveldb::Status status;
-            if (pdb) {
-                status = pdb->Put(writeoptions, key, strValue);
-                PrintToLog("STODBDEBUG : %s(): %s, line %d, file: %s\n", __FUNCTION__, status.ToString(), __LINE__, __FILE__);
+    // see if we are overwriting (check)
+    if (Exists(CSTORecipientKey(txid, address))) {
+        PrintToLog("STODEBUG : Duplicating entry for %s : %s\n", address, txid.ToString());
+    }
+
+    // receipts are stored as separate records, so existing receipts are not rewritten
+    leveldb::WriteBatch batch;
+    BatchWriteReceipt(batch, address, txid, CSTOReceipt(nBlock, propertyId, amount));
+    leveldb::Status status = Apply(batch);
+    ++nWritten;
+    if (msc_debug_sto) PrintToLog("STODBDEBUG : %s(): %s, line %d, file: %s\n", __FUNCTION__, status.ToString(), __LINE__, __FILE__);
+}
+
+/**
+ * Converts records of the legacy string based format into the binary format.
+ *
+ * Legacy keys are recipient addresses, and values are comma separated lists of
+ * "txid:block:propertyId:amount" receipts.
+ *
+ * @return The number of converted records, or -1 on failure
+ */
+int CMPSTOList::ConvertLegacyRecords()
+{
+    assert(pdb);
+
+    int64_t nTimeStart = GetTimeMicros();
+    int nConverted = 0;
+    int nBatched = 0;
+    leveldb::WriteBatch batch;
+    leveldb::Status status;
+    CSTORecipientKey recipientKey;
+    CSTOReceiptKey receiptKey;
+
+    // the iterator operates on a snapshot, so converted entries are not visited again
+    leveldb::Iterator* it = NewIterator();
+
+    for (it->SeekToFirst(); it->Valid() && status.ok(); it->Next()) {
+        if (DecodeDBEntry(it->key(), recipientKey) || DecodeDBEntry(it->key(), receiptKey)) continue; // already converted
+        const std::string strKey = it->key().ToString();
+        const std::string strValue = it->value().ToString();
+
+        std::vector<std::string> vecSTORecords;
+        boost::split(vecSTORecords, strValue, boost::is_any_of(","), boost::token_compress_on);
+        for (uint32_t i = 0; i < vecSTORecords.size(); i++) {
+            std::vector<std::string> vecSTORecordFields;
+            boost::split(vecSTORecordFields, vecSTORecords[i], boost::is_any_of(":"), boost::token_compress_on);
+            if (4 != vecSTORecordFields.size()) continue;
+            try {
+                BatchWriteReceipt(batch, strKey, uint256S(vecSTORecordFields[0]), CSTOReceipt(
+                        boost::lexical_cast<int32_t>(vecSTORecordFields[1]),
+                        boost::lexical_cast<uint32_t>(vecSTORecordFields[2]),
+                        boost::lexical_cast<uint64_t>(vecSTORecordFields[3])));
+            } catch (const boost::bad_lexical_cast&) {
+                PrintToLog("%s(): failed to parse receipt %s of %s\n", __func__, vecSTORecords[i], strKey);
+            }
+        }
+
+        batch.Delete(it->key());
+        ++nConverted;
+
+        if (++nBatched >= CONVERT_BATCH_SIZE) {
+            status = Apply(batch);
+            batch.Clear();
+            nBatched = 0;
+        }
+    }
+
+    delete it;
+
+    if (status.ok()) {
+        status = Apply(batch, true);
+    }
+
+    PrintToLog("%s(): converted %d records: %s [%.3f ms total]\n",
+            __func__, nConverted, status.ToString(), 0.001 * (GetTimeMicros() - nTimeStart));
+
+    return status.ok() ? nConverted : -1;
+}
+
+/**
+ * Converts the receipt lists of addresses into separate records per receipt.
+ *
+ * Databases of version 10 and 11 store all receipts of an address as one list.
+ *
+ * @return The number of converted lists, or -1 on failure
+ */
+int CMPSTOList::ConvertReceiptLists()
+{
+    assert(pdb);
+
+    int64_t nTimeStart = GetTimeMicros();
+    int nConverted = 0;
+    int nBatched = 0;
+    leveldb::WriteBatch batch;
+    leveldb::Status status;
+    CSTOReceiptListKey key;
+    std::vector<CSTOReceiptListEntry> receipts;
+
+    // the iterator operates on a snapshot, so converted entries are not visited again
+    leveldb::Iterator* it = NewIterator();
+
+    for (it->Seek(std::string(1, STO_RECEIPT_LIST)); it->Valid() && status.ok(); it->Next()) {
+        if (!DecodeDBEntry(it->key(), key)) break;
+        if (!DecodeDBEntry(it->value(), receipts)) {
+            PrintToLog("%s(): failed to decode receipts of %s\n", __func__, key.address);
+        } else {
+            for (std::vector<CSTOReceiptListEntry>::const_iterator itReceipt = receipts.begin(); itReceipt != receipts.end(); ++itReceipt) {
+                BatchWriteReceipt(batch, key.address, itReceipt->txid, CSTOReceipt(itReceipt->block, itReceipt->propertyId, itReceipt->amount));
             }
         }
-    } else {
-        const std::string key = address;
-        const std::string value = strprintf("%s:%d:%u:%lu,", txid.ToString(), nBlock, propertyId, amount);
-        leveldb::Status status;
-        if (pdb) {
-            status = pdb->Put(writeoptions, key, value);
-            PrintToLog("STODBDEBUG : %s(): %s, line %d, file: %s\n", __FUNCTION__, status.ToString(), __LINE__, __FILE__);
+
+        batch.Delete(it->key());
+        ++nConverted;
+
+        if (++nBatched >= CONVERT_BATCH_SIZE) {
+            status = Apply(batch);
+            batch.Clear();
+            nBatched = 0;
         }
     }
+
+    delete it;
+
+    if (status.ok()) {
+        status = Apply(batch, true);
+    }
+
+    PrintToLog("%s(): converted %d records: %s [%.3f ms total]\n",
+            __func__, nConverted, status.ToString(), 0.001 * (GetTimeMicros() - nTimeStart));
+
+    return status.ok() ? nConverted : -1;
 }
@@ -11,12 +11,35 @@
 #include <stdint.h>
 
 #include <string>
+#include <utility>
+#include <vector>
 
 namespace interfaces {
 class Wallet;
 } // namespace interfaces
 
 /** LevelDB based storage for STO recipients.
+ *
+ * Each receipt is stored twice, once under the transaction and once under the recipient,
+ * so that the recipients of a transaction and the receipts of an address can be looked
+ * up with range seeks. Receipts are written as new records, existing ones are never rewritten.
+ *
+ * DB Schema:
+ *
+ *  Key:
+ *      char 't'
+ *      uint256 txid
+ *      std::string address
+ *  Value:
+ *      int32_t block, uint32_t propertyId, uint64_t amount
+ *
+ *  Key:
+ *      char 'a'
+ *      std::string address
+ *      int32_t block (big-endian)
+ *      uint256 txid
+ *  Value:
+ *      int32_t block, uint32_t propertyId, uint64_t amount
  */
 class CMPSTOList : public CDBBase
 {
@@ -24,8 +47,11 @@ public:
     CMPSTOList(const fs::path& path, bool fWipe);
     virtual ~CMPSTOList();
 
-    void getRecipients(const uint256 txid, std::string filterAddress, UniValue* recipientArray, uint64_t* total, uint64_t* numRecipients, interfaces::Wallet* iWallet = nullptr);
-    std::string getMySTOReceipts(std::string filterAddress, interfaces::Wallet& iWallet);
+    void getRecipients(const uint256 txid, std::string filterAddress, UniValue* recipientArray, uint64_t* total, uint64_t* numRecipients, interfaces::Wallet* iWallet = nullptr, uint64_t offset = 0, uint64_t limit = 0);
+    /** Returns the blocks and transactions of the receipts of the wallet, or of one of its addresses. */
+    std::vector<std::pair<int, uint256> > GetWalletReceipts(interfaces::Wallet& iWallet, const std::string& filterAddress = "");
+    /** Returns the recipient addresses of a send to owners transaction. */
+    std::vector<std::string> GetRecipientAddresses(const uint256& txid);
     
     /**
      * This function deletes records of STO receivers above/equal to a specific block from the STO database.
@@ -37,6 +63,11 @@ public:
     void printAll();
     bool exists(std::string address);
     void recordSTOReceive(std::string, const uint256&, int, unsigned int, uint64_t);
+
+    /** Converts records of the legacy string based format into the binary format. */
+    int ConvertLegacyRecords();
+    /** Converts the receipt lists of addresses into separate records per receipt. */
+    int ConvertReceiptLists();
 };
 
 namespace mastercore
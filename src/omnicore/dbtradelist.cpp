@@ -5,9 +5,12 @@
 #include <omnicore/sp.h>
 
 #include <amount.h>
+#include <clientversion.h>
 #include <fs.h>
+#include <serialize.h>
 #include <uint256.h>
 #include <util/strencodings.h>
+#include <util/time.h>
 #include <tinyformat.h>
 
 #include <univalue.h>
@@ -15,6 +18,7 @@
 #include <leveldb/iterator.h>
 #include <leveldb/slice.h>
 #include <leveldb/status.h>
+#include <leveldb/write_batch.h>
 
 #include <boost/algorithm/string.hpp>
 #include <boost/lexical_cast.hpp>
@@ -22,13 +26,290 @@
 #include <stddef.h>
 
 #include <algorithm>
-#include <map>
+#include <ios>
+#include <set>
 #include <string>
 #include <utility>
 #include <vector>
 
 using mastercore::isPropertyDivisible;
 
+namespace {
+
+//! Key prefix of matched trades
+const char TRADE_MATCH = 'm';
+//! Key prefix of new trades
+const char TRADE_NEW = 'n';
+//! Key prefix of the index of new trades by address
+const char TRADE_ADDRESS_INDEX = 'a';
+//! Key prefix of the index of matched trades by property pair
+const char TRADE_PAIR_INDEX = 'p';
+//! Key prefix of the index of matched trades by the txid of the second trade
+const char TRADE_MATCH_REVERSE = 'r';
+
+//! Number of entries converted from the legacy format, before a batch is written
+const int CONVERT_BATCH_SIZE = 10000;
+
+/** Key of a trade record: prefix, txid and the txid of the matched trade, if any. */
+struct CTradeKey
+{
+    char prefix;
+    uint256 txid1;
+    uint256 txid2;
+
+    CTradeKey() : prefix(0) {}
+    explicit CTradeKey(const uint256& txid) : prefix(TRADE_NEW), txid1(txid) {}
+    CTradeKey(const uint256& txid1In, const uint256& txid2In) : prefix(TRADE_MATCH), txid1(txid1In), txid2(txid2In) {}
+
+    template <typename Stream>
+    void Serialize(Stream& s) const
+    {
+        ser_writedata8(s, prefix);
+        txid1.Serialize(s);
+        if (prefix == TRADE_MATCH) txid2.Serialize(s);
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s)
+    {
+        prefix = ser_readdata8(s);
+        if (prefix != TRADE_MATCH && prefix != TRADE_NEW) {
+            throw std::ios_base::failure("unknown trade key prefix");
+        }
+        txid1.Unserialize(s);
+        if (prefix == TRADE_MATCH) txid2.Unserialize(s);
+    }
+};
+
+/** A new MetaDEx trade. */
+struct CTradeNew
+{
+    std::string address;
+    uint32_t propertyIdForSale;
+    uint32_t propertyIdDesired;
+    int32_t block;
+    int32_t blockIndex;
+
+    CTradeNew() : propertyIdForSale(0), propertyIdDesired(0), block(0), blockIndex(0) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(address);
+        READWRITE(propertyIdForSale);
+        READWRITE(propertyIdDesired);
+        READWRITE(block);
+        READWRITE(blockIndex);
+    }
+};
+
+/** A match between two MetaDEx trades. */
+struct CTradeMatch
+{
+    std::string address1;
+    std::string address2;
+    uint32_t prop1;
+    uint32_t prop2;
+    int64_t amount1;
+    int64_t amount2;
+    int32_t block;
+    int64_t fee;
+
+    CTradeMatch() : prop1(0), prop2(0), amount1(0), amount2(0), block(0), fee(0) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(address1);
+        READWRITE(address2);
+        READWRITE(prop1);
+        READWRITE(prop2);
+        READWRITE(amount1);
+        READWRITE(amount2);
+        READWRITE(block);
+        READWRITE(fee);
+    }
+};
+
+/** Key of the address index: address, position in the chain and txid of a new trade. */
+struct CTradeAddressKey
+{
+    std::string address;
+    int nBlock;
+    int nBlockIndex;
+    uint256 txid;
+
+    CTradeAddressKey() : nBlock(0), nBlockIndex(0) {}
+    CTradeAddressKey(const std::string& addressIn, int nBlockIn, int nBlockIndexIn, const uint256& txidIn)
+      : address(addressIn), nBlock(nBlockIn), nBlockIndex(nBlockIndexIn), txid(txidIn) {}
+
+    template <typename Stream>
+    void Serialize(Stream& s) const
+    {
+        ser_writedata8(s, TRADE_ADDRESS_INDEX);
+        ::Serialize(s, address);
+        // Positions are stored big-endian for key sorting in LevelDB
+        ser_writedata32be(s, nBlock);
+        ser_writedata32be(s, nBlockIndex);
+        txid.Serialize(s);
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s)
+    {
+        if (ser_readdata8(s) != TRADE_ADDRESS_INDEX) {
+            throw std::ios_base::failure("not an address index key");
+        }
+        ::Unserialize(s, address);
+        nBlock = ser_readdata32be(s);
+        nBlockIndex = ser_readdata32be(s);
+        txid.Unserialize(s);
+    }
+};
+
+/** Value of the address index: the properties of the new trade, used for filtering. */
+struct CTradeAddressEntry
+{
+    uint32_t propertyIdForSale;
+    uint32_t propertyIdDesired;
+
+    CTradeAddressEntry() : propertyIdForSale(0), propertyIdDesired(0) {}
+    CTradeAddressEntry(uint32_t propertyIdForSaleIn, uint32_t propertyIdDesiredIn)
+      : propertyIdForSale(propertyIdForSaleIn), propertyIdDesired(propertyIdDesiredIn) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(propertyIdForSale);
+        READWRITE(propertyIdDesired);
+    }
+};
+
+/**
+ * Key of the pair index: property pair, position in the chain and txids of a match.
+ *
+ * The lower property identifier comes first, so that both sides of a market share
+ * the same range.
+ */
+struct CTradePairKey
+{
+    uint32_t propertyIdLow;
+    uint32_t propertyIdHigh;
+    int nBlock;
+    int nBlockIndex;
+    uint256 txid1;
+    uint256 txid2;
+
+    CTradePairKey() : propertyIdLow(0), propertyIdHigh(0), nBlock(0), nBlockIndex(0) {}
+    CTradePairKey(uint32_t prop1, uint32_t prop2, int nBlockIn, int nBlockIndexIn, const uint256& txid1In, const uint256& txid2In)
+      : propertyIdLow(std::min(prop1, prop2)), propertyIdHigh(std::max(prop1, prop2)),
+        nBlock(nBlockIn), nBlockIndex(nBlockIndexIn), txid1(txid1In), txid2(txid2In) {}
+
+    template <typename Stream>
+    void Serialize(Stream& s) const
+    {
+        ser_writedata8(s, TRADE_PAIR_INDEX);
+        // Identifiers and positions are stored big-endian for key sorting in LevelDB
+        ser_writedata32be(s, propertyIdLow);
+        ser_writedata32be(s, propertyIdHigh);
+        ser_writedata32be(s, nBlock);
+        ser_writedata32be(s, nBlockIndex);
+        txid1.Serialize(s);
+        txid2.Serialize(s);
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s)
+    {
+        if (ser_readdata8(s) != TRADE_PAIR_INDEX) {
+            throw std::ios_base::failure("not a pair index key");
+        }
+        propertyIdLow = ser_readdata32be(s);
+        propertyIdHigh = ser_readdata32be(s);
+        nBlock = ser_readdata32be(s);
+        nBlockIndex = ser_readdata32be(s);
+        txid1.Unserialize(s);
+        txid2.Unserialize(s);
+    }
+};
+
+/** Key of the reverse lookup of matches: txid of the second trade, followed by the first one. */
+struct CTradeReverseKey
+{
+    uint256 txid2;
+    uint256 txid1;
+
+    CTradeReverseKey() {}
+    CTradeReverseKey(const uint256& txid2In, const uint256& txid1In) : txid2(txid2In), txid1(txid1In) {}
+
+    template <typename Stream>
+    void Serialize(Stream& s) const
+    {
+        ser_writedata8(s, TRADE_MATCH_REVERSE);
+        txid2.Serialize(s);
+        txid1.Serialize(s);
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s)
+    {
+        if (ser_readdata8(s) != TRADE_MATCH_REVERSE) {
+            throw std::ios_base::failure("not a reverse match key");
+        }
+        txid2.Unserialize(s);
+        txid1.Unserialize(s);
+    }
+};
+
+/** Returns the position of the first entry with the given prefix, followed by a txid. */
+std::string GetTxidSeekKey(char prefix, const uint256& txid)
+{
+    CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+    ser_writedata8(ssKey, prefix);
+    txid.Serialize(ssKey);
+    return std::string(ssKey.begin(), ssKey.end());
+}
+
+/** Returns the position of the first address index entry of the given address. */
+std::string GetAddressSeekKey(const std::string& address)
+{
+    CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+    ser_writedata8(ssKey, TRADE_ADDRESS_INDEX);
+    ssKey << address;
+    return std::string(ssKey.begin(), ssKey.end());
+}
+
+/** Returns the position of the first pair index entry of the given pair. */
+std::string GetPairSeekKey(uint32_t prop1, uint32_t prop2)
+{
+    CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+    ser_writedata8(ssKey, TRADE_PAIR_INDEX);
+    ser_writedata32be(ssKey, std::min(prop1, prop2));
+    ser_writedata32be(ssKey, std::max(prop1, prop2));
+    return std::string(ssKey.begin(), ssKey.end());
+}
+
+/** Stores a new trade, and adds it to the address index. */
+void BatchWriteNewTrade(leveldb::WriteBatch& batch, const uint256& txid, const CTradeNew& trade)
+{
+    batch.Put(EncodeDBEntry(CTradeKey(txid)), EncodeDBEntry(trade));
+    batch.Put(EncodeDBEntry(CTradeAddressKey(trade.address, trade.block, trade.blockIndex, txid)),
+            EncodeDBEntry(CTradeAddressEntry(trade.propertyIdForSale, trade.propertyIdDesired)));
+}
+
+/** Stores a matched trade, and adds it to the pair index and the reverse lookup. */
+void BatchWriteMatchedTrade(leveldb::WriteBatch& batch, const uint256& txid1, const uint256& txid2, int nBlockIndex, const CTradeMatch& match)
+{
+    batch.Put(EncodeDBEntry(CTradeKey(txid1, txid2)), EncodeDBEntry(match));
+    batch.Put(EncodeDBEntry(CTradePairKey(match.prop1, match.prop2, match.block, nBlockIndex, txid1, txid2)), leveldb::Slice());
+    batch.Put(EncodeDBEntry(CTradeReverseKey(txid2, txid1)), leveldb::Slice());
+}
+
+} // anonymous namespace
+
 CMPTradeList::CMPTradeList(const fs::path& path, bool fWipe)
 {
     leveldb::Status status = Open(path, fWipe);
@@ -40,12 +321,21 @@ CMPTradeList::~CMPTradeList()
     if (msc_debug_persistence) PrintToLog("CMPTradeList closed\n");
 }
 
-void CMPTradeList::recordMatchedTrade(const uint256& txid1, const uint256& txid2, const std::string& address1, const std::string& address2, uint32_t prop1, uint32_t prop2, int64_t amount1, int64_t amount2, int blockNum, int64_t fee)
+void CMPTradeList::recordMatchedTrade(const uint256& txid1, const uint256& txid2, const std::string& address1, const std::string& address2, uint32_t prop1, uint32_t prop2, int64_t amount1, int64_t amount2, int blockNum, int blockIndex, int64_t fee)
 {
     if (!pdb) return;
-    const std::string key = txid1.ToString() + "+" + txid2.ToString();
-    const std::string value = strprintf("%s:%s:%u:%u:%lu:%lu:%d:%d", address1, address2, prop1, prop2, amount1, amount2, blockNum, fee);
-    leveldb::Status status = pdb->Put(writeoptions, key, value);
+    CTradeMatch match;
+    match.address1 = address1;
+    match.address2 = address2;
+    match.prop1 = prop1;
+    match.prop2 = prop2;
+    match.amount1 = amount1;
+    match.amount2 = amount2;
+    match.block = blockNum;
+    match.fee = fee;
+    leveldb::WriteBatch batch;
+    BatchWriteMatchedTrade(batch, txid1, txid2, blockIndex, match);
+    leveldb::Status status = Apply(batch);
     ++nWritten;
     if (msc_debug_tradedb) PrintToLog("%s: %s\n", __func__, status.ToString());
 }
@@ -53,8 +343,15 @@ void CMPTradeList::recordMatchedTrade(const uint256& txid1, const uint256& txid2
 void CMPTradeList::recordNewTrade(const uint256& txid, const std::string& address, uint32_t propertyIdForSale, uint32_t propertyIdDesired, int blockNum, int blockIndex)
 {
     if (!pdb) return;
-    std::string strValue = strprintf("%s:%d:%d:%d:%d", address, propertyIdForSale, propertyIdDesired, blockNum, blockIndex);
-    leveldb::Status status = pdb->Put(writeoptions, txid.ToString(), strValue);
+    CTradeNew trade;
+    trade.address = address;
+    trade.propertyIdForSale = propertyIdForSale;
+    trade.propertyIdDesired = propertyIdDesired;
+    trade.block = blockNum;
+    trade.blockIndex = blockIndex;
+    leveldb::WriteBatch batch;
+    BatchWriteNewTrade(batch, txid, trade);
+    leveldb::Status status = Apply(batch);
     ++nWritten;
     if (msc_debug_tradedb) PrintToLog("%s: %s\n", __func__, status.ToString());
 }
@@ -62,33 +359,53 @@ void CMPTradeList::recordNewTrade(const uint256& txid, const std::string& addres
 /**
  * This function deletes records of trades above/equal to a specific block from the trade database.
  *
+ * Index entries are removed together with the records they refer to.
+ *
  * Returns the number of records changed.
  */
 int CMPTradeList::deleteAboveBlock(int blockNum)
 {
-    leveldb::Slice skey, svalue;
-    unsigned int count = 0;
-    std::vector<std::string> vstr;
-    int block = 0;
+    CTradeKey key;
+    CTradeNew trade;
+    CTradeMatch match;
+    CTradeAddressKey addressKey;
+    CTradePairKey pairKey;
     unsigned int n_found = 0;
+    leveldb::WriteBatch batch;
     leveldb::Iterator* it = NewIterator();
     for (it->SeekToFirst(); it->Valid(); it->Next()) {
-        skey = it->key();
-        svalue = it->value();
-        ++count;
-        std::string strvalue = it->value().ToString();
-        boost::split(vstr, strvalue, boost::is_any_of(":"), boost::token_compress_on);
-        if (7 == vstr.size()) block = atoi(vstr[6]); // trade matches have 7 tokens, key is txid+txid, only care about block
-        if (5 == vstr.size()) block = atoi(vstr[3]); // trades have 5 tokens, key is txid, only care about block
+        if (it->key().empty()) continue;
+        const char prefix = it->key()[0];
+
+        if (prefix == TRADE_ADDRESS_INDEX) {
+            if (DecodeDBEntry(it->key(), addressKey) && addressKey.nBlock >= blockNum) batch.Delete(it->key());
+            continue;
+        }
+        if (prefix == TRADE_PAIR_INDEX) {
+            if (DecodeDBEntry(it->key(), pairKey) && pairKey.nBlock >= blockNum) batch.Delete(it->key());
+            continue;
+        }
+
+        int block = 0;
+        if (!DecodeDBEntry(it->key(), key)) continue;
+        if (key.prefix == TRADE_MATCH && DecodeDBEntry(it->value(), match)) block = match.block;
+        if (key.prefix == TRADE_NEW && DecodeDBEntry(it->value(), trade)) block = trade.block;
         if (block >= blockNum) {
             ++n_found;
-            PrintToLog("%s() DELETING FROM TRADEDB: %s=%s\n", __func__, skey.ToString(), svalue.ToString());
-            pdb->Delete(writeoptions, skey);
+            PrintToLog("%s() DELETING FROM TRADEDB: %s%s (block %d)\n", __func__, key.txid1.ToString(),
+                    (key.prefix == TRADE_MATCH ? "+" + key.txid2.ToString() : ""), block);
+            batch.Delete(it->key());
+            if (key.prefix == TRADE_MATCH) batch.Delete(EncodeDBEntry(CTradeReverseKey(key.txid2, key.txid1)));
         }
     }
-    
+
     delete it;
 
+    if (n_found > 0) {
+        leveldb::Status status = Apply(batch);
+        if (!status.ok()) PrintToLog("%s(): failed to delete trades: %s\n", __func__, status.ToString());
+    }
+
     PrintToLog("%s(%d); tradedb n_found= %d\n", __func__, blockNum, n_found);
 
     return n_found;
@@ -102,14 +419,22 @@ void CMPTradeList::printStats()
 void CMPTradeList::printAll()
 {
     int count = 0;
-    leveldb::Slice skey, svalue;
+    CTradeKey key;
+    CTradeNew trade;
+    CTradeMatch match;
     leveldb::Iterator* it = NewIterator();
 
     for (it->SeekToFirst(); it->Valid(); it->Next()) {
-        skey = it->key();
-        svalue = it->value();
         ++count;
-        PrintToConsole("entry #%8d= %s:%s\n", count, skey.ToString(), svalue.ToString());
+        if (!DecodeDBEntry(it->key(), key)) {
+            PrintToConsole("entry #%8d= %s:%s\n", count, HexStr(it->key().ToString()), HexStr(it->value().ToString()));
+        } else if (key.prefix == TRADE_NEW && DecodeDBEntry(it->value(), trade)) {
+            PrintToConsole("entry #%8d= %s:%s:%d:%d:%d:%d\n", count, key.txid1.ToString(), trade.address,
+                    trade.propertyIdForSale, trade.propertyIdDesired, trade.block, trade.blockIndex);
+        } else if (key.prefix == TRADE_MATCH && DecodeDBEntry(it->value(), match)) {
+            PrintToConsole("entry #%8d= %s+%s:%s:%s:%d:%d:%d:%d:%d:%d\n", count, key.txid1.ToString(), key.txid2.ToString(),
+                    match.address1, match.address2, match.prop1, match.prop2, match.amount1, match.amount2, match.block, match.fee);
+        }
     }
 
     delete it;
@@ -123,74 +448,63 @@ bool CMPTradeList::getMatchingTrades(const uint256& txid, uint32_t propertyId, U
     totalReceived = 0;
     totalSold = 0;
 
-    std::vector<std::string> vstr;
-    std::string txidStr = txid.ToString();
+    // collect the matches, where the trade is the first or the second party, ordered like the records
+    std::set<std::pair<uint256, uint256> > setMatches;
+    CTradeKey key;
+    CTradeReverseKey reverseKey;
     leveldb::Iterator* it = NewIterator();
-    for (it->SeekToFirst(); it->Valid(); it->Next()) {
-        // search key to see if this is a matching trade
-        std::string strKey = it->key().ToString();
-        std::string strValue = it->value().ToString();
-        std::string matchTxid;
-        size_t txidMatch = strKey.find(txidStr);
-        if (txidMatch == std::string::npos) continue; // no match
+    for (it->Seek(GetTxidSeekKey(TRADE_MATCH, txid)); it->Valid(); it->Next()) {
+        if (!DecodeDBEntry(it->key(), key) || key.prefix != TRADE_MATCH || key.txid1 != txid) break;
+        setMatches.insert(std::make_pair(key.txid1, key.txid2));
+    }
+    for (it->Seek(GetTxidSeekKey(TRADE_MATCH_REVERSE, txid)); it->Valid(); it->Next()) {
+        if (!DecodeDBEntry(it->key(), reverseKey) || reverseKey.txid2 != txid) break;
+        setMatches.insert(std::make_pair(reverseKey.txid1, reverseKey.txid2));
+    }
+    delete it;
 
-        // sanity check key is the correct length for a matched trade
-        if (strKey.length() != 129) continue;
+    CTradeMatch match;
+    for (std::set<std::pair<uint256, uint256> >::const_iterator itMatch = setMatches.begin(); itMatch != setMatches.end(); ++itMatch) {
+        const uint256& txid1 = itMatch->first;
+        const uint256& txid2 = itMatch->second;
 
         // obtain the txid of the match
-        if (txidMatch == 0) {
-            matchTxid = strKey.substr(65, 64);
-        } else {
-            matchTxid = strKey.substr(0, 64);
-        }
+        uint256 matchTxid = (txid1 == txid) ? txid2 : txid1;
 
-        // ensure correct amount of tokens in value string
-        boost::split(vstr, strValue, boost::is_any_of(":"), boost::token_compress_on);
-        if (vstr.size() != 8) {
-            PrintToLog("TRADEDB error - unexpected number of tokens in value (%s)\n", strValue);
+        // decode the details of the match
+        if (!Read(CTradeKey(txid1, txid2), match)) {
+            PrintToLog("TRADEDB error - unexpected value of %s+%s\n", txid1.ToString(), txid2.ToString());
             continue;
         }
 
-        // decode the details from the value string
-        std::string address1 = vstr[0];
-        std::string address2 = vstr[1];
-        uint32_t prop1 = boost::lexical_cast<uint32_t>(vstr[2]);
-        uint32_t prop2 = boost::lexical_cast<uint32_t>(vstr[3]);
-        int64_t amount1 = boost::lexical_cast<int64_t>(vstr[4]);
-        int64_t amount2 = boost::lexical_cast<int64_t>(vstr[5]);
-        int blockNum = atoi(vstr[6]);
-        int64_t tradingFee = boost::lexical_cast<int64_t>(vstr[7]);
-
-        std::string strAmount1 = FormatMP(prop1, amount1);
-        std::string strAmount2 = FormatMP(prop2, amount2);
-        std::string strTradingFee = FormatMP(prop2, tradingFee);
-        std::string strAmount2PlusFee = FormatMP(prop2, amount2 + tradingFee);
+        std::string strAmount1 = FormatMP(match.prop1, match.amount1);
+        std::string strAmount2 = FormatMP(match.prop2, match.amount2);
+        std::string strTradingFee = FormatMP(match.prop2, match.fee);
+        std::string strAmount2PlusFee = FormatMP(match.prop2, match.amount2 + match.fee);
 
         // populate trade object and add to the trade array, correcting for orientation of trade
         UniValue trade(UniValue::VOBJ);
-        trade.pushKV("txid", matchTxid);
-        trade.pushKV("block", blockNum);
-        if (prop1 == propertyId) {
-            trade.pushKV("address", address1);
+        trade.pushKV("txid", matchTxid.GetHex());
+        trade.pushKV("block", match.block);
+        if (match.prop1 == propertyId) {
+            trade.pushKV("address", match.address1);
             trade.pushKV("amountsold", strAmount1);
             trade.pushKV("amountreceived", strAmount2);
             trade.pushKV("tradingfee", strTradingFee);
-            totalReceived += amount2;
-            totalSold += amount1;
+            totalReceived += match.amount2;
+            totalSold += match.amount1;
         } else {
-            trade.pushKV("address", address2);
+            trade.pushKV("address", match.address2);
             trade.pushKV("amountsold", strAmount2PlusFee);
             trade.pushKV("amountreceived", strAmount1);
-            trade.pushKV("tradingfee", FormatMP(prop1, 0)); // not the liquidity taker so no fee for this participant - include attribute for standardness
-            totalReceived += amount1;
-            totalSold += amount2;
+            trade.pushKV("tradingfee", FormatMP(match.prop1, 0)); // not the liquidity taker so no fee for this participant - include attribute for standardness
+            totalReceived += match.amount1;
+            totalSold += match.amount2;
         }
         tradeArray.push_back(trade);
         ++count;
     }
 
-    // clean up
-    delete it;
     if (count) {
         return true;
     } else {
@@ -199,87 +513,114 @@ bool CMPTradeList::getMatchingTrades(const uint256& txid, uint32_t propertyId, U
 }
 
 
-// obtains a vector of txids where the supplied address participated in a trade (needed for gettradehistory_MP)
-// optional property ID parameter will filter on propertyId transacted if supplied
-// sorted by block then index
-void CMPTradeList::getTradesForAddress(const std::string& address, std::vector<uint256>& vecTransactions, uint32_t propertyIdFilter)
+/**
+ * Obtains the txids of trades created by the supplied address, sorted by block and position in the block.
+ *
+ * Only the entries of the address index of this address are visited. The optional property
+ * identifier filters on the properties transacted. If reverse order is requested, the most
+ * recent trades are returned first.
+ *
+ * @param address           The address of the trader
+ * @param vecTransactions   The txids of the trades are appended to this vector
+ * @param propertyIdFilter  Only trades of this property (optional)
+ * @param count             The maximal number of txids to return, or 0 for all (optional)
+ * @param skip              The number of matching trades to skip first (optional)
+ * @param fReverse          Whether to return the most recent trades first (optional)
+ */
+void CMPTradeList::getTradesForAddress(const std::string& address, std::vector<uint256>& vecTransactions, uint32_t propertyIdFilter, uint64_t count, uint64_t skip, bool fReverse)
 {
     if (!pdb) return;
 
-    std::map<std::string, uint256> mapTrades;
+    const std::string strSeekKey = GetAddressSeekKey(address);
+    CTradeAddressKey key;
+    CTradeAddressEntry entry;
+    uint64_t nAdded = 0;
     leveldb::Iterator* it = NewIterator();
-    for (it->SeekToFirst(); it->Valid(); it->Next()) {
-        std::string strKey = it->key().ToString();
-        std::string strValue = it->value().ToString();
-        std::vector<std::string> vecValues;
-        if (strKey.size() != 64) continue; // only interested in trades
-        uint256 txid = uint256S(strKey);
-        size_t addressMatch = strValue.find(address);
-        if (addressMatch == std::string::npos) continue;
-        boost::split(vecValues, strValue, boost::is_any_of(":"), boost::token_compress_on);
-        if (vecValues.size() != 5) {
-            PrintToLog("TRADEDB error - unexpected number of tokens in value (%s)\n", strValue);
-            continue;
+
+    if (fReverse) {
+        // position on the last entry of this address, if any
+        std::string strEndKey = strSeekKey;
+        strEndKey.push_back('\xff');
+        it->Seek(strEndKey);
+        if (it->Valid()) {
+            it->Prev();
+        } else {
+            it->SeekToLast();
         }
-        uint32_t propertyIdForSale = boost::lexical_cast<uint32_t>(vecValues[1]);
-        uint32_t propertyIdDesired = boost::lexical_cast<uint32_t>(vecValues[2]);
-        int64_t blockNum = boost::lexical_cast<uint32_t>(vecValues[3]);
-        int64_t txIndex = boost::lexical_cast<uint32_t>(vecValues[4]);
-        if (propertyIdFilter != 0 && propertyIdFilter != propertyIdForSale && propertyIdFilter != propertyIdDesired) continue;
-        std::string sortKey = strprintf("%06d%010d", blockNum, txIndex);
-        mapTrades.insert(std::make_pair(sortKey, txid));
+    } else {
+        it->Seek(strSeekKey);
     }
-    delete it;
 
-    for (std::map<std::string, uint256>::iterator it = mapTrades.begin(); it != mapTrades.end(); it++) {
-        vecTransactions.push_back(it->second);
+    for (; it->Valid(); fReverse ? it->Prev() : it->Next()) {
+        if (!it->key().starts_with(strSeekKey)) break;
+        if (!DecodeDBEntry(it->key(), key) || key.address != address) break;
+        if (!DecodeDBEntry(it->value(), entry)) {
+            PrintToLog("TRADEDB error - unexpected index value of %s\n", key.txid.ToString());
+            continue;
+        }
+        if (propertyIdFilter != 0 && propertyIdFilter != entry.propertyIdForSale && propertyIdFilter != entry.propertyIdDesired) continue;
+        if (skip > 0) {
+            --skip;
+            continue;
+        }
+        vecTransactions.push_back(key.txid);
+        if (++nAdded == count) break;
     }
-}
 
-static bool CompareTradePair(const std::pair<int64_t, UniValue>& firstJSONObj, const std::pair<int64_t, UniValue>& secondJSONObj)
-{
-    return firstJSONObj.first > secondJSONObj.first;
+    delete it;
 }
 
-// obtains an array of matching trades with pricing and volume details for a pair sorted by blocknumber
+/**
+ * Obtains an array of the most recent matching trades with pricing and volume details for a pair.
+ *
+ * The pair index is iterated backwards from the most recent match, so only the requested
+ * number of matches is visited. The trades are returned sorted by block number.
+ */
 void CMPTradeList::getTradesForPair(uint32_t propertyIdSideA, uint32_t propertyIdSideB, UniValue& responseArray, uint64_t count)
 {
     if (!pdb) return;
-    leveldb::Iterator* it = NewIterator();
-    std::vector<std::pair<int64_t, UniValue> > vecResponse;
+    CTradePairKey pairKey;
+    CTradeMatch match;
+    std::vector<UniValue> vecResponse;
     bool propertyIdSideAIsDivisible = isPropertyDivisible(propertyIdSideA);
     bool propertyIdSideBIsDivisible = isPropertyDivisible(propertyIdSideB);
-    for (it->SeekToFirst(); it->Valid(); it->Next()) {
-        std::string strKey = it->key().ToString();
-        std::string strValue = it->value().ToString();
-        std::vector<std::string> vecKeys;
-        std::vector<std::string> vecValues;
+
+    // position on the most recent match of this pair, if any
+    const std::string strSeekKey = GetPairSeekKey(propertyIdSideA, propertyIdSideB);
+    std::string strEndKey = strSeekKey;
+    strEndKey.push_back('\xff');
+    leveldb::Iterator* it = NewIterator();
+    it->Seek(strEndKey);
+    if (it->Valid()) {
+        it->Prev();
+    } else {
+        it->SeekToLast();
+    }
+
+    for (; it->Valid(); it->Prev()) {
         uint256 sellerTxid, matchingTxid;
         std::string sellerAddress, matchingAddress;
         int64_t amountReceived = 0, amountSold = 0;
-        if (strKey.size() != 129) continue; // only interested in matches
-        boost::split(vecKeys, strKey, boost::is_any_of("+"), boost::token_compress_on);
-        boost::split(vecValues, strValue, boost::is_any_of(":"), boost::token_compress_on);
-        if (vecKeys.size() != 2 || vecValues.size() != 8) {
-            PrintToLog("TRADEDB error - unexpected number of tokens (%s:%s)\n", strKey, strValue);
+        if (!it->key().starts_with(strSeekKey) || !DecodeDBEntry(it->key(), pairKey)) break; // only interested in this pair
+        const CTradeKey key(pairKey.txid1, pairKey.txid2);
+        if (!Read(key, match)) {
+            PrintToLog("TRADEDB error - unexpected value of %s+%s\n", key.txid1.ToString(), key.txid2.ToString());
             continue;
         }
-        uint32_t tradePropertyIdSideA = boost::lexical_cast<uint32_t>(vecValues[2]);
-        uint32_t tradePropertyIdSideB = boost::lexical_cast<uint32_t>(vecValues[3]);
-        if (tradePropertyIdSideA == propertyIdSideA && tradePropertyIdSideB == propertyIdSideB) {
-            sellerTxid.SetHex(vecKeys[1]);
-            sellerAddress = vecValues[1];
-            amountSold = boost::lexical_cast<int64_t>(vecValues[4]);
-            matchingTxid.SetHex(vecKeys[0]);
-            matchingAddress = vecValues[0];
-            amountReceived = boost::lexical_cast<int64_t>(vecValues[5]);
-        } else if (tradePropertyIdSideB == propertyIdSideA && tradePropertyIdSideA == propertyIdSideB) {
-            sellerTxid.SetHex(vecKeys[0]);
-            sellerAddress = vecValues[0];
-            amountSold = boost::lexical_cast<int64_t>(vecValues[5]);
-            matchingTxid.SetHex(vecKeys[1]);
-            matchingAddress = vecValues[1];
-            amountReceived = boost::lexical_cast<int64_t>(vecValues[4]);
+        if (match.prop1 == propertyIdSideA && match.prop2 == propertyIdSideB) {
+            sellerTxid = key.txid2;
+            sellerAddress = match.address2;
+            amountSold = match.amount1;
+            matchingTxid = key.txid1;
+            matchingAddress = match.address1;
+            amountReceived = match.amount2;
+        } else if (match.prop2 == propertyIdSideA && match.prop1 == propertyIdSideB) {
+            sellerTxid = key.txid1;
+            sellerAddress = match.address1;
+            amountSold = match.amount2;
+            matchingTxid = key.txid2;
+            matchingAddress = match.address2;
+            amountReceived = match.amount1;
         } else {
             continue;
         }
@@ -291,7 +632,7 @@ void CMPTradeList::getTradesForPair(uint32_t propertyIdSideA, uint32_t propertyI
         std::string unitPriceStr = xToString(unitPrice); // TODO: not here!
         std::string inversePriceStr = xToString(inversePrice);
 
-        int64_t blockNum = boost::lexical_cast<int64_t>(vecValues[6]);
+        int64_t blockNum = match.block;
 
         UniValue trade(UniValue::VOBJ);
         trade.pushKV("block", blockNum);
@@ -311,35 +652,166 @@ void CMPTradeList::getTradesForPair(uint32_t propertyIdSideA, uint32_t propertyI
         }
         trade.pushKV("matchingtxid", matchingTxid.GetHex());
         trade.pushKV("matchingaddress", matchingAddress);
-        vecResponse.push_back(std::make_pair(blockNum, trade));
+        vecResponse.push_back(trade);
+        if (vecResponse.size() >= count) break;
     }
 
-    // sort the response most recent first before adding to the array
-    std::sort(vecResponse.begin(), vecResponse.end(), CompareTradePair);
-    uint64_t processed = 0;
-    for (std::vector<std::pair<int64_t, UniValue> >::iterator it = vecResponse.begin(); it != vecResponse.end(); ++it) {
-        responseArray.push_back(it->second);
-        processed++;
-        if (processed >= count) break;
-    }
+    delete it;
 
-    std::vector<UniValue> responseArrayValues = responseArray.getValues();
-    std::reverse(responseArrayValues.begin(), responseArrayValues.end());
-    responseArray.clear();
-    for (std::vector<UniValue>::iterator it = responseArrayValues.begin(); it != responseArrayValues.end(); ++it) {
-        responseArray.push_back(*it);
+    // the trades were collected most recent first
+    for (std::vector<UniValue>::reverse_iterator itResponse = vecResponse.rbegin(); itResponse != vecResponse.rend(); ++itResponse) {
+        responseArray.push_back(*itResponse);
     }
-
-    delete it;
 }
 
 int CMPTradeList::getMPTradeCountTotal()
 {
     int count = 0;
+    CTradeKey key;
     leveldb::Iterator* it = NewIterator();
-    for (it->SeekToFirst(); it->Valid(); it->Next()) {
+    // matched and new trades are adjacent, index entries are not counted
+    for (it->Seek(std::string(1, TRADE_MATCH)); it->Valid(); it->Next()) {
+        if (!DecodeDBEntry(it->key(), key)) break;
         ++count;
     }
     delete it;
     return count;
 }
+
+/**
+ * Converts records of the legacy string based format into the binary format.
+ *
+ * Legacy keys are hex encoded txids of new trades, or "txid1+txid2" for matched trades.
+ * Values are colon separated strings.
+ *
+ * @return The number of converted records, or -1 on failure
+ */
+int CMPTradeList::ConvertLegacyRecords()
+{
+    assert(pdb);
+
+    int64_t nTimeStart = GetTimeMicros();
+    int nConverted = 0;
+    int nBatched = 0;
+    leveldb::WriteBatch batch;
+    leveldb::Status status;
+
+    // the iterator operates on a snapshot, so converted entries are not visited again
+    leveldb::Iterator* it = NewIterator();
+
+    for (it->SeekToFirst(); it->Valid() && status.ok(); it->Next()) {
+        const std::string strKey = it->key().ToString();
+        const std::string strValue = it->value().ToString();
+        std::vector<std::string> vstr;
+        boost::split(vstr, strValue, boost::is_any_of(":"), boost::token_compress_on);
+
+        try {
+            if (strKey.size() == 64 && IsHex(strKey) && vstr.size() == 5) {
+                CTradeNew trade;
+                trade.address = vstr[0];
+                trade.propertyIdForSale = boost::lexical_cast<uint32_t>(vstr[1]);
+                trade.propertyIdDesired = boost::lexical_cast<uint32_t>(vstr[2]);
+                trade.block = boost::lexical_cast<int32_t>(vstr[3]);
+                trade.blockIndex = boost::lexical_cast<int32_t>(vstr[4]);
+                batch.Put(EncodeDBEntry(CTradeKey(uint256S(strKey))), EncodeDBEntry(trade));
+            } else if (strKey.size() == 129 && strKey[64] == '+' && IsHex(strKey.substr(0, 64)) &&
+                    IsHex(strKey.substr(65)) && vstr.size() == 8) {
+                CTradeMatch match;
+                match.address1 = vstr[0];
+                match.address2 = vstr[1];
+                match.prop1 = boost::lexical_cast<uint32_t>(vstr[2]);
+                match.prop2 = boost::lexical_cast<uint32_t>(vstr[3]);
+                match.amount1 = boost::lexical_cast<int64_t>(vstr[4]);
+                match.amount2 = boost::lexical_cast<int64_t>(vstr[5]);
+                match.block = boost::lexical_cast<int32_t>(vstr[6]);
+                match.fee = boost::lexical_cast<int64_t>(vstr[7]);
+                batch.Put(EncodeDBEntry(CTradeKey(uint256S(strKey.substr(0, 64)), uint256S(strKey.substr(65)))), EncodeDBEntry(match));
+            } else {
+                continue; // not a legacy record
+            }
+        } catch (const boost::bad_lexical_cast&) {
+            PrintToLog("%s(): failed to parse trade %s=%s\n", __func__, strKey, strValue);
+            continue;
+        }
+
+        batch.Delete(it->key());
+        ++nConverted;
+
+        if (++nBatched >= CONVERT_BATCH_SIZE) {
+            status = Apply(batch);
+            batch.Clear();
+            nBatched = 0;
+        }
+    }
+
+    delete it;
+
+    if (status.ok()) {
+        status = Apply(batch, true);
+    }
+
+    PrintToLog("%s(): converted %d records: %s [%.3f ms total]\n",
+            __func__, nConverted, status.ToString(), 0.001 * (GetTimeMicros() - nTimeStart));
+
+    return status.ok() ? nConverted : -1;
+}
+
+/**
+ * Adds all trades to the address index, the pair index and the reverse lookup of matches.
+ *
+ * Used to upgrade databases, which were created without the indexes. Matches are indexed
+ * with the position of the second trade in the block, which is read from its record.
+ *
+ * @return The number of indexed records, or -1 on failure
+ */
+int CMPTradeList::BuildIndex()
+{
+    assert(pdb);
+
+    int64_t nTimeStart = GetTimeMicros();
+    int nIndexed = 0;
+    int nBatched = 0;
+    CTradeKey key;
+    CTradeNew trade;
+    CTradeMatch match;
+    leveldb::WriteBatch batch;
+    leveldb::Status status;
+
+    // the iterator operates on a snapshot, so new index entries are not visited
+    leveldb::Iterator* it = NewIterator();
+
+    // matched and new trades are adjacent
+    for (it->Seek(std::string(1, TRADE_MATCH)); it->Valid() && status.ok(); it->Next()) {
+        if (!DecodeDBEntry(it->key(), key)) break;
+
+        if (key.prefix == TRADE_NEW) {
+            if (!DecodeDBEntry(it->value(), trade)) continue;
+            batch.Put(EncodeDBEntry(CTradeAddressKey(trade.address, trade.block, trade.blockIndex, key.txid1)),
+                    EncodeDBEntry(CTradeAddressEntry(trade.propertyIdForSale, trade.propertyIdDesired)));
+        } else {
+            if (!DecodeDBEntry(it->value(), match)) continue;
+            CTradeNew tradeNew;
+            int nBlockIndex = Read(CTradeKey(key.txid2), tradeNew) ? tradeNew.blockIndex : 0;
+            batch.Put(EncodeDBEntry(CTradePairKey(match.prop1, match.prop2, match.block, nBlockIndex, key.txid1, key.txid2)), leveldb::Slice());
+            batch.Put(EncodeDBEntry(CTradeReverseKey(key.txid2, key.txid1)), leveldb::Slice());
+        }
+        ++nIndexed;
+
+        if (++nBatched >= CONVERT_BATCH_SIZE) {
+            status = Apply(batch);
+            batch.Clear();
+            nBatched = 0;
+        }
+    }
+
+    delete it;
+
+    if (status.ok()) {
+        status = Apply(batch, true);
+    }
+
+    PrintToLog("%s(): indexed %d records: %s [%.3f ms total]\n",
+            __func__, nIndexed, status.ToString(), 0.001 * (GetTimeMicros() - nTimeStart));
+
+    return status.ok() ? nIndexed : -1;
+}
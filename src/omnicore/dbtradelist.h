@@ -13,7 +13,54 @@
 #include <string>
 #include <vector>
 
-/** LevelDB based storage for the MetaDEx trade history. Trades are listed with key "txid1+txid2".
+/** LevelDB based storage for the MetaDEx trade history.
+ *
+ * New trades are additionally indexed by address, and matched trades by property pair
+ * and by the txid of the second trade, so that the history of an address or a market
+ * can be looked up without iterating over the whole database.
+ *
+ * DB Schema:
+ *
+ *  Key:
+ *      char 'n'
+ *      uint256 txid
+ *  Value:
+ *      std::string address, uint32_t propertyIdForSale, uint32_t propertyIdDesired, int32_t block, int32_t blockIndex
+ *
+ *  Key:
+ *      char 'm'
+ *      uint256 txid1
+ *      uint256 txid2
+ *  Value:
+ *      std::string address1, std::string address2, uint32_t prop1, uint32_t prop2,
+ *      int64_t amount1, int64_t amount2, int32_t block, int64_t fee
+ *
+ *  Key:
+ *      char 'a'
+ *      std::string address
+ *      int32_t block (big-endian)
+ *      int32_t blockIndex (big-endian)
+ *      uint256 txid
+ *  Value:
+ *      uint32_t propertyIdForSale, uint32_t propertyIdDesired
+ *
+ *  Key:
+ *      char 'p'
+ *      uint32_t lower of prop1 and prop2 (big-endian)
+ *      uint32_t higher of prop1 and prop2 (big-endian)
+ *      int32_t block (big-endian)
+ *      int32_t blockIndex of txid2 (big-endian)
+ *      uint256 txid1
+ *      uint256 txid2
+ *  Value:
+ *      empty
+ *
+ *  Key:
+ *      char 'r'
+ *      uint256 txid2
+ *      uint256 txid1
+ *  Value:
+ *      empty
  */
 class CMPTradeList : public CDBBase
 {
@@ -21,16 +68,21 @@ public:
     CMPTradeList(const fs::path& path, bool fWipe);
     virtual ~CMPTradeList();
 
-    void recordMatchedTrade(const uint256& txid1, const uint256& txid2, const std::string& address1, const std::string& address2, uint32_t prop1, uint32_t prop2, int64_t amount1, int64_t amount2, int blockNum, int64_t fee);
+    void recordMatchedTrade(const uint256& txid1, const uint256& txid2, const std::string& address1, const std::string& address2, uint32_t prop1, uint32_t prop2, int64_t amount1, int64_t amount2, int blockNum, int blockIndex, int64_t fee);
     void recordNewTrade(const uint256& txid, const std::string& address, uint32_t propertyIdForSale, uint32_t propertyIdDesired, int blockNum, int blockIndex);
     int deleteAboveBlock(int blockNum);
     bool exists(const uint256 &txid);
     void printStats();
     void printAll();
     bool getMatchingTrades(const uint256& txid, uint32_t propertyId, UniValue& tradeArray, int64_t& totalSold, int64_t& totalBought);
-    void getTradesForAddress(const std::string& address, std::vector<uint256>& vecTransactions, uint32_t propertyIdFilter = 0);
+    void getTradesForAddress(const std::string& address, std::vector<uint256>& vecTransactions, uint32_t propertyIdFilter = 0, uint64_t count = 0, uint64_t skip = 0, bool fReverse = false);
     void getTradesForPair(uint32_t propertyIdSideA, uint32_t propertyIdSideB, UniValue& response, uint64_t count);
     int getMPTradeCountTotal();
+
+    /** Converts records of the legacy string based format into the binary format. */
+    int ConvertLegacyRecords();
+    /** Adds all trades to the address and pair indexes. */
+    int BuildIndex();
 };
 
 namespace mastercore
@@ -4,10 +4,15 @@
 #include <omnicore/log.h>
 
 #include <fs.h>
+#include <serialize.h>
 #include <uint256.h>
+#include <util/strencodings.h>
+#include <util/time.h>
 #include <tinyformat.h>
 
+#include <leveldb/iterator.h>
 #include <leveldb/status.h>
+#include <leveldb/write_batch.h>
 
 #include <boost/algorithm/string.hpp>
 #include <boost/lexical_cast.hpp>
@@ -15,9 +20,73 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include <ios>
 #include <string>
 #include <vector>
 
+namespace {
+
+//! Key prefix of transaction details
+const char TXDB_DETAILS = 't';
+//! Key prefix of decoded transactions
+const char TXDB_DECODED = 'd';
+//! Maximal number of cached decoded transactions
+const size_t MAX_DECODED_CACHE_ENTRIES = 20000;
+//! Number of converted records written per batch
+const int CONVERT_BATCH_SIZE = 10000;
+
+/** Key of the position and validation result of a transaction. */
+struct CTransactionDetailsKey
+{
+    uint256 txid;
+
+    CTransactionDetailsKey() {}
+    explicit CTransactionDetailsKey(const uint256& txidIn) : txid(txidIn) {}
+
+    template <typename Stream>
+    void Serialize(Stream& s) const
+    {
+        ser_writedata8(s, TXDB_DETAILS);
+        s << txid;
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s)
+    {
+        if (ser_readdata8(s) != TXDB_DETAILS) {
+            throw std::ios_base::failure("unknown transaction key prefix");
+        }
+        s >> txid;
+    }
+};
+
+/** Key of the decoded form of a transaction. */
+struct CDecodedTransactionKey
+{
+    uint256 txid;
+
+    CDecodedTransactionKey() {}
+    explicit CDecodedTransactionKey(const uint256& txidIn) : txid(txidIn) {}
+
+    template <typename Stream>
+    void Serialize(Stream& s) const
+    {
+        ser_writedata8(s, TXDB_DECODED);
+        s << txid;
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s)
+    {
+        if (ser_readdata8(s) != TXDB_DECODED) {
+            throw std::ios_base::failure("unknown transaction key prefix");
+        }
+        s >> txid;
+    }
+};
+
+} // anonymous namespace
+
 COmniTransactionDB::COmniTransactionDB(const fs::path& path, bool fWipe)
 {
     leveldb::Status status = Open(path, fWipe);
@@ -30,29 +99,18 @@ COmniTransactionDB::~COmniTransactionDB()
 }
 
 /**
- * Retrieves the serialized transaction details from the DB. 
+ * Retrieves the position in block and validation result of a transaction from the DB.
  */
-std::vector<std::string> COmniTransactionDB::FetchTransactionDetails(const uint256& txid)
+bool COmniTransactionDB::FetchTransactionDetails(const uint256& txid, CTransactionDetails& details)
 {
     assert(pdb);
-    std::string strValue;
-    std::vector<std::string> vTransactionDetails;
 
-    leveldb::Status status = pdb->Get(readoptions, txid.ToString(), &strValue);
-    if (status.ok()) {
-        std::vector<std::string> vStr;
-        boost::split(vStr, strValue, boost::is_any_of(":"), boost::token_compress_on);
-        if (vStr.size() == 2) {
-            vTransactionDetails.push_back(vStr[0]);
-            vTransactionDetails.push_back(vStr[1]);
-        } else {
-            PrintToLog("ERROR: Entry (%s) found in OmniTXDB with unexpected number of attributes!\n", txid.GetHex());
-        }
-    } else {
+    if (!Read(CTransactionDetailsKey(txid), details)) {
         PrintToLog("ERROR: Entry (%s) could not be loaded from OmniTXDB!\n", txid.GetHex());
+        return false;
     }
 
-    return vTransactionDetails;
+    return true;
 }
 
 /**
@@ -62,11 +120,11 @@ void COmniTransactionDB::RecordTransaction(const uint256& txid, uint32_t posInBl
 {
     assert(pdb);
 
-    const std::string key = txid.ToString();
-    const std::string value = strprintf("%d:%d", posInBlock, processingResult);
+    CTransactionDetails details;
+    details.posInBlock = posInBlock;
+    details.processingResult = processingResult;
 
-    leveldb::Status status = pdb->Put(writeoptions, key, value);
-    ++nWritten;
+    Write(CTransactionDetailsKey(txid), details);
 }
 
 /**
@@ -76,9 +134,9 @@ uint32_t COmniTransactionDB::FetchTransactionPosition(const uint256& txid)
 {
     uint32_t posInBlock = 999999; // setting an initial arbitrarily high value will ensure transaction is always "last" in event of bug/exploit
 
-    std::vector<std::string> vTransactionDetails = FetchTransactionDetails(txid);
-    if (vTransactionDetails.size() == 2) {
-        posInBlock = boost::lexical_cast<uint32_t>(vTransactionDetails[0]);
+    CTransactionDetails details;
+    if (FetchTransactionDetails(txid, details)) {
+        posInBlock = details.posInBlock;
     }
 
     return posInBlock;
@@ -91,10 +149,152 @@ std::string COmniTransactionDB::FetchInvalidReason(const uint256& txid)
 {
     int processingResult = -999999;
 
-    std::vector<std::string> vTransactionDetails = FetchTransactionDetails(txid);
-    if (vTransactionDetails.size() == 2) {
-        processingResult = boost::lexical_cast<int>(vTransactionDetails[1]);
+    CTransactionDetails details;
+    if (FetchTransactionDetails(txid, details)) {
+        processingResult = details.processingResult;
     }
 
     return error_str(processingResult);
 }
+
+/**
+ * Stores the decoded form of a confirmed transaction.
+ *
+ * A cached record of the transaction is replaced, given that the transaction
+ * may be parsed again in another block after a reorganization.
+ */
+void COmniTransactionDB::RecordDecodedTransaction(const uint256& txid, const CDecodedTransaction& decoded)
+{
+    assert(pdb);
+
+    Write(CDecodedTransactionKey(txid), decoded);
+
+    LOCK(cs_decoded);
+    std::map<uint256, DecodedList::iterator>::iterator it = decodedIndex.find(txid);
+    if (it != decodedIndex.end()) {
+        decodedEntries.erase(it->second);
+        decodedIndex.erase(it);
+    }
+}
+
+/**
+ * Retrieves the decoded form of a confirmed transaction from the cache, or the DB.
+ *
+ * The caller is expected to check, whether the block of the record is part of
+ * the active chain.
+ *
+ * @return True, if a record was found
+ */
+bool COmniTransactionDB::FetchDecodedTransaction(const uint256& txid, CDecodedTransaction& decoded)
+{
+    assert(pdb);
+
+    {
+        LOCK(cs_decoded);
+        std::map<uint256, DecodedList::iterator>::iterator it = decodedIndex.find(txid);
+        if (it != decodedIndex.end()) {
+            decodedEntries.splice(decodedEntries.begin(), decodedEntries, it->second);
+            decoded = it->second->second;
+            return true;
+        }
+    }
+
+    if (!Read(CDecodedTransactionKey(txid), decoded)) {
+        return false;
+    }
+
+    CacheDecodedTransaction(txid, decoded);
+
+    return true;
+}
+
+/**
+ * Adds a decoded transaction to the cache, and evicts the least recently used one, if the cache is full.
+ */
+void COmniTransactionDB::CacheDecodedTransaction(const uint256& txid, const CDecodedTransaction& decoded)
+{
+    LOCK(cs_decoded);
+    if (decodedIndex.count(txid)) return; // cached by a concurrent call
+
+    decodedEntries.emplace_front(txid, decoded);
+    decodedIndex[txid] = decodedEntries.begin();
+
+    if (decodedEntries.size() > MAX_DECODED_CACHE_ENTRIES) {
+        decodedIndex.erase(decodedEntries.back().first);
+        decodedEntries.pop_back();
+    }
+}
+
+/**
+ * Deletes all entries of the database, and clears the cache of decoded transactions.
+ */
+void COmniTransactionDB::Clear()
+{
+    CDBBase::Clear();
+
+    LOCK(cs_decoded);
+    decodedEntries.clear();
+    decodedIndex.clear();
+}
+
+/**
+ * Converts records of the legacy string based format into the binary format.
+ *
+ * Legacy keys are hex encoded txids, and values are strings of the format
+ * "posInBlock:processingResult".
+ *
+ * @return The number of converted records, or -1 on failure
+ */
+int COmniTransactionDB::ConvertLegacyRecords()
+{
+    assert(pdb);
+
+    int64_t nTimeStart = GetTimeMicros();
+    int nConverted = 0;
+    leveldb::WriteBatch batch;
+    leveldb::Status status;
+
+    // the iterator operates on a snapshot, so converted entries are not visited again
+    leveldb::Iterator* it = NewIterator();
+
+    for (it->SeekToFirst(); it->Valid() && status.ok(); it->Next()) {
+        const std::string strKey = it->key().ToString();
+        const std::string strValue = it->value().ToString();
+        if (strKey.size() != 64 || !IsHex(strKey)) continue; // not a legacy record
+
+        std::vector<std::string> vStr;
+        boost::split(vStr, strValue, boost::is_any_of(":"), boost::token_compress_on);
+        if (vStr.size() != 2) {
+            PrintToLog("%s(): unexpected record %s=%s\n", __func__, strKey, strValue);
+            continue;
+        }
+
+        CTransactionDetails details;
+        try {
+            details.posInBlock = boost::lexical_cast<uint32_t>(vStr[0]);
+            details.processingResult = boost::lexical_cast<int32_t>(vStr[1]);
+        } catch (const boost::bad_lexical_cast&) {
+            PrintToLog("%s(): failed to parse record %s=%s\n", __func__, strKey, strValue);
+            continue;
+        }
+
+        batch.Put(EncodeDBEntry(CTransactionDetailsKey(uint256S(strKey))), EncodeDBEntry(details));
+        batch.Delete(it->key());
+
+        if (++nConverted % CONVERT_BATCH_SIZE == 0) {
+            status = Apply(batch);
+            batch.Clear();
+        }
+    }
+
+    delete it;
+
+    if (status.ok()) {
+        status = Apply(batch, true);
+    }
+
+    PrintToLog("%s(): converted %d records: %s [%.3f ms total]\n",
+            __func__, nConverted, status.ToString(), 0.001 * (GetTimeMicros() - nTimeStart));
+
+    return status.ok() ? nConverted : -1;
+}
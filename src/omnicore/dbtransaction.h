@@ -4,17 +4,100 @@
 #include <omnicore/dbbase.h>
 
 #include <fs.h>
+#include <serialize.h>
+#include <sync.h>
 #include <uint256.h>
 
+#include <stddef.h>
 #include <stdint.h>
 
+#include <list>
+#include <map>
 #include <string>
+#include <utility>
 #include <vector>
 
+/** Position in block and validation result of a transaction. */
+struct CTransactionDetails
+{
+    uint32_t posInBlock;
+    int32_t processingResult;
+
+    CTransactionDetails() : posInBlock(0), processingResult(0) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(posInBlock);
+        READWRITE(processingResult);
+    }
+};
+
+/** Result of parsing a confirmed transaction, which is sufficient to interpret it again without its inputs. */
+struct CDecodedTransaction
+{
+    //! Block, in which the transaction was parsed
+    uint256 blockHash;
+    uint32_t posInBlock;
+    int32_t processingResult;
+    int32_t encodingClass;
+    uint64_t fee;
+    std::string sender;
+    std::string reference;
+    std::vector<unsigned char> payload;
+
+    CDecodedTransaction() : posInBlock(0), processingResult(0), encodingClass(0), fee(0) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(blockHash);
+        READWRITE(posInBlock);
+        READWRITE(processingResult);
+        READWRITE(encodingClass);
+        READWRITE(fee);
+        READWRITE(sender);
+        READWRITE(reference);
+        READWRITE(payload);
+    }
+};
+
 /** LevelDB based storage for storing Omni transaction validation and position in block data.
+ *
+ * DB Schema:
+ *
+ *  Key:
+ *      char 't'
+ *      uint256 txid
+ *  Value:
+ *      uint32_t posInBlock, int32_t processingResult
+ *
+ *  Key:
+ *      char 'd'
+ *      uint256 txid
+ *  Value:
+ *      CDecodedTransaction decoded
+ *
+ * Decoded transactions are stored, when a block is connected, so RPC calls
+ * don't need to resolve the inputs of confirmed transactions again. Recently
+ * fetched records are kept in a least recently used cache.
  */
 class COmniTransactionDB : public CDBBase
 {
+private:
+    typedef std::list<std::pair<uint256, CDecodedTransaction> > DecodedList;
+
+    //! Guards the cache of decoded transactions
+    mutable CCriticalSection cs_decoded;
+    //! Cached decoded transactions, most recently used first
+    DecodedList decodedEntries;
+    std::map<uint256, DecodedList::iterator> decodedIndex;
+
+    /** Adds a decoded transaction to the cache, and evicts the least recently used one, if the cache is full. */
+    void CacheDecodedTransaction(const uint256& txid, const CDecodedTransaction& decoded);
+
 public:
     COmniTransactionDB(const fs::path& path, bool fWipe);
     virtual ~COmniTransactionDB();
@@ -28,9 +111,21 @@ public:
     /** Returns the reason why a transaction is invalid. */
     std::string FetchInvalidReason(const uint256& txid);
 
+    /** Stores the decoded form of a confirmed transaction. */
+    void RecordDecodedTransaction(const uint256& txid, const CDecodedTransaction& decoded);
+
+    /** Retrieves the decoded form of a confirmed transaction from the cache, or the DB. */
+    bool FetchDecodedTransaction(const uint256& txid, CDecodedTransaction& decoded);
+
+    /** Converts records of the legacy string based format into the binary format. */
+    int ConvertLegacyRecords();
+
+    /** Extends clearing of CDBBase. */
+    void Clear();
+
 private:
-    /** Retrieves the serialized transaction details from the DB. */
-    std::vector<std::string> FetchTransactionDetails(const uint256& txid);
+    /** Retrieves the position in block and validation result of a transaction from the DB. */
+    bool FetchTransactionDetails(const uint256& txid, CTransactionDetails& details);
 };
 
 namespace mastercore
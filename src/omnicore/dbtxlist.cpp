@@ -11,8 +11,11 @@
 
 #include <chain.h>
 #include <chainparams.h>
+#include <clientversion.h>
 #include <fs.h>
 #include <validation.h>
+#include <serialize.h>
+#include <streams.h>
 #include <sync.h>
 #include <tinyformat.h>
 #include <uint256.h>
@@ -22,6 +25,7 @@
 #include <leveldb/iterator.h>
 #include <leveldb/slice.h>
 #include <leveldb/status.h>
+#include <leveldb/write_batch.h>
 
 #include <boost/algorithm/string.hpp>
 #include <boost/lexical_cast.hpp>
@@ -30,6 +34,7 @@
 #include <stdint.h>
 
 #include <algorithm>
+#include <ios>
 #include <string>
 #include <utility>
 #include <vector>
@@ -43,6 +48,205 @@ using mastercore::GetBlockIndex;
 using mastercore::isNonMainNet;
 using mastercore::pDbTransaction;
 
+namespace {
+
+//! Key prefix of master records of transactions
+const char TXLIST_TX = 't';
+//! Key prefix of DEx payment sub records
+const char TXLIST_PAYMENT = 'p';
+//! Key prefix of MetaDEx cancel master (number 0) and sub records
+const char TXLIST_CANCEL = 'c';
+//! Key prefix of "send all" sub records
+const char TXLIST_SENDALL = 's';
+//! Key prefix of the block height index
+const char TXLIST_BLOCK_INDEX = 'h';
+
+//! Number of entries converted from the legacy format, before a batch is written
+const int CONVERT_BATCH_SIZE = 10000;
+
+/** Key of a record: prefix, txid and sub record number (zero for master records). */
+struct CTxListKey
+{
+    char prefix;
+    uint256 txid;
+    uint32_t number;
+
+    CTxListKey() : prefix(0), number(0) {}
+    CTxListKey(char prefixIn, const uint256& txidIn, uint32_t numberIn = 0)
+      : prefix(prefixIn), txid(txidIn), number(numberIn) {}
+
+    template <typename Stream>
+    void Serialize(Stream& s) const
+    {
+        ser_writedata8(s, prefix);
+        txid.Serialize(s);
+        // Numbers are stored big-endian for key sorting in LevelDB
+        ser_writedata32be(s, number);
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s)
+    {
+        prefix = ser_readdata8(s);
+        txid.Unserialize(s);
+        number = ser_readdata32be(s);
+    }
+};
+
+/** Key of the block height index: height, followed by the key of the indexed record. */
+struct CTxListBlockKey
+{
+    int nBlock;
+    CTxListKey key;
+
+    CTxListBlockKey() : nBlock(0) {}
+    CTxListBlockKey(int nBlockIn, const CTxListKey& keyIn) : nBlock(nBlockIn), key(keyIn) {}
+
+    template <typename Stream>
+    void Serialize(Stream& s) const
+    {
+        ser_writedata8(s, TXLIST_BLOCK_INDEX);
+        // Heights are stored big-endian for key sorting in LevelDB
+        ser_writedata32be(s, nBlock);
+        key.Serialize(s);
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s)
+    {
+        if (ser_readdata8(s) != TXLIST_BLOCK_INDEX) {
+            throw std::ios_base::failure("not a block index key");
+        }
+        nBlock = ser_readdata32be(s);
+        key.Unserialize(s);
+    }
+};
+
+/** Master record of a transaction, payment or MetaDEx cancel. */
+struct CTxListRecord
+{
+    bool fValid;
+    int32_t nBlock;
+    uint32_t type;
+    //! Amount, or number of sub records
+    uint64_t nValue;
+
+    CTxListRecord() : fValid(false), nBlock(0), type(0), nValue(0) {}
+    CTxListRecord(bool fValidIn, int nBlockIn, uint32_t typeIn, uint64_t nValueIn)
+      : fValid(fValidIn), nBlock(nBlockIn), type(typeIn), nValue(nValueIn) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(fValid);
+        READWRITE(nBlock);
+        READWRITE(type);
+        READWRITE(nValue);
+    }
+};
+
+/** Sub record of a DEx payment. */
+struct CTxListPayment
+{
+    uint32_t vout;
+    std::string buyer;
+    std::string seller;
+    uint32_t propertyId;
+    uint64_t nValue;
+
+    CTxListPayment() : vout(0), propertyId(0), nValue(0) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(vout);
+        READWRITE(buyer);
+        READWRITE(seller);
+        READWRITE(propertyId);
+        READWRITE(nValue);
+    }
+};
+
+/** Sub record of a MetaDEx cancel, which refers to a cancelled order. */
+struct CTxListCancel
+{
+    uint256 txidSub;
+    uint32_t propertyId;
+    uint64_t nValue;
+
+    CTxListCancel() : propertyId(0), nValue(0) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(txidSub);
+        READWRITE(propertyId);
+        READWRITE(nValue);
+    }
+};
+
+/** Sub record of a "send all" transaction. */
+struct CTxListSendAll
+{
+    uint32_t propertyId;
+    int64_t nValue;
+
+    CTxListSendAll() : propertyId(0), nValue(0) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(propertyId);
+        READWRITE(nValue);
+    }
+};
+
+/** Returns the position of the first record with the given prefix. */
+std::string GetPrefixSeekKey(char prefix)
+{
+    return std::string(1, prefix);
+}
+
+/** Returns the position of the first block index entry of the given block. */
+std::string GetBlockIndexSeekKey(int nBlock)
+{
+    CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+    ser_writedata8(ssKey, TXLIST_BLOCK_INDEX);
+    ser_writedata32be(ssKey, std::max(nBlock, 0));
+    return std::string(ssKey.begin(), ssKey.end());
+}
+
+/** Stores a record, and adds it to the block height index. */
+template <typename V>
+void BatchWriteIndexed(leveldb::WriteBatch& batch, int nBlock, const CTxListKey& key, const V& value)
+{
+    batch.Put(EncodeDBEntry(key), EncodeDBEntry(value));
+    batch.Put(EncodeDBEntry(CTxListBlockKey(nBlock, key)), leveldb::Slice());
+}
+
+/** Parses a master record of the legacy "valid:block:type:value" format. */
+bool ParseLegacyRecord(const std::string& strValue, CTxListRecord& record)
+{
+    std::vector<std::string> vstr;
+    boost::split(vstr, strValue, boost::is_any_of(":"), boost::token_compress_on);
+    if (4 != vstr.size()) return false;
+    try {
+        record.fValid = (atoi(vstr[0]) == 1);
+        record.nBlock = boost::lexical_cast<int32_t>(vstr[1]);
+        record.type = boost::lexical_cast<uint32_t>(vstr[2]);
+        record.nValue = boost::lexical_cast<uint64_t>(vstr[3]);
+    } catch (const boost::bad_lexical_cast&) {
+        return false;
+    }
+    return true;
+}
+
+} // anonymous namespace
+
 CMPTxList::CMPTxList(const fs::path& path, bool fWipe)
 {
     leveldb::Status status = Open(path, fWipe);
@@ -62,15 +266,16 @@ void CMPTxList::recordTX(const uint256 &txid, bool fValid, int nBlock, unsigned
     // reorgs delete all txs from levelDB above reorg_chain_height
     if (exists(txid)) PrintToLog("LEVELDB TX OVERWRITE DETECTION - %s\n", txid.ToString());
 
-    const std::string key = txid.ToString();
-    const std::string value = strprintf("%u:%d:%u:%lu", fValid ? 1 : 0, nBlock, type, nValue);
     leveldb::Status status;
 
     PrintToLog("%s(%s, valid=%s, block= %d, type= %d, value= %lu)\n",
             __func__, txid.ToString(), fValid ? "YES" : "NO", nBlock, type, nValue);
 
-    status = pdb->Put(writeoptions, key, value);
+    leveldb::WriteBatch batch;
+    BatchWriteIndexed(batch, nBlock, CTxListKey(TXLIST_TX, txid), CTxListRecord(fValid, nBlock, type, nValue));
+    status = Apply(batch);
     ++nWritten;
+    if (!status.ok()) PrintToLog("%s(): failed to store %s: %s\n", __func__, txid.ToString(), status.ToString());
 }
 
 void CMPTxList::recordPaymentTX(const uint256& txid, bool fValid, int nBlock, unsigned int vout, unsigned int propertyId, uint64_t nValue, std::string buyer, std::string seller)
@@ -81,45 +286,34 @@ void CMPTxList::recordPaymentTX(const uint256& txid, bool fValid, int nBlock, un
     unsigned int type = 99999999;
     uint64_t numberOfPayments = 1;
     unsigned int paymentNumber = 1;
-    uint64_t existingNumberOfPayments = 0;
 
     // Step 1 - Check TXList to see if this payment TXID exists
-    bool paymentEntryExists = exists(txid);
-
     // Step 2a - If doesn't exist leave number of payments & paymentNumber set to 1
     // Step 2b - If does exist add +1 to existing number of payments and set this paymentNumber as new numberOfPayments
-    if (paymentEntryExists) {
-        //retrieve old numberOfPayments
-        std::vector<std::string> vstr;
-        std::string strValue;
-        leveldb::Status status = pdb->Get(readoptions, txid.ToString(), &strValue);
-        if (status.ok()) {
-            // parse the string returned
-            boost::split(vstr, strValue, boost::is_any_of(":"), boost::token_compress_on);
-
-            // obtain the existing number of payments
-            if (4 <= vstr.size()) {
-                existingNumberOfPayments = atoi(vstr[3]);
-                paymentNumber = existingNumberOfPayments + 1;
-                numberOfPayments = existingNumberOfPayments + 1;
-            }
-        }
+    CTxListRecord existing;
+    if (Read(CTxListKey(TXLIST_TX, txid), existing)) {
+        paymentNumber = existing.nValue + 1;
+        numberOfPayments = existing.nValue + 1;
     }
 
     // Step 3 - Create new/update master record for payment tx in TXList
-    const std::string key = txid.ToString();
-    const std::string value = strprintf("%u:%d:%u:%lu", fValid ? 1 : 0, nBlock, type, numberOfPayments);
-    leveldb::Status status;
+    leveldb::WriteBatch batch;
     PrintToLog("DEXPAYDEBUG : Writing master record %s(%s, valid=%s, block= %d, type= %d, number of payments= %lu)\n", __func__, txid.ToString(), fValid ? "YES" : "NO", nBlock, type, numberOfPayments);
-    status = pdb->Put(writeoptions, key, value);
+    BatchWriteIndexed(batch, nBlock, CTxListKey(TXLIST_TX, txid), CTxListRecord(fValid, nBlock, type, numberOfPayments));
 
     // Step 4 - Write sub-record with payment details
-    const std::string txidStr = txid.ToString();
-    const std::string subKey = STR_PAYMENT_SUBKEY_TXID_PAYMENT_COMBO(txidStr, paymentNumber);
-    const std::string subValue = strprintf("%d:%s:%s:%d:%lu", vout, buyer, seller, propertyId, nValue);
-    leveldb::Status subStatus;
-    PrintToLog("DEXPAYDEBUG : Writing sub-record %s with value %s\n", subKey, subValue);
-    subStatus = pdb->Put(writeoptions, subKey, subValue);
+    CTxListPayment payment;
+    payment.vout = vout;
+    payment.buyer = buyer;
+    payment.seller = seller;
+    payment.propertyId = propertyId;
+    payment.nValue = nValue;
+    PrintToLog("DEXPAYDEBUG : Writing sub-record %s-%d with value %d:%s:%s:%d:%lu\n", txid.ToString(), paymentNumber, vout, buyer, seller, propertyId, nValue);
+    BatchWriteIndexed(batch, nBlock, CTxListKey(TXLIST_PAYMENT, txid, paymentNumber), payment);
+
+    leveldb::Status status = Apply(batch);
+    nWritten += 2;
+    if (!status.ok()) PrintToLog("%s(): failed to store %s-%d: %s\n", __func__, txid.ToString(), paymentNumber, status.ToString());
 }
 
 void CMPTxList::recordMetaDExCancelTX(const uint256& txidMaster, const uint256& txidSub, bool fValid, int nBlock, unsigned int propertyId, uint64_t nValue)
@@ -129,87 +323,79 @@ void CMPTxList::recordMetaDExCancelTX(const uint256& txidMaster, const uint256&
     // Prep - setup vars
     unsigned int type = 99992104;
     unsigned int refNumber = 1;
-    uint64_t existingAffectedTXCount = 0;
-    std::string txidMasterStr = txidMaster.ToString() + "-C";
 
     // Step 1 - Check TXList to see if this cancel TXID exists
     // Step 2a - If doesn't exist leave number of affected txs & ref set to 1
     // Step 2b - If does exist add +1 to existing ref and set this ref as new number of affected
-    std::vector<std::string> vstr;
-    std::string strValue;
-    leveldb::Status status = pdb->Get(readoptions, txidMasterStr, &strValue);
-    if (status.ok()) {
-        // parse the string returned
-        boost::split(vstr, strValue, boost::is_any_of(":"), boost::token_compress_on);
-
-        // obtain the existing affected tx count
-        if (4 <= vstr.size()) {
-            existingAffectedTXCount = atoi(vstr[3]);
-            refNumber = existingAffectedTXCount + 1;
-        }
+    CTxListRecord existing;
+    if (Read(CTxListKey(TXLIST_CANCEL, txidMaster), existing)) {
+        refNumber = existing.nValue + 1;
     }
 
     // Step 3 - Create new/update master record for cancel tx in TXList
-    const std::string key = txidMasterStr;
-    const std::string value = strprintf("%u:%d:%u:%lu", fValid ? 1 : 0, nBlock, type, refNumber);
+    leveldb::WriteBatch batch;
     PrintToLog("METADEXCANCELDEBUG : Writing master record %s(%s, valid=%s, block= %d, type= %d, number of affected transactions= %d)\n", __func__, txidMaster.ToString(), fValid ? "YES" : "NO", nBlock, type, refNumber);
-    status = pdb->Put(writeoptions, key, value);
+    BatchWriteIndexed(batch, nBlock, CTxListKey(TXLIST_CANCEL, txidMaster), CTxListRecord(fValid, nBlock, type, refNumber));
 
     // Step 4 - Write sub-record with cancel details
-    const std::string txidStr = txidMaster.ToString() + "-C";
-    const std::string subKey = STR_REF_SUBKEY_TXID_REF_COMBO(txidStr, refNumber);
-    const std::string subValue = strprintf("%s:%d:%lu", txidSub.ToString(), propertyId, nValue);
-    PrintToLog("METADEXCANCELDEBUG : Writing sub-record %s with value %s\n", subKey, subValue);
-    status = pdb->Put(writeoptions, subKey, subValue);
-    if (msc_debug_txdb) PrintToLog("%s(): store: %s=%s, status: %s\n", __func__, subKey, subValue, status.ToString());
+    CTxListCancel cancel;
+    cancel.txidSub = txidSub;
+    cancel.propertyId = propertyId;
+    cancel.nValue = nValue;
+    PrintToLog("METADEXCANCELDEBUG : Writing sub-record %s-C%d with value %s:%d:%lu\n", txidMaster.ToString(), refNumber, txidSub.ToString(), propertyId, nValue);
+    BatchWriteIndexed(batch, nBlock, CTxListKey(TXLIST_CANCEL, txidMaster, refNumber), cancel);
+
+    leveldb::Status status = Apply(batch);
+    nWritten += 2;
+    if (!status.ok()) PrintToLog("%s(): failed to store %s-C%d: %s\n", __func__, txidMaster.ToString(), refNumber, status.ToString());
+    if (msc_debug_txdb) PrintToLog("%s(): store: %s-C%d, status: %s\n", __func__, txidMaster.ToString(), refNumber, status.ToString());
 }
 
 
 /**
  * Records a "send all" sub record.
  */
-void CMPTxList::recordSendAllSubRecord(const uint256& txid, int subRecordNumber, uint32_t propertyId, int64_t nValue)
+void CMPTxList::recordSendAllSubRecord(const uint256& txid, int nBlock, int subRecordNumber, uint32_t propertyId, int64_t nValue)
 {
-    std::string strKey = strprintf("%s-%d", txid.ToString(), subRecordNumber);
-    std::string strValue = strprintf("%d:%d", propertyId, nValue);
+    CTxListSendAll sendAll;
+    sendAll.propertyId = propertyId;
+    sendAll.nValue = nValue;
 
-    leveldb::Status status = pdb->Put(writeoptions, strKey, strValue);
+    leveldb::WriteBatch batch;
+    BatchWriteIndexed(batch, nBlock, CTxListKey(TXLIST_SENDALL, txid, subRecordNumber), sendAll);
+    leveldb::Status status = Apply(batch);
     ++nWritten;
-    if (msc_debug_txdb) PrintToLog("%s(): store: %s=%s, status: %s\n", __func__, strKey, strValue, status.ToString());
+    if (msc_debug_txdb) PrintToLog("%s(): store: %s-%d=%d:%d, status: %s\n", __func__, txid.ToString(), subRecordNumber, propertyId, nValue, status.ToString());
 }
 
-
-std::string CMPTxList::getKeyValue(std::string key)
+/**
+ * Retrieves details about a MetaDEx cancel sub record.
+ */
+bool CMPTxList::getMetaDExCancelDetails(const uint256& txid, int refNumber, uint256& txidSub, uint32_t& propertyId, int64_t& amount)
 {
-    if (!pdb) return "";
-    std::string strValue;
-    leveldb::Status status = pdb->Get(readoptions, key, &strValue);
-    if (status.ok()) {
-        return strValue;
-    } else {
-        return "";
-    }
+    if (!pdb) return false;
+
+    CTxListCancel cancel;
+    if (!Read(CTxListKey(TXLIST_CANCEL, txid, refNumber), cancel)) return false;
+
+    txidSub = cancel.txidSub;
+    propertyId = cancel.propertyId;
+    amount = cancel.nValue;
+    return true;
 }
 
 uint256 CMPTxList::findMetaDExCancel(const uint256 txid)
 {
-    std::vector<std::string> vstr;
-    std::string txidStr = txid.ToString();
-    leveldb::Slice skey, svalue;
-    uint256 cancelTxid;
+    CTxListKey key;
+    CTxListCancel cancel;
     leveldb::Iterator* it = NewIterator();
-    for (it->SeekToFirst(); it->Valid(); it->Next()) {
-        skey = it->key();
-        svalue = it->value();
-        std::string svalueStr = svalue.ToString();
-        boost::split(vstr, svalueStr, boost::is_any_of(":"), boost::token_compress_on);
-        // obtain the existing affected tx count
-        if (3 <= vstr.size()) {
-            if (vstr[0] == txidStr) {
-                delete it;
-                cancelTxid.SetHex(skey.ToString());
-                return cancelTxid;
-            }
+    for (it->Seek(GetPrefixSeekKey(TXLIST_CANCEL)); it->Valid(); it->Next()) {
+        if (!DecodeDBEntry(it->key(), key) || key.prefix != TXLIST_CANCEL) break;
+        if (key.number == 0) continue; // master record
+        if (!DecodeDBEntry(it->value(), cancel)) continue;
+        if (cancel.txidSub == txid) {
+            delete it;
+            return key.txid;
         }
     }
 
@@ -224,14 +410,9 @@ int CMPTxList::getNumberOfSubRecords(const uint256& txid)
 {
     int numberOfSubRecords = 0;
 
-    std::string strValue;
-    leveldb::Status status = pdb->Get(readoptions, txid.ToString(), &strValue);
-    if (status.ok()) {
-        std::vector<std::string> vstr;
-        boost::split(vstr, strValue, boost::is_any_of(":"), boost::token_compress_on);
-        if (4 <= vstr.size()) {
-            numberOfSubRecords = boost::lexical_cast<int>(vstr[3]);
-        }
+    CTxListRecord record;
+    if (Read(CTxListKey(TXLIST_TX, txid), record)) {
+        numberOfSubRecords = static_cast<int>(record.nValue);
     }
 
     return numberOfSubRecords;
@@ -241,16 +422,9 @@ int CMPTxList::getNumberOfMetaDExCancels(const uint256 txid)
 {
     if (!pdb) return 0;
     int numberOfCancels = 0;
-    std::vector<std::string> vstr;
-    std::string strValue;
-    leveldb::Status status = pdb->Get(readoptions, txid.ToString() + "-C", &strValue);
-    if (status.ok()) {
-        // parse the string returned
-        boost::split(vstr, strValue, boost::is_any_of(":"), boost::token_compress_on);
-        // obtain the number of cancels
-        if (4 <= vstr.size()) {
-            numberOfCancels = atoi(vstr[3]);
-        }
+    CTxListRecord record;
+    if (Read(CTxListKey(TXLIST_CANCEL, txid), record)) {
+        numberOfCancels = static_cast<int>(record.nValue);
     }
     return numberOfCancels;
 }
@@ -258,21 +432,14 @@ int CMPTxList::getNumberOfMetaDExCancels(const uint256 txid)
 bool CMPTxList::getPurchaseDetails(const uint256 txid, int purchaseNumber, std::string* buyer, std::string* seller, uint64_t* vout, uint64_t* propertyId, uint64_t* nValue)
 {
     if (!pdb) return 0;
-    std::vector<std::string> vstr;
-    std::string strValue;
-    leveldb::Status status = pdb->Get(readoptions, txid.ToString() + "-" + std::to_string(purchaseNumber), &strValue);
-    if (status.ok()) {
-        // parse the string returned
-        boost::split(vstr, strValue, boost::is_any_of(":"), boost::token_compress_on);
-        // obtain the requisite details
-        if (5 == vstr.size()) {
-            *vout = atoi(vstr[0]);
-            *buyer = vstr[1];
-            *seller = vstr[2];
-            *propertyId = atoi64(vstr[3]);
-            *nValue = boost::lexical_cast<boost::uint64_t>(vstr[4]);
-            return true;
-        }
+    CTxListPayment payment;
+    if (Read(CTxListKey(TXLIST_PAYMENT, txid, purchaseNumber), payment)) {
+        *vout = payment.vout;
+        *buyer = payment.buyer;
+        *seller = payment.seller;
+        *propertyId = payment.propertyId;
+        *nValue = payment.nValue;
+        return true;
     }
     return false;
 }
@@ -282,17 +449,11 @@ bool CMPTxList::getPurchaseDetails(const uint256 txid, int purchaseNumber, std::
  */
 bool CMPTxList::getSendAllDetails(const uint256& txid, int subSend, uint32_t& propertyId, int64_t& amount)
 {
-    std::string strKey = strprintf("%s-%d", txid.ToString(), subSend);
-    std::string strValue;
-    leveldb::Status status = pdb->Get(readoptions, strKey, &strValue);
-    if (status.ok()) {
-        std::vector<std::string> vstr;
-        boost::split(vstr, strValue, boost::is_any_of(":"), boost::token_compress_on);
-        if (2 == vstr.size()) {
-            propertyId = boost::lexical_cast<uint32_t>(vstr[0]);
-            amount = boost::lexical_cast<int64_t>(vstr[1]);
-            return true;
-        }
+    CTxListSendAll sendAll;
+    if (Read(CTxListKey(TXLIST_SENDALL, txid, subSend), sendAll)) {
+        propertyId = sendAll.propertyId;
+        amount = sendAll.nValue;
+        return true;
     }
     return false;
 }
@@ -300,13 +461,10 @@ bool CMPTxList::getSendAllDetails(const uint256& txid, int subSend, uint32_t& pr
 int CMPTxList::getMPTransactionCountTotal()
 {
     int count = 0;
-    leveldb::Slice skey, svalue;
     leveldb::Iterator* it = NewIterator();
-    for (it->SeekToFirst(); it->Valid(); it->Next()) {
-        skey = it->key();
-        if (skey.ToString().length() == 64) {
-            ++count;
-        } //extra entries for cancels and purchases are more than 64 chars long
+    for (it->Seek(GetPrefixSeekKey(TXLIST_TX)); it->Valid(); it->Next()) {
+        if (it->key().size() == 0 || it->key()[0] != TXLIST_TX) break;
+        ++count;
     }
     delete it;
     return count;
@@ -314,48 +472,25 @@ int CMPTxList::getMPTransactionCountTotal()
 
 int CMPTxList::getMPTransactionCountBlock(int block)
 {
-    int count = 0;
-    leveldb::Slice skey, svalue;
-    leveldb::Iterator* it = NewIterator();
-    for (it->SeekToFirst(); it->Valid(); it->Next()) {
-        skey = it->key();
-        svalue = it->value();
-        if (skey.ToString().length() == 64) {
-            std::string strValue = svalue.ToString();
-            std::vector<std::string> vstr;
-            boost::split(vstr, strValue, boost::is_any_of(":"), boost::token_compress_on);
-            if (4 == vstr.size()) {
-                if (atoi(vstr[1]) == block) {
-                    ++count;
-                }
-            }
-        }
-    }
-    delete it;
-    return count;
+    std::set<uint256> txs;
+    return GetOmniTxsInBlockRange(block, block, txs);
 }
 
 /** Returns a list of all Omni transactions in the given block range. */
 int CMPTxList::GetOmniTxsInBlockRange(int blockFirst, int blockLast, std::set<uint256>& retTxs)
 {
     int count = 0;
+    CTxListBlockKey indexKey;
     leveldb::Iterator* it = NewIterator();
-    
-    for (it->SeekToFirst(); it->Valid(); it->Next()) {
-        const leveldb::Slice& sKey = it->key();
-        const leveldb::Slice& sValue = it->value();
-
-        if (sKey.ToString().length() == 64) {
-            const std::string& strValue = sValue.ToString();
-            std::vector<std::string> vStr;
-            boost::split(vStr, strValue, boost::is_any_of(":"), boost::token_compress_on);
-            if (4 == vStr.size()) {
-                int blockCurrent = atoi(vStr[1]);
-                if (blockCurrent >= blockFirst && blockCurrent <= blockLast) {
-                    retTxs.insert(uint256S(sKey.ToString()));                    
-                    ++count;
-                }
-            }
+
+    for (it->Seek(GetBlockIndexSeekKey(blockFirst)); it->Valid(); it->Next()) {
+        if (!DecodeDBEntry(it->key(), indexKey)) break;
+        if (indexKey.nBlock > blockLast) break;
+
+        // sub records for cancels and purchases are indexed as well
+        if (indexKey.key.prefix == TXLIST_TX) {
+            retTxs.insert(indexKey.key.txid);
+            ++count;
         }
     }
 
@@ -373,7 +508,7 @@ int CMPTxList::getDBVersion()
     std::string strValue;
     int verDB = 0;
 
-    leveldb::Status status = pdb->Get(readoptions, "dbversion", &strValue);
+    leveldb::Status status = Get("dbversion", &strValue);
     if (status.ok()) {
         verDB = boost::lexical_cast<uint64_t>(strValue);
     }
@@ -402,26 +537,22 @@ bool CMPTxList::exists(const uint256 &txid)
 {
     if (!pdb) return false;
 
-    std::string strValue;
-    leveldb::Status status = pdb->Get(readoptions, txid.ToString(), &strValue);
-
-    if (!status.ok()) {
-        if (status.IsNotFound()) return false;
-    }
-
-    return true;
+    return Exists(CTxListKey(TXLIST_TX, txid));
 }
 
-bool CMPTxList::getTX(const uint256 &txid, std::string& value)
+bool CMPTxList::getTX(const uint256 &txid, bool& fValid, int& block, unsigned int& type, uint64_t& nValue)
 {
-    leveldb::Status status = pdb->Get(readoptions, txid.ToString(), &value);
-    ++nRead;
-
-    if (status.ok()) {
-        return true;
+    CTxListRecord record;
+    if (!Read(CTxListKey(TXLIST_TX, txid), record)) {
+        return false;
     }
 
-    return false;
+    fValid = record.fValid;
+    block = record.nBlock;
+    type = record.type;
+    nValue = record.nValue;
+
+    return true;
 }
 
 // call it like so (variable # of parameters):
@@ -433,43 +564,26 @@ bool CMPTxList::getTX(const uint256 &txid, std::string& value)
 //
 bool CMPTxList::getValidMPTX(const uint256& txid, int* block, unsigned int* type, uint64_t* nAmended)
 {
-    std::string result;
-    int validity = 0;
+    bool fValid = false;
+    int nBlock = 0;
+    unsigned int nType = 0;
+    uint64_t nValue = 0;
 
     if (msc_debug_txdb) PrintToLog("%s()\n", __func__);
 
     if (!pdb) return false;
 
-    if (!getTX(txid, result)) return false;
-
-    // parse the string returned, find the validity flag/bit & other parameters
-    std::vector<std::string> vstr;
-    boost::split(vstr, result, boost::is_any_of(":"), boost::token_compress_on);
-
-    if (msc_debug_txdb) PrintToLog("%s() size=%lu : %s\n", __func__, vstr.size(), result);
+    if (!getTX(txid, fValid, nBlock, nType, nValue)) return false;
 
-    if (1 <= vstr.size()) validity = atoi(vstr[0]);
+    if (msc_debug_txdb) PrintToLog("%s() %s : %d:%d:%d:%d\n", __func__, txid.ToString(), fValid, nBlock, nType, nValue);
 
-    if (block) {
-        if (2 <= vstr.size()) *block = atoi(vstr[1]);
-        else *block = 0;
-    }
-
-    if (type) {
-        if (3 <= vstr.size()) *type = atoi(vstr[2]);
-        else *type = 0;
-    }
-
-    if (nAmended) {
-        if (4 <= vstr.size()) *nAmended = boost::lexical_cast<boost::uint64_t>(vstr[3]);
-        else nAmended = 0;
-    }
+    if (block) *block = nBlock;
+    if (type) *type = nType;
+    if (nAmended) *nAmended = nValue;
 
     if (msc_debug_txdb) printStats();
 
-    if ((int) 0 == validity) return false;
-
-    return true;
+    return fValid;
 }
 
 std::set<int> CMPTxList::GetSeedBlocks(int startHeight, int endHeight)
@@ -478,17 +592,13 @@ std::set<int> CMPTxList::GetSeedBlocks(int startHeight, int endHeight)
 
     if (!pdb) return setSeedBlocks;
 
+    CTxListBlockKey indexKey;
     leveldb::Iterator* it = NewIterator();
 
-    for (it->SeekToFirst(); it->Valid(); it->Next()) {
-        std::string itData = it->value().ToString();
-        std::vector<std::string> vstr;
-        boost::split(vstr, itData, boost::is_any_of(":"), boost::token_compress_on);
-        if (4 != vstr.size()) continue; // unexpected number of tokens
-        int block = atoi(vstr[1]);
-        if (block >= startHeight && block <= endHeight) {
-            setSeedBlocks.insert(block);
-        }
+    for (it->Seek(GetBlockIndexSeekKey(startHeight)); it->Valid(); it->Next()) {
+        if (!DecodeDBEntry(it->key(), indexKey)) break;
+        if (indexKey.nBlock > endHeight) break;
+        setSeedBlocks.insert(indexKey.nBlock);
     }
 
     delete it;
@@ -499,19 +609,17 @@ std::set<int> CMPTxList::GetSeedBlocks(int startHeight, int endHeight)
 void CMPTxList::LoadAlerts(int blockHeight)
 {
     if (!pdb) return;
-    leveldb::Slice skey, svalue;
+    CTxListKey key;
+    CTxListRecord record;
     leveldb::Iterator* it = NewIterator();
 
     std::vector<std::pair<int64_t, uint256> > loadOrder;
 
-    for (it->SeekToFirst(); it->Valid(); it->Next()) {
-        std::string itData = it->value().ToString();
-        std::vector<std::string> vstr;
-        boost::split(vstr, itData, boost::is_any_of(":"), boost::token_compress_on);
-        if (4 != vstr.size()) continue; // unexpected number of tokens
-        if (atoi(vstr[2]) != OMNICORE_MESSAGE_TYPE_ALERT || atoi(vstr[0]) != 1) continue; // not a valid alert
-        uint256 txid = uint256S(it->key().ToString());
-        loadOrder.push_back(std::make_pair(atoi(vstr[1]), txid));
+    for (it->Seek(GetPrefixSeekKey(TXLIST_TX)); it->Valid(); it->Next()) {
+        if (!DecodeDBEntry(it->key(), key) || key.prefix != TXLIST_TX) break;
+        if (!DecodeDBEntry(it->value(), record)) continue; // unexpected record
+        if (record.type != OMNICORE_MESSAGE_TYPE_ALERT || !record.fValid) continue; // not a valid alert
+        loadOrder.push_back(std::make_pair(record.nBlock, key.txid));
     }
 
     std::sort(loadOrder.begin(), loadOrder.end());
@@ -573,21 +681,19 @@ void CMPTxList::LoadActivations(int blockHeight)
 {
     if (!pdb) return;
 
-    leveldb::Slice skey, svalue;
+    CTxListKey key;
+    CTxListRecord record;
     leveldb::Iterator* it = NewIterator();
 
     PrintToLog("Loading feature activations from levelDB\n");
 
     std::vector<std::pair<int64_t, uint256> > loadOrder;
 
-    for (it->SeekToFirst(); it->Valid(); it->Next()) {
-        std::string itData = it->value().ToString();
-        std::vector<std::string> vstr;
-        boost::split(vstr, itData, boost::is_any_of(":"), boost::token_compress_on);
-        if (4 != vstr.size()) continue; // unexpected number of tokens
-        if (atoi(vstr[2]) != OMNICORE_MESSAGE_TYPE_ACTIVATION || atoi(vstr[0]) != 1) continue; // we only care about valid activations
-        uint256 txid = uint256S(it->key().ToString());
-        loadOrder.push_back(std::make_pair(atoi(vstr[1]), txid));
+    for (it->Seek(GetPrefixSeekKey(TXLIST_TX)); it->Valid(); it->Next()) {
+        if (!DecodeDBEntry(it->key(), key) || key.prefix != TXLIST_TX) break;
+        if (!DecodeDBEntry(it->value(), record)) continue; // unexpected record
+        if (record.type != OMNICORE_MESSAGE_TYPE_ACTIVATION || !record.fValid) continue; // we only care about valid activations
+        loadOrder.push_back(std::make_pair(record.nBlock, key.txid));
     }
 
     std::sort(loadOrder.begin(), loadOrder.end());
@@ -650,22 +756,21 @@ bool CMPTxList::LoadFreezeState(int blockHeight)
 
     std::vector<std::pair<std::string, uint256> > loadOrder;
     int txnsLoaded = 0;
+    CTxListKey key;
+    CTxListRecord record;
     leveldb::Iterator* it = NewIterator();
     PrintToLog("Loading freeze state from levelDB\n");
 
-    for (it->SeekToFirst(); it->Valid(); it->Next()) {
-        std::string itData = it->value().ToString();
-        std::vector<std::string> vstr;
-        boost::split(vstr, itData, boost::is_any_of(":"), boost::token_compress_on);
-        if (4 != vstr.size()) continue;
-        uint16_t txtype = atoi(vstr[2]);
+    for (it->Seek(GetPrefixSeekKey(TXLIST_TX)); it->Valid(); it->Next()) {
+        if (!DecodeDBEntry(it->key(), key) || key.prefix != TXLIST_TX) break;
+        if (!DecodeDBEntry(it->value(), record)) continue;
+        uint16_t txtype = record.type;
         if (txtype != MSC_TYPE_FREEZE_PROPERTY_TOKENS && txtype != MSC_TYPE_UNFREEZE_PROPERTY_TOKENS &&
                 txtype != MSC_TYPE_ENABLE_FREEZING && txtype != MSC_TYPE_DISABLE_FREEZING) continue;
-        if (atoi(vstr[0]) != 1) continue; // invalid, ignore
-        uint256 txid = uint256S(it->key().ToString());
-        int txPosition = pDbTransaction->FetchTransactionPosition(txid);
-        std::string sortKey = strprintf("%06d%010d", atoi(vstr[1]), txPosition);
-        loadOrder.push_back(std::make_pair(sortKey, txid));
+        if (!record.fValid) continue; // invalid, ignore
+        int txPosition = pDbTransaction->FetchTransactionPosition(key.txid);
+        std::string sortKey = strprintf("%06d%010d", record.nBlock, txPosition);
+        loadOrder.push_back(std::make_pair(sortKey, key.txid));
     }
 
     delete it;
@@ -727,16 +832,15 @@ bool CMPTxList::CheckForFreezeTxs(int blockHeight)
 {
     assert(pdb);
 
+    CTxListBlockKey indexKey;
+    CTxListRecord record;
     leveldb::Iterator* it = NewIterator();
 
-    for (it->SeekToFirst(); it->Valid(); it->Next()) {
-        std::string itData = it->value().ToString();
-        std::vector<std::string> vstr;
-        boost::split(vstr, itData, boost::is_any_of(":"), boost::token_compress_on);
-        if (4 != vstr.size()) continue;
-        int block = atoi(vstr[1]);
-        if (block < blockHeight) continue;
-        uint16_t txtype = atoi(vstr[2]);
+    for (it->Seek(GetBlockIndexSeekKey(blockHeight)); it->Valid(); it->Next()) {
+        if (!DecodeDBEntry(it->key(), indexKey)) break;
+        if (indexKey.key.prefix != TXLIST_TX) continue;
+        if (!Read(indexKey.key, record)) continue;
+        uint16_t txtype = record.type;
         if (txtype == MSC_TYPE_FREEZE_PROPERTY_TOKENS || txtype == MSC_TYPE_UNFREEZE_PROPERTY_TOKENS ||
                 txtype == MSC_TYPE_ENABLE_FREEZING || txtype == MSC_TYPE_DISABLE_FREEZING) {
             delete it;
@@ -756,14 +860,18 @@ void CMPTxList::printStats()
 void CMPTxList::printAll()
 {
     int count = 0;
-    leveldb::Slice skey, svalue;
+    CTxListKey key;
+    CTxListRecord record;
     leveldb::Iterator* it = NewIterator();
 
     for (it->SeekToFirst(); it->Valid(); it->Next()) {
-        skey = it->key();
-        svalue = it->value();
         ++count;
-        PrintToConsole("entry #%8d= %s:%s\n", count, skey.ToString(), svalue.ToString());
+        if (DecodeDBEntry(it->key(), key) && key.number == 0 && DecodeDBEntry(it->value(), record)) {
+            PrintToConsole("entry #%8d= %c:%s=%d:%d:%d:%d\n", count, key.prefix, key.txid.ToString(),
+                    record.fValid, record.nBlock, record.type, record.nValue);
+        } else {
+            PrintToConsole("entry #%8d= %s:%s\n", count, HexStr(it->key().ToString()), HexStr(it->value().ToString()));
+        }
     }
 
     delete it;
@@ -774,40 +882,144 @@ void CMPTxList::printAll()
 // pass in bDeleteFound = true to erase each entry found within the block range
 bool CMPTxList::isMPinBlockRange(int starting_block, int ending_block, bool bDeleteFound)
 {
-    leveldb::Slice skey, svalue;
-    unsigned int count = 0;
-    std::vector<std::string> vstr;
-    int block;
+    CTxListBlockKey indexKey;
     unsigned int n_found = 0;
+    leveldb::WriteBatch batch;
 
     leveldb::Iterator* it = NewIterator();
 
-    for (it->SeekToFirst(); it->Valid(); it->Next()) {
-        skey = it->key();
-        svalue = it->value();
+    // the block height index is ordered by block, so only the records of the range are visited
+    for (it->Seek(GetBlockIndexSeekKey(starting_block)); it->Valid(); it->Next()) {
+        if (!DecodeDBEntry(it->key(), indexKey)) break;
+        if (indexKey.nBlock > ending_block) break;
+
+        ++n_found;
+        PrintToLog("%s() DELETING: %c:%s-%d (block %d)\n", __func__,
+                indexKey.key.prefix, indexKey.key.txid.ToString(), indexKey.key.number, indexKey.nBlock);
+        if (bDeleteFound) {
+            batch.Delete(EncodeDBEntry(indexKey.key));
+            batch.Delete(it->key());
+        }
+    }
 
-        ++count;
+    delete it;
 
-        std::string strvalue = it->value().ToString();
+    if (bDeleteFound && n_found > 0) {
+        leveldb::Status status = Apply(batch);
+        if (!status.ok()) PrintToLog("%s(): failed to delete records: %s\n", __func__, status.ToString());
+    }
+
+    PrintToLog("%s(%d, %d); n_found= %d\n", __func__, starting_block, ending_block, n_found);
 
-        // parse the string returned, find the validity flag/bit & other parameters
-        boost::split(vstr, strvalue, boost::is_any_of(":"), boost::token_compress_on);
+    return (n_found);
+}
 
-        // only care about the block number/height here
-        if (2 <= vstr.size()) {
-            block = atoi(vstr[1]);
+/**
+ * Converts records of the legacy string based format into the binary format.
+ *
+ * Legacy keys are hex encoded txids, optionally followed by "-<number>" for payment and
+ * "send all" sub records, or "-C" and "-C<number>" for MetaDEx cancels. Values are colon
+ * separated strings. Sub records are indexed with the block of their master record,
+ * which precedes them in the legacy key order.
+ *
+ * @return The number of converted records, or -1 on failure
+ */
+int CMPTxList::ConvertLegacyRecords()
+{
+    assert(pdb);
 
-            if ((starting_block <= block) && (block <= ending_block)) {
-                ++n_found;
-                PrintToLog("%s() DELETING: %s=%s\n", __func__, skey.ToString(), svalue.ToString());
-                if (bDeleteFound) pdb->Delete(writeoptions, skey);
+    int64_t nTimeStart = GetTimeMicros();
+    int nConverted = 0;
+    int nBatched = 0;
+    uint256 txidMaster;
+    int nBlockMaster = -1;
+    leveldb::WriteBatch batch;
+    leveldb::Status status;
+
+    // the iterator operates on a snapshot, so converted entries are not visited again
+    leveldb::Iterator* it = NewIterator();
+
+    for (it->SeekToFirst(); it->Valid() && status.ok(); it->Next()) {
+        const std::string strKey = it->key().ToString();
+        const std::string strValue = it->value().ToString();
+
+        // remove the string based block height index, it is rebuilt below
+        if (strKey.size() > 64 && strKey[0] == TXLIST_BLOCK_INDEX) {
+            batch.Delete(it->key());
+            ++nBatched;
+            continue;
+        }
+        if (strKey.size() < 64 || !IsHex(strKey.substr(0, 64))) continue; // not a legacy record
+        const uint256 txid = uint256S(strKey.substr(0, 64));
+        const std::string strSuffix = strKey.substr(64);
+
+        std::vector<std::string> vstr;
+        boost::split(vstr, strValue, boost::is_any_of(":"), boost::token_compress_on);
+
+        CTxListRecord record;
+        if (strSuffix.empty() || strSuffix == "-C") {
+            if (!ParseLegacyRecord(strValue, record)) {
+                PrintToLog("%s(): unexpected master record %s=%s\n", __func__, strKey, strValue);
+                continue;
+            }
+            txidMaster = txid;
+            nBlockMaster = record.nBlock;
+            BatchWriteIndexed(batch, nBlockMaster, CTxListKey(strSuffix.empty() ? TXLIST_TX : TXLIST_CANCEL, txid), record);
+        } else if (txid != txidMaster || nBlockMaster < 0) {
+            PrintToLog("%s(): sub record without master record %s=%s\n", __func__, strKey, strValue);
+            continue;
+        } else {
+            try {
+                if (strSuffix.compare(0, 2, "-C") == 0 && 3 == vstr.size()) {
+                    CTxListCancel cancel;
+                    cancel.txidSub = uint256S(vstr[0]);
+                    cancel.propertyId = boost::lexical_cast<uint32_t>(vstr[1]);
+                    cancel.nValue = boost::lexical_cast<uint64_t>(vstr[2]);
+                    uint32_t refNumber = boost::lexical_cast<uint32_t>(strSuffix.substr(2));
+                    BatchWriteIndexed(batch, nBlockMaster, CTxListKey(TXLIST_CANCEL, txid, refNumber), cancel);
+                } else if (5 == vstr.size()) {
+                    CTxListPayment payment;
+                    payment.vout = boost::lexical_cast<uint32_t>(vstr[0]);
+                    payment.buyer = vstr[1];
+                    payment.seller = vstr[2];
+                    payment.propertyId = boost::lexical_cast<uint32_t>(vstr[3]);
+                    payment.nValue = boost::lexical_cast<uint64_t>(vstr[4]);
+                    uint32_t paymentNumber = boost::lexical_cast<uint32_t>(strSuffix.substr(1));
+                    BatchWriteIndexed(batch, nBlockMaster, CTxListKey(TXLIST_PAYMENT, txid, paymentNumber), payment);
+                } else if (2 == vstr.size()) {
+                    CTxListSendAll sendAll;
+                    sendAll.propertyId = boost::lexical_cast<uint32_t>(vstr[0]);
+                    sendAll.nValue = boost::lexical_cast<int64_t>(vstr[1]);
+                    uint32_t subNumber = boost::lexical_cast<uint32_t>(strSuffix.substr(1));
+                    BatchWriteIndexed(batch, nBlockMaster, CTxListKey(TXLIST_SENDALL, txid, subNumber), sendAll);
+                } else {
+                    PrintToLog("%s(): unexpected sub record %s=%s\n", __func__, strKey, strValue);
+                    continue;
+                }
+            } catch (const boost::bad_lexical_cast&) {
+                PrintToLog("%s(): failed to parse sub record %s=%s\n", __func__, strKey, strValue);
+                continue;
             }
         }
-    }
 
-    PrintToLog("%s(%d, %d); n_found= %d\n", __func__, starting_block, ending_block, n_found);
+        batch.Delete(it->key());
+        ++nConverted;
+
+        if (++nBatched >= CONVERT_BATCH_SIZE) {
+            status = Apply(batch);
+            batch.Clear();
+            nBatched = 0;
+        }
+    }
 
     delete it;
 
-    return (n_found);
+    if (status.ok()) {
+        status = Apply(batch, true);
+    }
+
+    PrintToLog("%s(): converted %d records: %s [%.3f ms total]\n",
+            __func__, nConverted, status.ToString(), 0.001 * (GetTimeMicros() - nTimeStart));
+
+    return status.ok() ? nConverted : -1;
 }
@@ -12,6 +12,58 @@
 #include <string>
 
 /** LevelDB based storage for transactions, with txid as key and validity bit, and other data as value.
+ *
+ * All records are additionally indexed by block height, so that block ranges can be
+ * looked up or removed without iterating over the whole database.
+ *
+ * DB Schema:
+ *
+ *  Key:
+ *      char 't'
+ *      uint256 txid
+ *      uint32_t 0 (big-endian)
+ *  Value:
+ *      bool valid, int32_t block, uint32_t type, uint64_t amount or number of sub records
+ *
+ *  Key:
+ *      char 'p'
+ *      uint256 txid
+ *      uint32_t paymentNumber (big-endian)
+ *  Value:
+ *      uint32_t vout, std::string buyer, std::string seller, uint32_t propertyId, uint64_t amount
+ *
+ *  Key:
+ *      char 'c'
+ *      uint256 txid
+ *      uint32_t 0 (big-endian)
+ *  Value:
+ *      bool valid, int32_t block, uint32_t type, uint64_t number of cancelled orders
+ *
+ *  Key:
+ *      char 'c'
+ *      uint256 txid
+ *      uint32_t refNumber (big-endian)
+ *  Value:
+ *      uint256 txidCancelled, uint32_t propertyId, uint64_t amount
+ *
+ *  Key:
+ *      char 's'
+ *      uint256 txid
+ *      uint32_t subRecordNumber (big-endian)
+ *  Value:
+ *      uint32_t propertyId, int64_t amount
+ *
+ *  Key:
+ *      char 'h'
+ *      int32_t block (big-endian)
+ *      key of the indexed record
+ *  Value:
+ *      empty
+ *
+ *  Key:
+ *      "dbversion"
+ *  Value:
+ *      std::string version
  */
 class CMPTxList : public CDBBase
 {
@@ -23,9 +75,10 @@ public:
     void recordPaymentTX(const uint256& txid, bool fValid, int nBlock, unsigned int vout, unsigned int propertyId, uint64_t nValue, std::string buyer, std::string seller);
     void recordMetaDExCancelTX(const uint256 &txidMaster, const uint256& txidSub, bool fValid, int nBlock, unsigned int propertyId, uint64_t nValue);
     /** Records a "send all" sub record. */
-    void recordSendAllSubRecord(const uint256& txid, int subRecordNumber, uint32_t propertyId, int64_t nvalue);
+    void recordSendAllSubRecord(const uint256& txid, int nBlock, int subRecordNumber, uint32_t propertyId, int64_t nvalue);
 
-    std::string getKeyValue(std::string key);
+    /** Retrieves details about a MetaDEx cancel sub record. */
+    bool getMetaDExCancelDetails(const uint256& txid, int refNumber, uint256& txidSub, uint32_t& propertyId, int64_t& amount);
     uint256 findMetaDExCancel(const uint256 txid);
     /** Returns the number of sub records. */
     int getNumberOfSubRecords(const uint256& txid);
@@ -40,9 +93,11 @@ public:
 
     int getDBVersion();
     int setDBVersion();
+    /** Converts records of the legacy string based format into the binary format. */
+    int ConvertLegacyRecords();
 
     bool exists(const uint256& txid);
-    bool getTX(const uint256& txid, std::string& value);
+    bool getTX(const uint256& txid, bool& fValid, int& block, unsigned int& type, uint64_t& nValue);
     bool getValidMPTX(const uint256& txid, int* block = nullptr, unsigned int* type = nullptr, uint64_t* nAmended = nullptr);
 
     std::set<int> GetSeedBlocks(int startHeight, int endHeight);
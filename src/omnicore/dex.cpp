@@ -11,6 +11,7 @@
 #include <omnicore/log.h>
 #include <omnicore/rules.h>
 #include <omnicore/uint256_extensions.h>
+#include <omnicore/undo.h>
 
 #include <arith_uint256.h>
 #include <validation.h>
@@ -251,6 +252,7 @@ int DEx_offerCreate(const std::string& addressSeller, uint32_t propertyId, int64
         assert(update_tally_map(addressSeller, propertyId, amountOffered, SELLOFFER_RESERVE));
 
         CMPOffer sellOffer(block, amountOffered, propertyId, amountDesired, minAcceptFee, paymentWindow, txid);
+        RecordOfferUndo(key);
         my_offers.insert(std::make_pair(key, sellOffer));
 
         rc = 0;
@@ -283,6 +285,7 @@ int DEx_offerDestroy(const std::string& addressSeller, uint32_t propertyId)
     // delete the offer
     const std::string key = STR_SELLOFFER_ADDR_PROP_COMBO(addressSeller, propertyId);
     OfferMap::iterator it = my_offers.find(key);
+    RecordOfferUndo(key);
     my_offers.erase(it);
 
     if (msc_debug_dex) PrintToLog("%s(%s|%s)\n", __func__, addressSeller, key);
@@ -367,6 +370,7 @@ int DEx_acceptCreate(const std::string& addressBuyer, const std::string& address
         assert(update_tally_map(addressSeller, propertyId, amountReserved, ACCEPT_RESERVE));
 
         CMPAccept acceptOffer(amountReserved, block, offer.getBlockTimeLimit(), offer.getProperty(), offer.getOfferAmountOriginal(), offer.getBTCDesiredOriginal(), offer.getHash());
+        RecordAcceptUndo(keyAcceptOrder);
         my_accepts.insert(std::make_pair(keyAcceptOrder, acceptOffer));
 
         rc = 0;
@@ -431,6 +435,7 @@ int DEx_acceptDestroy(const std::string& addressBuyer, const std::string& addres
         AcceptMap::iterator it = my_accepts.find(key);
 
         if (my_accepts.end() != it) {
+            RecordAcceptUndo(key);
             my_accepts.erase(it);
         }
     }
@@ -595,6 +600,7 @@ int DEx_payment(const uint256& txid, unsigned int vout, const std::string& addre
     }
 
     // reduce the amount of units still desired by the buyer and if 0 destroy the Accept order
+    RecordAcceptUndo(STR_ACCEPT_ADDR_PROP_ADDR_COMBO(addressSeller, addressBuyer, propertyId));
     if (p_accept->reduceAcceptAmountRemaining_andIsZero(amountPurchased)) {
         const int64_t reserveSell = GetTokenBalance(addressSeller, propertyId, SELLOFFER_RESERVE);
         const int64_t reserveAccept = GetTokenBalance(addressSeller, propertyId, ACCEPT_RESERVE);
@@ -635,6 +641,7 @@ unsigned int eraseExpiredAccepts(int blockNow)
 
             DEx_acceptDestroy(addressBuyer, addressSeller, propertyId);
 
+            RecordAcceptUndo(it->first);
             my_accepts.erase(it++);
 
             ++how_many_erased;
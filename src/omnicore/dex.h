@@ -7,6 +7,7 @@
 
 #include <amount.h>
 #include <hash.h>
+#include <serialize.h>
 #include <tinyformat.h>
 #include <uint256.h>
 
@@ -86,6 +87,20 @@ public:
     {
     }
 
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(offerBlock);
+        READWRITE(offer_amount_original);
+        READWRITE(property);
+        READWRITE(BTC_desired_original);
+        READWRITE(min_fee);
+        READWRITE(blocktimelimit);
+        READWRITE(txid);
+        READWRITE(subaction);
+    }
+
     void saveOffer(std::ofstream& file, const std::string& address, CHash256& hasher) const
     {
         std::string lineOut = strprintf("%s,%d,%d,%d,%d,%d,%d,%d,%s",
@@ -142,6 +157,12 @@ public:
 
     int getAcceptBlock() const { return block; }
 
+    CMPAccept()
+      : accept_amount_original(0), accept_amount_remaining(0), blocktimelimit(0), property(0),
+        offer_amount_original(0), BTC_desired_original(0), block(0)
+    {
+    }
+
     CMPAccept(int64_t amountAccepted, int blockIn, uint8_t paymentWindow, uint32_t propertyId,
               int64_t offerAmountOriginal, int64_t amountDesired, const uint256& txid)
       : accept_amount_remaining(amountAccepted), blocktimelimit(paymentWindow),
@@ -194,6 +215,20 @@ public:
         return bRet;
     }
 
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(accept_amount_original);
+        READWRITE(accept_amount_remaining);
+        READWRITE(blocktimelimit);
+        READWRITE(property);
+        READWRITE(offer_amount_original);
+        READWRITE(BTC_desired_original);
+        READWRITE(offer_txid);
+        READWRITE(block);
+    }
+
     void saveAccept(std::ofstream& file, const std::string& address, const std::string& buyer, CHash256& hasher) const
     {
         std::string lineOut = strprintf("%s,%d,%s,%d,%d,%d,%d,%d,%d,%s",
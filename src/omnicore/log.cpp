@@ -7,10 +7,16 @@
 #include <util/time.h>
 
 #include <assert.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <algorithm>
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <mutex>
 #include <string>
+#include <thread>
+#include <utility>
 #include <vector>
 
 // Default log files
@@ -19,6 +25,8 @@ const std::string LOG_FILENAME    = "omnicore.log";
 // Options
 static const long LOG_BUFFERSIZE  =  8000000; //  8 MB
 static const long LOG_SHRINKSIZE  = 50000000; // 50 MB
+static const int64_t DEFAULT_LOG_FLUSH_INTERVAL = 1000; // milliseconds
+static const int64_t DEFAULT_LOG_BUFFER_SIZE    = 4096; // kilobytes
 
 // Debug flags
 bool msc_debug_parser_data        = 0;
@@ -133,6 +141,194 @@ static std::string GetTimestamp()
     return FormatISO8601DateTime(GetTime());
 }
 
+/**
+ * Writes a message to the log file, with the debug log mutex held.
+ */
+static int WriteToLogFile(const std::string& str)
+{
+    // Reopen the log file, if requested
+    if (fReopenOmniCoreLog) {
+        fReopenOmniCoreLog = false;
+        fs::path pathDebug = GetLogPath();
+        if (freopen(pathDebug.string().c_str(), "a", fileout) != nullptr) {
+            setbuf(fileout, nullptr); // Unbuffered
+        }
+    }
+
+    return fwrite(str.data(), 1, str.size(), fileout);
+}
+
+/** Modes to write pending log messages to the log file. */
+enum LogFlushMode
+{
+    //! Write every message immediately
+    LOG_FLUSH_ALWAYS,
+    //! Write pending messages periodically
+    LOG_FLUSH_INTERVAL,
+    //! Write pending messages only when the buffer runs full, or on shutdown
+    LOG_FLUSH_SHUTDOWN
+};
+
+/**
+ * Collects log messages and writes them in batches on a background thread.
+ *
+ * Logging threads only append the messages to a pending buffer, which is swapped
+ * with an empty one and written by the writer thread. When the buffer is full,
+ * logging threads either wait for the writer, or the messages are dropped and
+ * the number of dropped messages is logged later.
+ */
+class CLogWriter
+{
+private:
+    std::mutex mutex;
+    //! Signals the writer that there is work to do
+    std::condition_variable condWork;
+    //! Signals logging threads that messages were written
+    std::condition_variable condWritten;
+    std::string strPending;
+    //! Total number of bytes added, and written
+    uint64_t nAdded;
+    uint64_t nWritten;
+    uint64_t nDropped;
+    bool fFlushRequested;
+    bool fRunning;
+    //! Whether the last added message ended a line, so the next one gets a timestamp
+    bool fStartedNewLine;
+    LogFlushMode mode;
+    std::chrono::milliseconds interval;
+    size_t nMaxPending;
+    bool fDropOnOverflow;
+    std::thread thread;
+
+    bool HasWork() const
+    {
+        return !fRunning || fFlushRequested || strPending.size() >= nMaxPending / 2;
+    }
+
+    void ThreadWrite()
+    {
+        RenameThread("omnicore-log");
+
+        std::string strWriting;
+        std::unique_lock<std::mutex> lock(mutex);
+
+        while (true) {
+            if (mode == LOG_FLUSH_INTERVAL) {
+                condWork.wait_for(lock, interval, [this] { return HasWork(); });
+            } else {
+                condWork.wait(lock, [this] { return HasWork(); });
+            }
+
+            bool fStop = !fRunning;
+            uint64_t nBatchEnd = nAdded;
+            std::swap(strWriting, strPending);
+            if (nDropped > 0) {
+                strWriting += strprintf("%s %d log messages were dropped\n", GetTimestamp(), nDropped);
+                nDropped = 0;
+            }
+            fFlushRequested = false;
+            lock.unlock();
+
+            if (!strWriting.empty()) {
+                std::lock_guard<std::mutex> lockFile(*mutexDebugLog);
+                WriteToLogFile(strWriting);
+                fflush(fileout);
+                strWriting.clear();
+            }
+
+            lock.lock();
+            nWritten = nBatchEnd;
+            condWritten.notify_all();
+
+            if (fStop && strPending.empty()) break;
+        }
+    }
+
+public:
+    CLogWriter() : nAdded(0), nWritten(0), nDropped(0), fFlushRequested(false), fRunning(false), fStartedNewLine(true),
+        mode(LOG_FLUSH_INTERVAL), interval(DEFAULT_LOG_FLUSH_INTERVAL), nMaxPending(0), fDropOnOverflow(false) {}
+
+    void Start(LogFlushMode modeIn, int64_t nIntervalMs, size_t nMaxPendingIn, bool fDropOnOverflowIn)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (fRunning) return;
+
+        mode = modeIn;
+        interval = std::chrono::milliseconds(nIntervalMs);
+        nMaxPending = nMaxPendingIn;
+        fDropOnOverflow = fDropOnOverflowIn;
+        strPending.reserve(nMaxPending);
+        fRunning = true;
+        thread = std::thread(&CLogWriter::ThreadWrite, this);
+    }
+
+    /** Writes all pending messages, and stops the writer thread. */
+    void Stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!fRunning) return;
+            fRunning = false;
+        }
+        condWork.notify_all();
+        thread.join();
+    }
+
+    /** Waits until all messages added so far are written. */
+    void Flush()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (!fRunning) return;
+
+        uint64_t nTarget = nAdded;
+        fFlushRequested = true;
+        condWork.notify_all();
+        condWritten.wait(lock, [this, nTarget] { return nWritten >= nTarget || !fRunning; });
+    }
+
+    /**
+     * Adds a message, which is prepended with a timestamp, if enabled and the message
+     * starts a new line.
+     *
+     * @return The number of added characters, or -1, if the writer isn't running
+     */
+    int Add(const std::string& str, bool fTimestamps)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (!fRunning) return -1;
+
+        std::string strTimestamp;
+        if (fTimestamps && fStartedNewLine) {
+            strTimestamp = GetTimestamp() + " ";
+        }
+        fStartedNewLine = (!str.empty() && str[str.size()-1] == '\n');
+
+        const size_t nSize = strTimestamp.size() + str.size();
+        if (strPending.size() + nSize > nMaxPending && !strPending.empty()) {
+            if (fDropOnOverflow) {
+                ++nDropped;
+                return 0;
+            }
+            condWork.notify_all();
+            condWritten.wait(lock, [this, nSize] { return strPending.size() + nSize <= nMaxPending || strPending.empty() || !fRunning; });
+            if (!fRunning) return -1;
+        }
+
+        strPending += strTimestamp;
+        strPending += str;
+        nAdded += nSize;
+
+        if (strPending.size() >= nMaxPending / 2) {
+            condWork.notify_all();
+        }
+
+        return nSize;
+    }
+};
+
+//! The background writer, which is never destroyed, see above
+static std::atomic<CLogWriter*> pLogWriter(nullptr);
+
 /**
  * Prints to log file.
  *
@@ -153,33 +349,29 @@ int LogFilePrint(const std::string& str)
         ret = ConsolePrint(str);
     }
     else if (LogInstance().m_print_to_file) {
-        static bool fStartedNewLine = true;
         std::call_once(debugLogInitFlag, &DebugLogInit);
 
         if (fileout == nullptr) {
             return ret;
         }
-        std::lock_guard<std::mutex> lock(*mutexDebugLog);
 
-        // Reopen the log file, if requested
-        if (fReopenOmniCoreLog) {
-            fReopenOmniCoreLog = false;
-            fs::path pathDebug = GetLogPath();
-            if (freopen(pathDebug.string().c_str(), "a", fileout) != nullptr) {
-                setbuf(fileout, nullptr); // Unbuffered
-            }
+        CLogWriter* pWriter = pLogWriter;
+        if (pWriter) {
+            ret = pWriter->Add(str, LogInstance().m_log_timestamps);
+            if (ret >= 0) return ret;
+            ret = 0;
         }
 
+        // without the writer, messages are written directly, and lines are tracked with the file mutex held
+        static bool fStartedNewLine = true;
+        std::lock_guard<std::mutex> lock(*mutexDebugLog);
+
         // Printing log timestamps can be useful for profiling
         if (LogInstance().m_log_timestamps && fStartedNewLine) {
-            ret += fprintf(fileout, "%s ", GetTimestamp().c_str());
+            ret += WriteToLogFile(GetTimestamp() + " ");
         }
-        if (!str.empty() && str[str.size()-1] == '\n') {
-            fStartedNewLine = true;
-        } else {
-            fStartedNewLine = false;
-        }
-        ret += fwrite(str.data(), 1, str.size(), fileout);
+        fStartedNewLine = (!str.empty() && str[str.size()-1] == '\n');
+        ret += WriteToLogFile(str);
     }
 
     return ret;
@@ -304,6 +496,63 @@ void InitDebugLogLevels()
     }
 }
 
+/**
+ * Starts to write the log file on a background thread.
+ *
+ * The configuration option "-omnilogflush" selects, whether messages are written
+ * immediately ("always"), every "-omnilogflushinterval" milliseconds ("interval"),
+ * or only when the buffer of "-omnilogbuffer" kilobytes runs full ("shutdown").
+ * Pending messages are always written on shutdown, and when the node is aborted.
+ *
+ * If the buffer is full, logging waits for the writer, unless "-omnilogoverflow"
+ * is set to "drop".
+ */
+void StartLogWriter()
+{
+    std::string strMode = gArgs.GetArg("-omnilogflush", "interval");
+    LogFlushMode mode = LOG_FLUSH_INTERVAL;
+    if (strMode == "always") {
+        mode = LOG_FLUSH_ALWAYS;
+    } else if (strMode == "shutdown") {
+        mode = LOG_FLUSH_SHUTDOWN;
+    } else if (strMode != "interval") {
+        PrintToLog("Unknown log flush mode \"%s\", using \"interval\"\n", strMode);
+    }
+    if (mode == LOG_FLUSH_ALWAYS) {
+        return;
+    }
+
+    int64_t nIntervalMs = std::max<int64_t>(gArgs.GetArg("-omnilogflushinterval", DEFAULT_LOG_FLUSH_INTERVAL), 1);
+    int64_t nBufferSize = std::max<int64_t>(gArgs.GetArg("-omnilogbuffer", DEFAULT_LOG_BUFFER_SIZE), 1) * 1024;
+    bool fDropOnOverflow = (gArgs.GetArg("-omnilogoverflow", "block") == "drop");
+
+    static std::once_flag logWriterInitFlag;
+    std::call_once(logWriterInitFlag, [] { pLogWriter = new CLogWriter(); });
+
+    CLogWriter* pWriter = pLogWriter;
+    pWriter->Start(mode, nIntervalMs, nBufferSize, fDropOnOverflow);
+}
+
+/**
+ * Writes all pending messages to the log file.
+ */
+void FlushLog()
+{
+    CLogWriter* pWriter = pLogWriter;
+    if (pWriter) pWriter->Flush();
+}
+
+/**
+ * Writes all pending messages, and stops the background writer.
+ *
+ * Messages logged afterwards are written immediately.
+ */
+void StopLogWriter()
+{
+    CLogWriter* pWriter = pLogWriter;
+    if (pWriter) pWriter->Stop();
+}
+
 /**
  * Scrolls debug log, if it's getting too big.
  */
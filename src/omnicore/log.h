@@ -18,6 +18,15 @@ void InitDebugLogLevels();
 /** Scrolls log file, if it's getting too big. */
 void ShrinkDebugLog();
 
+/** Starts to write the log file on a background thread. */
+void StartLogWriter();
+
+/** Writes all pending messages to the log file. */
+void FlushLog();
+
+/** Writes all pending messages, and stops the background writer. */
+void StopLogWriter();
+
 // Debug flags
 extern bool msc_debug_parser_data;
 extern bool msc_debug_parser_readonly;
@@ -7,6 +7,7 @@
 #include <omnicore/rules.h>
 #include <omnicore/sp.h>
 #include <omnicore/uint256_extensions.h>
+#include <omnicore/undo.h>
 
 #include <arith_uint256.h>
 #include <chain.h>
@@ -40,9 +41,9 @@ using namespace mastercore;
 //! Global map for price and order data
 md_PropertiesMap mastercore::metadex;
 
-md_PricesMap* mastercore::get_Prices(uint32_t prop)
+md_PricesMap* mastercore::get_Prices(uint32_t propertyForSale, uint32_t propertyDesired)
 {
-    md_PropertiesMap::iterator it = metadex.find(prop);
+    md_PropertiesMap::iterator it = metadex.find(md_PropertyPair(propertyForSale, propertyDesired));
 
     if (it != metadex.end()) return &(it->second);
 
@@ -58,6 +59,16 @@ md_Set* mastercore::get_Indexes(md_PricesMap* p, rational_t price)
     return static_cast<md_Set*>(nullptr);
 }
 
+/**
+ * Checks, whether there is a map of prices for any pair with the given property for sale.
+ */
+static bool HasPricesForProperty(uint32_t propertyForSale)
+{
+    md_PropertiesMap::const_iterator it = metadex.lower_bound(md_PropertyPair(propertyForSale, 0));
+
+    return (it != metadex.end() && it->first.first == propertyForSale);
+}
+
 enum MatchReturnType
 {
     NOTHING = 0,
@@ -137,10 +148,14 @@ static MatchReturnType x_Trade(CMPMetaDEx* const pnew)
     MatchReturnType NewReturn = NOTHING;
     bool bBuyerSatisfied = false;
 
+    // the amounts of the new order are fixed, so its price is only calculated once
+    const rational_t buyersPrice = pnew->inversePrice();
+
     if (msc_debug_metadex1) PrintToLog("%s(%s: prop=%d, desprop=%d, desprice= %s);newo: %s\n",
-        __FUNCTION__, pnew->getAddr(), propertyForSale, propertyDesired, xToString(pnew->inversePrice()), pnew->ToString());
+        __FUNCTION__, pnew->getAddr(), propertyForSale, propertyDesired, xToString(buyersPrice), pnew->ToString());
 
-    md_PricesMap* const ppriceMap = get_Prices(propertyDesired);
+    // only orders selling the desired property for the property offered can match
+    md_PricesMap* const ppriceMap = get_Prices(propertyDesired, propertyForSale);
 
     // nothing for the desired property exists in the market, sorry!
     if (!ppriceMap) {
@@ -148,35 +163,29 @@ static MatchReturnType x_Trade(CMPMetaDEx* const pnew)
         return NewReturn;
     }
 
-    // within the desired property map (given one property) iterate over the items looking at prices
+    // within the map of the property pair iterate over the price levels, starting with the best price
     for (md_PricesMap::iterator priceIt = ppriceMap->begin(); priceIt != ppriceMap->end(); ++priceIt) { // check all prices
-        const rational_t sellersPrice = priceIt->first;
+        const rational_t& sellersPrice = priceIt->first;
 
         if (msc_debug_metadex2) PrintToLog("comparing prices: desprice %s needs to be GREATER THAN OR EQUAL TO %s\n",
-            xToString(pnew->inversePrice()), xToString(sellersPrice));
+            xToString(buyersPrice), xToString(sellersPrice));
 
         // Is the desired price check satisfied? The buyer's inverse price must be larger than that of the seller.
-        if (pnew->inversePrice() < sellersPrice) {
-            continue;
+        // Prices are sorted in ascending order, so none of the following price levels can match either.
+        if (buyersPrice < sellersPrice) {
+            break;
         }
 
         md_Set* const pofferSet = &(priceIt->second);
 
-        // at good (single) price level and property iterate over offers looking at all parameters to find the match
+        // at good (single) price level iterate over offers, oldest first, to find the match
         md_Set::iterator offerIt = pofferSet->begin();
-        while (offerIt != pofferSet->end()) { // specific price, check all properties
+        while (offerIt != pofferSet->end()) { // specific price, check all offers
             const CMPMetaDEx* const pold = &(*offerIt);
-            assert(pold->unitPrice() == sellersPrice);
 
             if (msc_debug_metadex1) PrintToLog("Looking at existing: %s (its prop= %d, its des prop= %d) = %s\n",
                 xToString(sellersPrice), pold->getProperty(), pold->getDesProperty(), pold->ToString());
 
-            // does the desired property match?
-            if (pold->getDesProperty() != propertyForSale) {
-                ++offerIt;
-                continue;
-            }
-
             if (msc_debug_metadex1) PrintToLog("MATCH FOUND, Trade: %s = %s\n", xToString(sellersPrice), pold->ToString());
 
             // match found, execute trade now!
@@ -196,7 +205,8 @@ static MatchReturnType x_Trade(CMPMetaDEx* const pnew)
             assert(pnew->getProperty() != pnew->getDesProperty());
             assert(pnew->getProperty() == pold->getDesProperty());
             assert(pold->getProperty() == pnew->getDesProperty());
-            assert(pold->unitPrice() <= pnew->inversePrice());
+            assert(pold->unitPrice() == sellersPrice);
+            assert(sellersPrice <= buyersPrice);
             assert(pnew->unitPrice() <= pold->inversePrice());
 
             ///////////////////////////
@@ -232,7 +242,7 @@ static MatchReturnType x_Trade(CMPMetaDEx* const pnew)
             // orders shall not execute, and no representable fill is made
             const rational_t xEffectivePrice(nWouldPay, nCouldBuy);
 
-            if (xEffectivePrice > pnew->inversePrice()) {
+            if (xEffectivePrice > buyersPrice) {
                 if (msc_debug_metadex1) PrintToLog(
                         "-- effective price is too expensive: %s\n", xToString(xEffectivePrice));
                 ++offerIt;
@@ -250,8 +260,8 @@ static MatchReturnType x_Trade(CMPMetaDEx* const pnew)
             ///////////////////////////
 
             // postconditions
-            assert(xEffectivePrice >= pold->unitPrice());
-            assert(xEffectivePrice <= pnew->inversePrice());
+            assert(xEffectivePrice >= sellersPrice);
+            assert(xEffectivePrice <= buyersPrice);
             assert(0 <= seller_amountLeft);
             assert(0 <= buyer_amountLeft);
             assert(seller_amountForSale == seller_amountLeft + buyer_amountGot);
@@ -309,23 +319,25 @@ static MatchReturnType x_Trade(CMPMetaDEx* const pnew)
 
             // record the trade in MPTradeList
             pDbTradeList->recordMatchedTrade(pold->getHash(), pnew->getHash(), // < might just pass pold, pnew
-                pold->getAddr(), pnew->getAddr(), pold->getDesProperty(), pnew->getDesProperty(), seller_amountGot, buyer_amountGotAfterFee, pnew->getBlock(), tradingFee);
+                pold->getAddr(), pnew->getAddr(), pold->getDesProperty(), pnew->getDesProperty(), seller_amountGot, buyer_amountGotAfterFee, pnew->getBlock(), pnew->getIdx(), tradingFee);
 
             if (msc_debug_metadex1) PrintToLog("++ erased old: %s\n", offerIt->ToString());
             // erase the old seller element
+            RecordMetaDExUndo(*offerIt, false);
             pofferSet->erase(offerIt++);
 
             // insert the updated one in place of the old
             if (0 < seller_replacement.getAmountRemaining()) {
                 PrintToLog("++ inserting seller_replacement: %s\n", seller_replacement.ToString());
                 pofferSet->insert(seller_replacement);
+                RecordMetaDExUndo(seller_replacement, true);
             }
 
             if (bBuyerSatisfied) {
                 assert(buyer_amountLeft == 0);
                 break;
             }
-        } // specific price, check all properties
+        } // specific price, check all offers
 
         if (bBuyerSatisfied) break;
     } // check all prices
@@ -454,35 +466,15 @@ bool MetaDEx_compare::operator()(const CMPMetaDEx &lhs, const CMPMetaDEx &rhs) c
 
 bool mastercore::MetaDEx_INSERT(const CMPMetaDEx& objMetaDEx)
 {
-    // Create an empty price map (to use in case price map for this property does not already exist)
-    md_PricesMap temp_prices;
-    // Attempt to obtain the price map for the property
-    md_PricesMap *p_prices = get_Prices(objMetaDEx.getProperty());
-
-    // Create an empty set of metadex objects (to use in case no set currently exists at this price)
-    md_Set temp_indexes;
-    md_Set *p_indexes = nullptr;
-
-    // Prepare for return code
-    std::pair <md_Set::iterator, bool> ret;
-
-    // Attempt to obtain a set of metadex objects for this price from the price map
-    if (p_prices) p_indexes = get_Indexes(p_prices, objMetaDEx.unitPrice());
-    // See if the set was populated, if not no set exists at this price level, use the empty set that we created earlier
-    if (!p_indexes) p_indexes = &temp_indexes;
+    // Obtain the set of metadex objects of the property pair at this price, the maps are created, if they don't exist
+    md_PricesMap& prices = metadex[md_PropertyPair(objMetaDEx.getProperty(), objMetaDEx.getDesProperty())];
+    md_Set& indexes = prices[objMetaDEx.unitPrice()];
 
     // Attempt to insert the metadex object into the set
-    ret = p_indexes->insert(objMetaDEx);
+    std::pair<md_Set::iterator, bool> ret = indexes.insert(objMetaDEx);
     if (false == ret.second) return false;
 
-    // If a prices map did not exist for this property, set p_prices to the temp empty price map
-    if (!p_prices) p_prices = &temp_prices;
-
-    // Update the prices map with the new set at this price
-    (*p_prices)[objMetaDEx.unitPrice()] = *p_indexes;
-
-    // Set the metadex map for the property to the updated (or new if it didn't exist) price map
-    metadex[objMetaDEx.getProperty()] = *p_prices;
+    RecordMetaDExUndo(objMetaDEx, true);
 
     return true;
 }
@@ -527,7 +519,7 @@ int mastercore::MetaDEx_CANCEL_AT_PRICE(const uint256& txid, unsigned int block,
 {
     int rc = METADEX_ERROR -20;
     CMPMetaDEx mdex(sender_addr, 0, prop, amount, property_desired, amount_desired, uint256(), 0, CMPTransaction::CANCEL_AT_PRICE);
-    md_PricesMap* prices = get_Prices(prop);
+    md_PricesMap* prices = get_Prices(prop, property_desired);
     const CMPMetaDEx* p_mdex = nullptr;
 
     if (msc_debug_metadex1) PrintToLog("%s():%s\n", __FUNCTION__, mdex.ToString());
@@ -536,23 +528,19 @@ int mastercore::MetaDEx_CANCEL_AT_PRICE(const uint256& txid, unsigned int block,
 
     if (!prices) {
         PrintToLog("%s() NOTHING FOUND for %s\n", __FUNCTION__, mdex.ToString());
-        return rc -1;
+        return HasPricesForProperty(prop) ? rc : rc -1;
     }
 
-    // within the desired property map (given one property) iterate over the items
-    for (md_PricesMap::iterator my_it = prices->begin(); my_it != prices->end(); ++my_it) {
-        rational_t sellers_price = my_it->first;
-
-        if (mdex.unitPrice() != sellers_price) continue;
-
-        md_Set* indexes = &(my_it->second);
+    // within the map of the property pair only the orders at the given price are affected
+    md_Set* indexes = get_Indexes(prices, mdex.unitPrice());
 
+    if (indexes) {
         for (md_Set::iterator iitt = indexes->begin(); iitt != indexes->end();) {
             p_mdex = &(*iitt);
 
             if (msc_debug_metadex3) PrintToLog("%s(): %s\n", __FUNCTION__, p_mdex->ToString());
 
-            if ((p_mdex->getDesProperty() != property_desired) || (p_mdex->getAddr() != sender_addr)) {
+            if (p_mdex->getAddr() != sender_addr) {
                 ++iitt;
                 continue;
             }
@@ -568,6 +556,7 @@ int mastercore::MetaDEx_CANCEL_AT_PRICE(const uint256& txid, unsigned int block,
             bool bValid = true;
             pDbTransactionList->recordMetaDExCancelTX(txid, p_mdex->getHash(), bValid, block, p_mdex->getProperty(), p_mdex->getAmountRemaining());
 
+            RecordMetaDExUndo(*iitt, false);
             indexes->erase(iitt++);
         }
     }
@@ -580,7 +569,7 @@ int mastercore::MetaDEx_CANCEL_AT_PRICE(const uint256& txid, unsigned int block,
 int mastercore::MetaDEx_CANCEL_ALL_FOR_PAIR(const uint256& txid, unsigned int block, const std::string& sender_addr, uint32_t prop, uint32_t property_desired)
 {
     int rc = METADEX_ERROR -30;
-    md_PricesMap* prices = get_Prices(prop);
+    md_PricesMap* prices = get_Prices(prop, property_desired);
     const CMPMetaDEx* p_mdex = nullptr;
 
     PrintToLog("%s(%d,%d)\n", __FUNCTION__, prop, property_desired);
@@ -589,10 +578,10 @@ int mastercore::MetaDEx_CANCEL_ALL_FOR_PAIR(const uint256& txid, unsigned int bl
 
     if (!prices) {
         PrintToLog("%s() NOTHING FOUND\n", __FUNCTION__);
-        return rc -1;
+        return HasPricesForProperty(prop) ? rc : rc -1;
     }
 
-    // within the desired property map (given one property) iterate over the items
+    // within the map of the property pair iterate over the items
     for (md_PricesMap::iterator my_it = prices->begin(); my_it != prices->end(); ++my_it) {
         md_Set* indexes = &(my_it->second);
 
@@ -601,7 +590,7 @@ int mastercore::MetaDEx_CANCEL_ALL_FOR_PAIR(const uint256& txid, unsigned int bl
 
             if (msc_debug_metadex3) PrintToLog("%s(): %s\n", __FUNCTION__, p_mdex->ToString());
 
-            if ((p_mdex->getDesProperty() != property_desired) || (p_mdex->getAddr() != sender_addr)) {
+            if (p_mdex->getAddr() != sender_addr) {
                 ++iitt;
                 continue;
             }
@@ -617,6 +606,7 @@ int mastercore::MetaDEx_CANCEL_ALL_FOR_PAIR(const uint256& txid, unsigned int bl
             bool bValid = true;
             pDbTransactionList->recordMetaDExCancelTX(txid, p_mdex->getHash(), bValid, block, p_mdex->getProperty(), p_mdex->getAmountRemaining());
 
+            RecordMetaDExUndo(*iitt, false);
             indexes->erase(iitt++);
         }
     }
@@ -639,42 +629,51 @@ int mastercore::MetaDEx_CANCEL_EVERYTHING(const uint256& txid, unsigned int bloc
 
     PrintToLog("<<<<<<\n");
 
-    for (md_PropertiesMap::iterator my_it = metadex.begin(); my_it != metadex.end(); ++my_it) {
-        unsigned int prop = my_it->first;
+    md_PropertiesMap::iterator my_it = metadex.begin();
+    while (my_it != metadex.end()) {
+        const uint32_t prop = my_it->first.first;
+
+        // the orders of all pairs of a property are collected first, and then cancelled sorted by
+        // price and position in the blockchain, so the cancellations are recorded in a stable order
+        md_PricesMap cancelled;
+        for (; my_it != metadex.end() && my_it->first.first == prop; ++my_it) {
+            const md_PricesMap& prices = my_it->second;
+            for (md_PricesMap::const_iterator it = prices.begin(); it != prices.end(); ++it) {
+                const md_Set& indexes = it->second;
+                for (md_Set::const_iterator iitt = indexes.begin(); iitt != indexes.end(); ++iitt) {
+                    if (iitt->getAddr() == sender_addr) cancelled[it->first].insert(*iitt);
+                }
+            }
+        }
 
         // skip property, if it is not in the expected ecosystem
         if (isMainEcosystemProperty(ecosystem) && !isMainEcosystemProperty(prop)) continue;
         if (isTestEcosystemProperty(ecosystem) && !isTestEcosystemProperty(prop)) continue;
 
         PrintToLog(" ## property: %u\n", prop);
-        md_PricesMap& prices = my_it->second;
 
-        for (md_PricesMap::iterator it = prices.begin(); it != prices.end(); ++it) {
-            rational_t price = it->first;
-            md_Set& indexes = it->second;
+        for (md_PricesMap::const_iterator it = cancelled.begin(); it != cancelled.end(); ++it) {
+            const rational_t& price = it->first;
+            const md_Set& indexes = it->second;
 
             PrintToLog("  # Price Level: %s\n", xToString(price));
 
-            for (md_Set::iterator it = indexes.begin(); it != indexes.end();) {
-                PrintToLog("%s= %s\n", xToString(price), it->ToString());
-
-                if (it->getAddr() != sender_addr) {
-                    ++it;
-                    continue;
-                }
+            for (md_Set::const_iterator iitt = indexes.begin(); iitt != indexes.end(); ++iitt) {
+                const CMPMetaDEx& obj = *iitt;
 
                 rc = 0;
-                PrintToLog("%s(): REMOVING %s\n", __FUNCTION__, it->ToString());
+                PrintToLog("%s(): REMOVING %s\n", __FUNCTION__, obj.ToString());
 
                 // move from reserve to balance
-                assert(update_tally_map(it->getAddr(), it->getProperty(), -it->getAmountRemaining(), METADEX_RESERVE));
-                assert(update_tally_map(it->getAddr(), it->getProperty(), it->getAmountRemaining(), BALANCE));
+                assert(update_tally_map(obj.getAddr(), obj.getProperty(), -obj.getAmountRemaining(), METADEX_RESERVE));
+                assert(update_tally_map(obj.getAddr(), obj.getProperty(), obj.getAmountRemaining(), BALANCE));
 
                 // record the cancellation
                 bool bValid = true;
-                pDbTransactionList->recordMetaDExCancelTX(txid, it->getHash(), bValid, block, it->getProperty(), it->getAmountRemaining());
+                pDbTransactionList->recordMetaDExCancelTX(txid, obj.getHash(), bValid, block, obj.getProperty(), obj.getAmountRemaining());
 
-                indexes.erase(it++);
+                RecordMetaDExUndo(obj, false);
+                get_Indexes(get_Prices(obj.getProperty(), obj.getDesProperty()), price)->erase(obj);
             }
         }
     }
@@ -693,17 +692,18 @@ int mastercore::MetaDEx_SHUTDOWN_ALLPAIR()
     int rc = 0;
     PrintToLog("%s()\n", __FUNCTION__);
     for (md_PropertiesMap::iterator my_it = metadex.begin(); my_it != metadex.end(); ++my_it) {
+        const md_PropertyPair& pair = my_it->first;
+        if (pair.first <= OMNI_PROPERTY_TMSC || pair.second <= OMNI_PROPERTY_TMSC) continue; // OMN/TOMN side to the trade
         md_PricesMap& prices = my_it->second;
         for (md_PricesMap::iterator it = prices.begin(); it != prices.end(); ++it) {
             md_Set& indexes = it->second;
             for (md_Set::iterator it = indexes.begin(); it != indexes.end();) {
-                if (it->getDesProperty() > OMNI_PROPERTY_TMSC && it->getProperty() > OMNI_PROPERTY_TMSC) { // no OMN/TOMN side to the trade
-                    PrintToLog("%s(): REMOVING %s\n", __FUNCTION__, it->ToString());
-                    // move from reserve to balance
-                    assert(update_tally_map(it->getAddr(), it->getProperty(), -it->getAmountRemaining(), METADEX_RESERVE));
-                    assert(update_tally_map(it->getAddr(), it->getProperty(), it->getAmountRemaining(), BALANCE));
-                    indexes.erase(it++);
-                }
+                PrintToLog("%s(): REMOVING %s\n", __FUNCTION__, it->ToString());
+                // move from reserve to balance
+                assert(update_tally_map(it->getAddr(), it->getProperty(), -it->getAmountRemaining(), METADEX_RESERVE));
+                assert(update_tally_map(it->getAddr(), it->getProperty(), it->getAmountRemaining(), BALANCE));
+                RecordMetaDExUndo(*it, false);
+                indexes.erase(it++);
             }
         }
     }
@@ -726,6 +726,7 @@ int mastercore::MetaDEx_SHUTDOWN()
                 // move from reserve to balance
                 assert(update_tally_map(it->getAddr(), it->getProperty(), -it->getAmountRemaining(), METADEX_RESERVE));
                 assert(update_tally_map(it->getAddr(), it->getProperty(), it->getAmountRemaining(), BALANCE));
+                RecordMetaDExUndo(*it, false);
                 indexes.erase(it++);
             }
         }
@@ -737,8 +738,10 @@ int mastercore::MetaDEx_SHUTDOWN()
 // allows search to be optimized if propertyIdForSale is specified
 bool mastercore::MetaDEx_isOpen(const uint256& txid, uint32_t propertyIdForSale)
 {
-    for (md_PropertiesMap::iterator my_it = metadex.begin(); my_it != metadex.end(); ++my_it) {
-        if (propertyIdForSale != 0 && propertyIdForSale != my_it->first) continue;
+    md_PropertiesMap::iterator my_it = metadex.begin();
+    if (propertyIdForSale != 0) my_it = metadex.lower_bound(md_PropertyPair(propertyIdForSale, 0));
+    for (; my_it != metadex.end(); ++my_it) {
+        if (propertyIdForSale != 0 && propertyIdForSale != my_it->first.first) break;
         md_PricesMap & prices = my_it->second;
         for (md_PricesMap::iterator it = prices.begin(); it != prices.end(); ++it) {
             md_Set & indexes = (it->second);
@@ -807,9 +810,9 @@ void mastercore::MetaDEx_debug_print(bool bShowPriceLevel, bool bDisplay)
 {
     PrintToLog("<<<\n");
     for (md_PropertiesMap::iterator my_it = metadex.begin(); my_it != metadex.end(); ++my_it) {
-        uint32_t prop = my_it->first;
+        const md_PropertyPair& pair = my_it->first;
 
-        PrintToLog(" ## property: %u\n", prop);
+        PrintToLog(" ## property: %u, desired property: %u\n", pair.first, pair.second);
         md_PricesMap& prices = my_it->second;
 
         for (md_PricesMap::iterator it = prices.begin(); it != prices.end(); ++it) {
@@ -3,6 +3,7 @@
 
 #include <omnicore/tx.h>
 
+#include <serialize.h>
 #include <uint256.h>
 
 #include <boost/lexical_cast.hpp>
@@ -16,6 +17,7 @@
 #include <map>
 #include <set>
 #include <string>
+#include <utility>
 
 class CHash256;
 
@@ -99,6 +101,22 @@ public:
     /** Used for display of unit prices with 50 decimal places at RPC layer. */
     std::string displayFullUnitPrice() const;
 
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(block);
+        READWRITE(txid);
+        READWRITE(idx);
+        READWRITE(property);
+        READWRITE(amount_forsale);
+        READWRITE(desired_property);
+        READWRITE(amount_desired);
+        READWRITE(amount_remaining);
+        READWRITE(subaction);
+        READWRITE(addr);
+    }
+
     void saveOffer(std::ofstream& file, CHash256 &hasher) const;
 };
 
@@ -110,18 +128,19 @@ struct MetaDEx_compare
 };
 
 // ---------------
+//! Pair of properties: the property for sale and the desired property
+typedef std::pair<uint32_t, uint32_t> md_PropertyPair;
 //! Set of objects sorted by block+idx
 typedef std::set<CMPMetaDEx, MetaDEx_compare> md_Set; 
 //! Map of prices; there is a set of sorted objects for each price
 typedef std::map<rational_t, md_Set> md_PricesMap;
-//! Map of properties; there is a map of prices for each property
-typedef std::map<uint32_t, md_PricesMap> md_PropertiesMap;
+//! Map of property pairs; there is a map of prices for each pair, pairs are sorted by the property for sale first
+typedef std::map<md_PropertyPair, md_PricesMap> md_PropertiesMap;
 
 //! Global map for price and order data
 extern md_PropertiesMap metadex;
 
-// TODO: explore a property-pair, instead of a single property as map's key........
-md_PricesMap* get_Prices(uint32_t prop);
+md_PricesMap* get_Prices(uint32_t propertyForSale, uint32_t propertyDesired);
 md_Set* get_Indexes(md_PricesMap* p, rational_t price);
 // ---------------
 
@@ -1,6 +1,7 @@
 #include <omnicore/notifications.h>
 
 #include <omnicore/log.h>
+#include <omnicore/undo.h>
 #include <omnicore/utilsbitcoin.h>
 #include <omnicore/version.h>
 
@@ -31,6 +32,7 @@ void DeleteAlerts(const std::string& sender)
     for (std::vector<AlertData>::iterator it = currentOmniAlerts.begin(); it != currentOmniAlerts.end(); ) {
         AlertData alert = *it;
         if (sender == alert.alert_sender) {
+            RecordAlertUndo();
             PrintToLog("Removing deleted alert (from:%s type:%d expiry:%d message:%s)\n", alert.alert_sender,
                 alert.alert_type, alert.alert_expiry, alert.alert_message);
             it = currentOmniAlerts.erase(it);
@@ -52,6 +54,17 @@ void ClearAlerts()
     uiInterface.OmniStateChanged();
 }
 
+/**
+ * Replaces the active alerts, when blocks are reverted.
+ *
+ * A signal is fired to notify the UI about the status update.
+ */
+void RestoreAlerts(const std::vector<AlertData>& alerts)
+{
+    currentOmniAlerts = alerts;
+    uiInterface.OmniStateChanged();
+}
+
 /**
  * Adds a new alert to the alerts vector
  *
@@ -70,6 +83,7 @@ void AddAlert(const std::string& sender, uint16_t alertType, uint32_t alertExpir
         return;
     }
 
+    RecordAlertUndo();
     currentOmniAlerts.push_back(newAlert);
     PrintToLog("New alert added: %s, %d, %d, %s\n", sender, alertType, alertExpiry, alertMessage);
 }
@@ -153,6 +167,7 @@ bool CheckExpiredAlerts(unsigned int curBlock, uint64_t curTime)
                 if (curBlock >= alert.alert_expiry) {
                     PrintToLog("Expiring alert (from %s: type:%d expiry:%d message:%s)\n", alert.alert_sender,
                         alert.alert_type, alert.alert_expiry, alert.alert_message);
+                    RecordAlertUndo();
                     it = currentOmniAlerts.erase(it);
                     uiInterface.OmniStateChanged();
                 } else {
@@ -163,6 +178,7 @@ bool CheckExpiredAlerts(unsigned int curBlock, uint64_t curTime)
                 if (curTime > alert.alert_expiry) {
                     PrintToLog("Expiring alert (from %s: type:%d expiry:%d message:%s)\n", alert.alert_sender,
                         alert.alert_type, alert.alert_expiry, alert.alert_message);
+                    RecordAlertUndo();
                     it = currentOmniAlerts.erase(it);
                     uiInterface.OmniStateChanged();
                 } else {
@@ -173,6 +189,7 @@ bool CheckExpiredAlerts(unsigned int curBlock, uint64_t curTime)
                 if (OMNICORE_VERSION > alert.alert_expiry) {
                     PrintToLog("Expiring alert (form: %s type:%d expiry:%d message:%s)\n", alert.alert_sender,
                         alert.alert_type, alert.alert_expiry, alert.alert_message);
+                    RecordAlertUndo();
                     it = currentOmniAlerts.erase(it);
                     uiInterface.OmniStateChanged();
                 } else {
@@ -182,6 +199,7 @@ bool CheckExpiredAlerts(unsigned int curBlock, uint64_t curTime)
             default: // unrecognized alert type
                     PrintToLog("Removing invalid alert (from:%s type:%d expiry:%d message:%s)\n", alert.alert_sender,
                         alert.alert_type, alert.alert_expiry, alert.alert_message);
+                    RecordAlertUndo();
                     it = currentOmniAlerts.erase(it);
                     uiInterface.OmniStateChanged();
             break;
@@ -34,6 +34,8 @@ bool CheckAlertAuthorization(const std::string& sender);
 void DeleteAlerts(const std::string& sender);
 /** Removes all active alerts. */
 void ClearAlerts();
+/** Replaces the active alerts, when blocks are reverted. */
+void RestoreAlerts(const std::vector<AlertData>& alerts);
 
 /** Adds a new alert to the alerts vector. */
 void AddAlert(const std::string& sender, uint16_t alertType, uint32_t alertExpiry, const std::string& alertMessage);
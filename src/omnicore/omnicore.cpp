@@ -23,16 +23,19 @@
 #include <omnicore/parsing.h>
 #include <omnicore/pending.h>
 #include <omnicore/persistence.h>
+#include <omnicore/prevoutcache.h>
 #include <omnicore/rules.h>
 #include <omnicore/script.h>
 #include <omnicore/seedblocks.h>
 #include <omnicore/sp.h>
 #include <omnicore/tally.h>
 #include <omnicore/tx.h>
+#include <omnicore/undo.h>
 #include <omnicore/utilsbitcoin.h>
 #include <omnicore/utilsui.h>
 #include <omnicore/version.h>
 #include <omnicore/walletcache.h>
+#include <omnicore/walletfetchtxs.h>
 #include <omnicore/walletutils.h>
 
 #include <base58.h>
@@ -52,6 +55,7 @@
 #include <tinyformat.h>
 #include <uint256.h>
 #include <ui_interface.h>
+#include <undo.h>
 #include <util/system.h>
 #include <util/strencodings.h>
 #include <util/time.h>
@@ -66,10 +70,17 @@
 #include <assert.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 
+#include <algorithm>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
 #include <set>
 #include <string>
+#include <thread>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 using namespace mastercore;
@@ -138,7 +149,11 @@ std::set<std::pair<uint32_t,int> > setFreezingEnabledProperties;
 std::set<std::pair<std::string,uint32_t> > setFrozenAddresses;
 
 //! In-memory collection of all amounts for all addresses for all properties
-std::unordered_map<std::string, CMPTally> mastercore::mp_tally_map;
+CMPTallyMap mastercore::mp_tally_map;
+//! Addresses with a non-zero sum of balance and reserves, by property
+static std::unordered_map<uint32_t, std::set<std::string> > mapPropertyHolders;
+//! Running sum of balances and reserves of all addresses, by property
+static std::unordered_map<uint32_t, int64_t> mapPropertyTotals;
 
 // Only needed for GUI:
 
@@ -245,11 +260,84 @@ std::string FormatByType(int64_t amount, uint16_t propertyType)
 
 CMPTally* mastercore::getTally(const std::string& address)
 {
-    std::unordered_map<std::string, CMPTally>::iterator it = mp_tally_map.find(address);
+    return mp_tally_map.find(address);
+}
+
+/**
+ * Returns the addresses with a non-zero sum of balance and reserves of a property.
+ *
+ * The caller must hold cs_tally, while using the result.
+ */
+const std::set<std::string>& mastercore::GetPropertyHolders(uint32_t propertyId)
+{
+    static const std::set<std::string> emptyHolders;
+
+    std::unordered_map<uint32_t, std::set<std::string> >::const_iterator it = mapPropertyHolders.find(propertyId);
+    if (it != mapPropertyHolders.end()) return it->second;
+
+    return emptyHolders;
+}
+
+/**
+ * Returns the sum of balances and reserves of all addresses for a property.
+ *
+ * Pending amounts and the fee cache are not included.
+ */
+int64_t mastercore::GetPropertyTotal(uint32_t propertyId)
+{
+    LOCK(cs_tally);
+
+    std::unordered_map<uint32_t, int64_t>::const_iterator it = mapPropertyTotals.find(propertyId);
+    if (it != mapPropertyTotals.end()) return it->second;
+
+    return 0;
+}
+
+/**
+ * Clears the tally map, as well as the property holder index, running totals,
+ * balance commitment, state journal and undo log.
+ */
+void mastercore::ClearTallyMap()
+{
+    LOCK(cs_tally);
 
-    if (it != mp_tally_map.end()) return &(it->second);
+    mp_tally_map.clear();
+    mapPropertyHolders.clear();
+    mapPropertyTotals.clear();
+    ClearBalanceCommitment();
+    ResetStateJournal();
+    ClearUndoLog();
+}
 
-    return static_cast<CMPTally*>(nullptr);
+/**
+ * Updates the property holder index and running total after a tally update.
+ *
+ * Pending amounts are not tracked, as they are not part of the token supply.
+ */
+static void UpdatePropertyHolders(const std::string& address, uint32_t propertyId, const CMPTally& tally, int64_t amount, TallyType ttype)
+{
+    if (ttype == PENDING) {
+        return;
+    }
+
+    mapPropertyTotals[propertyId] += amount;
+
+    int64_t tokens = 0;
+    tokens += tally.getMoney(propertyId, BALANCE);
+    tokens += tally.getMoney(propertyId, SELLOFFER_RESERVE);
+    tokens += tally.getMoney(propertyId, ACCEPT_RESERVE);
+    tokens += tally.getMoney(propertyId, METADEX_RESERVE);
+
+    if (tokens != 0) {
+        mapPropertyHolders[propertyId].insert(address);
+        return;
+    }
+
+    std::unordered_map<uint32_t, std::set<std::string> >::iterator it = mapPropertyHolders.find(propertyId);
+    if (it != mapPropertyHolders.end()) {
+        it->second.erase(address);
+        if (it->second.empty()) mapPropertyHolders.erase(it);
+    }
 }
 
 // look at balance for an address
@@ -261,9 +349,9 @@ int64_t GetTokenBalance(const std::string& address, uint32_t propertyId, TallyTy
     }
 
     LOCK(cs_tally);
-    const std::unordered_map<std::string, CMPTally>::iterator my_it = mp_tally_map.find(address);
-    if (my_it != mp_tally_map.end()) {
-        balance = (my_it->second).getMoney(propertyId, ttype);
+    const CMPTally* tally = mp_tally_map.find(address);
+    if (tally) {
+        balance = tally->getMoney(propertyId, ttype);
     }
 
     return balance;
@@ -323,6 +411,18 @@ void mastercore::ClearFreezeState()
     setFrozenAddresses.clear();
 }
 
+void mastercore::GetFreezeState(std::set<std::pair<std::string,uint32_t> >& frozenAddresses, std::set<std::pair<uint32_t,int> >& freezingEnabledProperties)
+{
+    frozenAddresses = setFrozenAddresses;
+    freezingEnabledProperties = setFreezingEnabledProperties;
+}
+
+void mastercore::RestoreFreezeState(const std::set<std::pair<std::string,uint32_t> >& frozenAddresses, const std::set<std::pair<uint32_t,int> >& freezingEnabledProperties)
+{
+    setFrozenAddresses = frozenAddresses;
+    setFreezingEnabledProperties = freezingEnabledProperties;
+}
+
 void mastercore::PrintFreezeState()
 {
     PrintToLog("setFrozenAddresses state:\n");
@@ -337,6 +437,7 @@ void mastercore::PrintFreezeState()
 
 void mastercore::enableFreezing(uint32_t propertyId, int liveBlock)
 {
+    RecordFreezeUndo();
     setFreezingEnabledProperties.insert(std::make_pair(propertyId, liveBlock));
     assert(isFreezingEnabled(propertyId, liveBlock));
     PrintToLog("Freezing for property %d will be enabled at block %d.\n", propertyId, liveBlock);
@@ -344,6 +445,7 @@ void mastercore::enableFreezing(uint32_t propertyId, int liveBlock)
 
 void mastercore::disableFreezing(uint32_t propertyId)
 {
+    RecordFreezeUndo();
     int liveBlock = 0;
     for (std::set<std::pair<uint32_t,int> >::iterator it = setFreezingEnabledProperties.begin(); it != setFreezingEnabledProperties.end(); it++) {
         if (propertyId == (*it).first) {
@@ -383,6 +485,7 @@ bool mastercore::isFreezingEnabled(uint32_t propertyId, int block)
 
 void mastercore::freezeAddress(const std::string& address, uint32_t propertyId)
 {
+    RecordFreezeUndo();
     setFrozenAddresses.insert(std::make_pair(address, propertyId));
     assert(isAddressFrozen(address, propertyId));
     PrintToLog("Address %s has been frozen for property %d.\n", address, propertyId);
@@ -390,6 +493,7 @@ void mastercore::freezeAddress(const std::string& address, uint32_t propertyId)
 
 void mastercore::unfreezeAddress(const std::string& address, uint32_t propertyId)
 {
+    RecordFreezeUndo();
     setFrozenAddresses.erase(std::make_pair(address, propertyId));
     assert(!isAddressFrozen(address, propertyId));
     PrintToLog("Address %s has been unfrozen for property %d.\n", address, propertyId);
@@ -422,37 +526,25 @@ std::string mastercore::getTokenLabel(uint32_t propertyId)
 // optionally counts the number of addresses who own that property: n_owners_total
 int64_t mastercore::getTotalTokens(uint32_t propertyId, int64_t* n_owners_total)
 {
-    int64_t prev = 0;
     int64_t owners = 0;
     int64_t totalTokens = 0;
 
     LOCK(cs_tally);
 
-    CMPSPInfo::Entry property;
-    if (false == pDbSpInfo->getSP(propertyId, property)) {
+    CMPSPInfo::HotFields property;
+    if (false == pDbSpInfo->getSPHotFields(propertyId, property)) {
         return 0; // property ID does not exist
     }
 
     if (!property.fixed || n_owners_total) {
-        for (std::unordered_map<std::string, CMPTally>::const_iterator it = mp_tally_map.begin(); it != mp_tally_map.end(); ++it) {
-            const CMPTally& tally = it->second;
-
-            totalTokens += tally.getMoney(propertyId, BALANCE);
-            totalTokens += tally.getMoney(propertyId, SELLOFFER_RESERVE);
-            totalTokens += tally.getMoney(propertyId, ACCEPT_RESERVE);
-            totalTokens += tally.getMoney(propertyId, METADEX_RESERVE);
-
-            if (prev != totalTokens) {
-                prev = totalTokens;
-                owners++;
-            }
-        }
+        totalTokens = GetPropertyTotal(propertyId);
+        owners = GetPropertyHolders(propertyId).size();
         int64_t cachedFee = pDbFeeCache->GetCachedAmount(propertyId);
         totalTokens += cachedFee;
     }
 
     if (property.fixed) {
-        totalTokens = property.num_tokens; // only valid for TX50
+        totalTokens = property.entry->num_tokens; // only valid for TX50
     }
 
     if (n_owners_total) *n_owners_total = owners;
@@ -460,6 +552,49 @@ int64_t mastercore::getTotalTokens(uint32_t propertyId, int64_t* n_owners_total)
     return totalTokens;
 }
 
+/**
+ * Applies an update to the tally map, and maintains the property holder index,
+ * running totals, balance commitment, state journal and the set of changed addresses.
+ *
+ * Updates of the consensus state are recorded in the undo log of the current
+ * block, unless a previously recorded update is reverted.
+ */
+static bool ApplyTallyUpdate(const std::string& who, uint32_t propertyId, int64_t amount, TallyType ttype, bool fRevert)
+{
+    bool bRet = false;
+    int64_t before = 0;
+    int64_t after = 0;
+
+    // the address is only looked up once, an empty element is inserted, if it is unknown
+    const uint32_t addressId = mp_tally_map.intern(who);
+    CMPTally& tally = mp_tally_map.getTally(addressId);
+
+    before = tally.getMoney(propertyId, ttype);
+    // pending amounts are not part of the consensus state
+    const std::string strBalanceBefore = (ttype != PENDING) ? GenerateConsensusString(tally, who, propertyId) : "";
+    bRet = tally.updateMoney(propertyId, amount, ttype);
+    if (bRet) {
+        mp_tally_map.markChanged(addressId);
+        UpdatePropertyHolders(who, propertyId, tally, amount, ttype);
+        if (ttype != PENDING) {
+            UpdateBalanceCommitment(strBalanceBefore, GenerateConsensusString(tally, who, propertyId));
+            RecordBalanceChange(who, propertyId);
+            if (!fRevert) RecordTallyUndo(who, propertyId, amount, ttype);
+        }
+    }
+
+    after = mp_tally_map.getTally(addressId).getMoney(propertyId, ttype);
+    if (!bRet) {
+        assert(before == after);
+        PrintToLog("%s(%s, %u=0x%X, %+d, ttype=%d) ERROR: insufficient balance (=%d)\n", __func__, who, propertyId, propertyId, amount, ttype, before);
+    }
+    if (msc_debug_tally && (exodus_address != who || msc_debug_exo)) {
+        PrintToLog("%s(%s, %u=0x%X, %+d, ttype=%d): before=%d, after=%d\n", __func__, who, propertyId, propertyId, amount, ttype, before, after);
+    }
+
+    return bRet;
+}
+
 // return true if everything is ok
 bool mastercore::update_tally_map(const std::string& who, uint32_t propertyId, int64_t amount, TallyType ttype)
 {
@@ -472,37 +607,26 @@ bool mastercore::update_tally_map(const std::string& who, uint32_t propertyId, i
         return false;
     }
 
-    bool bRet = false;
-    int64_t before = 0;
-    int64_t after = 0;
-
     LOCK(cs_tally);
 
     if (ttype == BALANCE && amount < 0) {
         assert(!isAddressFrozen(who, propertyId)); // for safety, this should never fail if everything else is working properly.
     }
 
-    before = GetTokenBalance(who, propertyId, ttype);
-
-    std::unordered_map<std::string, CMPTally>::iterator my_it = mp_tally_map.find(who);
-    if (my_it == mp_tally_map.end()) {
-        // insert an empty element
-        my_it = (mp_tally_map.insert(std::make_pair(who, CMPTally()))).first;
-    }
-
-    CMPTally& tally = my_it->second;
-    bRet = tally.updateMoney(propertyId, amount, ttype);
+    return ApplyTallyUpdate(who, propertyId, amount, ttype, false);
+}
 
-    after = GetTokenBalance(who, propertyId, ttype);
-    if (!bRet) {
-        assert(before == after);
-        PrintToLog("%s(%s, %u=0x%X, %+d, ttype=%d) ERROR: insufficient balance (=%d)\n", __func__, who, propertyId, propertyId, amount, ttype, before);
-    }
-    if (msc_debug_tally && (exodus_address != who || msc_debug_exo)) {
-        PrintToLog("%s(%s, %u=0x%X, %+d, ttype=%d): before=%d, after=%d\n", __func__, who, propertyId, propertyId, amount, ttype, before, after);
-    }
+/**
+ * Reverts a previously recorded update of the tally map, when a block is disconnected.
+ *
+ * Frozen addresses are not restricted, because the freeze state is reverted separately,
+ * and crediting a frozen address is valid.
+ */
+bool mastercore::revert_tally_map(const std::string& who, uint32_t propertyId, int64_t amount, TallyType ttype)
+{
+    LOCK(cs_tally);
 
-    return bRet;
+    return ApplyTallyUpdate(who, propertyId, -amount, ttype, true);
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -618,15 +742,19 @@ void CheckWalletUpdate(bool forceUpdate)
     global_balance_reserved.clear();
 
     // populate global balance totals and wallet property list - note global balances do not include additional balances from watch-only addresses
-    for (std::unordered_map<std::string, CMPTally>::iterator my_it = mp_tally_map.begin(); my_it != mp_tally_map.end(); ++my_it) {
+    // only the addresses of the wallet balance cache are considered, which includes all wallet addresses with tallies
+    const std::vector<std::string> vWalletAddresses = GetWalletCacheAddresses();
+    for (std::vector<std::string>::const_iterator it = vWalletAddresses.begin(); it != vWalletAddresses.end(); ++it) {
         // check if the address is a wallet address (including watched addresses)
-        std::string address = my_it->first;
+        const std::string& address = *it;
         int addressIsMine = IsMyAddressAllWallets(address, false, ISMINE_SPENDABLE);
         if (!addressIsMine) continue;
+        CMPTally* tally = mp_tally_map.find(address);
+        if (!tally) continue;
         // iterate only those properties in the TokenMap for this address
-        my_it->second.init();
+        tally->init();
         uint32_t propertyId;
-        while (0 != (propertyId = (my_it->second).next())) {
+        while (0 != (propertyId = tally->next())) {
             // add to the global wallet property list
             global_wallet_property_list.insert(propertyId);
             // check if the address is spendable (only spendable balances are included in totals)
@@ -740,6 +868,104 @@ bool IsInMarkerCache(const uint256& txHash)
     return (setMarkerCache.find(txHash) != setMarkerCache.end());
 }
 
+//! The "omni" marker of class C transactions
+static const unsigned char OMNI_MARKER_BYTES[] = {0x6f, 0x6d, 0x6e, 0x69};
+
+//! The script of the Exodus address on mainnet, which marks class A and B transactions
+static const unsigned char EXODUS_SCRIPT_BYTES[] = {
+    0x76, 0xa9, 0x14, 0x94, 0x6c, 0xb2, 0xe0, 0x80, 0x75, 0xbc, 0xba, 0xf1, 0x57, 0xe4,
+    0x7b, 0xcb, 0x67, 0xeb, 0x2b, 0x23, 0x39, 0xd2, 0x42, 0x88, 0xac
+};
+
+/**
+ * Searches the "omni" marker bytes within a script.
+ *
+ * The search jumps between candidates for the first marker byte with memchr, and
+ * doesn't allocate memory.
+ */
+static bool ContainsOmniMarker(const CScript& script)
+{
+    const size_t nMarkerSize = sizeof(OMNI_MARKER_BYTES);
+    const unsigned char* pch = script.data();
+    const unsigned char* pend = pch + script.size();
+
+    while (static_cast<size_t>(pend - pch) >= nMarkerSize) {
+        const void* pfound = memchr(pch, OMNI_MARKER_BYTES[0], (pend - pch) - nMarkerSize + 1);
+        if (pfound == nullptr) {
+            return false;
+        }
+        pch = static_cast<const unsigned char*>(pfound);
+        if (memcmp(pch + 1, OMNI_MARKER_BYTES + 1, nMarkerSize - 1) == 0) {
+            return true;
+        }
+        ++pch;
+    }
+
+    return false;
+}
+
+/**
+ * Determines, whether the first element pushed by a script starts with the "omni" marker.
+ *
+ * Like GetScriptPushes(), it fails for scripts, which can't be parsed entirely.
+ */
+static bool FirstPushHasOmniMarker(const CScript& script)
+{
+    bool fFirst = true;
+    bool fMarker = false;
+    std::vector<unsigned char> vchPushed;
+
+    CScript::const_iterator pc = script.begin();
+    while (pc < script.end()) {
+        opcodetype opcode;
+        if (!script.GetOp(pc, opcode, vchPushed)) {
+            return false;
+        }
+        if (fFirst && opcode <= OP_PUSHDATA4) {
+            fFirst = false;
+            fMarker = vchPushed.size() >= sizeof(OMNI_MARKER_BYTES) &&
+                    std::equal(OMNI_MARKER_BYTES, OMNI_MARKER_BYTES + sizeof(OMNI_MARKER_BYTES), vchPushed.begin());
+        }
+    }
+
+    return fMarker;
+}
+
+/**
+ * Determines, whether a transaction may carry an Omni marker, and needs to be examined closely.
+ *
+ * This is a fast search, which compares each scriptPubKey directly with the script of
+ * the Exodus address, and looks for the "omni" marker bytes. It operates on the raw
+ * script bytes without allocating memory, and allows to drop non-Omni transactions
+ * with less work.
+ *
+ * The result only depends on the transaction, block height and network, so it can be
+ * determined outside of the transaction handler and in parallel.
+ */
+bool mastercore::MayHaveMarker(const CTransaction& tx, int nBlock)
+{
+    // Examine everything when not on mainnet
+    if (isNonMainNet()) {
+        return true;
+    }
+
+    // class C not enabled yet, no need to search for marker bytes
+    const bool fSearchClassC = (nBlock >= 395000);
+
+    for (const CTxOut& output : tx.vout) {
+        const CScript& script = output.scriptPubKey;
+        if (script.size() == sizeof(EXODUS_SCRIPT_BYTES) &&
+                memcmp(script.data(), EXODUS_SCRIPT_BYTES, sizeof(EXODUS_SCRIPT_BYTES)) == 0) {
+            return true;
+        }
+        if (fSearchClassC && ContainsOmniMarker(script)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
 /**
  * Returns the encoding class, used to embed a payload.
  *
@@ -755,37 +981,7 @@ int mastercore::GetEncodingClass(const CTransaction& tx, int nBlock)
     bool hasOpReturn = false;
     bool hasMoney = false;
 
-    /* Fast Search
-     * Perform a string comparison on hex for each scriptPubKey & look directly for Exodus hash160 bytes or omni marker bytes
-     * This allows to drop non-Omni transactions with less work
-     */
-    std::string strClassC = "6f6d6e69";
-    std::string strClassAB = "76a914946cb2e08075bcbaf157e47bcb67eb2b2339d24288ac";
-    bool examineClosely = false;
-    for (unsigned int n = 0; n < tx.vout.size(); ++n) {
-        const CTxOut& output = tx.vout[n];
-        std::string strSPB = HexStr(output.scriptPubKey.begin(), output.scriptPubKey.end());
-        if (strSPB != strClassAB) { // not an exodus marker
-            if (nBlock < 395000) { // class C not enabled yet, no need to search for marker bytes
-                continue;
-            } else {
-                if (strSPB.find(strClassC) != std::string::npos) {
-                    examineClosely = true;
-                    break;
-                }
-            }
-        } else {
-            examineClosely = true;
-            break;
-        }
-    }
-
-    // Examine everything when not on mainnet
-    if (isNonMainNet()) {
-        examineClosely = true;
-    }
-
-    if (!examineClosely) return NO_MARKER;
+    if (!MayHaveMarker(tx, nBlock)) return NO_MARKER;
 
     for (unsigned int n = 0; n < tx.vout.size(); ++n) {
         const CTxOut& output = tx.vout[n];
@@ -815,19 +1011,8 @@ int mastercore::GetEncodingClass(const CTransaction& tx, int nBlock)
         if (outType == TX_NULL_DATA) {
             // Ensure there is a payload, and the first pushed element equals,
             // or starts with the "omni" marker
-            std::vector<std::string> scriptPushes;
-            if (!GetScriptPushes(output.scriptPubKey, scriptPushes)) {
-                continue;
-            }
-            if (!scriptPushes.empty()) {
-                std::vector<unsigned char> vchMarker = GetOmMarker();
-                std::vector<unsigned char> vchPushed = ParseHex(scriptPushes[0]);
-                if (vchPushed.size() < vchMarker.size()) {
-                    continue;
-                }
-                if (std::equal(vchMarker.begin(), vchMarker.end(), vchPushed.begin())) {
-                    hasOpReturn = true;
-                }
+            if (FirstPushHasOmniMarker(output.scriptPubKey)) {
+                hasOpReturn = true;
             }
         }
     }
@@ -852,54 +1037,59 @@ CCoinsViewCache mastercore::view(&viewDummy);
 //! Guards coins view cache
 CCriticalSection mastercore::cs_tx_cache;
 
-static unsigned int nCacheHits = 0;
-static unsigned int nCacheMiss = 0;
-
 /**
- * Fetches transaction inputs and adds them to the coins view cache.
+ * Removes the inputs, which were added to the coins view cache for a single
+ * transaction, once they are no longer needed.
  *
- * Note: cs_tx_cache should be locked, when adding and accessing inputs!
+ * The inputs are kept by the prevout cache, so the coins view cache only holds the
+ * inputs of the transaction, which is currently parsed.
  *
- * @param tx[in]  The transaction to fetch inputs for
- * @return True, if all inputs were successfully added to the cache
+ * Note: cs_tx_cache should be locked for the lifetime of this object!
  */
-static bool FillTxInputCache(const CTransaction& tx, const std::shared_ptr<std::map<COutPoint, Coin>> removedCoins)
+class CTxInputCacheScope
 {
-    static unsigned int nCacheSize = gArgs.GetArg("-omnitxcache", 500000);
+private:
+    std::vector<COutPoint> vAdded;
 
-    if (view.GetCacheSize() > nCacheSize) {
-        PrintToLog("%s(): clearing cache before insertion [size=%d, hit=%d, miss=%d]\n",
-                __func__, view.GetCacheSize(), nCacheHits, nCacheMiss);
-        view.Flush();
+public:
+    ~CTxInputCacheScope()
+    {
+        for (const COutPoint& outpoint : vAdded) {
+            view.SpendCoin(outpoint);
+        }
     }
 
-    for (std::vector<CTxIn>::const_iterator it = tx.vin.begin(); it != tx.vin.end(); ++it) {
-        const CTxIn& txIn = *it;
-        unsigned int nOut = txIn.prevout.n;
-        const Coin& coin = view.AccessCoin(txIn.prevout);
+    void Added(const COutPoint& outpoint)
+    {
+        vAdded.push_back(outpoint);
+    }
+};
 
-        if (!coin.IsSpent()) {
-            ++nCacheHits;
-            continue;
-        } else {
-            ++nCacheMiss;
-        }
+/**
+ * Fetches transaction inputs and adds them to the coins view cache.
+ *
+ * Inputs, which are already available in the coins view cache, for example,
+ * because they were provided via RPC, are not resolved again.
+ *
+ * Note: cs_tx_cache should be locked, when adding and accessing inputs!
+ *
+ * @param tx[in]            The transaction to fetch inputs for
+ * @param removedCoins[in]  The coins spent by the current block, if available
+ * @param scope[in,out]     Tracks the added inputs
+ * @return True, if all inputs were successfully added to the cache
+ */
+static bool FillTxInputCache(const CTransaction& tx, const std::shared_ptr<std::map<COutPoint, Coin>> removedCoins, CTxInputCacheScope& scope)
+{
+    for (const CTxIn& txIn : tx.vin) {
+        if (!view.AccessCoin(txIn.prevout).IsSpent()) continue;
 
-        CTransactionRef txPrev;
-        uint256 hashBlock;
         Coin newcoin;
-        if (removedCoins && removedCoins->find(txIn.prevout) != removedCoins->end()) {
-            newcoin = removedCoins->find(txIn.prevout)->second;
-        } else if (GetTransaction(txIn.prevout.hash, txPrev, Params().GetConsensus(), hashBlock)) {
-            newcoin.out.scriptPubKey = txPrev->vout[nOut].scriptPubKey;
-            newcoin.out.nValue = txPrev->vout[nOut].nValue;
-            BlockMap::iterator bit = mapBlockIndex.find(hashBlock);
-            newcoin.nHeight = bit != mapBlockIndex.end() ? bit->second->nHeight : 1;
-        } else {
+        if (!ResolvePrevout(txIn.prevout, removedCoins.get(), newcoin)) {
             return false;
         }
 
-        view.AddCoin(txIn.prevout, std::move(newcoin), true);
+        view.AddCoin(txIn.prevout, std::move(newcoin), false);
+        scope.Added(txIn.prevout);
     }
 
     return true;
@@ -936,7 +1126,8 @@ static int parseTransaction(bool bRPConly, const CTransaction& wtx, int nBlock,
     LOCK2(cs_main, cs_tx_cache); // cs_main should be locked first to avoid deadlocks with cs_tx_cache at FillTxInputCache(...)->GetTransaction(...)->LOCK(cs_main)
 
     // Add previous transaction inputs to the cache
-    if (!FillTxInputCache(wtx, removedCoins)) {
+    CTxInputCacheScope inputCacheScope;
+    if (!FillTxInputCache(wtx, removedCoins, inputCacheScope)) {
         PrintToLog("%s() ERROR: failed to get inputs for %s\n", __func__, wtx.GetHash().GetHex());
         return -101;
     }
@@ -1482,12 +1673,205 @@ public:
     }
 };
 
+/**
+ * The disk positions of a block of the initial scan.
+ *
+ * The positions are guarded by cs_main, so they are looked up before the blocks
+ * are read by worker threads, which must not acquire cs_main themselves.
+ */
+struct CScanBlockPos
+{
+    CBlockIndex* pBlockIndex;
+    CDiskBlockPos blockPos;
+    //! Position of the undo data, which is null, if there is none
+    CDiskBlockPos undoPos;
+
+    CScanBlockPos() : pBlockIndex(nullptr) {}
+};
+
+/**
+ * A block of the initial scan, which is read and classified ahead of processing.
+ */
+struct CScanBlock
+{
+    CBlockIndex* pBlockIndex;
+    CBlock block;
+    //! Marks the transactions, which may carry an Omni marker
+    std::vector<bool> vCandidates;
+    //! Coins spent by the candidates, taken from the undo data of the block
+    std::shared_ptr<std::map<COutPoint, Coin> > spentCoins;
+    //! Whether the block is skipped by the seed block filter
+    bool fSkipped;
+    //! Whether the block was read from disk
+    bool fRead;
+
+    CScanBlock() : pBlockIndex(nullptr), fSkipped(false), fRead(false) {}
+};
+
+/**
+ * Collects the coins spent by the marked transactions of a block from its undo data,
+ * so their inputs don't need to be looked up one by one.
+ */
+static void LoadScanSpentCoins(const CScanBlockPos& blockPos, CScanBlock& scanBlock)
+{
+    const CBlockIndex* pBlockIndex = scanBlock.pBlockIndex;
+    if (pBlockIndex->pprev == nullptr || blockPos.undoPos.IsNull()) return;
+    if (std::find(scanBlock.vCandidates.begin(), scanBlock.vCandidates.end(), true) == scanBlock.vCandidates.end()) return;
+
+    CBlockUndo blockUndo;
+    if (!UndoReadFromDisk(blockUndo, blockPos.undoPos, pBlockIndex->pprev->GetBlockHash())) return;
+    if (blockUndo.vtxundo.size() + 1 != scanBlock.block.vtx.size()) return;
+
+    scanBlock.spentCoins = std::make_shared<std::map<COutPoint, Coin> >();
+    for (size_t n = 1; n < scanBlock.block.vtx.size(); ++n) {
+        if (!scanBlock.vCandidates[n]) continue;
+        const CTransaction& tx = *scanBlock.block.vtx[n];
+        const CTxUndo& txUndo = blockUndo.vtxundo[n - 1];
+        if (txUndo.vprevout.size() != tx.vin.size()) continue;
+        for (size_t i = 0; i < tx.vin.size(); ++i) {
+            scanBlock.spentCoins->emplace(tx.vin[i].prevout, txUndo.vprevout[i]);
+        }
+    }
+}
+
+/**
+ * Reads a block of the initial scan from disk, and marks the transactions, which
+ * may carry an Omni marker. The coins spent by those are taken from the undo data
+ * of the block, if available.
+ *
+ * This doesn't touch the Omni state, so it can be done for blocks ahead of the one
+ * currently processed, and in parallel. The scan may run while cs_main is held by
+ * the caller, so the block index and disk positions are looked up beforehand.
+ */
+static void LoadScanBlock(const CScanBlockPos& blockPos, bool fSeedBlockFilter, CScanBlock& scanBlock)
+{
+    CBlockIndex* pBlockIndex = blockPos.pBlockIndex;
+    scanBlock.pBlockIndex = pBlockIndex;
+
+    if (nullptr == pBlockIndex) return;
+
+    const int nBlock = pBlockIndex->nHeight;
+
+    if (fSeedBlockFilter && SkipBlock(nBlock)) {
+        scanBlock.fSkipped = true;
+        return;
+    }
+
+    scanBlock.fRead = ReadBlockFromDisk(scanBlock.block, blockPos.blockPos, Params().GetConsensus())
+            && scanBlock.block.GetHash() == pBlockIndex->GetBlockHash();
+    if (!scanBlock.fRead) return;
+
+    scanBlock.vCandidates.resize(scanBlock.block.vtx.size());
+    for (size_t n = 0; n < scanBlock.block.vtx.size(); ++n) {
+        scanBlock.vCandidates[n] = MayHaveMarker(*scanBlock.block.vtx[n], nBlock);
+    }
+
+    LoadScanSpentCoins(blockPos, scanBlock);
+}
+
+/**
+ * Prepares the blocks of the initial scan ahead of processing.
+ *
+ * Worker threads read the upcoming blocks from disk and classify their transactions,
+ * while the scan applies the blocks in order. At most nLookAhead blocks are prepared
+ * ahead of the block, which is processed next.
+ */
+class CScanPrefetcher
+{
+private:
+    const std::vector<CScanBlockPos>& vBlockPos;
+    const int nFirstBlock;
+    const int nLastBlock;
+    const int nLookAhead;
+    const bool fSeedBlockFilter;
+
+    std::mutex mutex;
+    std::condition_variable cond;
+    //! Prepared blocks, indexed by height modulo the look-ahead depth
+    std::vector<CScanBlock> vSlots;
+    std::vector<bool> vReady;
+    //! The next block to be prepared by a worker
+    int nNextBlock;
+    //! The next block to be processed by the scan
+    int nNextProcessed;
+    bool fStop;
+    std::vector<std::thread> vThreads;
+
+    void ThreadPrepare()
+    {
+        while (true) {
+            int nBlock;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cond.wait(lock, [this] {
+                    return fStop || nNextBlock > nLastBlock || nNextBlock < nNextProcessed + nLookAhead;
+                });
+                if (fStop || nNextBlock > nLastBlock) return;
+                nBlock = nNextBlock++;
+            }
+
+            CScanBlock scanBlock;
+            LoadScanBlock(vBlockPos[nBlock - nFirstBlock], fSeedBlockFilter, scanBlock);
+
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                vSlots[nBlock % nLookAhead] = std::move(scanBlock);
+                vReady[nBlock % nLookAhead] = true;
+            }
+            cond.notify_all();
+        }
+    }
+
+public:
+    CScanPrefetcher(const std::vector<CScanBlockPos>& vBlockPosIn, int nFirstBlockIn, int nLookAheadIn, int nThreads, bool fSeedBlockFilterIn)
+      : vBlockPos(vBlockPosIn), nFirstBlock(nFirstBlockIn), nLastBlock(nFirstBlockIn + vBlockPosIn.size() - 1),
+        nLookAhead(nLookAheadIn), fSeedBlockFilter(fSeedBlockFilterIn), vSlots(nLookAheadIn), vReady(nLookAheadIn, false),
+        nNextBlock(nFirstBlockIn), nNextProcessed(nFirstBlockIn), fStop(false)
+    {
+        for (int i = 0; i < nThreads; ++i) {
+            vThreads.emplace_back(&CScanPrefetcher::ThreadPrepare, this);
+        }
+    }
+
+    ~CScanPrefetcher()
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            fStop = true;
+        }
+        cond.notify_all();
+        for (std::thread& thread : vThreads) {
+            thread.join();
+        }
+    }
+
+    /** Waits until the block at the given height is prepared, and hands it over. */
+    void Get(int nBlock, CScanBlock& scanBlock)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            assert(nBlock == nNextProcessed);
+            cond.wait(lock, [this, nBlock] { return vReady[nBlock % nLookAhead]; });
+            scanBlock = std::move(vSlots[nBlock % nLookAhead]);
+            vReady[nBlock % nLookAhead] = false;
+            nNextProcessed = nBlock + 1;
+        }
+        cond.notify_all();
+    }
+};
+
 /**
  * Scans the blockchain for meta transactions.
  *
  * It scans the blockchain, starting at the given block index, to the current
  * tip, much like as if new block were arriving and being processed on the fly.
  *
+ * The blocks are read from disk and their transactions are classified ahead of
+ * processing by "-omniscanthreads" worker threads, with a look-ahead depth of
+ * "-omniscanlookahead" blocks. Only transactions, which may carry an Omni marker,
+ * are handed to the transaction handler, and the state is modified strictly in
+ * order. With a look-ahead depth of 0, the blocks are read and processed serially.
+ *
  * Every 30 seconds the progress of the scan is reported.
  *
  * In case the current block being processed is not part of the active chain, or
@@ -1516,11 +1900,22 @@ static int msc_initial_scan(int nFirstBlock)
 
     const CBlockIndex* pFirstBlock;
     const CBlockIndex* pLastBlock;
+    std::vector<CScanBlockPos> vBlockPos;
     {
         LOCK(cs_main);
         // used to print the progress to the console and notifies the UI
         pFirstBlock = chainActive[nFirstBlock];
         pLastBlock = chainActive[nLastBlock];
+
+        vBlockPos.resize(nLastBlock - nFirstBlock + 1);
+        for (int n = nFirstBlock; n <= nLastBlock; ++n) {
+            CScanBlockPos& blockPos = vBlockPos[n - nFirstBlock];
+            blockPos.pBlockIndex = chainActive[n];
+            blockPos.blockPos = blockPos.pBlockIndex->GetBlockPos();
+            if (blockPos.pBlockIndex->nStatus & BLOCK_HAVE_UNDO) {
+                blockPos.undoPos = blockPos.pBlockIndex->GetUndoPos();
+            }
+        }
     }
 
     ProgressReporter progressReporter(pFirstBlock, pLastBlock);
@@ -1528,6 +1923,14 @@ static int msc_initial_scan(int nFirstBlock)
     // check if using seed block filter should be disabled
     bool seedBlockFilterEnabled = gArgs.GetBoolArg("-omniseedblockfilter", true);
 
+    // prepare the upcoming blocks in parallel, unless disabled
+    int nLookAhead = gArgs.GetArg("-omniscanlookahead", 32);
+    int nScanThreads = gArgs.GetArg("-omniscanthreads", std::min(GetNumCores(), 4));
+    std::unique_ptr<CScanPrefetcher> prefetcher;
+    if (nLookAhead > 0 && nScanThreads > 0) {
+        prefetcher.reset(new CScanPrefetcher(vBlockPos, nFirstBlock, nLookAhead, nScanThreads, seedBlockFilterEnabled));
+    }
+
     for (nBlock = nFirstBlock; nBlock <= nLastBlock; ++nBlock)
     {
         if (ShutdownRequested()) {
@@ -1535,12 +1938,14 @@ static int msc_initial_scan(int nFirstBlock)
             break;
         }
 
-        CBlockIndex* pblockindex;
-        {
-            LOCK(cs_main);
-            pblockindex = chainActive[nBlock];
+        CScanBlock scanBlock;
+        if (prefetcher) {
+            prefetcher->Get(nBlock, scanBlock);
+        } else {
+            LoadScanBlock(vBlockPos[nBlock - nFirstBlock], seedBlockFilterEnabled, scanBlock);
         }
 
+        CBlockIndex* pblockindex = scanBlock.pBlockIndex;
         if (nullptr == pblockindex) break;
         std::string strBlockHash = pblockindex->GetBlockHash().GetHex();
 
@@ -1556,12 +1961,18 @@ static int msc_initial_scan(int nFirstBlock)
         unsigned int nTxsFoundInBlock = 0;
         mastercore_handler_block_begin(nBlock, pblockindex);
 
-        if (!seedBlockFilterEnabled || !SkipBlock(nBlock)) {
-            CBlock block;
-            if (!ReadBlockFromDisk(block, pblockindex, Params().GetConsensus())) break;
-
-            for(const auto tx : block.vtx) {
-                if (mastercore_handler_tx(*tx, nBlock, nTxNum, pblockindex, nullptr)) ++nTxsFoundInBlock;
+        if (!scanBlock.fSkipped) {
+            if (!scanBlock.fRead) break;
+
+            for (size_t n = 0; n < scanBlock.block.vtx.size(); ++n) {
+                const CTransaction& tx = *scanBlock.block.vtx[n];
+                if (scanBlock.vCandidates[n]) {
+                    if (mastercore_handler_tx(tx, nBlock, nTxNum, pblockindex, scanBlock.spentCoins)) ++nTxsFoundInBlock;
+                } else {
+                    // not an Omni transaction, but pending amounts are cleared like in the handler
+                    LOCK(cs_tally);
+                    PendingDelete(tx.GetHash());
+                }
                 ++nTxNum;
             }
         }
@@ -1589,11 +2000,12 @@ void clear_all_state()
     LOCK2(cs_tally, cs_pending);
 
     // Memory based storage
-    mp_tally_map.clear();
+    ClearTallyMap();
     my_offers.clear();
     my_accepts.clear();
     my_crowds.clear();
     metadex.clear();
+    ResetOrderbookCommitments();
     my_pending.clear();
     ResetConsensusParams();
     ClearActivations();
@@ -1612,10 +2024,11 @@ void clear_all_state()
     exodus_prev = 0;
 }
 
-void RewindDBsAndState(int nHeight, int nBlockPrev = 0, bool fInitialParse = false)
+void RewindDBsAndState(int nHeight, int nBlockPrev = 0, bool fInitialParse = false, const CBlockIndex* pForkIndex = nullptr)
 {
     int nWaterline;
     bool reorgContainsFreeze;
+    bool fReverted = false;
     {
         LOCK(cs_tally);
         // Check if any freeze related transactions would be rolled back - if so wipe the state and startclean
@@ -1627,12 +2040,21 @@ void RewindDBsAndState(int nHeight, int nBlockPrev = 0, bool fInitialParse = fal
         pDbStoList->deleteAboveBlock(nHeight);
         pDbFeeCache->RollBackCache(nHeight);
         pDbFeeHistory->RollBackHistory(nHeight);
+        RewindWalletTxIndexes(nHeight);
         reorgRecoveryMaxHeight = 0;
 
         nWaterlineBlock = ConsensusParams().GENESIS_BLOCK - 1;
+
+        // revert the disconnected blocks with their undo logs, if available
+        if (pForkIndex != nullptr) {
+            fReverted = RevertBlocks(nHeight, pForkIndex->GetBlockHash());
+            if (fReverted) nWaterlineBlock = pForkIndex->nHeight;
+        }
     }
 
-    if (reorgContainsFreeze && !fInitialParse) {
+    if (fReverted) {
+        PrintToLog("Reverted the state to block %d without reparsing\n", nWaterlineBlock);
+    } else if (reorgContainsFreeze && !fInitialParse) {
        PrintToConsole("Reorganization containing freeze related transactions detected, forcing a reparse...\n");
        clear_all_state(); // unable to reorg freezes safely, clear state and reparse
     } else {
@@ -1661,6 +2083,77 @@ void RewindDBsAndState(int nHeight, int nBlockPrev = 0, bool fInitialParse = fal
     }
 }
 
+/**
+ * Converts the LevelDB based storage of previous versions into the current format in place.
+ *
+ * Databases of version 8 and 9 store string based records, which are converted
+ * into the binary format of version 10. Databases of version 10 lack the indexes
+ * of the trade database, which are built from the stored trades. Databases up to
+ * version 11 store the STO receipts of an address as one list, which is split into
+ * separate records. Databases up to version 12 store the fee cache history of a
+ * property as one list, which is split into entries per block.
+ *
+ * @return True, if all databases were upgraded
+ */
+static bool ConvertDatabases(int nVersion)
+{
+    if (nVersion < 10) {
+        if (pDbTransactionList->ConvertLegacyRecords() < 0) return false;
+        if (pDbTradeList->ConvertLegacyRecords() < 0) return false;
+        if (pDbStoList->ConvertLegacyRecords() < 0) return false;
+        if (pDbTransaction->ConvertLegacyRecords() < 0) return false;
+        if (pDbFeeCache->ConvertLegacyRecords() < 0) return false;
+        if (pDbFeeHistory->ConvertLegacyRecords() < 0) return false;
+    }
+
+    if (nVersion < 11) {
+        if (pDbTradeList->BuildIndex() < 0) return false;
+    }
+
+    if (nVersion < 12) {
+        if (pDbStoList->ConvertReceiptLists() < 0) return false;
+    }
+
+    if (nVersion < 13) {
+        if (pDbFeeCache->ConvertCacheHistories() < 0) return false;
+    }
+
+    return true;
+}
+
+/**
+ * Upgrades the databases of previous versions in place, if possible.
+ *
+ * A conversion, which fails partway, leaves the databases in mixed formats, so
+ * all databases are wiped in this case. Without a DB version the wiped
+ * databases are rebuilt by a full reparse.
+ *
+ * @return True, if the databases were upgraded
+ */
+static bool UpgradeDatabases()
+{
+    int nVersion = pDbTransactionList->getDBVersion();
+    if (nVersion < 8 || nVersion >= DB_VERSION) {
+        return false;
+    }
+
+    PrintToConsole("Upgrading databases from version %d to %d ...\n", nVersion, DB_VERSION);
+
+    if (ConvertDatabases(nVersion) && pDbTransactionList->setDBVersion() == DB_VERSION) {
+        return true;
+    }
+
+    PrintToConsole("Upgrading databases failed, removing them to parse all transactions again ...\n");
+    pDbTransactionList->Clear();
+    pDbTradeList->Clear();
+    pDbStoList->Clear();
+    pDbTransaction->Clear();
+    pDbFeeCache->Clear();
+    pDbFeeHistory->Clear();
+
+    return false;
+}
+
 /**
  * Global handler to initialize Omni Core.
  *
@@ -1685,6 +2178,9 @@ int mastercore_init()
 
         InitDebugLogLevels();
         ShrinkDebugLog();
+        StartLogWriter();
+
+        SetPrevoutCacheSize(std::max<int64_t>(gArgs.GetArg("-omniprevoutcache", 64), 0) << 20);
 
         if (isNonMainNet()) {
             exodus_address = exodus_testnet;
@@ -1736,6 +2232,9 @@ int mastercore_init()
         pathStateFiles = GetDataDir() / "MP_persist";
         TryCreateDirectories(pathStateFiles);
 
+        // upgrade the databases in place, if possible, instead of parsing all transactions again
+        if (!startClean) UpgradeDatabases();
+
         wrongDBVersion = (pDbTransactionList->getDBVersion() != DB_VERSION);
 
         ++mastercoreInitialized;
@@ -1895,6 +2394,8 @@ int mastercore_shutdown()
 
     PrintToConsole("Omni Core shutdown completed\n");
 
+    StopLogWriter();
+
     return 0;
 }
 
@@ -1971,6 +2472,18 @@ bool mastercore_handler_tx(const CTransaction& tx, int nBlock, unsigned int idx,
             bool bValid = (0 <= interp_ret);
             pDbTransactionList->recordTX(tx.GetHash(), bValid, nBlock, mp_obj.getType(), mp_obj.getNewAmount());
             pDbTransaction->RecordTransaction(tx.GetHash(), idx, interp_ret);
+
+            // keep the parsed form, so RPC calls don't need to resolve the inputs again
+            CDecodedTransaction decoded;
+            decoded.blockHash = pBlockIndex->GetBlockHash();
+            decoded.posInBlock = idx;
+            decoded.processingResult = interp_ret;
+            decoded.encodingClass = mp_obj.getEncodingClass();
+            decoded.fee = mp_obj.getFeePaid();
+            decoded.sender = mp_obj.getSender();
+            decoded.reference = mp_obj.getReceiver();
+            decoded.payload = ParseHex(mp_obj.getPayload());
+            pDbTransaction->RecordDecodedTransaction(tx.GetHash(), decoded);
         }
         fFoundTx |= (interp_ret == 0);
     }
@@ -2001,6 +2514,45 @@ bool mastercore::UseEncodingClassC(size_t nDataSize)
     return nTotalSize <= nMaxDatacarrierBytes && fDataEnabled;
 }
 
+/**
+ * Returns the LevelDB based databases, which are written per block.
+ */
+static std::vector<CDBBase*> GetBlockDatabases()
+{
+    std::vector<CDBBase*> vDatabases{pDbSpInfo, pDbTransactionList, pDbStoList, pDbTradeList,
+            pDbTransaction, pDbFeeCache, pDbFeeHistory};
+    vDatabases.erase(std::remove(vDatabases.begin(), vDatabases.end(), nullptr), vDatabases.end());
+    return vDatabases;
+}
+
+/**
+ * Starts collecting the writes of a block in memory.
+ */
+static void BeginBlockBatches()
+{
+    for (CDBBase* pdb : GetBlockDatabases()) {
+        pdb->BeginBatch();
+    }
+}
+
+/**
+ * Commits the writes of a block to the databases.
+ */
+static void CommitBlockBatches(int nBlock)
+{
+    int64_t nTimeStart = GetTimeMicros();
+    for (CDBBase* pdb : GetBlockDatabases()) {
+        leveldb::Status status = pdb->CommitBatch();
+        if (!status.ok()) {
+            const std::string& msg = strprintf("Failed to commit Omni Core databases for block %d: %s\n", nBlock, status.ToString());
+            PrintToLog(msg);
+            DoAbortNode(msg, msg);
+            return;
+        }
+    }
+    if (msc_debug_persistence) PrintToLog("%s(%d): committed databases in %.3f ms\n", __func__, nBlock, 0.001 * (GetTimeMicros() - nTimeStart));
+}
+
 int mastercore_handler_block_begin(int nBlockPrev, CBlockIndex const * pBlockIndex)
 {
     bool bRecoveryMode{false};
@@ -2014,12 +2566,18 @@ int mastercore_handler_block_begin(int nBlockPrev, CBlockIndex const * pBlockInd
     }
 
     if (bRecoveryMode) {
-        RewindDBsAndState(pBlockIndex->nHeight, nBlockPrev);
+        RewindDBsAndState(pBlockIndex->nHeight, nBlockPrev, false, pBlockIndex->pprev);
     }
 
     {
         LOCK(cs_tally);
 
+        // collect the database writes of this block, so they are committed at once
+        BeginBlockBatches();
+
+        // record the state changes of this block, so it can be reverted
+        BeginBlockUndo(pBlockIndex);
+
         // handle any features that go live with this block
         CheckLiveActivations(pBlockIndex->nHeight);
 
@@ -2085,6 +2643,14 @@ int mastercore_handler_block_end(int nBlockNow, CBlockIndex const * pBlockIndex,
             PrintToLog("Consensus hash for block %d: %s\n", nBlockNow, consensusHash.GetHex());
         }
 
+        // print the commitment of the whole state, which is maintained incrementally with each change
+        uint256 stateCommitment = GetStateCommitment();
+        PrintToLog("State commitment for block %d: %s\n", nBlockNow, stateCommitment.GetHex());
+
+        // all state changes of this block have been recorded
+        EndBlockUndo();
+        CommitBlockBatches(nBlockNow);
+
         // request checkpoint verification
         checkpointValid = VerifyCheckpoint(nBlockNow, pBlockIndex->GetBlockHash());
         if (!checkpointValid) {
@@ -2103,11 +2669,12 @@ int mastercore_handler_block_end(int nBlockNow, CBlockIndex const * pBlockIndex,
     }
 
     LOCK2(cs_main, cs_tally);
-    if (checkpointValid){
+    if (checkpointValid && IsPersistenceEnabled(nBlockNow) && nBlockNow >= ConsensusParams().GENESIS_BLOCK) {
         // save out the state after this block
-        if (IsPersistenceEnabled(nBlockNow) && nBlockNow >= ConsensusParams().GENESIS_BLOCK) {
-            PersistInMemoryState(pBlockIndex);
-        }
+        PersistInMemoryState(pBlockIndex);
+    } else {
+        // no journal can be based on this block, so the changed balances are dropped
+        ResetStateJournal();
     }
 
     return 0;
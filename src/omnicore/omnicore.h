@@ -23,7 +23,6 @@ class Coin;
 #include <string>
 #include <vector>
 #include <set>
-#include <unordered_map>
 
 // Keep the state of the last 50 blocks to roll back quickly
 // in case of a block reorganization
@@ -38,7 +37,7 @@ int const DONT_STORE_MAINNET_STATE_UNTIL = 622000;
 #define TEST_ECO_PROPERTY_1 (0x80000003UL)
 
 // increment this value to force a refresh of the state (similar to --startclean)
-#define DB_VERSION 8
+#define DB_VERSION 13
 
 // could probably also use: int64_t maxInt64 = std::numeric_limits<int64_t>::max();
 // maximum numeric values from the spec:
@@ -182,7 +181,7 @@ void NotifyTotalTokensChanged(uint32_t propertyId, int block);
 namespace mastercore
 {
 //! In-memory collection of all amounts for all addresses for all properties
-extern std::unordered_map<std::string, CMPTally> mp_tally_map;
+extern CMPTallyMap mp_tally_map;
 
 // TODO: move, rename
 extern CCoinsView viewDummy;
@@ -192,6 +191,8 @@ extern CCriticalSection cs_tx_cache;
 
 /** Returns the encoding class, used to embed a payload. */
 int GetEncodingClass(const CTransaction& tx, int nBlock);
+/** Determines, whether a transaction may carry an Omni marker, and needs to be examined closely. */
+bool MayHaveMarker(const CTransaction& tx, int nBlock);
 
 /** Determines, whether it is valid to use a Class C transaction for a given payload size. */
 bool UseEncodingClassC(size_t nDataSize);
@@ -202,7 +203,15 @@ uint32_t GetNextPropertyId(bool maineco); // maybe move into sp
 
 CMPTally* getTally(const std::string& address);
 bool update_tally_map(const std::string& who, uint32_t propertyId, int64_t amount, TallyType ttype);
+/** Reverts a previously recorded update of the tally map, when a block is disconnected. */
+bool revert_tally_map(const std::string& who, uint32_t propertyId, int64_t amount, TallyType ttype);
 int64_t getTotalTokens(uint32_t propertyId, int64_t* n_owners_total = nullptr);
+/** Returns the addresses with a non-zero sum of balance and reserves of a property. */
+const std::set<std::string>& GetPropertyHolders(uint32_t propertyId);
+/** Returns the sum of balances and reserves of all addresses for a property. */
+int64_t GetPropertyTotal(uint32_t propertyId);
+/** Clears the tally map, as well as the property holder index, running totals, balance commitment, state journal and undo log. */
+void ClearTallyMap();
 
 std::string strMPProperty(uint32_t propertyId);
 std::string strTransactionType(uint16_t txType);
@@ -226,6 +235,10 @@ void disableFreezing(uint32_t propertyId);
 bool isFreezingEnabled(uint32_t propertyId, int block);
 /** Clears the freeze state in the event of a reorg **/
 void ClearFreezeState();
+/** Copies the freeze state, so it can be restored when reverting blocks **/
+void GetFreezeState(std::set<std::pair<std::string,uint32_t> >& frozenAddresses, std::set<std::pair<uint32_t,int> >& freezingEnabledProperties);
+/** Restores a previously copied freeze state when reverting blocks **/
+void RestoreFreezeState(const std::set<std::pair<std::string,uint32_t> >& frozenAddresses, const std::set<std::pair<uint32_t,int> >& freezingEnabledProperties);
 /** Prints the freeze state **/
 void PrintFreezeState();
 
@@ -15,8 +15,11 @@
 #include <omnicore/utilsbitcoin.h>
 
 #include <chain.h>
+#include <clientversion.h>
 #include <fs.h>
 #include <hash.h>
+#include <serialize.h>
+#include <streams.h>
 #include <validation.h>
 #include <tinyformat.h>
 #include <uint256.h>
@@ -28,10 +31,12 @@
 
 #include <stdint.h>
 
+#include <algorithm>
+#include <exception>
 #include <fstream>
+#include <map>
 #include <set>
 #include <string>
-#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -73,121 +78,329 @@ static bool is_state_prefix(std::string const &str)
     return false;
 }
 
-static int write_msc_balances(std::ofstream& file, CHash256& hasher)
+//! Version of the binary state files
+static const uint32_t STATE_FILE_VERSION = 1;
+//! Full state of all balances
+static const uint8_t STATE_SNAPSHOT = 0;
+//! Balances changed since the state of the previous block
+static const uint8_t STATE_JOURNAL = 1;
+//! Maximal number of consecutive journals, before a snapshot is persisted
+static const int MAX_STATE_JOURNALS = 100;
+
+//! Block of the last persisted state, which the next journal can be based on
+static uint256 hashJournalBase;
+//! Block of the snapshot, which the current chain of journals is based on
+static uint256 hashJournalSnapshot;
+//! Number of journals persisted since the last snapshot
+static int nJournalLength = 0;
+//! Balances changed since the state of the previous block, which was persisted
+static std::set<std::pair<std::string, uint32_t> > setChangedBalances;
+
+/** Header of a binary state file. */
+struct CStateFileHeader
 {
-    std::unordered_map<std::string, CMPTally>::iterator iter;
-    for (iter = mp_tally_map.begin(); iter != mp_tally_map.end(); ++iter) {
-        bool emptyWallet = true;
-
-        std::string lineOut = (*iter).first;
-        lineOut.append("=");
-        CMPTally& curAddr = (*iter).second;
-        curAddr.init();
-        uint32_t propertyId = 0;
-        while (0 != (propertyId = curAddr.next())) {
-            int64_t balance = (*iter).second.getMoney(propertyId, BALANCE);
-            int64_t sellReserved = (*iter).second.getMoney(propertyId, SELLOFFER_RESERVE);
-            int64_t acceptReserved = (*iter).second.getMoney(propertyId, ACCEPT_RESERVE);
-            int64_t metadexReserved = (*iter).second.getMoney(propertyId, METADEX_RESERVE);
-
-            // we don't allow 0 balances to read in, so if we don't write them
-            // it makes things match up better between persisted state and processed state
-            if (0 == balance && 0 == sellReserved && 0 == acceptReserved && 0 == metadexReserved) {
-                continue;
-            }
+    uint32_t nVersion;
+    uint8_t nType;
+    //! The block of the persisted state
+    uint256 hashBlock;
+    //! The block of the snapshot, a journal is based on
+    uint256 hashSnapshot;
+
+    CStateFileHeader() : nVersion(STATE_FILE_VERSION), nType(STATE_SNAPSHOT) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(nVersion);
+        READWRITE(nType);
+        READWRITE(hashBlock);
+        READWRITE(hashSnapshot);
+    }
+};
 
-            emptyWallet = false;
+/** Balances of an address for a single property. */
+struct CBalanceRecord
+{
+    std::string address;
+    uint32_t propertyId;
+    int64_t balance;
+    int64_t sellReserved;
+    int64_t acceptReserved;
+    int64_t metadexReserved;
 
-            lineOut.append(strprintf("%d:%d,%d,%d,%d;",
-                    propertyId,
-                    balance,
-                    sellReserved,
-                    acceptReserved,
-                    metadexReserved));
+    CBalanceRecord() : propertyId(0), balance(0), sellReserved(0), acceptReserved(0), metadexReserved(0) {}
+
+    CBalanceRecord(const std::string& addressIn, uint32_t propertyIdIn, const CMPTally* tally)
+      : address(addressIn), propertyId(propertyIdIn), balance(0), sellReserved(0), acceptReserved(0), metadexReserved(0)
+    {
+        if (tally != nullptr) {
+            balance = tally->getMoney(propertyId, BALANCE);
+            sellReserved = tally->getMoney(propertyId, SELLOFFER_RESERVE);
+            acceptReserved = tally->getMoney(propertyId, ACCEPT_RESERVE);
+            metadexReserved = tally->getMoney(propertyId, METADEX_RESERVE);
         }
+    }
+
+    bool IsEmpty() const
+    {
+        return (0 == balance && 0 == sellReserved && 0 == acceptReserved && 0 == metadexReserved);
+    }
 
-        if (false == emptyWallet) {
-            // add the line to the hash
-            hasher.Write((unsigned char*)lineOut.c_str(), lineOut.length());
+    ADD_SERIALIZE_METHODS;
 
-            // write the line
-            file << lineOut << std::endl;
-        }
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(address);
+        READWRITE(propertyId);
+        READWRITE(balance);
+        READWRITE(sellReserved);
+        READWRITE(acceptReserved);
+        READWRITE(metadexReserved);
     }
+};
 
-    return 0;
+/** Content of a binary state file, besides the header. */
+struct CStateFileData
+{
+    std::vector<CBalanceRecord> vBalances;
+    int64_t exodusPrev;
+    uint32_t nextSPID;
+    uint32_t nextTestSPID;
+    OfferMap offers;
+    AcceptMap accepts;
+    CrowdMap crowds;
+    std::vector<CMPMetaDEx> vOrders;
+
+    CStateFileData() : exodusPrev(0), nextSPID(0), nextTestSPID(0) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(vBalances);
+        READWRITE(exodusPrev);
+        READWRITE(nextSPID);
+        READWRITE(nextTestSPID);
+        READWRITE(offers);
+        READWRITE(accepts);
+        READWRITE(crowds);
+        READWRITE(vOrders);
+    }
+};
+
+static fs::path GetStateFilePath(const uint256& hashBlock)
+{
+    return pathStateFiles / strprintf("state-%s.bin", hashBlock.ToString());
 }
 
-static int write_mp_offers(std::ofstream& file, CHash256& hasher)
+/**
+ * Writes the state as of the given block into a binary state file.
+ *
+ * Snapshots contain all non-empty balances, while journals contain only the balances,
+ * which changed since the previously persisted state. Offers, accepts, crowdsales and
+ * MetaDEx orders are always written in full.
+ *
+ * The file is written to a temporary location, flushed to disk and then moved into
+ * place, so there is a single sync per block and no partially written state file.
+ */
+static bool WriteStateFile(const CBlockIndex* pBlockIndex, bool fSnapshot)
 {
-    OfferMap::const_iterator iter;
-    for (iter = my_offers.begin(); iter != my_offers.end(); ++iter) {
-        // decompose the key for address
-        std::vector<std::string> vstr;
-        boost::split(vstr, iter->first, boost::is_any_of("-"), boost::token_compress_on);
-        const CMPOffer& offer = iter->second;
-        offer.saveOffer(file, vstr[0], hasher);
+    CStateFileHeader header;
+    header.nType = fSnapshot ? STATE_SNAPSHOT : STATE_JOURNAL;
+    header.hashBlock = pBlockIndex->GetBlockHash();
+    header.hashSnapshot = fSnapshot ? header.hashBlock : hashJournalSnapshot;
+
+    CStateFileData data;
+    if (fSnapshot) {
+        for (CMPTallyMap::iterator it = mp_tally_map.begin(); it != mp_tally_map.end(); ++it) {
+            CMPTally& tally = it->second;
+            tally.init();
+            uint32_t propertyId = 0;
+            while (0 != (propertyId = tally.next())) {
+                CBalanceRecord record(it->first, propertyId, &tally);
+                // empty balances are not restored, so they are not written either
+                if (!record.IsEmpty()) data.vBalances.push_back(record);
+            }
+        }
+    } else {
+        std::set<std::pair<std::string, uint32_t> >::const_iterator it;
+        for (it = setChangedBalances.begin(); it != setChangedBalances.end(); ++it) {
+            // empty balances are included, so they are removed when restoring
+            data.vBalances.push_back(CBalanceRecord(it->first, it->second, getTally(it->first)));
+        }
     }
 
-    return 0;
+    data.exodusPrev = exodus_prev;
+    data.nextSPID = pDbSpInfo->peekNextSPID(OMNI_PROPERTY_MSC);
+    data.nextTestSPID = pDbSpInfo->peekNextSPID(OMNI_PROPERTY_TMSC);
+    data.offers = my_offers;
+    data.accepts = my_accepts;
+    data.crowds = my_crowds;
+    for (md_PropertiesMap::const_iterator my_it = metadex.begin(); my_it != metadex.end(); ++my_it) {
+        const md_PricesMap& prices = my_it->second;
+        for (md_PricesMap::const_iterator it = prices.begin(); it != prices.end(); ++it) {
+            const md_Set& indexes = it->second;
+            data.vOrders.insert(data.vOrders.end(), indexes.begin(), indexes.end());
+        }
+    }
+
+    CDataStream ssState(SER_DISK, CLIENT_VERSION);
+    ssState << header << data;
+    uint256 hashChecksum = Hash(ssState.begin(), ssState.end());
+    ssState << hashChecksum;
+
+    fs::path path = GetStateFilePath(header.hashBlock);
+    fs::path pathTmp = path;
+    pathTmp += ".tmp";
+
+    try {
+        CAutoFile fileout(fsbridge::fopen(pathTmp, "wb"), SER_DISK, CLIENT_VERSION);
+        if (fileout.IsNull()) {
+            PrintToLog("%s(): failed to open file %s\n", __func__, pathTmp.string());
+            return false;
+        }
+        fileout.write(ssState.data(), ssState.size());
+        if (!FileCommit(fileout.Get())) {
+            PrintToLog("%s(): failed to flush file %s\n", __func__, pathTmp.string());
+            return false;
+        }
+        fileout.fclose();
+    } catch (const std::exception& e) {
+        PrintToLog("%s(): failed to write file %s: %s\n", __func__, pathTmp.string(), e.what());
+        return false;
+    }
+
+    if (!RenameOver(pathTmp, path)) {
+        PrintToLog("%s(): failed to rename file %s\n", __func__, pathTmp.string());
+        return false;
+    }
+
+    if (msc_debug_persistence) {
+        PrintToLog("%s(): persisted %s of block %d with %d balances (%d bytes)\n", __func__,
+                fSnapshot ? "snapshot" : "journal", pBlockIndex->nHeight, data.vBalances.size(), ssState.size());
+    }
+
+    return true;
 }
 
-static int write_mp_accepts(std::ofstream& file, CHash256& hasher)
+/**
+ * Reads the header of a binary state file.
+ */
+static bool ReadStateFileHeader(const uint256& hashBlock, CStateFileHeader& header)
 {
-    AcceptMap::const_iterator iter;
-    for (iter = my_accepts.begin(); iter != my_accepts.end(); ++iter) {
-        // decompose the key for address
-        std::vector<std::string> vstr;
-        boost::split(vstr, iter->first, boost::is_any_of("-+"), boost::token_compress_on);
-        const CMPAccept& accept = iter->second;
-        accept.saveAccept(file, vstr[0], vstr[2], hasher);
+    try {
+        CAutoFile filein(fsbridge::fopen(GetStateFilePath(hashBlock), "rb"), SER_DISK, CLIENT_VERSION);
+        if (filein.IsNull()) return false;
+        filein >> header;
+    } catch (const std::exception& e) {
+        PrintToLog("%s(): failed to read header of state file for block %s: %s\n", __func__, hashBlock.ToString(), e.what());
+        return false;
     }
 
-    return 0;
+    return (header.nVersion == STATE_FILE_VERSION && header.hashBlock == hashBlock);
 }
 
-static int write_globals_state(std::ofstream& file, CHash256& hasher)
+/**
+ * Reads and verifies a binary state file.
+ */
+static bool ReadStateFile(const uint256& hashBlock, CStateFileHeader& header, CStateFileData& data)
 {
-    uint32_t nextSPID = pDbSpInfo->peekNextSPID(OMNI_PROPERTY_MSC);
-    uint32_t nextTestSPID = pDbSpInfo->peekNextSPID(OMNI_PROPERTY_TMSC);
-    std::string lineOut = strprintf("%d,%d,%d",
-            exodus_prev,
-            nextSPID,
-            nextTestSPID);
+    try {
+        CAutoFile filein(fsbridge::fopen(GetStateFilePath(hashBlock), "rb"), SER_DISK, CLIENT_VERSION);
+        if (filein.IsNull()) {
+            PrintToLog("%s(): state file for block %s not found\n", __func__, hashBlock.ToString());
+            return false;
+        }
 
-    // add the line to the hash
-    hasher.Write((unsigned char*)lineOut.c_str(), lineOut.length());
+        CHashVerifier<CAutoFile> verifier(&filein);
+        verifier >> header;
+        if (header.nVersion != STATE_FILE_VERSION || header.hashBlock != hashBlock) {
+            PrintToLog("%s(): unexpected header in state file for block %s\n", __func__, hashBlock.ToString());
+            return false;
+        }
+        verifier >> data;
 
-    // write the line
-    file << lineOut << std::endl;
+        uint256 hashChecksum;
+        filein >> hashChecksum;
+        if (hashChecksum != verifier.GetHash()) {
+            PrintToLog("%s(): state file for block %s failed hash validation\n", __func__, hashBlock.ToString());
+            return false;
+        }
+    } catch (const std::exception& e) {
+        PrintToLog("%s(): failed to read state file for block %s: %s\n", __func__, hashBlock.ToString(), e.what());
+        return false;
+    }
 
-    return 0;
+    return true;
 }
 
-static int write_mp_crowdsales(std::ofstream& file, CHash256& hasher)
+/**
+ * Restores the state of a block from its binary state file.
+ *
+ * For journals, the snapshot they are based on and all journals in between are
+ * loaded as well. Files are verified before anything is applied.
+ *
+ * @return 0 if the state was restored, or -1 on failure
+ */
+int RestoreStateFiles(const CBlockIndex* pBlockIndex)
 {
-    for (CrowdMap::const_iterator it = my_crowds.begin(); it != my_crowds.end(); ++it) {
-        // decompose the key for address
-        const CMPCrowd& crowd = it->second;
-        crowd.saveCrowdSale(file, it->first, hasher);
+    CStateFileHeader header;
+    if (!ReadStateFileHeader(pBlockIndex->GetBlockHash(), header)) {
+        return -1;
     }
 
-    return 0;
-}
-
-static int write_mp_metadex(std::ofstream &file, CHash256& hasher)
-{
-    for (md_PropertiesMap::iterator my_it = metadex.begin(); my_it != metadex.end(); ++my_it) {
-        md_PricesMap& prices = my_it->second;
-        for (md_PricesMap::iterator it = prices.begin(); it != prices.end(); ++it) {
-            md_Set& indexes = (it->second);
-            for (md_Set::iterator it = indexes.begin(); it != indexes.end(); ++it) {
-                const CMPMetaDEx& meta = *it;
-                meta.saveOffer(file, hasher);
-            }
+    // collect the chain of state files, from the snapshot to the given block
+    std::vector<const CBlockIndex*> vChain;
+    const CBlockIndex* pIndex = pBlockIndex;
+    while (pIndex != nullptr) {
+        vChain.push_back(pIndex);
+        if (pIndex->GetBlockHash() == header.hashSnapshot) break;
+        pIndex = pIndex->pprev;
+    }
+    if (pIndex == nullptr) {
+        PrintToLog("%s(): snapshot %s of block %d not found\n", __func__, header.hashSnapshot.ToString(), pBlockIndex->nHeight);
+        return -1;
+    }
+    std::reverse(vChain.begin(), vChain.end());
+
+    // merge all balances, later journals replace earlier entries
+    std::map<std::pair<std::string, uint32_t>, CBalanceRecord> mapBalances;
+    CStateFileData data;
+    for (std::vector<const CBlockIndex*>::const_iterator it = vChain.begin(); it != vChain.end(); ++it) {
+        uint8_t nTypeExpected = (it == vChain.begin()) ? STATE_SNAPSHOT : STATE_JOURNAL;
+        if (!ReadStateFile((*it)->GetBlockHash(), header, data) || header.nType != nTypeExpected) {
+            return -1;
+        }
+        for (std::vector<CBalanceRecord>::const_iterator itBal = data.vBalances.begin(); itBal != data.vBalances.end(); ++itBal) {
+            mapBalances[std::make_pair(itBal->address, itBal->propertyId)] = *itBal;
         }
     }
 
+    // the last file contains the current offers, accepts, crowdsales and orders
+    ClearTallyMap();
+    for (std::map<std::pair<std::string, uint32_t>, CBalanceRecord>::const_iterator it = mapBalances.begin(); it != mapBalances.end(); ++it) {
+        const CBalanceRecord& record = it->second;
+        if (record.balance) update_tally_map(record.address, record.propertyId, record.balance, BALANCE);
+        if (record.sellReserved) update_tally_map(record.address, record.propertyId, record.sellReserved, SELLOFFER_RESERVE);
+        if (record.acceptReserved) update_tally_map(record.address, record.propertyId, record.acceptReserved, ACCEPT_RESERVE);
+        if (record.metadexReserved) update_tally_map(record.address, record.propertyId, record.metadexReserved, METADEX_RESERVE);
+    }
+
+    exodus_prev = data.exodusPrev;
+    pDbSpInfo->init(data.nextSPID, data.nextTestSPID);
+    my_offers.swap(data.offers);
+    my_accepts.swap(data.accepts);
+    my_crowds.swap(data.crowds);
+    metadex.clear();
+    ResetOrderbookCommitments();
+    for (std::vector<CMPMetaDEx>::const_iterator it = data.vOrders.begin(); it != data.vOrders.end(); ++it) {
+        if (!MetaDEx_INSERT(*it)) return -1;
+    }
+
+    PrintToLog("%s(): restored state of block %d from %d files with %d balances\n", __func__,
+            pBlockIndex->nHeight, vChain.size(), mapBalances.size());
+
     return 0;
 }
 
@@ -399,54 +612,6 @@ static int input_mp_mdexorder_string(const std::string& s)
     return 0;
 }
 
-static int write_state_file(const CBlockIndex* pBlockIndex, int what)
-{
-    fs::path path = pathStateFiles / strprintf("%s-%s.dat", statePrefix[what], pBlockIndex->GetBlockHash().ToString());
-    const std::string strFile = path.string();
-
-    std::ofstream file;
-    file.open(strFile.c_str());
-
-    CHash256 hasher;
-
-    int result = 0;
-
-    switch (what) {
-        case FILETYPE_BALANCES:
-            result = write_msc_balances(file, hasher);
-            break;
-
-        case FILETYPE_OFFERS:
-            result = write_mp_offers(file, hasher);
-            break;
-
-        case FILETYPE_ACCEPTS:
-            result = write_mp_accepts(file, hasher);
-            break;
-
-        case FILETYPE_GLOBALS:
-            result = write_globals_state(file, hasher);
-            break;
-
-        case FILETYPE_CROWDSALES:
-            result = write_mp_crowdsales(file, hasher);
-            break;
-
-        case FILETYPE_MDEXORDERS:
-            result = write_mp_metadex(file, hasher);
-            break;
-    }
-
-    // generate and wite the double hash of all the contents written
-    uint256 hash;
-    hasher.Finalize(hash.begin());
-    file << "!" << hash.ToString() << std::endl;
-
-    file.flush();
-    file.close();
-    return result;
-}
-
 static void prune_state_files(const CBlockIndex* topIndex)
 {
     // build a set of blockHashes for which we have any state files
@@ -465,8 +630,8 @@ static void prune_state_files(const CBlockIndex* topIndex)
         std::vector<std::string> vstr;
         boost::split(vstr, fName, boost::is_any_of("-."), boost::token_compress_on);
         if (vstr.size() == 3 &&
-                is_state_prefix(vstr[0]) &&
-                boost::equals(vstr[2], "dat")) {
+                ((is_state_prefix(vstr[0]) && boost::equals(vstr[2], "dat")) ||
+                 (boost::equals(vstr[0], "state") && boost::equals(vstr[2], "bin")))) {
             uint256 blockHash;
             blockHash.SetHex(vstr[1]);
             statefulBlockHashes.insert(blockHash);
@@ -476,6 +641,7 @@ static void prune_state_files(const CBlockIndex* topIndex)
     }
 
     // for each blockHash in the set, determine the distance from the given block
+    std::set<uint256> requiredBlockHashes;
     std::set<uint256>::const_iterator iter;
     for (iter = statefulBlockHashes.begin(); iter != statefulBlockHashes.end(); ++iter) {
         // look up the CBlockIndex for height info
@@ -484,21 +650,36 @@ static void prune_state_files(const CBlockIndex* topIndex)
         // if we have nothing int the index, or this block is too old..
         if (nullptr == curIndex || (((topIndex->nHeight - curIndex->nHeight) > MAX_STATE_HISTORY)
                 && (curIndex->nHeight % STORE_EVERY_N_BLOCK != 0))) {
-            if (msc_debug_persistence) {
-                if (curIndex) {
-                    PrintToLog("State from Block:%s is no longer need, removing files (age-from-tip: %d)\n", (*iter).ToString(), topIndex->nHeight - curIndex->nHeight);
-                } else {
-                    PrintToLog("State from Block:%s is no longer need, removing files (not in index)\n", (*iter).ToString());
-                }
+            continue;
+        }
+        requiredBlockHashes.insert(*iter);
+
+        // journals also require the states they are based on
+        CStateFileHeader header;
+        if (ReadStateFileHeader(*iter, header) && header.nType == STATE_JOURNAL) {
+            for (curIndex = curIndex->pprev; curIndex != nullptr; curIndex = curIndex->pprev) {
+                requiredBlockHashes.insert(curIndex->GetBlockHash());
+                if (curIndex->GetBlockHash() == header.hashSnapshot) break;
             }
+        }
+    }
 
-            // destroy the associated files!
-            std::string strBlockHash = iter->ToString();
-            for (int i = 0; i < NUM_FILETYPES; ++i) {
-                fs::path path = pathStateFiles / strprintf("%s-%s.dat", statePrefix[i], strBlockHash);
-                fs::remove(path);
-            }
+    for (iter = statefulBlockHashes.begin(); iter != statefulBlockHashes.end(); ++iter) {
+        if (requiredBlockHashes.count(*iter)) {
+            continue;
+        }
+
+        if (msc_debug_persistence) {
+            PrintToLog("State from Block:%s is no longer need, removing files\n", (*iter).ToString());
         }
+
+        // destroy the associated files!
+        std::string strBlockHash = iter->ToString();
+        for (int i = 0; i < NUM_FILETYPES; ++i) {
+            fs::path path = pathStateFiles / strprintf("%s-%s.dat", statePrefix[i], strBlockHash);
+            fs::remove(path);
+        }
+        fs::remove(GetStateFilePath(*iter));
     }
 }
 
@@ -536,18 +717,57 @@ bool IsPersistenceEnabled(int blockHeight)
     return true;
 }
 
+/**
+ * Records a balance change, which is included in the next state journal.
+ */
+void RecordBalanceChange(const std::string& address, uint32_t propertyId)
+{
+    // without a base, the next persisted state is a snapshot anyway
+    if (hashJournalBase.IsNull()) return;
+
+    setChangedBalances.insert(std::make_pair(address, propertyId));
+}
+
+/**
+ * Forces the next persisted state to be a full snapshot.
+ */
+void ResetStateJournal()
+{
+    hashJournalBase.SetNull();
+    hashJournalSnapshot.SetNull();
+    nJournalLength = 0;
+    setChangedBalances.clear();
+}
+
 /**
  * Stores the in-memory state in files.
+ *
+ * A journal of changed balances is written, if the state of the previous block was
+ * persisted. Otherwise, and after MAX_STATE_JOURNALS consecutive journals, a full
+ * snapshot is written. States, which are kept every STORE_EVERY_N_BLOCK blocks, are
+ * always snapshots.
  */
 int PersistInMemoryState(const CBlockIndex* pBlockIndex)
 {
+    bool fSnapshot = (hashJournalBase.IsNull()
+            || nJournalLength >= MAX_STATE_JOURNALS
+            || pBlockIndex->pprev == nullptr
+            || pBlockIndex->pprev->GetBlockHash() != hashJournalBase
+            || pBlockIndex->nHeight % STORE_EVERY_N_BLOCK == 0);
+
     // write the new state as of the given block
-    write_state_file(pBlockIndex, FILETYPE_BALANCES);
-    write_state_file(pBlockIndex, FILETYPE_OFFERS);
-    write_state_file(pBlockIndex, FILETYPE_ACCEPTS);
-    write_state_file(pBlockIndex, FILETYPE_GLOBALS);
-    write_state_file(pBlockIndex, FILETYPE_CROWDSALES);
-    write_state_file(pBlockIndex, FILETYPE_MDEXORDERS);
+    if (WriteStateFile(pBlockIndex, fSnapshot)) {
+        hashJournalBase = pBlockIndex->GetBlockHash();
+        if (fSnapshot) {
+            hashJournalSnapshot = hashJournalBase;
+            nJournalLength = 0;
+        } else {
+            ++nJournalLength;
+        }
+        setChangedBalances.clear();
+    } else {
+        ResetStateJournal();
+    }
 
     // clean-up the directory
     prune_state_files(pBlockIndex);
@@ -558,7 +778,7 @@ int PersistInMemoryState(const CBlockIndex* pBlockIndex)
 }
 
 /**
- * Loads and retrieves state from a file.
+ * Loads and retrieves state from a legacy text file.
  */
 int RestoreInMemoryState(const std::string& filename, int what, bool verifyHash)
 {
@@ -569,7 +789,7 @@ int RestoreInMemoryState(const std::string& filename, int what, bool verifyHash)
 
     switch (what) {
         case FILETYPE_BALANCES:
-            mp_tally_map.clear();
+            ClearTallyMap();
             inputLineFunc = input_msc_balances_string;
             break;
 
@@ -605,6 +825,9 @@ int RestoreInMemoryState(const std::string& filename, int what, bool verifyHash)
             return -1;
     }
 
+    // the orderbooks are replaced, so their commitments are rebuilt, when used next
+    ResetOrderbookCommitments();
+
     if (msc_debug_persistence) {
         LogPrintf("Loading %s ... \n", filename);
         PrintToLog("%s(%s), line %d, file: %s\n", __FUNCTION__, filename, __LINE__, __FILE__);
@@ -727,7 +950,7 @@ int LoadMostRelevantInMemoryState()
             std::vector<std::string> vstr;
             boost::split(vstr, fName, boost::is_any_of("-."), boost::token_compress_on);
             if (vstr.size() == 3 &&
-                    boost::equals(vstr[2], "dat")) {
+                    (boost::equals(vstr[2], "dat") || boost::equals(vstr[2], "bin"))) {
                 uint256 blockHash;
                 blockHash.SetHex(vstr[1]);
                 CBlockIndex *pBlockIndex = GetBlockIndex(blockHash);
@@ -754,17 +977,22 @@ int LoadMostRelevantInMemoryState()
         while (nullptr != curTip && persistedBlocks.size() > 0 && curTip->nHeight > abortRollBackBlock ) {
             if (persistedBlocks.find(curTip->GetBlockHash()) != persistedBlocks.end()) {
                 int success = -1;
-                for (int i = 0; i < NUM_FILETYPES; ++i) {
-                    fs::path path = pathStateFiles / strprintf("%s-%s.dat", statePrefix[i], curTip->GetBlockHash().ToString());
-                    const std::string strFile = path.string();
-                    success = RestoreInMemoryState(strFile, i, true);
-                    if (success < 0) {
-                        PrintToConsole("Found a state inconsistency at block height %d. "
-                                "Reverting up to %d blocks.. this may take a few minutes.\n",
-                                curTip->nHeight, (curTip->nHeight - abortRollBackBlock - 1));
-                        break;
+                if (fs::exists(GetStateFilePath(curTip->GetBlockHash()))) {
+                    success = RestoreStateFiles(curTip);
+                } else {
+                    // state files of previous versions are stored as text files
+                    for (int i = 0; i < NUM_FILETYPES; ++i) {
+                        fs::path path = pathStateFiles / strprintf("%s-%s.dat", statePrefix[i], curTip->GetBlockHash().ToString());
+                        const std::string strFile = path.string();
+                        success = RestoreInMemoryState(strFile, i, true);
+                        if (success < 0) break;
                     }
                 }
+                if (success < 0) {
+                    PrintToConsole("Found a state inconsistency at block height %d. "
+                            "Reverting up to %d blocks.. this may take a few minutes.\n",
+                            curTip->nHeight, (curTip->nHeight - abortRollBackBlock - 1));
+                }
 
                 if (success >= 0) {
                     res = curTip->nHeight;
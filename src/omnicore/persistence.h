@@ -3,6 +3,9 @@
 
 #include <boost/filesystem.hpp>
 
+#include <stdint.h>
+#include <string>
+
 class CBlockIndex;
 
 /** Indicates whether persistence is enabled and the state is stored. */
@@ -11,7 +14,16 @@ bool IsPersistenceEnabled(int blockHeight);
 /** Stores the in-memory state in files. */
 int PersistInMemoryState(const CBlockIndex* pBlockIndex);
 
-/** Loads and retrieves state from a file. */
+/** Records a balance change, which is included in the next state journal. */
+void RecordBalanceChange(const std::string& address, uint32_t propertyId);
+
+/** Forces the next persisted state to be a full snapshot. */
+void ResetStateJournal();
+
+/** Restores the state of a block from its binary state file. */
+int RestoreStateFiles(const CBlockIndex* pBlockIndex);
+
+/** Loads and retrieves state from a legacy text file. */
 int RestoreInMemoryState(const std::string& filename, int what, bool verifyHash = false);
 
 /** Loads and restores the latest state. Returns -1 if reparse is required. */
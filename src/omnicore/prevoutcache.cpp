@@ -0,0 +1,214 @@
+/**
+ * @file prevoutcache.cpp
+ *
+ * This file contains the resolver of previous transaction outputs, which are needed
+ * to identify the sender of a transaction and to calculate its fee.
+ *
+ * The outputs are resolved in the following order:
+ *
+ * 1. the coins spent by the block, which is connected or scanned, taken from its
+ *    undo data,
+ * 2. the prevout cache,
+ * 3. the UTXO set, for outputs which are not yet spent,
+ * 4. the previous transactions in the mempool or transaction index.
+ *
+ * Outputs of the last two sources are added to the prevout cache, which is bounded
+ * by its memory usage and evicts the least recently used outputs first.
+ */
+
+#include <omnicore/prevoutcache.h>
+
+#include <omnicore/log.h>
+
+#include <chain.h>
+#include <chainparams.h>
+#include <coins.h>
+#include <memusage.h>
+#include <primitives/transaction.h>
+#include <sync.h>
+#include <uint256.h>
+#include <validation.h>
+
+#include <stddef.h>
+#include <stdint.h>
+#include <list>
+#include <map>
+#include <utility>
+
+namespace mastercore
+{
+//! Default maximal memory usage of the prevout cache
+static const size_t DEFAULT_PREVOUT_CACHE_SIZE = 64 << 20;
+
+//! Guards the prevout cache and the statistics
+static CCriticalSection cs_prevout_cache;
+//! Number of outputs resolved per source
+static uint64_t nResolvedBlockUndo = 0;
+static uint64_t nResolvedCoinsTip = 0;
+static uint64_t nResolvedTxIndex = 0;
+
+CPrevoutCache::CPrevoutCache(size_t nMaxUsageIn)
+  : nUsage(0), nMaxUsage(nMaxUsageIn), nHits(0), nMisses(0), nEvictions(0)
+{
+}
+
+/**
+ * Estimates the memory usage of a cached output, including the list and index nodes.
+ */
+size_t CPrevoutCache::EntryUsage(const Coin& coin)
+{
+    return memusage::MallocUsage(sizeof(EntryList::value_type) + 2 * sizeof(void*))
+         + memusage::MallocUsage(sizeof(std::pair<const COutPoint, EntryList::iterator>) + sizeof(void*))
+         + coin.DynamicMemoryUsage();
+}
+
+/**
+ * Evicts the least recently used outputs, until the memory usage is at most nMax.
+ */
+void CPrevoutCache::Evict(size_t nMax)
+{
+    while (nUsage > nMax && !entries.empty()) {
+        const EntryList::value_type& entry = entries.back();
+        nUsage -= EntryUsage(entry.second);
+        index.erase(entry.first);
+        entries.pop_back();
+        ++nEvictions;
+    }
+}
+
+bool CPrevoutCache::Get(const COutPoint& outpoint, Coin& coin)
+{
+    auto it = index.find(outpoint);
+    if (it == index.end()) {
+        ++nMisses;
+        return false;
+    }
+
+    entries.splice(entries.begin(), entries, it->second);
+    coin = it->second->second;
+    ++nHits;
+
+    return true;
+}
+
+void CPrevoutCache::Add(const COutPoint& outpoint, const Coin& coin)
+{
+    size_t nEntryUsage = EntryUsage(coin);
+    if (nEntryUsage > nMaxUsage) return;
+
+    auto it = index.find(outpoint);
+    if (it != index.end()) {
+        nUsage -= EntryUsage(it->second->second);
+        entries.erase(it->second);
+        index.erase(it);
+    }
+
+    Evict(nMaxUsage - nEntryUsage);
+
+    entries.emplace_front(outpoint, coin);
+    index.emplace(outpoint, entries.begin());
+    nUsage += nEntryUsage;
+}
+
+void CPrevoutCache::Clear()
+{
+    entries.clear();
+    index.clear();
+    nUsage = 0;
+}
+
+void CPrevoutCache::SetMaxUsage(size_t nMaxUsageIn)
+{
+    nMaxUsage = nMaxUsageIn;
+    Evict(nMaxUsage);
+}
+
+void CPrevoutCache::GetStats(CPrevoutCacheStats& stats) const
+{
+    stats.nHits = nHits;
+    stats.nMisses = nMisses;
+    stats.nEvictions = nEvictions;
+    stats.nEntries = entries.size();
+    stats.nUsage = nUsage;
+    stats.nMaxUsage = nMaxUsage;
+}
+
+//! Outputs resolved from the UTXO set or transaction index, guarded by cs_prevout_cache
+static CPrevoutCache prevoutCache(DEFAULT_PREVOUT_CACHE_SIZE);
+
+/**
+ * Resolves a previous transaction output.
+ *
+ * Note: cs_main should be locked, when the output may be looked up in the UTXO set
+ * or transaction index!
+ *
+ * @param outpoint[in]     The output to resolve
+ * @param pSpentCoins[in]  The coins spent by the current block, if available
+ * @param coin[out]        The resolved output
+ * @return True, if the output was found
+ */
+bool ResolvePrevout(const COutPoint& outpoint, const std::map<COutPoint, Coin>* pSpentCoins, Coin& coin)
+{
+    if (pSpentCoins) {
+        std::map<COutPoint, Coin>::const_iterator it = pSpentCoins->find(outpoint);
+        if (it != pSpentCoins->end()) {
+            coin = it->second;
+            LOCK(cs_prevout_cache);
+            ++nResolvedBlockUndo;
+            return true;
+        }
+    }
+
+    {
+        LOCK(cs_prevout_cache);
+        if (prevoutCache.Get(outpoint, coin)) return true;
+    }
+
+    bool fCoinsTip = false;
+    CTransactionRef txPrev;
+    uint256 hashBlock;
+    if (pcoinsTip && pcoinsTip->GetCoin(outpoint, coin)) {
+        fCoinsTip = true;
+    } else if (GetTransaction(outpoint.hash, txPrev, Params().GetConsensus(), hashBlock) && outpoint.n < txPrev->vout.size()) {
+        coin = Coin(txPrev->vout[outpoint.n], 1, txPrev->IsCoinBase());
+        BlockMap::iterator bit = mapBlockIndex.find(hashBlock);
+        if (bit != mapBlockIndex.end()) coin.nHeight = bit->second->nHeight;
+    } else {
+        return false;
+    }
+
+    LOCK(cs_prevout_cache);
+    if (fCoinsTip) {
+        ++nResolvedCoinsTip;
+    } else {
+        ++nResolvedTxIndex;
+    }
+    prevoutCache.Add(outpoint, coin);
+
+    return true;
+}
+
+void SetPrevoutCacheSize(size_t nMaxUsage)
+{
+    LOCK(cs_prevout_cache);
+    prevoutCache.SetMaxUsage(nMaxUsage);
+}
+
+void ClearPrevoutCache()
+{
+    LOCK(cs_prevout_cache);
+    prevoutCache.Clear();
+}
+
+CPrevoutCacheStats GetPrevoutCacheStats()
+{
+    LOCK(cs_prevout_cache);
+    CPrevoutCacheStats stats;
+    prevoutCache.GetStats(stats);
+    stats.nBlockUndo = nResolvedBlockUndo;
+    stats.nCoinsTip = nResolvedCoinsTip;
+    stats.nTxIndex = nResolvedTxIndex;
+
+    return stats;
+}
+}
@@ -0,0 +1,79 @@
+#ifndef BITCOIN_OMNICORE_PREVOUTCACHE_H
+#define BITCOIN_OMNICORE_PREVOUTCACHE_H
+
+#include <coins.h>
+#include <primitives/transaction.h>
+
+#include <stddef.h>
+#include <stdint.h>
+#include <list>
+#include <map>
+#include <unordered_map>
+#include <utility>
+
+namespace mastercore
+{
+/** Statistics of the prevout cache and the sources of resolved outputs. */
+struct CPrevoutCacheStats
+{
+    uint64_t nHits;
+    uint64_t nMisses;
+    uint64_t nEvictions;
+    //! Outputs taken from the undo data of the connected or scanned block
+    uint64_t nBlockUndo;
+    //! Outputs taken from the UTXO set
+    uint64_t nCoinsTip;
+    //! Outputs taken from previous transactions in the mempool or transaction index
+    uint64_t nTxIndex;
+    size_t nEntries;
+    size_t nUsage;
+    size_t nMaxUsage;
+
+    CPrevoutCacheStats() : nHits(0), nMisses(0), nEvictions(0), nBlockUndo(0), nCoinsTip(0), nTxIndex(0),
+        nEntries(0), nUsage(0), nMaxUsage(0) {}
+};
+
+/** A least recently used cache of previous transaction outputs, bounded by its memory usage. */
+class CPrevoutCache
+{
+private:
+    typedef std::list<std::pair<COutPoint, Coin> > EntryList;
+
+    //! Cached outputs, most recently used first
+    EntryList entries;
+    std::unordered_map<COutPoint, EntryList::iterator, SaltedOutpointHasher> index;
+    size_t nUsage;
+    size_t nMaxUsage;
+    uint64_t nHits;
+    uint64_t nMisses;
+    uint64_t nEvictions;
+
+    static size_t EntryUsage(const Coin& coin);
+    void Evict(size_t nMax);
+
+public:
+    explicit CPrevoutCache(size_t nMaxUsageIn);
+
+    /** Looks up an output, and marks it as most recently used. */
+    bool Get(const COutPoint& outpoint, Coin& coin);
+    /** Adds an output, and evicts the least recently used ones, if the cache is full. */
+    void Add(const COutPoint& outpoint, const Coin& coin);
+    /** Removes all outputs. */
+    void Clear();
+    /** Changes the maximal memory usage. */
+    void SetMaxUsage(size_t nMaxUsageIn);
+    /** Fills the cache related fields of the statistics. */
+    void GetStats(CPrevoutCacheStats& stats) const;
+};
+
+/** Resolves a previous output, preferring the given spent coins of a block over the cache and slower sources. */
+bool ResolvePrevout(const COutPoint& outpoint, const std::map<COutPoint, Coin>* pSpentCoins, Coin& coin);
+/** Sets the maximal memory usage of the prevout cache in bytes. */
+void SetPrevoutCacheSize(size_t nMaxUsage);
+/** Removes all cached outputs. */
+void ClearPrevoutCache();
+/** Returns statistics of the prevout cache. */
+CPrevoutCacheStats GetPrevoutCacheStats();
+}
+
+#endif // BITCOIN_OMNICORE_PREVOUTCACHE_H
@@ -21,6 +21,7 @@
 #include <omnicore/notifications.h>
 #include <omnicore/omnicore.h>
 #include <omnicore/parsing.h>
+#include <omnicore/prevoutcache.h>
 #include <omnicore/rpcrequirements.h>
 #include <omnicore/rpctxobject.h>
 #include <omnicore/rpcvalues.h>
@@ -59,6 +60,7 @@
 
 #include <stdint.h>
 #include <map>
+#include <set>
 #include <stdexcept>
 #include <string>
 #include <tuple>
@@ -146,13 +148,9 @@ void MetaDexObjectsToJSON(std::vector<CMPMetaDEx>& vMetaDexObjs, UniValue& respo
     }
 }
 
-bool BalanceToJSON(const std::string& address, uint32_t property, UniValue& balance_obj, bool divisible)
+/** Adds the available, reserved and frozen amounts to a JSON object. Returns false, if all are zero. */
+static bool AmountsToJSON(int64_t nAvailable, int64_t nReserved, int64_t nFrozen, UniValue& balance_obj, bool divisible)
 {
-    // confirmed balance minus unconfirmed, spent amounts
-    int64_t nAvailable = GetAvailableTokenBalance(address, property);
-    int64_t nReserved = GetReservedTokenBalance(address, property);
-    int64_t nFrozen = GetFrozenTokenBalance(address, property);
-
     if (divisible) {
         balance_obj.pushKV("balance", FormatDivisibleMP(nAvailable));
         balance_obj.pushKV("reserved", FormatDivisibleMP(nReserved));
@@ -166,6 +164,30 @@ bool BalanceToJSON(const std::string& address, uint32_t property, UniValue& bala
     return (nAvailable || nReserved || nFrozen);
 }
 
+bool BalanceToJSON(const std::string& address, uint32_t property, UniValue& balance_obj, bool divisible)
+{
+    // confirmed balance minus unconfirmed, spent amounts
+    int64_t nAvailable = GetAvailableTokenBalance(address, property);
+    int64_t nReserved = GetReservedTokenBalance(address, property);
+    int64_t nFrozen = GetFrozenTokenBalance(address, property);
+
+    return AmountsToJSON(nAvailable, nReserved, nFrozen, balance_obj, divisible);
+}
+
+/**
+ * Adds the balance of a property to a JSON object, taken directly from the tally of an address.
+ *
+ * The caller must hold cs_tally.
+ */
+static bool TallyToJSON(const std::string& address, const CMPTally& tally, uint32_t property, UniValue& balance_obj, bool divisible)
+{
+    int64_t nAvailable = tally.getMoneyAvailable(property);
+    int64_t nReserved = tally.getMoneyReserved(property);
+    int64_t nFrozen = isAddressFrozen(address, property) ? tally.getMoney(property, BALANCE) : 0;
+
+    return AmountsToJSON(nAvailable, nReserved, nFrozen, balance_obj, divisible);
+}
+
 // Obtains details of a fee distribution
 static UniValue omni_getfeedistribution(const JSONRPCRequest& request)
 {
@@ -670,7 +692,7 @@ static UniValue mscrpc(const JSONRPCRequest& request)
             LOCK(cs_tally);
             int64_t total = 0;
             // display all balances
-            for (std::unordered_map<std::string, CMPTally>::iterator my_it = mp_tally_map.begin(); my_it != mp_tally_map.end(); ++my_it) {
+            for (CMPTallyMap::iterator my_it = mp_tally_map.begin(); my_it != mp_tally_map.end(); ++my_it) {
                 PrintToConsole("%34s => ", my_it->first);
                 total += (my_it->second).print(extra2, bDivisible);
             }
@@ -697,7 +719,7 @@ static UniValue mscrpc(const JSONRPCRequest& request)
             LOCK(cs_tally);
             uint32_t id = 0;
             // for each address display all currencies it holds
-            for (std::unordered_map<std::string, CMPTally>::iterator my_it = mp_tally_map.begin(); my_it != mp_tally_map.end(); ++my_it) {
+            for (CMPTallyMap::iterator my_it = mp_tally_map.begin(); my_it != mp_tally_map.end(); ++my_it) {
                 PrintToConsole("%34s => ", my_it->first);
                 (my_it->second).print(extra2);
                 (my_it->second).init();
@@ -875,20 +897,10 @@ static UniValue omni_getallbalancesforid(const JSONRPCRequest& request)
 
     LOCK(cs_tally);
 
-    for (std::unordered_map<std::string, CMPTally>::iterator it = mp_tally_map.begin(); it != mp_tally_map.end(); ++it) {
-        uint32_t id = 0;
-        bool includeAddress = false;
-        std::string address = it->first;
-        (it->second).init();
-        while (0 != (id = (it->second).next())) {
-            if (id == propertyId) {
-                includeAddress = true;
-                break;
-            }
-        }
-        if (!includeAddress) {
-            continue; // ignore this address, has never transacted in this propertyId
-        }
+    const std::set<std::string>& holders = GetPropertyHolders(propertyId);
+
+    for (std::set<std::string>::const_iterator it = holders.begin(); it != holders.end(); ++it) {
+        const std::string& address = *it;
         UniValue balanceObj(UniValue::VOBJ);
         balanceObj.pushKV("address", address);
         bool nonEmptyBalance = BalanceToJSON(address, propertyId, balanceObj, isDivisible);
@@ -944,16 +956,16 @@ static UniValue omni_getallbalancesforaddress(const JSONRPCRequest& request)
 
     uint32_t propertyId = 0;
     while (0 != (propertyId = addressTally->next())) {
-        CMPSPInfo::Entry property;
-        if (!pDbSpInfo->getSP(propertyId, property)) {
+        CMPSPInfo::HotFields property;
+        if (!pDbSpInfo->getSPHotFields(propertyId, property)) {
             continue;
         }
 
         UniValue balanceObj(UniValue::VOBJ);
         balanceObj.pushKV("propertyid", (uint64_t) propertyId);
-        balanceObj.pushKV("name", property.name);
+        balanceObj.pushKV("name", property.entry->name);
 
-        bool nonEmptyBalance = BalanceToJSON(address, propertyId, balanceObj, property.isDivisible());
+        bool nonEmptyBalance = BalanceToJSON(address, propertyId, balanceObj, property.divisible);
 
         if (nonEmptyBalance) {
             response.push_back(balanceObj);
@@ -963,6 +975,143 @@ static UniValue omni_getallbalancesforaddress(const JSONRPCRequest& request)
     return response;
 }
 
+static UniValue omni_getbalances(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() < 1 || request.params.size() > 2)
+        throw runtime_error(
+            RPCHelpMan{"omni_getbalances",
+               "\nReturns the token balances of several addresses.\n"
+               "\nAll balances are taken from the state of the same block, which is part of the result.\n",
+               {
+                   {"addresses", RPCArg::Type::ARR, RPCArg::Optional::NO, "a JSON array of addresses\n",
+                        {
+                            {"address", RPCArg::Type::STR, RPCArg::Optional::OMITTED, "the address\n"},
+                        }
+                   },
+                   {"propertyids", RPCArg::Type::ARR, /* default */ "all properties", "a JSON array of property identifiers to filter the balances\n",
+                        {
+                            {"propertyid", RPCArg::Type::NUM, RPCArg::Optional::OMITTED, "the property identifier\n"},
+                        }
+                   },
+               },
+               RPCResult{
+                   "{\n"
+                   "  \"block\" : nnnnnn,                  (number) the index of the block the balances apply to\n"
+                   "  \"blockhash\" : \"hash\",              (string) the hash of the corresponding block\n"
+                   "  \"addresses\" : [                    (array of JSON objects) the addresses, in the order of the request\n"
+                   "    {\n"
+                   "      \"address\" : \"address\",          (string) the address\n"
+                   "      \"balances\" : [                  (array of JSON objects) the non-empty balances of the address\n"
+                   "        {\n"
+                   "          \"propertyid\" : n,           (number) the property identifier\n"
+                   "          \"name\" : \"name\",            (string) the name of the property\n"
+                   "          \"balance\" : \"n.nnnnnnnn\",   (string) the available balance of the address\n"
+                   "          \"reserved\" : \"n.nnnnnnnn\",  (string) the amount reserved by sell offers and accepts\n"
+                   "          \"frozen\" : \"n.nnnnnnnn\"     (string) the amount frozen by the issuer (applies to managed properties only)\n"
+                   "        },\n"
+                   "        ...\n"
+                   "      ]\n"
+                   "    },\n"
+                   "    ...\n"
+                   "  ]\n"
+                   "}\n"
+               },
+               RPCExamples{
+                   HelpExampleCli("omni_getbalances", "\"[\\\"1EXoDusjGwvnjZUyKkxZ4UHEf77z6A5S4P\\\",\\\"1Po1oWkD2LmodfkBYiAktwh76vkF93LKnh\\\"]\"")
+                   + HelpExampleCli("omni_getbalances", "\"[\\\"1EXoDusjGwvnjZUyKkxZ4UHEf77z6A5S4P\\\"]\" \"[1,31]\"")
+                   + HelpExampleRpc("omni_getbalances", "[\"1EXoDusjGwvnjZUyKkxZ4UHEf77z6A5S4P\",\"1Po1oWkD2LmodfkBYiAktwh76vkF93LKnh\"], [1,31]")
+               }
+            }.ToString());
+
+    const UniValue& addressValues = request.params[0].get_array();
+    std::vector<std::string> addresses;
+    addresses.reserve(addressValues.size());
+    for (size_t i = 0; i < addressValues.size(); ++i) {
+        addresses.push_back(ParseAddress(addressValues[i]));
+    }
+
+    std::set<uint32_t> propertyFilter;
+    if (request.params.size() > 1 && !request.params[1].isNull()) {
+        const UniValue& propertyValues = request.params[1].get_array();
+        for (size_t i = 0; i < propertyValues.size(); ++i) {
+            uint32_t propertyId = ParsePropertyId(propertyValues[i]);
+            RequireExistingProperty(propertyId);
+            propertyFilter.insert(propertyId);
+        }
+    }
+
+    // no block can be connected, while the balances are collected
+    LOCK2(cs_main, cs_tally);
+
+    int block = GetHeight();
+    CBlockIndex* pblockindex = chainActive[block];
+
+    // the property details are looked up once per property, an entry of
+    // nullptr marks a property, which wasn't found
+    std::map<uint32_t, CMPSPInfo::HotFields> properties;
+    auto lookupProperty = [&properties](uint32_t propertyId) -> const CMPSPInfo::HotFields& {
+        std::map<uint32_t, CMPSPInfo::HotFields>::iterator it = properties.find(propertyId);
+        if (it == properties.end()) {
+            CMPSPInfo::HotFields property;
+            if (!pDbSpInfo->getSPHotFields(propertyId, property)) {
+                property.entry = nullptr;
+            }
+            it = properties.emplace(propertyId, property).first;
+        }
+        return it->second;
+    };
+
+    UniValue arrAddresses(UniValue::VARR);
+
+    for (const std::string& address : addresses) {
+        UniValue arrBalances(UniValue::VARR);
+
+        CMPTally* addressTally = getTally(address);
+        if (nullptr != addressTally) {
+            auto pushBalance = [&](uint32_t propertyId) {
+                const CMPSPInfo::HotFields& property = lookupProperty(propertyId);
+                if (!property.entry) {
+                    return; // token wasn't found in the DB
+                }
+
+                UniValue balanceObj(UniValue::VOBJ);
+                balanceObj.pushKV("propertyid", (uint64_t) propertyId);
+                balanceObj.pushKV("name", property.entry->name);
+
+                bool nonEmptyBalance = TallyToJSON(address, *addressTally, propertyId, balanceObj, property.divisible);
+
+                if (nonEmptyBalance) {
+                    arrBalances.push_back(balanceObj);
+                }
+            };
+
+            if (propertyFilter.empty()) {
+                uint32_t propertyId = 0;
+                addressTally->init();
+                while (0 != (propertyId = addressTally->next())) {
+                    pushBalance(propertyId);
+                }
+            } else {
+                for (uint32_t propertyId : propertyFilter) {
+                    pushBalance(propertyId);
+                }
+            }
+        }
+
+        UniValue objEntry(UniValue::VOBJ);
+        objEntry.pushKV("address", address);
+        objEntry.pushKV("balances", arrBalances);
+        arrAddresses.push_back(objEntry);
+    }
+
+    UniValue response(UniValue::VOBJ);
+    response.pushKV("block", block);
+    response.pushKV("blockhash", pblockindex->GetBlockHash().GetHex());
+    response.pushKV("addresses", arrAddresses);
+
+    return response;
+}
+
 /** Returns all addresses that may be mine. */
 static std::set<std::string> getWalletAddresses(const JSONRPCRequest& request, bool fIncludeWatchOnly)
 {
@@ -1072,8 +1221,8 @@ static UniValue omni_getwalletbalances(const JSONRPCRequest& request)
         uint32_t propertyId = item.first;
         std::tuple<int64_t, int64_t, int64_t> balance = item.second;
 
-        CMPSPInfo::Entry property;
-        if (!pDbSpInfo->getSP(propertyId, property)) {
+        CMPSPInfo::HotFields property;
+        if (!pDbSpInfo->getSPHotFields(propertyId, property)) {
             continue; // token wasn't found in the DB
         }
 
@@ -1083,9 +1232,9 @@ static UniValue omni_getwalletbalances(const JSONRPCRequest& request)
 
         UniValue objBalance(UniValue::VOBJ);
         objBalance.pushKV("propertyid", (uint64_t) propertyId);
-        objBalance.pushKV("name", property.name);
+        objBalance.pushKV("name", property.entry->name);
 
-        if (property.isDivisible()) {
+        if (property.divisible) {
             objBalance.pushKV("balance", FormatDivisibleMP(nAvailable));
             objBalance.pushKV("reserved", FormatDivisibleMP(nReserved));
             objBalance.pushKV("frozen", FormatDivisibleMP(nFrozen));
@@ -1164,16 +1313,16 @@ static UniValue omni_getwalletaddressbalances(const JSONRPCRequest& request)
         addressTally->init();
 
         while (0 != (propertyId = addressTally->next())) {
-            CMPSPInfo::Entry property;
-            if (!pDbSpInfo->getSP(propertyId, property)) {
+            CMPSPInfo::HotFields property;
+            if (!pDbSpInfo->getSPHotFields(propertyId, property)) {
                 continue; // token wasn't found in the DB
             }
 
             UniValue objBalance(UniValue::VOBJ);
             objBalance.pushKV("propertyid", (uint64_t) propertyId);
-            objBalance.pushKV("name", property.name);
+            objBalance.pushKV("name", property.entry->name);
 
-            bool nonEmptyBalance = BalanceToJSON(address, propertyId, objBalance, property.isDivisible());
+            bool nonEmptyBalance = BalanceToJSON(address, propertyId, objBalance, property.divisible);
 
             if (nonEmptyBalance) {
                 arrBalances.push_back(objBalance);
@@ -1693,17 +1842,22 @@ static UniValue omni_getorderbook(const JSONRPCRequest& request)
     std::vector<CMPMetaDEx> vecMetaDexObjects;
     {
         LOCK(cs_tally);
-        for (md_PropertiesMap::const_iterator my_it = metadex.begin(); my_it != metadex.end(); ++my_it) {
+        // the orderbook is sorted by pair, so only the pairs of the property for sale are visited, and
+        // their price levels are merged, so the orders are sorted by price across all desired properties
+        md_PricesMap levels;
+        md_PropertiesMap::const_iterator my_it = metadex.lower_bound(md_PropertyPair(propertyIdForSale, propertyIdDesired));
+        for (; my_it != metadex.end() && my_it->first.first == propertyIdForSale; ++my_it) {
+            if (filterDesired && my_it->first.second != propertyIdDesired) break;
             const md_PricesMap& prices = my_it->second;
             for (md_PricesMap::const_iterator it = prices.begin(); it != prices.end(); ++it) {
                 const md_Set& indexes = it->second;
-                for (md_Set::const_iterator it = indexes.begin(); it != indexes.end(); ++it) {
-                    const CMPMetaDEx& obj = *it;
-                    if (obj.getProperty() != propertyIdForSale) continue;
-                    if (!filterDesired || obj.getDesProperty() == propertyIdDesired) vecMetaDexObjects.push_back(obj);
-                }
+                levels[it->first].insert(indexes.begin(), indexes.end());
             }
         }
+        for (md_PricesMap::const_iterator it = levels.begin(); it != levels.end(); ++it) {
+            const md_Set& indexes = it->second;
+            vecMetaDexObjects.insert(vecMetaDexObjects.end(), indexes.begin(), indexes.end());
+        }
     }
 
     UniValue response(UniValue::VARR);
@@ -1782,23 +1936,27 @@ static UniValue omni_gettradehistoryforaddress(const JSONRPCRequest& request)
         RequireExistingProperty(propertyId);
     }
 
-    // Obtain a sorted vector of txids for the address trade history
-    std::vector<uint256> vecTransactions;
-    {
-        LOCK(cs_tally);
-        pDbTradeList->getTradesForAddress(address, vecTransactions, propertyId);
-    }
-
     // Populate the address trade history into JSON objects until we have processed count transactions
     UniValue response(UniValue::VARR);
-    uint32_t processed = 0;
-    for(std::vector<uint256>::reverse_iterator it = vecTransactions.rbegin(); it != vecTransactions.rend(); ++it) {
-        UniValue txobj(UniValue::VOBJ);
-        int populateResult = populateRPCTransactionObject(*it, txobj, "", true, "", pWallet.get());
-        if (0 == populateResult) {
-            response.push_back(txobj);
-            processed++;
-            if (processed >= count) break;
+    uint64_t processed = 0;
+    uint64_t skip = 0;
+    while (processed < count) {
+        // Obtain the next page of txids of the address trade history, most recent first
+        std::vector<uint256> vecTransactions;
+        {
+            LOCK(cs_tally);
+            pDbTradeList->getTradesForAddress(address, vecTransactions, propertyId, count - processed, skip, true);
+        }
+        if (vecTransactions.empty()) break;
+        skip += vecTransactions.size();
+
+        for (std::vector<uint256>::const_iterator it = vecTransactions.begin(); it != vecTransactions.end(); ++it) {
+            UniValue txobj(UniValue::VOBJ);
+            int populateResult = populateRPCTransactionObject(*it, txobj, "", true, "", pWallet.get());
+            if (0 == populateResult) {
+                response.push_back(txobj);
+                processed++;
+            }
         }
     }
 
@@ -2437,13 +2595,15 @@ static UniValue omni_getsto(const JSONRPCRequest& request)
     std::unique_ptr<interfaces::Wallet> pWallet;
 #endif
 
-    if (request.fHelp || request.params.size() < 1 || request.params.size() > 2)
+    if (request.fHelp || request.params.size() < 1 || request.params.size() > 4)
         throw runtime_error(
             RPCHelpMan{"omni_getsto",
                "\nGet information and recipients of a send-to-owners transaction.\n",
                {
                    {"txid", RPCArg::Type::STR, RPCArg::Optional::NO, "the hash of the transaction to lookup\n"},
                    {"recipientfilter", RPCArg::Type::STR, /* default */ "\"*\" for all", "a filter for recipients\n"},
+                   {"skip", RPCArg::Type::NUM, /* default */ "0", "the number of recipients to skip\n"},
+                   {"count", RPCArg::Type::NUM, /* default */ "0 for all", "the maximal number of recipients to return\n"},
                },
                RPCResult{
                    "{\n"
@@ -2472,6 +2632,7 @@ static UniValue omni_getsto(const JSONRPCRequest& request)
                },
                RPCExamples{
                    HelpExampleCli("omni_getsto", "\"1075db55d416d3ca199f55b6084e2115b9345e16c5cf302fc80e9d5fbf5d48d\" \"*\"")
+                   + HelpExampleCli("omni_getsto", "\"1075db55d416d3ca199f55b6084e2115b9345e16c5cf302fc80e9d5fbf5d48d\" \"*\" 1000 500")
                    + HelpExampleRpc("omni_getsto", "\"1075db55d416d3ca199f55b6084e2115b9345e16c5cf302fc80e9d5fbf5d48d\", \"*\"")
                }
             }.ToString());
@@ -2479,9 +2640,14 @@ static UniValue omni_getsto(const JSONRPCRequest& request)
     uint256 hash = ParseHashV(request.params[0], "txid");
     std::string filterAddress;
     if (request.params.size() > 1) filterAddress = ParseAddressOrWildcard(request.params[1]);
+    int64_t nSkip = (request.params.size() > 2) ? request.params[2].get_int64() : 0;
+    int64_t nCount = (request.params.size() > 3) ? request.params[3].get_int64() : 0;
+    if (nSkip < 0) throw JSONRPCError(RPC_INVALID_PARAMETER, "Negative skip");
+    if (nCount < 0) throw JSONRPCError(RPC_INVALID_PARAMETER, "Negative count");
 
     UniValue txobj(UniValue::VOBJ);
-    int populateResult = populateRPCTransactionObject(hash, txobj, "", true, filterAddress, pWallet.get());
+    // only the requested page of recipients is retrieved
+    int populateResult = populateRPCTransactionObject(hash, txobj, "", true, filterAddress, pWallet.get(), nSkip, nCount);
     if (populateResult != 0) PopulateFailure(populateResult);
 
     return txobj;
@@ -2679,6 +2845,78 @@ static UniValue omni_getbalanceshash(const JSONRPCRequest& request)
     return response;
 }
 
+static UniValue omni_getprevoutcacheinfo(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 0)
+        throw runtime_error(
+            RPCHelpMan{"omni_getprevoutcacheinfo",
+               "\nReturns statistics of the cache of previous transaction outputs, which are used to identify senders.\n",
+               {},
+               RPCResult{
+                   "{\n"
+                   "  \"entries\" : n,             (number) the number of cached outputs\n"
+                   "  \"usage\" : n,               (number) the estimated memory usage of the cache in bytes\n"
+                   "  \"maxusage\" : n,            (number) the maximal memory usage of the cache in bytes\n"
+                   "  \"hits\" : n,                (number) the number of outputs found in the cache\n"
+                   "  \"misses\" : n,              (number) the number of outputs not found in the cache\n"
+                   "  \"evictions\" : n,           (number) the number of outputs evicted from the cache\n"
+                   "  \"blockundo\" : n,           (number) the number of outputs taken from the undo data of blocks\n"
+                   "  \"coinstip\" : n,            (number) the number of outputs taken from the UTXO set\n"
+                   "  \"txindex\" : n              (number) the number of outputs taken from the mempool or transaction index\n"
+                   "}\n"
+               },
+               RPCExamples{
+                   HelpExampleCli("omni_getprevoutcacheinfo", "")
+                   + HelpExampleRpc("omni_getprevoutcacheinfo", "")
+               }
+            }.ToString());
+
+    CPrevoutCacheStats stats = GetPrevoutCacheStats();
+
+    UniValue response(UniValue::VOBJ);
+    response.pushKV("entries", (uint64_t)stats.nEntries);
+    response.pushKV("usage", (uint64_t)stats.nUsage);
+    response.pushKV("maxusage", (uint64_t)stats.nMaxUsage);
+    response.pushKV("hits", stats.nHits);
+    response.pushKV("misses", stats.nMisses);
+    response.pushKV("evictions", stats.nEvictions);
+    response.pushKV("blockundo", stats.nBlockUndo);
+    response.pushKV("coinstip", stats.nCoinsTip);
+    response.pushKV("txindex", stats.nTxIndex);
+
+    return response;
+}
+
+static UniValue omni_gettallyinfo(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 0)
+        throw runtime_error(
+            RPCHelpMan{"omni_gettallyinfo",
+               "\nReturns statistics of the in-memory tally of all addresses and their balances.\n",
+               {},
+               RPCResult{
+                   "{\n"
+                   "  \"addresses\" : n,           (number) the number of addresses in the tally\n"
+                   "  \"records\" : n,             (number) the number of balance records of all addresses\n"
+                   "  \"usage\" : n                (number) the estimated memory usage of the tally in bytes\n"
+                   "}\n"
+               },
+               RPCExamples{
+                   HelpExampleCli("omni_gettallyinfo", "")
+                   + HelpExampleRpc("omni_gettallyinfo", "")
+               }
+            }.ToString());
+
+    UniValue response(UniValue::VOBJ);
+
+    LOCK(cs_tally);
+    response.pushKV("addresses", (uint64_t)mp_tally_map.size());
+    response.pushKV("records", (uint64_t)mp_tally_map.countRecords());
+    response.pushKV("usage", (uint64_t)mp_tally_map.DynamicMemoryUsage());
+
+    return response;
+}
+
 static const CRPCCommand commands[] =
 { //  category                             name                            actor (function)               argNames
   //  ------------------------------------ ------------------------------- ------------------------------ ----------
@@ -2695,11 +2933,12 @@ static const CRPCCommand commands[] =
     { "omni layer (data retrieval)", "omni_getactivecrowdsales",       &omni_getactivecrowdsales,        {} },
     { "omni layer (data retrieval)", "omni_getorderbook",              &omni_getorderbook,               {"propertyid", "propertyid"} },
     { "omni layer (data retrieval)", "omni_gettrade",                  &omni_gettrade,                   {"txid"} },
-    { "omni layer (data retrieval)", "omni_getsto",                    &omni_getsto,                     {"txid", "recipientfilter"} },
+    { "omni layer (data retrieval)", "omni_getsto",                    &omni_getsto,                     {"txid", "recipientfilter", "skip", "count"} },
     { "omni layer (data retrieval)", "omni_listblocktransactions",     &omni_listblocktransactions,      {"index"} },
     { "omni layer (data retrieval)", "omni_listblockstransactions",    &omni_listblockstransactions,     {"firstblock", "lastblock"} },
     { "omni layer (data retrieval)", "omni_listpendingtransactions",   &omni_listpendingtransactions,    {"address"} },
     { "omni layer (data retrieval)", "omni_getallbalancesforaddress",  &omni_getallbalancesforaddress,   {"address"} },
+    { "omni layer (data retrieval)", "omni_getbalances",               &omni_getbalances,                {"addresses", "propertyids"} },
     { "omni layer (data retrieval)", "omni_gettradehistoryforaddress", &omni_gettradehistoryforaddress,  {"address", "count", "propertyid"} },
     { "omni layer (data retrieval)", "omni_gettradehistoryforpair",    &omni_gettradehistoryforpair,     {"propertyid", "propertyidsecond", "count"} },
     { "omni layer (data retrieval)", "omni_getcurrentconsensushash",   &omni_getcurrentconsensushash,    {} },
@@ -2711,6 +2950,8 @@ static const CRPCCommand commands[] =
     { "omni layer (data retrieval)", "omni_getfeedistribution",        &omni_getfeedistribution,         {"distributionid"} },
     { "omni layer (data retrieval)", "omni_getfeedistributions",       &omni_getfeedistributions,        {"propertyid"} },
     { "omni layer (data retrieval)", "omni_getbalanceshash",           &omni_getbalanceshash,            {"propertyid"} },
+    { "omni layer (data retrieval)", "omni_getprevoutcacheinfo",       &omni_getprevoutcacheinfo,        {} },
+    { "omni layer (data retrieval)", "omni_gettallyinfo",              &omni_gettallyinfo,               {} },
 #ifdef ENABLE_WALLET
     { "omni layer (data retrieval)", "omni_listtransactions",          &omni_listtransactions,           {"address", "count", "skip", "startblock", "endblock"} },
     { "omni layer (data retrieval)", "omni_getfeeshare",               &omni_getfeeshare,                {"address", "ecosystem"} },
@@ -2731,7 +2972,7 @@ static const CRPCCommand commands[] =
     { "hidden",                      "getgrants_MP",                   &omni_getgrants,                  {"propertyid"} },
     { "hidden",                      "getactivedexsells_MP",           &omni_getactivedexsells,          {"address"} },
     { "hidden",                      "getactivecrowdsales_MP",         &omni_getactivecrowdsales,        {} },
-    { "hidden",                      "getsto_MP",                      &omni_getsto,                     {"txid", "recipientfilter"} },
+    { "hidden",                      "getsto_MP",                      &omni_getsto,                     {"txid", "recipientfilter", "skip", "count"} },
     { "hidden",                      "getorderbook_MP",                &omni_getorderbook,               {"propertyid", "propertyiddesired"} },
     { "hidden",                      "gettrade_MP",                    &omni_gettrade,                   {"txid"} },
     { "hidden",                      "gettransaction_MP",              &omni_gettransaction,             {"txid"} },
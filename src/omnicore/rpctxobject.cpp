@@ -32,9 +32,6 @@
 
 #include <univalue.h>
 
-#include <boost/algorithm/string.hpp>
-#include <boost/lexical_cast.hpp>
-
 #include <stdint.h>
 #include <string>
 #include <vector>
@@ -42,6 +39,103 @@
 // Namespaces
 using namespace mastercore;
 
+/**
+ * Populates the RPC output of a parsed Omni transaction, which is not a DEx payment.
+ *
+ * @return 0 on success, -1 if filtered, or an error code
+ */
+static int populateRPCParsedTransaction(CMPTransaction& mp_obj, const uint256& blockHash, int64_t blockTime, int blockHeight, int confirmations, bool valid, int positionInBlock, const std::string& invalidReason, UniValue& txobj, const std::string& filterAddress, bool extendedDetails, const std::string& extendedDetailsFilter, interfaces::Wallet* iWallet, uint64_t skip, uint64_t count)
+{
+    const uint256 txid = mp_obj.getHash();
+
+    // check if we're filtering from listtransactions_MP, and if so whether we have a non-match we want to skip
+    if (!filterAddress.empty() && mp_obj.getSender() != filterAddress && mp_obj.getReceiver() != filterAddress) return -1;
+
+    // parse packet and populate mp_obj
+    if (!mp_obj.interpret_Transaction()) return MP_TX_IS_NOT_OMNI_PROTOCOL;
+
+    // populate some initial info for the transaction
+    bool fMine = false;
+    if (IsMyAddress(mp_obj.getSender(), iWallet) || IsMyAddress(mp_obj.getReceiver(), iWallet)) fMine = true;
+    txobj.pushKV("txid", txid.GetHex());
+    txobj.pushKV("fee", FormatDivisibleMP(mp_obj.getFeePaid()));
+    txobj.pushKV("sendingaddress", mp_obj.getSender());
+    if (showRefForTx(mp_obj.getType())) txobj.pushKV("referenceaddress", mp_obj.getReceiver());
+    txobj.pushKV("ismine", fMine);
+    txobj.pushKV("version", (uint64_t)mp_obj.getVersion());
+    txobj.pushKV("type_int", (uint64_t)mp_obj.getType());
+    if (mp_obj.getType() != MSC_TYPE_SIMPLE_SEND) { // Type 0 will add "Type" attribute during populateRPCTypeSimpleSend
+        txobj.pushKV("type", mp_obj.getTypeString());
+    }
+
+    // populate type specific info and extended details if requested
+    // extended details are not available for unconfirmed transactions
+    if (confirmations <= 0) extendedDetails = false;
+    populateRPCTypeInfo(mp_obj, txobj, mp_obj.getType(), extendedDetails, extendedDetailsFilter, confirmations, iWallet, skip, count);
+
+    // state and chain related information
+    if (confirmations != 0 && !blockHash.IsNull()) {
+        txobj.pushKV("valid", valid);
+        if (!valid) {
+            txobj.pushKV("invalidreason", invalidReason);
+        }
+        txobj.pushKV("blockhash", blockHash.GetHex());
+        txobj.pushKV("blocktime", blockTime);
+        txobj.pushKV("positioninblock", positionInBlock);
+    }
+    if (confirmations != 0) {
+        txobj.pushKV("block", blockHeight);
+    }
+    txobj.pushKV("confirmations", confirmations);
+
+    // finished
+    return 0;
+}
+
+/**
+ * Populates the RPC output of a confirmed transaction from the decoded form,
+ * which was stored when the block was connected, without resolving the inputs
+ * of the transaction.
+ *
+ * @return True, if the decoded form of a transaction in the active chain was found
+ */
+static bool populateRPCDecodedTransaction(const uint256& txid, UniValue& txobj, const std::string& filterAddress, bool extendedDetails, const std::string& extendedDetailsFilter, interfaces::Wallet* iWallet, uint64_t skip, uint64_t count, int& populateResult)
+{
+    CDecodedTransaction decoded;
+    {
+        LOCK(cs_tally);
+        if (!pDbTransaction->FetchDecodedTransaction(txid, decoded)) return false;
+    }
+
+    int blockHeight = 0;
+    int64_t blockTime = 0;
+    int confirmations = 0;
+    {
+        LOCK(cs_main);
+        BlockMap::const_iterator it = mapBlockIndex.find(decoded.blockHash);
+        if (it == mapBlockIndex.end() || !chainActive.Contains(it->second)) {
+            return false; // disconnected since, the transaction is parsed again
+        }
+        blockHeight = it->second->nHeight;
+        blockTime = it->second->nTime;
+        confirmations = 1 + chainActive.Height() - blockHeight;
+    }
+
+    CMPTransaction mp_obj;
+    mp_obj.Set(decoded.sender, decoded.reference, 0, txid, blockHeight, decoded.posInBlock,
+            decoded.payload.data(), decoded.payload.size(), decoded.encodingClass, decoded.fee);
+
+    // the validity of a transaction is determined, when it's processed
+    bool valid = (0 <= decoded.processingResult);
+    std::string invalidReason;
+    if (!valid) invalidReason = error_str(decoded.processingResult);
+
+    populateResult = populateRPCParsedTransaction(mp_obj, decoded.blockHash, blockTime, blockHeight, confirmations,
+            valid, decoded.posInBlock, invalidReason, txobj, filterAddress, extendedDetails, extendedDetailsFilter, iWallet, skip, count);
+
+    return true;
+}
+
 /**
  * Function to standardize RPC output for transactions into a JSON object in either basic or extended mode.
  *
@@ -49,9 +143,17 @@ using namespace mastercore;
  * Use extended mode for transaction specific calls (e.g. omni_getsto, omni_gettrade etc.)
  *
  * DEx payments and the extended mode are only available for confirmed transactions.
+ * The recipients of send-to-owners transactions can be retrieved page-wise with skip and count.
+ *
+ * Confirmed transactions are populated from their stored decoded form, if available.
  */
-int populateRPCTransactionObject(const uint256& txid, UniValue& txobj, std::string filterAddress, bool extendedDetails, std::string extendedDetailsFilter, interfaces::Wallet* iWallet)
+int populateRPCTransactionObject(const uint256& txid, UniValue& txobj, std::string filterAddress, bool extendedDetails, std::string extendedDetailsFilter, interfaces::Wallet* iWallet, uint64_t skip, uint64_t count)
 {
+    int populateResult = 0;
+    if (populateRPCDecodedTransaction(txid, txobj, filterAddress, extendedDetails, extendedDetailsFilter, iWallet, skip, count, populateResult)) {
+        return populateResult;
+    }
+
     bool f_txindex_ready = false;
     if (g_txindex) {
         f_txindex_ready = g_txindex->BlockUntilSyncedToCurrentChain();
@@ -68,10 +170,10 @@ int populateRPCTransactionObject(const uint256& txid, UniValue& txobj, std::stri
         }
     }
 
-    return populateRPCTransactionObject(*tx, blockHash, txobj, filterAddress, extendedDetails, extendedDetailsFilter, 0, iWallet);
+    return populateRPCTransactionObject(*tx, blockHash, txobj, filterAddress, extendedDetails, extendedDetailsFilter, 0, iWallet, skip, count);
 }
 
-int populateRPCTransactionObject(const CTransaction& tx, const uint256& blockHash, UniValue& txobj, std::string filterAddress, bool extendedDetails, std::string extendedDetailsFilter, int blockHeight, interfaces::Wallet* iWallet)
+int populateRPCTransactionObject(const CTransaction& tx, const uint256& blockHash, UniValue& txobj, std::string filterAddress, bool extendedDetails, std::string extendedDetailsFilter, int blockHeight, interfaces::Wallet* iWallet, uint64_t skip, uint64_t count)
 {
     int confirmations = 0;
     int64_t blockTime = 0;
@@ -127,68 +229,32 @@ int populateRPCTransactionObject(const CTransaction& tx, const uint256& blockHas
         return 0;
     }
 
-    // check if we're filtering from listtransactions_MP, and if so whether we have a non-match we want to skip
-    if (!filterAddress.empty() && mp_obj.getSender() != filterAddress && mp_obj.getReceiver() != filterAddress) return -1;
-
-    // parse packet and populate mp_obj
-    if (!mp_obj.interpret_Transaction()) return MP_TX_IS_NOT_OMNI_PROTOCOL;
-
     // obtain validity - only confirmed transactions can be valid
     bool valid = false;
+    std::string invalidReason;
     if (confirmations > 0) {
         LOCK(cs_tally);
         valid = pDbTransactionList->getValidMPTX(txid);
         positionInBlock = pDbTransaction->FetchTransactionPosition(txid);
     }
-
-    // populate some initial info for the transaction
-    bool fMine = false;
-    if (IsMyAddress(mp_obj.getSender(), iWallet) || IsMyAddress(mp_obj.getReceiver(), iWallet)) fMine = true;
-    txobj.pushKV("txid", txid.GetHex());
-    txobj.pushKV("fee", FormatDivisibleMP(mp_obj.getFeePaid()));
-    txobj.pushKV("sendingaddress", mp_obj.getSender());
-    if (showRefForTx(mp_obj.getType())) txobj.pushKV("referenceaddress", mp_obj.getReceiver());
-    txobj.pushKV("ismine", fMine);
-    txobj.pushKV("version", (uint64_t)mp_obj.getVersion());
-    txobj.pushKV("type_int", (uint64_t)mp_obj.getType());
-    if (mp_obj.getType() != MSC_TYPE_SIMPLE_SEND) { // Type 0 will add "Type" attribute during populateRPCTypeSimpleSend
-        txobj.pushKV("type", mp_obj.getTypeString());
+    if (!valid && confirmations != 0 && !blockHash.IsNull()) {
+        invalidReason = pDbTransaction->FetchInvalidReason(txid);
     }
 
-    // populate type specific info and extended details if requested
-    // extended details are not available for unconfirmed transactions
-    if (confirmations <= 0) extendedDetails = false;
-    populateRPCTypeInfo(mp_obj, txobj, mp_obj.getType(), extendedDetails, extendedDetailsFilter, confirmations, iWallet);
-
-    // state and chain related information
-    if (confirmations != 0 && !blockHash.IsNull()) {
-        txobj.pushKV("valid", valid);
-        if (!valid) {
-            txobj.pushKV("invalidreason", pDbTransaction->FetchInvalidReason(txid));
-        }
-        txobj.pushKV("blockhash", blockHash.GetHex());
-        txobj.pushKV("blocktime", blockTime);
-        txobj.pushKV("positioninblock", positionInBlock);
-    }
-    if (confirmations != 0) {
-        txobj.pushKV("block", blockHeight);
-    }
-    txobj.pushKV("confirmations", confirmations);
-
-    // finished
-    return 0;
+    return populateRPCParsedTransaction(mp_obj, blockHash, blockTime, blockHeight, confirmations, valid, positionInBlock,
+            invalidReason, txobj, filterAddress, extendedDetails, extendedDetailsFilter, iWallet, skip, count);
 }
 
 /* Function to call respective populators based on message type
  */
-void populateRPCTypeInfo(CMPTransaction& mp_obj, UniValue& txobj, uint32_t txType, bool extendedDetails, std::string extendedDetailsFilter, int confirmations, interfaces::Wallet *iWallet)
+void populateRPCTypeInfo(CMPTransaction& mp_obj, UniValue& txobj, uint32_t txType, bool extendedDetails, std::string extendedDetailsFilter, int confirmations, interfaces::Wallet *iWallet, uint64_t skip, uint64_t count)
 {
     switch (txType) {
         case MSC_TYPE_SIMPLE_SEND:
             populateRPCTypeSimpleSend(mp_obj, txobj);
             break;
         case MSC_TYPE_SEND_TO_OWNERS:
-            populateRPCTypeSendToOwners(mp_obj, txobj, extendedDetails, extendedDetailsFilter, iWallet);
+            populateRPCTypeSendToOwners(mp_obj, txobj, extendedDetails, extendedDetailsFilter, iWallet, skip, count);
             break;
         case MSC_TYPE_SEND_ALL:
             populateRPCTypeSendAll(mp_obj, txobj, confirmations);
@@ -313,13 +379,13 @@ void populateRPCTypeSimpleSend(CMPTransaction& omniObj, UniValue& txobj)
     }
 }
 
-void populateRPCTypeSendToOwners(CMPTransaction& omniObj, UniValue& txobj, bool extendedDetails, std::string extendedDetailsFilter, interfaces::Wallet *iWallet)
+void populateRPCTypeSendToOwners(CMPTransaction& omniObj, UniValue& txobj, bool extendedDetails, std::string extendedDetailsFilter, interfaces::Wallet *iWallet, uint64_t skip, uint64_t count)
 {
     uint32_t propertyId = omniObj.getProperty();
     txobj.pushKV("propertyid", (uint64_t)propertyId);
     txobj.pushKV("divisible", isPropertyDivisible(propertyId));
     txobj.pushKV("amount", FormatMP(propertyId, omniObj.getAmount()));
-    if (extendedDetails) populateRPCExtendedTypeSendToOwners(omniObj.getHash(), extendedDetailsFilter, txobj, omniObj.getVersion(), iWallet);
+    if (extendedDetails) populateRPCExtendedTypeSendToOwners(omniObj.getHash(), extendedDetailsFilter, txobj, omniObj.getVersion(), iWallet, skip, count);
 }
 
 void populateRPCTypeSendAll(CMPTransaction& omniObj, UniValue& txobj, int confirmations)
@@ -582,12 +648,12 @@ void populateRPCTypeAnyData(CMPTransaction& omniObj, UniValue& txobj)
     txobj.pushKV("data", omniObj.getPayloadData());
 }
 
-void populateRPCExtendedTypeSendToOwners(const uint256 txid, std::string extendedDetailsFilter, UniValue& txobj, uint16_t version, interfaces::Wallet *iWallet)
+void populateRPCExtendedTypeSendToOwners(const uint256 txid, std::string extendedDetailsFilter, UniValue& txobj, uint16_t version, interfaces::Wallet *iWallet, uint64_t skip, uint64_t count)
 {
     UniValue receiveArray(UniValue::VARR);
     uint64_t tmpAmount = 0, stoFee = 0, numRecipients = 0;
     LOCK(cs_tally);
-    pDbStoList->getRecipients(txid, extendedDetailsFilter, &receiveArray, &tmpAmount, &numRecipients, iWallet);
+    pDbStoList->getRecipients(txid, extendedDetailsFilter, &receiveArray, &tmpAmount, &numRecipients, iWallet, skip, count);
     if (version == MP_TX_PKT_V0) {
         stoFee = numRecipients * TRANSFER_FEE_PER_OWNER;
     } else {
@@ -626,17 +692,14 @@ void populateRPCExtendedTypeMetaDExCancel(const uint256& txid, UniValue& txobj)
     if (0<numberOfCancels) {
         for(int refNumber = 1; refNumber <= numberOfCancels; refNumber++) {
             UniValue cancelTx(UniValue::VOBJ);
-            std::string strValue = pDbTransactionList->getKeyValue(txid.ToString() + "-C" + strprintf("%d",refNumber));
-            if (strValue.empty()) continue;
-            std::vector<std::string> vstr;
-            boost::split(vstr, strValue, boost::is_any_of(":"), boost::token_compress_on);
-            if (vstr.size() != 3) {
-                PrintToLog("TXListDB Error - trade cancel number of tokens is not as expected (%s)\n", strValue);
+            uint256 txidCancelled;
+            uint32_t propId = 0;
+            int64_t amountUnreserved = 0;
+            if (!pDbTransactionList->getMetaDExCancelDetails(txid, refNumber, txidCancelled, propId, amountUnreserved)) {
+                PrintToLog("TXListDB Error - trade cancel %s-C%d could not be loaded\n", txid.GetHex(), refNumber);
                 continue;
             }
-            uint32_t propId = boost::lexical_cast<uint32_t>(vstr[1]);
-            int64_t amountUnreserved = boost::lexical_cast<int64_t>(vstr[2]);
-            cancelTx.pushKV("txid", vstr[0]);
+            cancelTx.pushKV("txid", txidCancelled.GetHex());
             cancelTx.pushKV("propertyid", (uint64_t) propId);
             cancelTx.pushKV("amountunreserved", FormatMP(propId, amountUnreserved));
             cancelArray.push_back(cancelTx);
@@ -12,6 +12,7 @@
 #include <omnicore/log.h>
 #include <omnicore/omnicore.h>
 #include <omnicore/notifications.h>
+#include <omnicore/undo.h>
 #include <omnicore/utilsbitcoin.h>
 #include <omnicore/version.h>
 
@@ -22,6 +23,7 @@
 #include <ui_interface.h>
 
 #include <stdint.h>
+#include <array>
 #include <limits>
 #include <string>
 #include <vector>
@@ -442,6 +444,227 @@ bool IsAllowedOutputType(int whichType, int nBlock)
     return false;
 }
 
+/**
+ * Retrieves the block at which a feature is activated.
+ *
+ * @return False, if the feature is unknown
+ */
+static bool GetFeatureActivationBlock(const CConsensusParams& params, uint16_t featureId, int& activationBlock)
+{
+    switch (featureId) {
+        case FEATURE_CLASS_C:
+            activationBlock = params.NULLDATA_BLOCK;
+            break;
+        case FEATURE_METADEX:
+            activationBlock = params.MSC_METADEX_BLOCK;
+            break;
+        case FEATURE_BETTING:
+            activationBlock = params.MSC_BET_BLOCK;
+            break;
+        case FEATURE_GRANTEFFECTS:
+            activationBlock = params.GRANTEFFECTS_FEATURE_BLOCK;
+            break;
+        case FEATURE_DEXMATH:
+            activationBlock = params.DEXMATH_FEATURE_BLOCK;
+            break;
+        case FEATURE_SENDALL:
+            activationBlock = params.MSC_SEND_ALL_BLOCK;
+            break;
+        case FEATURE_SPCROWDCROSSOVER:
+            activationBlock = params.SPCROWDCROSSOVER_FEATURE_BLOCK;
+            break;
+        case FEATURE_TRADEALLPAIRS:
+            activationBlock = params.TRADEALLPAIRS_FEATURE_BLOCK;
+            break;
+        case FEATURE_FEES:
+            activationBlock = params.FEES_FEATURE_BLOCK;
+            break;
+        case FEATURE_STOV1:
+            activationBlock = params.MSC_STOV1_BLOCK;
+            break;
+        case FEATURE_FREEZENOTICE:
+            activationBlock = params.FREEZENOTICE_FEATURE_BLOCK;
+        break;
+        case FEATURE_FREEDEX:
+            activationBlock = params.FREEDEX_FEATURE_BLOCK;
+        break;
+        default:
+            return false;
+    }
+
+    return true;
+}
+
+namespace
+{
+//! Number of transaction types, which are looked up in the restriction table directly
+const size_t INDEXED_TX_TYPES = 256;
+//! Number of transaction versions, which are looked up in the restriction table directly
+const size_t INDEXED_TX_VERSIONS = MP_TX_PKT_V1 + 1;
+//! Number of Omni Core message types (deactivation, activation and alert), which use the version 0xFFFF
+const size_t INDEXED_MESSAGE_TYPES = OMNICORE_MESSAGE_TYPE_ALERT - OMNICORE_MESSAGE_TYPE_DEACTIVATION + 1;
+//! Highest feature identifier, which is looked up in the activation table directly
+const uint16_t MAX_INDEXED_FEATURE = FEATURE_FREEDEX;
+
+//! Activation heights, which are used by the restrictions and features
+typedef std::array<int, 19> ActivationHeights;
+
+/** Collects the activation heights, the restrictions and features depend on. */
+ActivationHeights GetActivationHeights(const CConsensusParams& params)
+{
+    return {{
+        params.NULLDATA_BLOCK, params.MSC_ALERT_BLOCK, params.MSC_SEND_BLOCK, params.MSC_DEX_BLOCK,
+        params.MSC_SP_BLOCK, params.MSC_MANUALSP_BLOCK, params.MSC_STO_BLOCK, params.MSC_METADEX_BLOCK,
+        params.MSC_SEND_ALL_BLOCK, params.MSC_BET_BLOCK, params.MSC_STOV1_BLOCK, params.MSC_ANYDATA_BLOCK,
+        params.GRANTEFFECTS_FEATURE_BLOCK, params.DEXMATH_FEATURE_BLOCK, params.SPCROWDCROSSOVER_FEATURE_BLOCK,
+        params.TRADEALLPAIRS_FEATURE_BLOCK, params.FEES_FEATURE_BLOCK, params.FREEZENOTICE_FEATURE_BLOCK,
+        params.FREEDEX_FEATURE_BLOCK
+    }};
+}
+
+/** Returns the slot of a transaction type and version in the restriction table, or -1, if it is not indexed. */
+int GetRestrictionSlot(uint16_t txType, uint16_t version)
+{
+    if (txType < INDEXED_TX_TYPES && version < INDEXED_TX_VERSIONS) {
+        return txType * INDEXED_TX_VERSIONS + version;
+    }
+    if (txType >= OMNICORE_MESSAGE_TYPE_DEACTIVATION && version == 0xFFFF) {
+        return INDEXED_TX_TYPES * INDEXED_TX_VERSIONS + (txType - OMNICORE_MESSAGE_TYPE_DEACTIVATION);
+    }
+    return -1;
+}
+
+/**
+ * Transaction restrictions and feature activation heights, compiled from the consensus parameters.
+ *
+ * The tables are compiled again, whenever the parameters or any activation height changed.
+ */
+class CCompiledRules
+{
+private:
+    /** A compiled restriction or feature activation. */
+    struct Slot
+    {
+        bool fKnown;
+        bool allowWildcard;
+        int activationBlock;
+
+        Slot() : fKnown(false), allowWildcard(false), activationBlock(std::numeric_limits<int>::max()) {}
+    };
+
+    //! The consensus parameters, the tables were compiled from
+    const CConsensusParams* pParams;
+    //! The activation heights, the tables were compiled from
+    ActivationHeights heights;
+    //! Restrictions, indexed by transaction type and version
+    std::vector<Slot> vRestrictions;
+    //! Restrictions, which can't be indexed, or which are not unique
+    std::vector<TransactionRestriction> vUnindexed;
+    //! Feature activations, indexed by feature identifier
+    std::vector<Slot> vFeatures;
+
+public:
+    CCompiledRules() : pParams(nullptr) {}
+
+    /** Checks, whether the tables were compiled from the current state of the parameters. */
+    bool IsCompiledFrom(const CConsensusParams& params) const
+    {
+        return pParams == &params && heights == GetActivationHeights(params);
+    }
+
+    /** Compiles the restriction and feature activation tables. */
+    void Compile(const CConsensusParams& params)
+    {
+        pParams = &params;
+        heights = GetActivationHeights(params);
+
+        vRestrictions.assign(INDEXED_TX_TYPES * INDEXED_TX_VERSIONS + INDEXED_MESSAGE_TYPES, Slot());
+        vUnindexed.clear();
+        const std::vector<TransactionRestriction> vTxRestrictions = params.GetRestrictions();
+        for (std::vector<TransactionRestriction>::const_iterator it = vTxRestrictions.begin(); it != vTxRestrictions.end(); ++it) {
+            int nSlot = GetRestrictionSlot(it->txType, it->txVersion);
+            if (nSlot < 0 || vRestrictions[nSlot].fKnown) {
+                vUnindexed.push_back(*it);
+                continue;
+            }
+            Slot& slot = vRestrictions[nSlot];
+            slot.fKnown = true;
+            slot.allowWildcard = it->allowWildcard;
+            slot.activationBlock = it->activationBlock;
+        }
+
+        vFeatures.assign(MAX_INDEXED_FEATURE + 1, Slot());
+        for (uint16_t featureId = 0; featureId <= MAX_INDEXED_FEATURE; ++featureId) {
+            Slot& slot = vFeatures[featureId];
+            slot.fKnown = GetFeatureActivationBlock(params, featureId, slot.activationBlock);
+        }
+    }
+
+    bool IsFeatureActivated(uint16_t featureId, int transactionBlock) const
+    {
+        if (featureId >= vFeatures.size()) {
+            int activationBlock = std::numeric_limits<int>::max();
+            return GetFeatureActivationBlock(*pParams, featureId, activationBlock) && transactionBlock >= activationBlock;
+        }
+        const Slot& slot = vFeatures[featureId];
+
+        return slot.fKnown && transactionBlock >= slot.activationBlock;
+    }
+
+    bool IsTransactionTypeAllowed(int txBlock, uint32_t txProperty, uint16_t txType, uint16_t version) const
+    {
+        int nSlot = GetRestrictionSlot(txType, version);
+        if (nSlot >= 0 && IsAllowed(vRestrictions[nSlot].fKnown, vRestrictions[nSlot].allowWildcard, vRestrictions[nSlot].activationBlock, txBlock, txProperty)) {
+            return true;
+        }
+
+        for (std::vector<TransactionRestriction>::const_iterator it = vUnindexed.begin(); it != vUnindexed.end(); ++it) {
+            if (it->txType == txType && it->txVersion == version && IsAllowed(true, it->allowWildcard, it->activationBlock, txBlock, txProperty)) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+private:
+    static bool IsAllowed(bool fKnown, bool allowWildcard, int activationBlock, int txBlock, uint32_t txProperty)
+    {
+        if (!fKnown) {
+            return false;
+        }
+        // a property identifier of 0 (= BTC) may be used as wildcard
+        if (OMNI_PROPERTY_BTC == txProperty && !allowWildcard) {
+            return false;
+        }
+        // transactions are not restricted in the test ecosystem
+        if (isTestEcosystemProperty(txProperty)) {
+            return true;
+        }
+        return (txBlock >= activationBlock);
+    }
+};
+
+/**
+ * Returns the compiled rules of the current consensus parameters.
+ *
+ * Each thread holds its own tables, which are compiled again, if the network was
+ * switched, or if any activation height changed, e.g. after a feature activation,
+ * a deactivation or when an activation is reverted.
+ */
+const CCompiledRules& GetCompiledRules()
+{
+    static thread_local CCompiledRules compiledRules;
+
+    const CConsensusParams& params = ConsensusParams();
+    if (!compiledRules.IsCompiledFrom(params)) {
+        compiledRules.Compile(params);
+    }
+
+    return compiledRules;
+}
+} // anonymous namespace
+
 /**
  * Activates a feature at a specific block height, authorization has already been validated.
  *
@@ -469,6 +692,9 @@ bool ActivateFeature(uint16_t featureId, int activationBlock, uint32_t minClient
         return false;
     }
 
+    // the consensus parameters are modified below
+    RecordActivationUndo();
+
     // check feature is recognized and activation is successful
     std::string featureName = GetFeatureName(featureId);
     bool supported = OMNICORE_VERSION >= minClientVersion;
@@ -545,6 +771,9 @@ bool DeactivateFeature(uint16_t featureId, int transactionBlock)
         return false;
     }
 
+    // the consensus parameters are modified below
+    RecordActivationUndo();
+
     std::string featureName = GetFeatureName(featureId);
     switch (featureId) {
         case FEATURE_CLASS_C:
@@ -625,51 +854,7 @@ std::string GetFeatureName(uint16_t featureId)
  */
 bool IsFeatureActivated(uint16_t featureId, int transactionBlock)
 {
-    const CConsensusParams& params = ConsensusParams();
-    int activationBlock = std::numeric_limits<int>::max();
-
-    switch (featureId) {
-        case FEATURE_CLASS_C:
-            activationBlock = params.NULLDATA_BLOCK;
-            break;
-        case FEATURE_METADEX:
-            activationBlock = params.MSC_METADEX_BLOCK;
-            break;
-        case FEATURE_BETTING:
-            activationBlock = params.MSC_BET_BLOCK;
-            break;
-        case FEATURE_GRANTEFFECTS:
-            activationBlock = params.GRANTEFFECTS_FEATURE_BLOCK;
-            break;
-        case FEATURE_DEXMATH:
-            activationBlock = params.DEXMATH_FEATURE_BLOCK;
-            break;
-        case FEATURE_SENDALL:
-            activationBlock = params.MSC_SEND_ALL_BLOCK;
-            break;
-        case FEATURE_SPCROWDCROSSOVER:
-            activationBlock = params.SPCROWDCROSSOVER_FEATURE_BLOCK;
-            break;
-        case FEATURE_TRADEALLPAIRS:
-            activationBlock = params.TRADEALLPAIRS_FEATURE_BLOCK;
-            break;
-        case FEATURE_FEES:
-            activationBlock = params.FEES_FEATURE_BLOCK;
-            break;
-        case FEATURE_STOV1:
-            activationBlock = params.MSC_STOV1_BLOCK;
-            break;
-        case FEATURE_FREEZENOTICE:
-            activationBlock = params.FREEZENOTICE_FEATURE_BLOCK;
-        break;
-        case FEATURE_FREEDEX:
-            activationBlock = params.FREEDEX_FEATURE_BLOCK;
-        break;
-        default:
-            return false;
-    }
-
-    return (transactionBlock >= activationBlock);
+    return GetCompiledRules().IsFeatureActivated(featureId, transactionBlock);
 }
 
 /**
@@ -683,28 +868,7 @@ bool IsFeatureActivated(uint16_t featureId, int transactionBlock)
  */
 bool IsTransactionTypeAllowed(int txBlock, uint32_t txProperty, uint16_t txType, uint16_t version)
 {
-    const std::vector<TransactionRestriction>& vTxRestrictions = ConsensusParams().GetRestrictions();
-
-    for (std::vector<TransactionRestriction>::const_iterator it = vTxRestrictions.begin(); it != vTxRestrictions.end(); ++it)
-    {
-        const TransactionRestriction& entry = *it;
-        if (entry.txType != txType || entry.txVersion != version) {
-            continue;
-        }
-        // a property identifier of 0 (= BTC) may be used as wildcard
-        if (OMNI_PROPERTY_BTC == txProperty && !entry.allowWildcard) {
-            continue;
-        }
-        // transactions are not restricted in the test ecosystem
-        if (isTestEcosystemProperty(txProperty)) {
-            return true;
-        }
-        if (txBlock >= entry.activationBlock) {
-            return true;
-        }
-    }
-
-    return false;
+    return GetCompiledRules().IsTransactionTypeAllowed(txBlock, txProperty, txType, version);
 }
 
 /**
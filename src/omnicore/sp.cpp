@@ -5,6 +5,7 @@
 #include <omnicore/log.h>
 #include <omnicore/omnicore.h>
 #include <omnicore/uint256_extensions.h>
+#include <omnicore/undo.h>
 
 #include <arith_uint256.h>
 #include <hash.h>
@@ -122,18 +123,17 @@ bool mastercore::IsPropertyIdValid(uint32_t propertyId)
 
 bool mastercore::isPropertyDivisible(uint32_t propertyId)
 {
-    // TODO: is a lock here needed
-    CMPSPInfo::Entry sp;
+    CMPSPInfo::HotFields sp;
 
-    if (pDbSpInfo->getSP(propertyId, sp)) return sp.isDivisible();
+    if (pDbSpInfo->getSPHotFields(propertyId, sp)) return sp.divisible;
 
     return true;
 }
 
 std::string mastercore::getPropertyName(uint32_t propertyId)
 {
-    CMPSPInfo::Entry sp;
-    if (pDbSpInfo->getSP(propertyId, sp)) return sp.name;
+    CMPSPInfo::EntryPtr sp = pDbSpInfo->getSPEntry(propertyId);
+    if (sp) return sp->name;
     return "Property Name Not Found";
 }
 
@@ -358,6 +358,7 @@ void mastercore::eraseMaxedCrowdsale(const std::string& address, int64_t blockTi
         assert(pDbSpInfo->updateSP(crowdsale.getPropertyId(), sp));
 
         // no calculate fractional calls here, no more tokens (at MAX)
+        RecordCrowdUndo(address);
         my_crowds.erase(it);
     }
 }
@@ -404,6 +405,7 @@ unsigned int mastercore::eraseExpiredCrowdsale(const CBlockIndex* pBlockIndex)
                 assert(update_tally_map(sp.issuer, crowdsale.getPropertyId(), missedTokens, BALANCE));
             }
 
+            RecordCrowdUndo(my_it->first);
             my_crowds.erase(my_it++);
 
             ++how_many_erased;
@@ -5,6 +5,8 @@
 #include <omnicore/dbspinfo.h>
 #include <omnicore/log.h>
 
+#include <serialize.h>
+
 class CBlockIndex;
 class CHash256;
 class uint256;
@@ -62,6 +64,21 @@ public:
     std::string toString(const std::string& address) const;
     void print(const std::string& address, FILE* fp = stdout) const;
     void saveCrowdSale(std::ofstream& file, const std::string& addr, CHash256 &hasher) const;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(propertyId);
+        READWRITE(nValue);
+        READWRITE(property_desired);
+        READWRITE(deadline);
+        READWRITE(early_bird);
+        READWRITE(percentage);
+        READWRITE(u_created);
+        READWRITE(i_created);
+        READWRITE(txFundraiserData);
+    }
 };
 
 namespace mastercore
@@ -40,17 +40,19 @@ OwnerAddrType STO_GetReceivers(const std::string& sender, uint32_t property, int
 
     {
         LOCK(cs_tally);
-        std::unordered_map<std::string, CMPTally>::iterator it;
+        // only the holders of the property are visited, instead of all addresses
+        const std::set<std::string>& holders = GetPropertyHolders(property);
 
-        for (it = mp_tally_map.begin(); it != mp_tally_map.end(); ++it) {
-            const std::string& address = it->first;
-            const CMPTally& tally = it->second;
+        for (std::set<std::string>::const_iterator it = holders.begin(); it != holders.end(); ++it) {
+            const std::string& address = *it;
+            const CMPTally* tally = getTally(address);
+            assert(tally != nullptr);
 
             int64_t tokens = 0;
-            tokens += tally.getMoney(property, BALANCE);
-            tokens += tally.getMoney(property, SELLOFFER_RESERVE);
-            tokens += tally.getMoney(property, ACCEPT_RESERVE);
-            tokens += tally.getMoney(property, METADEX_RESERVE);
+            tokens += tally->getMoney(property, BALANCE);
+            tokens += tally->getMoney(property, SELLOFFER_RESERVE);
+            tokens += tally->getMoney(property, ACCEPT_RESERVE);
+            tokens += tally->getMoney(property, METADEX_RESERVE);
 
             // Do not include the sender
             if (address == sender) {
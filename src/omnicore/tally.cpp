@@ -3,15 +3,26 @@
 #include <omnicore/log.h>
 #include <omnicore/omnicore.h>
 
+#include <crypto/siphash.h>
+#include <memusage.h>
+#include <random.h>
+
+#include <assert.h>
+#include <stddef.h>
 #include <stdint.h>
-#include <map>
+
+#include <algorithm>
+#include <deque>
+#include <limits>
+#include <string>
+#include <utility>
+#include <vector>
 
 /**
  * Creates an empty tally.
  */
-CMPTally::CMPTally()
+CMPTally::CMPTally() : my_pos(0)
 {
-    my_it = mp_token.begin();
 }
 
 /**
@@ -22,9 +33,9 @@ CMPTally::CMPTally()
 uint32_t CMPTally::init()
 {
     uint32_t propertyId = 0;
-    my_it = mp_token.begin();
-    if (my_it != mp_token.end()) {
-        propertyId = my_it->first;
+    my_pos = 0;
+    if (my_pos < mp_token.size()) {
+        propertyId = mp_token[my_pos].first;
     }
     return propertyId;
 }
@@ -37,13 +48,31 @@ uint32_t CMPTally::init()
 uint32_t CMPTally::next()
 {
     uint32_t ret = 0;
-    if (my_it != mp_token.end()) {
-        ret = my_it->first;
-        ++my_it;
+    if (my_pos < mp_token.size()) {
+        ret = mp_token[my_pos].first;
+        ++my_pos;
     }
     return ret;
 }
 
+/**
+ * Returns the balance record of a property.
+ *
+ * @param propertyId  The identifier of the tally to lookup
+ * @return The balance record, or nullptr, if there is none
+ */
+const CMPTally::BalanceRecord* CMPTally::find(uint32_t propertyId) const
+{
+    TokenMap::const_iterator it = std::lower_bound(mp_token.begin(), mp_token.end(), propertyId,
+        [](const TokenMap::value_type& entry, uint32_t id) { return entry.first < id; });
+
+    if (it != mp_token.end() && it->first == propertyId) {
+        return &(it->second);
+    }
+
+    return nullptr;
+}
+
 /**
  * Checks whether the addition of a + b overflows.
  *
@@ -73,7 +102,15 @@ bool CMPTally::updateMoney(uint32_t propertyId, int64_t amount, TallyType ttype)
         return false;
     }
     bool fUpdated = false;
-    int64_t now64 = mp_token[propertyId].balance[ttype];
+
+    // the record is created, even if the update fails, as done by the former map based tally
+    TokenMap::iterator it = std::lower_bound(mp_token.begin(), mp_token.end(), propertyId,
+        [](const TokenMap::value_type& entry, uint32_t id) { return entry.first < id; });
+    if (it == mp_token.end() || it->first != propertyId) {
+        BalanceRecord emptyRecord = {};
+        it = mp_token.insert(it, std::make_pair(propertyId, emptyRecord));
+    }
+    int64_t now64 = it->second.balance[ttype];
 
     if (isOverflow(now64, amount)) {
         PrintToLog("%s(): ERROR: arithmetic overflow [%d + %d]\n", __func__, now64, amount);
@@ -86,7 +123,7 @@ bool CMPTally::updateMoney(uint32_t propertyId, int64_t amount, TallyType ttype)
     } else {
 
         now64 += amount;
-        mp_token[propertyId].balance[ttype] = now64;
+        it->second.balance[ttype] = now64;
 
         fUpdated = true;
     }
@@ -107,11 +144,10 @@ int64_t CMPTally::getMoney(uint32_t propertyId, TallyType ttype) const
         return 0;
     }
     int64_t money = 0;
-    TokenMap::const_iterator it = mp_token.find(propertyId);
+    const BalanceRecord* record = find(propertyId);
 
-    if (it != mp_token.end()) {
-        const BalanceRecord& record = it->second;
-        money = record.balance[ttype];
+    if (record) {
+        money = record->balance[ttype];
     }
 
     return money;
@@ -128,14 +164,13 @@ int64_t CMPTally::getMoney(uint32_t propertyId, TallyType ttype) const
  */
 int64_t CMPTally::getMoneyAvailable(uint32_t propertyId) const
 {
-    TokenMap::const_iterator it = mp_token.find(propertyId);
+    const BalanceRecord* record = find(propertyId);
 
-    if (it != mp_token.end()) {
-        const BalanceRecord& record = it->second;
-        if (record.balance[PENDING] < 0) {
-            return record.balance[BALANCE] + record.balance[PENDING];
+    if (record) {
+        if (record->balance[PENDING] < 0) {
+            return record->balance[BALANCE] + record->balance[PENDING];
         } else {
-            return record.balance[BALANCE];
+            return record->balance[BALANCE];
         }
     }
 
@@ -154,13 +189,12 @@ int64_t CMPTally::getMoneyAvailable(uint32_t propertyId) const
 int64_t CMPTally::getMoneyReserved(uint32_t propertyId) const
 {
     int64_t money = 0;
-    TokenMap::const_iterator it = mp_token.find(propertyId);
+    const BalanceRecord* record = find(propertyId);
 
-    if (it != mp_token.end()) {
-        const BalanceRecord& record = it->second;
-        money += record.balance[SELLOFFER_RESERVE];
-        money += record.balance[ACCEPT_RESERVE];
-        money += record.balance[METADEX_RESERVE];
+    if (record) {
+        money += record->balance[SELLOFFER_RESERVE];
+        money += record->balance[ACCEPT_RESERVE];
+        money += record->balance[METADEX_RESERVE];
     }
 
     return money;
@@ -228,15 +262,14 @@ int64_t CMPTally::print(uint32_t propertyId, bool bDivisible) const
     int64_t pending = 0;
     int64_t metadex_reserve = 0;
 
-    TokenMap::const_iterator it = mp_token.find(propertyId);
+    const BalanceRecord* record = find(propertyId);
 
-    if (it != mp_token.end()) {
-        const BalanceRecord& record = it->second;
-        balance = record.balance[BALANCE];
-        selloffer_reserve = record.balance[SELLOFFER_RESERVE];
-        accept_reserve = record.balance[ACCEPT_RESERVE];
-        pending = record.balance[PENDING];
-        metadex_reserve = record.balance[METADEX_RESERVE];
+    if (record) {
+        balance = record->balance[BALANCE];
+        selloffer_reserve = record->balance[SELLOFFER_RESERVE];
+        accept_reserve = record->balance[ACCEPT_RESERVE];
+        pending = record->balance[PENDING];
+        metadex_reserve = record->balance[METADEX_RESERVE];
     }
 
     if (bDivisible) {
@@ -251,3 +284,252 @@ int64_t CMPTally::print(uint32_t propertyId, bool bDivisible) const
 
     return (balance + selloffer_reserve + accept_reserve + metadex_reserve);
 }
+
+/**
+ * Returns the estimated heap memory usage of the tally.
+ */
+size_t CMPTally::DynamicMemoryUsage() const
+{
+    return memusage::DynamicUsage(mp_token);
+}
+
+/**
+ * Returns the estimated heap memory usage of a string.
+ *
+ * Short strings are stored within the string object, without allocation.
+ */
+static size_t StringUsage(const std::string& str)
+{
+    static const size_t nInlineCapacity = std::string().capacity();
+
+    return (str.capacity() > nInlineCapacity) ? memusage::MallocUsage(str.capacity() + 1) : 0;
+}
+
+const uint32_t CMPTallyMap::NO_ID;
+
+/**
+ * Creates an empty map with random hash salt.
+ */
+CMPTallyMap::CMPTallyMap()
+  : k0(GetRand(std::numeric_limits<uint64_t>::max())),
+    k1(GetRand(std::numeric_limits<uint64_t>::max())),
+    fAllChanged(true)
+{
+}
+
+/**
+ * Returns the slot of an address.
+ *
+ * The hash table must not be empty.
+ *
+ * @param address  The address to lookup
+ * @return The slot holding the identifier of the address, or the empty slot, where it can be inserted
+ */
+size_t CMPTallyMap::findSlot(const std::string& address) const
+{
+    // the number of slots is a power of two
+    const size_t mask = slots.size() - 1;
+    size_t pos = CSipHasher(k0, k1).Write((const unsigned char*) address.data(), address.size()).Finalize() & mask;
+
+    while (slots[pos] != 0 && entries[slots[pos] - 1].first != address) {
+        pos = (pos + 1) & mask;
+    }
+
+    return pos;
+}
+
+/**
+ * Resizes the hash table, and inserts all identifiers again.
+ *
+ * @param nSlots  The new number of slots, a power of two
+ */
+void CMPTallyMap::rehash(size_t nSlots)
+{
+    slots.assign(nSlots, 0);
+
+    for (size_t id = 0; id < entries.size(); ++id) {
+        slots[findSlot(entries[id].first)] = id + 1;
+    }
+}
+
+/**
+ * Removes all addresses and tallies.
+ */
+void CMPTallyMap::clear()
+{
+    entries.clear();
+    slots.clear();
+    changed.clear();
+    changedFlags.clear();
+    fAllChanged = true;
+    orderedIds.clear();
+}
+
+/**
+ * Returns the identifier of an address.
+ *
+ * @param address  The address to lookup
+ * @return The identifier, or NO_ID, if the address is unknown
+ */
+uint32_t CMPTallyMap::getId(const std::string& address) const
+{
+    if (slots.empty()) {
+        return NO_ID;
+    }
+
+    const uint32_t slot = slots[findSlot(address)];
+
+    return (slot != 0) ? slot - 1 : NO_ID;
+}
+
+/**
+ * Returns the identifier of an address, and adds the address with an empty
+ * tally, if it is unknown.
+ *
+ * @param address  The address to lookup or add
+ * @return The identifier of the address
+ */
+uint32_t CMPTallyMap::intern(const std::string& address)
+{
+    size_t pos = 0;
+
+    if (!slots.empty()) {
+        pos = findSlot(address);
+        if (slots[pos] != 0) {
+            return slots[pos] - 1;
+        }
+    }
+
+    // keep the load factor at or below one half, so probe sequences are short
+    if ((entries.size() + 1) * 2 > slots.size()) {
+        rehash(std::max<size_t>(64, slots.size() * 2));
+        pos = findSlot(address);
+    }
+
+    assert(entries.size() < NO_ID);
+    const uint32_t id = entries.size();
+    entries.push_back(std::make_pair(address, CMPTally()));
+    slots[pos] = id + 1;
+
+    return id;
+}
+
+/**
+ * Returns the tally of an address.
+ *
+ * @param address  The address to lookup
+ * @return The tally, or nullptr, if the address is unknown
+ */
+CMPTally* CMPTallyMap::find(const std::string& address)
+{
+    const uint32_t id = getId(address);
+
+    return (id != NO_ID) ? &(entries[id].second) : nullptr;
+}
+
+const CMPTally* CMPTallyMap::find(const std::string& address) const
+{
+    const uint32_t id = getId(address);
+
+    return (id != NO_ID) ? &(entries[id].second) : nullptr;
+}
+
+/**
+ * Returns the number of balance records of all addresses.
+ */
+size_t CMPTallyMap::countRecords() const
+{
+    size_t nRecords = 0;
+
+    for (const_iterator it = entries.begin(); it != entries.end(); ++it) {
+        nRecords += it->second.size();
+    }
+
+    return nRecords;
+}
+
+/**
+ * Returns the identifiers of all addresses, ordered by address.
+ *
+ * Identifiers are assigned in ascending order, so the addresses added since the
+ * last call are sorted on their own, and merged into the existing order, which
+ * avoids sorting all addresses again.
+ */
+const std::vector<uint32_t>& CMPTallyMap::getOrderedIds() const
+{
+    const size_t nOrdered = orderedIds.size();
+    if (nOrdered == entries.size()) {
+        return orderedIds;
+    }
+
+    for (size_t id = nOrdered; id < entries.size(); ++id) {
+        orderedIds.push_back(id);
+    }
+
+    const EntryList& list = entries;
+    auto compareAddress = [&list](uint32_t lhs, uint32_t rhs) { return list[lhs].first < list[rhs].first; };
+    std::sort(orderedIds.begin() + nOrdered, orderedIds.end(), compareAddress);
+    std::inplace_merge(orderedIds.begin(), orderedIds.begin() + nOrdered, orderedIds.end(), compareAddress);
+
+    return orderedIds;
+}
+
+/**
+ * Marks the tally of an identifier as changed.
+ *
+ * Each identifier is recorded once, so the list of changes is bounded by the
+ * number of addresses, even if the changes are never taken.
+ */
+void CMPTallyMap::markChanged(uint32_t id)
+{
+    assert(id < entries.size());
+
+    if (fAllChanged) {
+        return;
+    }
+    if (changedFlags.size() <= id) {
+        changedFlags.resize(entries.size(), false);
+    }
+    if (!changedFlags[id]) {
+        changedFlags[id] = true;
+        changed.push_back(id);
+    }
+}
+
+/**
+ * Moves the identifiers of changed tallies into vIds, and resets the change tracking.
+ */
+bool CMPTallyMap::takeChanged(std::vector<uint32_t>& vIds)
+{
+    bool fPartial = !fAllChanged;
+
+    if (fPartial) {
+        vIds.insert(vIds.end(), changed.begin(), changed.end());
+    }
+    for (std::vector<uint32_t>::const_iterator it = changed.begin(); it != changed.end(); ++it) {
+        changedFlags[*it] = false;
+    }
+    changed.clear();
+    fAllChanged = false;
+
+    return fPartial;
+}
+
+/**
+ * Returns the estimated heap memory usage of the map, including the addresses
+ * and balance records.
+ */
+size_t CMPTallyMap::DynamicMemoryUsage() const
+{
+    // the deque allocates its elements in blocks, which is approximated by the size of all elements
+    size_t nUsage = memusage::MallocUsage(sizeof(EntryList::value_type) * entries.size());
+    nUsage += memusage::DynamicUsage(slots) + memusage::DynamicUsage(changed);
+    nUsage += memusage::DynamicUsage(orderedIds);
+
+    for (const_iterator it = entries.begin(); it != entries.end(); ++it) {
+        nUsage += StringUsage(it->first);
+        nUsage += it->second.DynamicMemoryUsage();
+    }
+
+    return nUsage;
+}
@@ -1,8 +1,12 @@
 #ifndef BITCOIN_OMNICORE_TALLY_H
 #define BITCOIN_OMNICORE_TALLY_H
 
+#include <stddef.h>
 #include <stdint.h>
-#include <map>
+#include <deque>
+#include <string>
+#include <utility>
+#include <vector>
 
 //! Balance record types
 enum TallyType {
@@ -23,12 +27,15 @@ private:
         int64_t balance[TALLY_TYPE_COUNT];
     } BalanceRecord;
 
-    //! Map of balance records
-    typedef std::map<uint32_t, BalanceRecord> TokenMap;
+    //! Balance records, sorted by property identifier
+    typedef std::vector<std::pair<uint32_t, BalanceRecord> > TokenMap;
     //! Balance records for different tokens
     TokenMap mp_token;
-    //! Internal iterator pointing to a balance record
-    TokenMap::iterator my_it;
+    //! Internal position of a balance record, used for iterations
+    size_t my_pos;
+
+    /** Returns the balance record of a property, or nullptr, if there is none. */
+    const BalanceRecord* find(uint32_t propertyId) const;
 
 public:
     /** Creates an empty tally. */
@@ -60,6 +67,110 @@ public:
 
     /** Prints a balance record to the console. */
     int64_t print(uint32_t propertyId = 1, bool bDivisible = true) const;
+
+    /** Returns the number of balance records. */
+    size_t size() const { return mp_token.size(); }
+
+    /** Returns the estimated heap memory usage of the tally. */
+    size_t DynamicMemoryUsage() const;
+};
+
+/** Tallies of all addresses.
+ *
+ * Addresses are interned to dense identifiers, which are assigned in the order
+ * the addresses are added. Addresses are only removed, when the whole map is
+ * cleared, so identifiers remain stable, and tallies are stored in a deque
+ * indexed by identifier. Adding addresses doesn't move existing tallies, so
+ * references to tallies remain valid until the map is cleared.
+ *
+ * The identifiers of addresses are found via an open addressing hash table
+ * with linear probing, which is keyed by a salted SipHash of the address.
+ */
+class CMPTallyMap
+{
+public:
+    typedef std::deque<std::pair<std::string, CMPTally> > EntryList;
+    typedef EntryList::iterator iterator;
+    typedef EntryList::const_iterator const_iterator;
+
+    //! Identifier returned for unknown addresses
+    static const uint32_t NO_ID = 0xffffffff;
+
+private:
+    //! Addresses and tallies, indexed by identifier
+    EntryList entries;
+    //! Hash table of identifiers plus one, zero marks an empty slot
+    std::vector<uint32_t> slots;
+    //! Salt of the address hashes
+    uint64_t k0, k1;
+    //! Identifiers of addresses with changed tallies, since the changes were last taken
+    std::vector<uint32_t> changed;
+    //! Whether an identifier is part of the changed list, indexed by identifier
+    std::vector<bool> changedFlags;
+    //! Whether all addresses are considered as changed, e.g. after the map was cleared
+    bool fAllChanged;
+    //! Identifiers ordered by address, new identifiers are merged in on demand
+    mutable std::vector<uint32_t> orderedIds;
+
+    /** Returns the slot of an address, which is either empty or holds the address. */
+    size_t findSlot(const std::string& address) const;
+
+    /** Resizes the hash table, and inserts all identifiers again. */
+    void rehash(size_t nSlots);
+
+public:
+    /** Creates an empty map. */
+    CMPTallyMap();
+
+    iterator begin() { return entries.begin(); }
+    iterator end() { return entries.end(); }
+    const_iterator begin() const { return entries.begin(); }
+    const_iterator end() const { return entries.end(); }
+
+    /** Returns the number of addresses. */
+    size_t size() const { return entries.size(); }
+
+    /** Returns true, if there are no addresses. */
+    bool empty() const { return entries.empty(); }
+
+    /** Removes all addresses and tallies. */
+    void clear();
+
+    /** Returns the identifier of an address, or NO_ID, if the address is unknown. */
+    uint32_t getId(const std::string& address) const;
+
+    /** Returns the identifier of an address, and adds the address with an empty tally, if it is unknown. */
+    uint32_t intern(const std::string& address);
+
+    /** Returns the address of an identifier. */
+    const std::string& getAddress(uint32_t id) const { return entries[id].first; }
+
+    /** Returns the tally of an identifier. */
+    CMPTally& getTally(uint32_t id) { return entries[id].second; }
+    const CMPTally& getTally(uint32_t id) const { return entries[id].second; }
+
+    /** Returns the tally of an address, or nullptr, if the address is unknown. */
+    CMPTally* find(const std::string& address);
+    const CMPTally* find(const std::string& address) const;
+
+    /** Returns the number of balance records of all addresses. */
+    size_t countRecords() const;
+
+    /** Returns the identifiers of all addresses, ordered by address. */
+    const std::vector<uint32_t>& getOrderedIds() const;
+
+    /** Marks the tally of an identifier as changed. */
+    void markChanged(uint32_t id);
+
+    /**
+     * Moves the identifiers of changed tallies into vIds, and resets the change tracking.
+     *
+     * @return False, if all addresses must be considered as changed, in which case vIds stays empty
+     */
+    bool takeChanged(std::vector<uint32_t>& vIds);
+
+    /** Returns the estimated heap memory usage of the map. */
+    size_t DynamicMemoryUsage() const;
 };
 
 
@@ -16,16 +16,6 @@
 #include <stdint.h>
 #include <string>
 
-namespace mastercore
-{
-extern std::string GenerateConsensusString(const CMPTally& tallyObj, const std::string& address, const uint32_t propertyId); // done
-extern std::string GenerateConsensusString(const CMPOffer& offerObj, const std::string& address); // half
-extern std::string GenerateConsensusString(const CMPAccept& acceptObj, const std::string& address);
-extern std::string GenerateConsensusString(const CMPMetaDEx& tradeObj);
-extern std::string GenerateConsensusString(const CMPCrowd& crowdObj);
-extern std::string GenerateConsensusString(const uint32_t propertyId, const std::string& address);
-}
-
 extern void clear_all_state();
 
 using namespace mastercore;
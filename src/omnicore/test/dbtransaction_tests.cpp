@@ -0,0 +1,88 @@
+#include <omnicore/createpayload.h>
+#include <omnicore/dbtransaction.h>
+#include <omnicore/errors.h>
+#include <omnicore/omnicore.h>
+#include <omnicore/tx.h>
+#include <omnicore/test/utils_db.h>
+
+#include <test/test_bitcoin.h>
+#include <uint256.h>
+#include <util/system.h>
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+using namespace mastercore;
+
+namespace
+{
+CDecodedTransaction DecodedSimpleSend(int nBlock, int64_t amount)
+{
+    CDecodedTransaction decoded;
+    decoded.blockHash = Txid(nBlock);
+    decoded.posInBlock = 7;
+    decoded.processingResult = PKT_ERROR_SEND - 25;
+    decoded.encodingClass = OMNI_CLASS_C;
+    decoded.fee = 10000;
+    decoded.sender = "alice";
+    decoded.reference = "bobby";
+    decoded.payload = CreatePayload_SimpleSend(OMNI_PROPERTY_MSC, amount);
+    return decoded;
+}
+}
+
+BOOST_FIXTURE_TEST_SUITE(omnicore_dbtransaction_tests, OmniDBTestingSetup<COmniTransactionDB>)
+
+BOOST_AUTO_TEST_CASE(decoded_transaction_roundtrip)
+{
+    pDb->RecordDecodedTransaction(Txid(1), DecodedSimpleSend(300, 50));
+
+    CDecodedTransaction decoded;
+    BOOST_CHECK(!pDb->FetchDecodedTransaction(Txid(2), decoded));
+    BOOST_CHECK(pDb->FetchDecodedTransaction(Txid(1), decoded));
+    BOOST_CHECK(decoded.blockHash == Txid(300));
+    BOOST_CHECK_EQUAL(decoded.posInBlock, 7U);
+    BOOST_CHECK_EQUAL(decoded.processingResult, PKT_ERROR_SEND - 25);
+    BOOST_CHECK_EQUAL(decoded.encodingClass, OMNI_CLASS_C);
+    BOOST_CHECK_EQUAL(decoded.fee, 10000U);
+    BOOST_CHECK_EQUAL(decoded.sender, "alice");
+    BOOST_CHECK_EQUAL(decoded.reference, "bobby");
+
+    // the transaction is interpreted again from the stored payload
+    CMPTransaction mp_obj;
+    mp_obj.Set(decoded.sender, decoded.reference, 0, Txid(1), 300, decoded.posInBlock,
+            decoded.payload.data(), decoded.payload.size(), decoded.encodingClass, decoded.fee);
+    BOOST_CHECK(mp_obj.interpret_Transaction());
+    BOOST_CHECK_EQUAL(mp_obj.getType(), MSC_TYPE_SIMPLE_SEND);
+    BOOST_CHECK_EQUAL(mp_obj.getProperty(), OMNI_PROPERTY_MSC);
+    BOOST_CHECK_EQUAL(mp_obj.getAmount(), 50U);
+    BOOST_CHECK_EQUAL(mp_obj.getFeePaid(), 10000U);
+}
+
+BOOST_AUTO_TEST_CASE(decoded_transaction_replaced)
+{
+    CDecodedTransaction decoded;
+    pDb->RecordDecodedTransaction(Txid(1), DecodedSimpleSend(300, 50));
+    BOOST_CHECK(pDb->FetchDecodedTransaction(Txid(1), decoded)); // now cached
+
+    // parsed again in another block after a reorganization
+    pDb->RecordDecodedTransaction(Txid(1), DecodedSimpleSend(301, 60));
+    BOOST_CHECK(pDb->FetchDecodedTransaction(Txid(1), decoded));
+    BOOST_CHECK(decoded.blockHash == Txid(301));
+    BOOST_CHECK(decoded.payload == CreatePayload_SimpleSend(OMNI_PROPERTY_MSC, 60));
+}
+
+BOOST_AUTO_TEST_CASE(decoded_transaction_cleared)
+{
+    CDecodedTransaction decoded;
+    pDb->RecordDecodedTransaction(Txid(1), DecodedSimpleSend(300, 50));
+    BOOST_CHECK(pDb->FetchDecodedTransaction(Txid(1), decoded)); // now cached
+
+    pDb->Clear();
+    BOOST_CHECK(!pDb->FetchDecodedTransaction(Txid(1), decoded));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,106 @@
+#include <omnicore/dbfees.h>
+#include <omnicore/omnicore.h>
+#include <omnicore/test/utils_db.h>
+
+#include <test/test_bitcoin.h>
+#include <util/system.h>
+
+#include <stdint.h>
+#include <set>
+
+#include <boost/test/unit_test.hpp>
+
+using namespace mastercore;
+
+BOOST_FIXTURE_TEST_SUITE(omnicore_feecache_tests, OmniDBTestingSetup<COmniFeeCache>)
+
+BOOST_AUTO_TEST_CASE(cached_amounts_per_block)
+{
+    BOOST_CHECK_EQUAL(0, pDb->GetCachedAmount(3));
+    BOOST_CHECK(pDb->GetCacheHistory(3).empty());
+
+    BOOST_CHECK_EQUAL(10, pDb->CacheFee(3, 100, 10));
+    BOOST_CHECK_EQUAL(25, pDb->CacheFee(3, 100, 15));
+    BOOST_CHECK_EQUAL(30, pDb->CacheFee(3, 102, 5));
+    BOOST_CHECK_EQUAL(7, pDb->CacheFee(4, 101, 7));
+    BOOST_CHECK_EQUAL(30, pDb->GetCachedAmount(3));
+    BOOST_CHECK_EQUAL(7, pDb->GetCachedAmount(4));
+
+    // one entry per block, with the cached amount after the block
+    std::set<feeCacheItem> history = pDb->GetCacheHistory(3);
+    BOOST_CHECK_EQUAL(2U, history.size());
+    BOOST_CHECK(history.count(feeCacheItem(100, 25)));
+    BOOST_CHECK(history.count(feeCacheItem(102, 30)));
+
+    pDb->ClearCache(3, 103);
+    BOOST_CHECK_EQUAL(0, pDb->GetCachedAmount(3));
+    BOOST_CHECK_EQUAL(3U, pDb->GetCacheHistory(3).size());
+}
+
+BOOST_AUTO_TEST_CASE(rollback_of_blocks)
+{
+    pDb->CacheFee(3, 100, 10);
+    pDb->CacheFee(3, 102, 20);
+    pDb->CacheFee(3, 104, 30);
+    pDb->CacheFee(4, 101, 5);
+    pDb->CacheFee(5, 103, 8);
+
+    pDb->RollBackCache(102);
+    BOOST_CHECK_EQUAL(10, pDb->GetCachedAmount(3));
+    BOOST_CHECK_EQUAL(1U, pDb->GetCacheHistory(3).size());
+    BOOST_CHECK_EQUAL(5, pDb->GetCachedAmount(4));
+    BOOST_CHECK_EQUAL(0, pDb->GetCachedAmount(5));
+    BOOST_CHECK(pDb->GetCacheHistory(5).empty());
+
+    // new entries can be added after a rollback
+    BOOST_CHECK_EQUAL(13, pDb->CacheFee(3, 102, 3));
+
+    pDb->RollBackCache(0);
+    BOOST_CHECK_EQUAL(0, pDb->GetCachedAmount(3));
+    BOOST_CHECK_EQUAL(0, pDb->GetCachedAmount(4));
+}
+
+BOOST_AUTO_TEST_CASE(pruning_of_matured_entries)
+{
+    pDb->CacheFee(3, 100, 10);
+    pDb->CacheFee(3, 110, 10);
+    pDb->CacheFee(3, 120, 10);
+    BOOST_CHECK_EQUAL(3U, pDb->GetCacheHistory(3).size());
+
+    // entries older than MAX_STATE_HISTORY blocks are removed, except the newest of them
+    pDb->CacheFee(3, 115 + MAX_STATE_HISTORY, 10);
+    std::set<feeCacheItem> history = pDb->GetCacheHistory(3);
+    BOOST_CHECK_EQUAL(3U, history.size());
+    BOOST_CHECK(!history.count(feeCacheItem(100, 10)));
+    BOOST_CHECK(history.count(feeCacheItem(110, 20)));
+
+    // the most recent entry is kept
+    pDb->PruneCache(3, 1000);
+    history = pDb->GetCacheHistory(3);
+    BOOST_CHECK_EQUAL(1U, history.size());
+    BOOST_CHECK_EQUAL(40, pDb->GetCachedAmount(3));
+
+    // pruned blocks are not part of a rollback anymore
+    pDb->RollBackCache(130);
+    BOOST_CHECK_EQUAL(0, pDb->GetCachedAmount(3));
+}
+
+BOOST_AUTO_TEST_CASE(rollback_after_pruning)
+{
+    pDb->CacheFee(3, 100, 10);
+    pDb->CacheFee(3, 110, 20);
+    pDb->CacheFee(3, 120, 30);
+    pDb->CacheFee(3, 115 + MAX_STATE_HISTORY, 40);
+
+    // the cached amount at the oldest block within MAX_STATE_HISTORY is restored
+    pDb->RollBackCache(115);
+    BOOST_CHECK_EQUAL(30, pDb->GetCachedAmount(3));
+    std::set<feeCacheItem> history = pDb->GetCacheHistory(3);
+    BOOST_CHECK_EQUAL(1U, history.size());
+    BOOST_CHECK(history.count(feeCacheItem(110, 30)));
+
+    // the cache continues with the restored amount
+    BOOST_CHECK_EQUAL(35, pDb->CacheFee(3, 115, 5));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,55 @@
+#include <omnicore/omnicore.h>
+#include <omnicore/tally.h>
+
+#include <test/test_bitcoin.h>
+
+#include <stdint.h>
+#include <set>
+#include <string>
+
+#include <boost/test/unit_test.hpp>
+
+using namespace mastercore;
+
+BOOST_FIXTURE_TEST_SUITE(omnicore_holders_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(holders_follow_tally_updates)
+{
+    ClearTallyMap();
+    BOOST_CHECK(GetPropertyHolders(7).empty());
+    BOOST_CHECK_EQUAL(0, GetPropertyTotal(7));
+
+    BOOST_CHECK(update_tally_map("alice", 7, 100, BALANCE));
+    BOOST_CHECK(update_tally_map("bob", 7, 50, BALANCE));
+    BOOST_CHECK(update_tally_map("carol", 8, 10, BALANCE));
+    BOOST_CHECK_EQUAL(2U, GetPropertyHolders(7).size());
+    BOOST_CHECK_EQUAL(1U, GetPropertyHolders(8).size());
+    BOOST_CHECK_EQUAL(150, GetPropertyTotal(7));
+
+    // moving tokens into reserves keeps the holder and the total
+    BOOST_CHECK(update_tally_map("bob", 7, -50, BALANCE));
+    BOOST_CHECK(update_tally_map("bob", 7, 50, METADEX_RESERVE));
+    BOOST_CHECK_EQUAL(1U, GetPropertyHolders(7).count("bob"));
+    BOOST_CHECK_EQUAL(150, GetPropertyTotal(7));
+
+    // pending amounts are not part of the total
+    BOOST_CHECK(update_tally_map("alice", 7, -30, PENDING));
+    BOOST_CHECK_EQUAL(150, GetPropertyTotal(7));
+
+    // failed updates change nothing
+    BOOST_CHECK(!update_tally_map("alice", 7, -101, BALANCE));
+    BOOST_CHECK_EQUAL(150, GetPropertyTotal(7));
+
+    // holders without tokens are removed
+    BOOST_CHECK(update_tally_map("alice", 7, -100, BALANCE));
+    BOOST_CHECK_EQUAL(0U, GetPropertyHolders(7).count("alice"));
+    BOOST_CHECK_EQUAL(1U, GetPropertyHolders(7).size());
+    BOOST_CHECK_EQUAL(50, GetPropertyTotal(7));
+
+    ClearTallyMap();
+    BOOST_CHECK(GetPropertyHolders(7).empty());
+    BOOST_CHECK(GetPropertyHolders(8).empty());
+    BOOST_CHECK_EQUAL(0, GetPropertyTotal(7));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
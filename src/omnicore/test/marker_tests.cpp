@@ -6,7 +6,9 @@
 #include <omnicore/script.h>
 
 #include <primitives/transaction.h>
+#include <script/script.h>
 #include <test/test_bitcoin.h>
+#include <util/strencodings.h>
 
 #include <boost/test/unit_test.hpp>
 
@@ -312,5 +314,41 @@ BOOST_AUTO_TEST_CASE(class_class_c)
     }
 }
 
+BOOST_AUTO_TEST_CASE(marker_prefilter)
+{
+    int nBlock = std::numeric_limits<int>::max();
+    {
+        CMutableTransaction mutableTx;
+        mutableTx.vout.push_back(PayToPubKeyHash_Unrelated());
+        mutableTx.vout.push_back(OpReturn_Unrelated());
+        mutableTx.vout.push_back(OpReturn_Empty());
+
+        BOOST_CHECK(!MayHaveMarker(CTransaction(mutableTx), nBlock));
+    }
+    {
+        CMutableTransaction mutableTx;
+        mutableTx.vout.push_back(PayToPubKeyHash_Unrelated());
+        mutableTx.vout.push_back(PayToPubKeyHash_Exodus());
+
+        BOOST_CHECK(MayHaveMarker(CTransaction(mutableTx), nBlock));
+        BOOST_CHECK(MayHaveMarker(CTransaction(mutableTx), 0));
+    }
+    {
+        // the marker bytes anywhere in a script are examined closely
+        CMutableTransaction mutableTx;
+        mutableTx.vout.push_back(CTxOut(0, CScript() << OP_RETURN << ParseHex("00006f6d6e6900")));
+
+        BOOST_CHECK(MayHaveMarker(CTransaction(mutableTx), nBlock));
+        BOOST_CHECK(!MayHaveMarker(CTransaction(mutableTx), 0));
+        BOOST_CHECK_EQUAL(GetEncodingClass(CTransaction(mutableTx), nBlock), NO_MARKER);
+    }
+    {
+        // partial markers at the end of a script are no match
+        CMutableTransaction mutableTx;
+        mutableTx.vout.push_back(CTxOut(0, CScript() << OP_RETURN << ParseHex("6f6d6e6f6d6e")));
+
+        BOOST_CHECK(!MayHaveMarker(CTransaction(mutableTx), nBlock));
+    }
+}
 
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,124 @@
+#include <omnicore/prevoutcache.h>
+
+#include <arith_uint256.h>
+#include <coins.h>
+#include <primitives/transaction.h>
+#include <script/script.h>
+#include <test/test_bitcoin.h>
+#include <uint256.h>
+
+#include <stdint.h>
+#include <map>
+
+#include <boost/test/unit_test.hpp>
+
+using namespace mastercore;
+
+namespace
+{
+COutPoint MakeOutPoint(uint32_t n)
+{
+    return COutPoint(ArithToUint256(arith_uint256(n + 1)), n);
+}
+
+Coin MakeCoin(int64_t nValue)
+{
+    CScript script;
+    script << OP_DUP << OP_HASH160 << std::vector<unsigned char>(20, 0x01) << OP_EQUALVERIFY << OP_CHECKSIG;
+    return Coin(CTxOut(nValue, script), 100, false);
+}
+
+size_t GetUsage(CPrevoutCache& cache)
+{
+    CPrevoutCacheStats stats;
+    cache.GetStats(stats);
+    return stats.nUsage;
+}
+}
+
+BOOST_FIXTURE_TEST_SUITE(omnicore_prevoutcache_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(cache_hits_and_misses)
+{
+    CPrevoutCache cache(1 << 20);
+    Coin coin;
+
+    BOOST_CHECK(!cache.Get(MakeOutPoint(0), coin));
+    cache.Add(MakeOutPoint(0), MakeCoin(5000));
+    BOOST_CHECK(cache.Get(MakeOutPoint(0), coin));
+    BOOST_CHECK_EQUAL(coin.out.nValue, 5000);
+    BOOST_CHECK_EQUAL(coin.nHeight, 100U);
+
+    // replacing an output doesn't change the usage
+    size_t nUsage = GetUsage(cache);
+    cache.Add(MakeOutPoint(0), MakeCoin(6000));
+    BOOST_CHECK_EQUAL(GetUsage(cache), nUsage);
+    BOOST_CHECK(cache.Get(MakeOutPoint(0), coin));
+    BOOST_CHECK_EQUAL(coin.out.nValue, 6000);
+
+    CPrevoutCacheStats stats;
+    cache.GetStats(stats);
+    BOOST_CHECK_EQUAL(stats.nHits, 2U);
+    BOOST_CHECK_EQUAL(stats.nMisses, 1U);
+    BOOST_CHECK_EQUAL(stats.nEntries, 1U);
+    BOOST_CHECK_EQUAL(stats.nEvictions, 0U);
+}
+
+BOOST_AUTO_TEST_CASE(cache_evicts_least_recently_used)
+{
+    CPrevoutCache probe(1 << 20);
+    probe.Add(MakeOutPoint(0), MakeCoin(1));
+    const size_t nEntryUsage = GetUsage(probe);
+
+    // room for three outputs
+    CPrevoutCache cache(3 * nEntryUsage);
+    Coin coin;
+    cache.Add(MakeOutPoint(0), MakeCoin(1));
+    cache.Add(MakeOutPoint(1), MakeCoin(2));
+    cache.Add(MakeOutPoint(2), MakeCoin(3));
+
+    // touch the oldest one, so the second one is evicted next
+    BOOST_CHECK(cache.Get(MakeOutPoint(0), coin));
+    cache.Add(MakeOutPoint(3), MakeCoin(4));
+
+    BOOST_CHECK(cache.Get(MakeOutPoint(0), coin));
+    BOOST_CHECK(!cache.Get(MakeOutPoint(1), coin));
+    BOOST_CHECK(cache.Get(MakeOutPoint(2), coin));
+    BOOST_CHECK(cache.Get(MakeOutPoint(3), coin));
+    BOOST_CHECK(GetUsage(cache) <= 3 * nEntryUsage);
+
+    // shrinking the cache evicts the least recently used outputs
+    cache.SetMaxUsage(nEntryUsage);
+    BOOST_CHECK(!cache.Get(MakeOutPoint(0), coin));
+    BOOST_CHECK(!cache.Get(MakeOutPoint(2), coin));
+    BOOST_CHECK(cache.Get(MakeOutPoint(3), coin));
+
+    CPrevoutCacheStats stats;
+    cache.GetStats(stats);
+    BOOST_CHECK_EQUAL(stats.nEvictions, 3U);
+    BOOST_CHECK_EQUAL(stats.nEntries, 1U);
+
+    cache.Clear();
+    BOOST_CHECK(!cache.Get(MakeOutPoint(3), coin));
+    BOOST_CHECK_EQUAL(GetUsage(cache), 0U);
+}
+
+BOOST_AUTO_TEST_CASE(resolve_from_spent_coins)
+{
+    std::map<COutPoint, Coin> spentCoins;
+    spentCoins.emplace(MakeOutPoint(7), MakeCoin(7000));
+
+    CPrevoutCacheStats before = GetPrevoutCacheStats();
+
+    Coin coin;
+    BOOST_CHECK(ResolvePrevout(MakeOutPoint(7), &spentCoins, coin));
+    BOOST_CHECK_EQUAL(coin.out.nValue, 7000);
+
+    // outputs of blocks are not cached
+    CPrevoutCacheStats after = GetPrevoutCacheStats();
+    BOOST_CHECK_EQUAL(after.nBlockUndo, before.nBlockUndo + 1);
+    BOOST_CHECK_EQUAL(after.nEntries, before.nEntries);
+    BOOST_CHECK_EQUAL(after.nMisses, before.nMisses);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -5,6 +5,7 @@
 
 #include <stdint.h>
 #include <limits>
+#include <vector>
 
 #include <boost/test/unit_test.hpp>
 
@@ -34,5 +35,42 @@ BOOST_AUTO_TEST_CASE(simple_send_restrictions)
     BOOST_CHECK(IsTransactionTypeAllowed(MAX_BLOCK,         OMNI_PROPERTY_TMSC, MSC_TYPE_SIMPLE_SEND, MP_TX_PKT_V0));
 }
 
+BOOST_AUTO_TEST_CASE(restriction_table)
+{
+    const int blocks[] = {0, ConsensusParams().MSC_SEND_BLOCK, ConsensusParams().MSC_METADEX_BLOCK, MAX_BLOCK};
+    const uint32_t properties[] = {OMNI_PROPERTY_BTC, OMNI_PROPERTY_MSC, OMNI_PROPERTY_TMSC, 31};
+    const uint16_t versions[] = {MP_TX_PKT_V0, MP_TX_PKT_V1, 2, MAX_VERSION};
+    const std::vector<TransactionRestriction> vTxRestrictions = ConsensusParams().GetRestrictions();
+
+    // the compiled table yields the same result as the list of restrictions
+    for (const TransactionRestriction& entry : vTxRestrictions) {
+        for (uint16_t version : versions) {
+            for (uint32_t propertyId : properties) {
+                for (int block : blocks) {
+                    bool fExpected = false;
+                    for (const TransactionRestriction& other : vTxRestrictions) {
+                        if (other.txType != entry.txType || other.txVersion != version) continue;
+                        if (OMNI_PROPERTY_BTC == propertyId && !other.allowWildcard) continue;
+                        fExpected = isTestEcosystemProperty(propertyId) || block >= other.activationBlock;
+                        if (fExpected) break;
+                    }
+                    BOOST_CHECK_EQUAL(fExpected, IsTransactionTypeAllowed(block, propertyId, entry.txType, version));
+                }
+            }
+        }
+    }
+    BOOST_CHECK(!IsTransactionTypeAllowed(MAX_BLOCK, OMNI_PROPERTY_MSC, MSC_TYPE_RESTRICTED_SEND, MP_TX_PKT_V0));
+    BOOST_CHECK(!IsTransactionTypeAllowed(MAX_BLOCK, OMNI_PROPERTY_MSC, 1000, MP_TX_PKT_V0));
+
+    // and the table follows changes of the activation heights
+    int oldActivationBlock = ConsensusParams().MSC_STOV1_BLOCK;
+    MutableConsensusParams().MSC_STOV1_BLOCK = 0;
+    BOOST_CHECK(IsTransactionTypeAllowed(0, OMNI_PROPERTY_MSC, MSC_TYPE_SEND_TO_OWNERS, MP_TX_PKT_V1));
+    BOOST_CHECK(IsFeatureActivated(FEATURE_STOV1, 0));
+    MutableConsensusParams().MSC_STOV1_BLOCK = oldActivationBlock;
+    BOOST_CHECK(!IsTransactionTypeAllowed(oldActivationBlock - 1, OMNI_PROPERTY_MSC, MSC_TYPE_SEND_TO_OWNERS, MP_TX_PKT_V1));
+    BOOST_CHECK(!IsFeatureActivated(FEATURE_STOV1, oldActivationBlock - 1));
+    BOOST_CHECK(!IsFeatureActivated(11, MAX_BLOCK));
+}
 
 BOOST_AUTO_TEST_SUITE_END()
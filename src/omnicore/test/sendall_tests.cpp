@@ -0,0 +1,79 @@
+#include <omnicore/createpayload.h>
+#include <omnicore/dbtxlist.h>
+#include <omnicore/omnicore.h>
+#include <omnicore/test/utils_db.h>
+#include <omnicore/tx.h>
+
+#include <sync.h>
+#include <test/test_bitcoin.h>
+#include <validation.h>
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+using namespace mastercore;
+
+namespace
+{
+/** Provides a chain with an empty tally map. The databases are opened by mastercore_init(), while the chain is mined. */
+struct SendAllTestingSetup : public TestChain100Setup
+{
+    SendAllTestingSetup()
+    {
+        ClearTallyMap();
+    }
+
+    ~SendAllTestingSetup()
+    {
+        ClearTallyMap();
+    }
+};
+
+/** Executes a send all transaction of the main ecosystem. */
+int ExecuteSendAll(const std::string& sender, const std::string& receiver, const uint256& txid)
+{
+    std::vector<unsigned char> vchPayload = CreatePayload_SendAll(OMNI_PROPERTY_MSC);
+    int nBlock = 0;
+    {
+        LOCK(cs_main);
+        nBlock = chainActive.Height();
+    }
+
+    CMPTransaction mp_obj;
+    mp_obj.Set(sender, receiver, 0, txid, nBlock, 1, vchPayload.data(), vchPayload.size(), OMNI_CLASS_C, 10000);
+    mp_obj.unlockLogic();
+    return mp_obj.interpretPacket();
+}
+}
+
+BOOST_FIXTURE_TEST_SUITE(omnicore_sendall_tests, SendAllTestingSetup)
+
+BOOST_AUTO_TEST_CASE(send_all_to_new_receiver)
+{
+    // the sender is the only known address, so the receiver is added while the sender's tally is used
+    BOOST_CHECK(update_tally_map("alice", 1, 100, BALANCE));
+    BOOST_CHECK(update_tally_map("alice", 3, 200, BALANCE));
+    BOOST_CHECK(update_tally_map("alice", 4, 300, BALANCE));
+    BOOST_CHECK(update_tally_map("alice", 2147483651U, 400, BALANCE));
+    BOOST_CHECK(getTally("bob") == nullptr);
+
+    BOOST_CHECK_EQUAL(0, ExecuteSendAll("alice", "bob", Txid(1)));
+
+    BOOST_CHECK_EQUAL(0, GetTokenBalance("alice", 1, BALANCE));
+    BOOST_CHECK_EQUAL(0, GetTokenBalance("alice", 3, BALANCE));
+    BOOST_CHECK_EQUAL(0, GetTokenBalance("alice", 4, BALANCE));
+    BOOST_CHECK_EQUAL(100, GetTokenBalance("bob", 1, BALANCE));
+    BOOST_CHECK_EQUAL(200, GetTokenBalance("bob", 3, BALANCE));
+    BOOST_CHECK_EQUAL(300, GetTokenBalance("bob", 4, BALANCE));
+
+    // tokens of the test ecosystem are not sent
+    BOOST_CHECK_EQUAL(400, GetTokenBalance("alice", 2147483651U, BALANCE));
+    BOOST_CHECK_EQUAL(0, GetTokenBalance("bob", 2147483651U, BALANCE));
+
+    BOOST_CHECK_EQUAL(3, pDbTransactionList->getNumberOfSubRecords(Txid(1)));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
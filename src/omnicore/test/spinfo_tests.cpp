@@ -0,0 +1,75 @@
+#include <omnicore/dbspinfo.h>
+#include <omnicore/omnicore.h>
+#include <omnicore/sp.h>
+#include <omnicore/test/utils_db.h>
+
+#include <test/test_bitcoin.h>
+#include <uint256.h>
+#include <util/system.h>
+
+#include <stdint.h>
+#include <string>
+
+#include <boost/test/unit_test.hpp>
+
+using namespace mastercore;
+
+BOOST_FIXTURE_TEST_SUITE(omnicore_spinfo_tests, OmniDBTestingSetup<CMPSPInfo>)
+
+BOOST_AUTO_TEST_CASE(implied_properties)
+{
+    CMPSPInfo::HotFields fields;
+    BOOST_CHECK(pDb->getSPHotFields(OMNI_PROPERTY_MSC, fields));
+    BOOST_CHECK(fields.divisible);
+    BOOST_CHECK_EQUAL(OMNI_PROPERTY_MSC, fields.ecosystem);
+    BOOST_CHECK_EQUAL("Omni tokens", fields.entry->name);
+
+    BOOST_CHECK(pDb->getSPHotFields(OMNI_PROPERTY_TMSC, fields));
+    BOOST_CHECK_EQUAL("Test Omni tokens", fields.entry->name);
+    BOOST_CHECK(!pDb->getSPHotFields(3, fields));
+    BOOST_CHECK(pDb->getSPEntry(3) == nullptr);
+}
+
+BOOST_AUTO_TEST_CASE(cached_entries_follow_updates)
+{
+    CMPSPInfo::Entry sp;
+    sp.issuer = "alice";
+    sp.prop_type = MSC_PROPERTY_TYPE_DIVISIBLE;
+    sp.name = "Alpha";
+    sp.fixed = true;
+    sp.txid = BlockHash(1);
+    sp.creation_block = BlockHash(100);
+    sp.update_block = BlockHash(100);
+    BOOST_CHECK_EQUAL(3U, pDb->putSP(OMNI_PROPERTY_MSC, sp));
+
+    CMPSPInfo::HotFields fields;
+    BOOST_CHECK(pDb->getSPHotFields(3, fields));
+    BOOST_CHECK(fields.divisible);
+    BOOST_CHECK(fields.fixed);
+    BOOST_CHECK(!fields.manual);
+    BOOST_CHECK_EQUAL(OMNI_PROPERTY_MSC, fields.ecosystem);
+    BOOST_CHECK_EQUAL("alice", fields.issuer());
+    BOOST_CHECK(pDb->hasSP(3));
+
+    // the cached entry is replaced after an update
+    sp.issuer = "bobby";
+    sp.name = "Beta";
+    sp.update_block = BlockHash(101);
+    BOOST_CHECK(pDb->updateSP(3, sp));
+    BOOST_CHECK_EQUAL("bobby", pDb->getSPEntry(3)->issuer);
+    CMPSPInfo::Entry info;
+    BOOST_CHECK(pDb->getSP(3, info));
+    BOOST_CHECK_EQUAL("Beta", info.name);
+
+    // previously retrieved entries are not affected
+    BOOST_CHECK_EQUAL("alice", fields.issuer());
+
+    // and the previous state is cached again, after the block is popped
+    BOOST_CHECK_EQUAL(1, pDb->popBlock(BlockHash(101)));
+    BOOST_CHECK_EQUAL("alice", pDb->getSPEntry(3)->issuer);
+    BOOST_CHECK_EQUAL(0, pDb->popBlock(BlockHash(100)));
+    BOOST_CHECK(pDb->getSPEntry(3) == nullptr);
+    BOOST_CHECK(!pDb->hasSP(3));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
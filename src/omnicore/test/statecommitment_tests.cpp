@@ -0,0 +1,177 @@
+#include <omnicore/consensushash.h>
+#include <omnicore/dbspinfo.h>
+#include <omnicore/dex.h>
+#include <omnicore/mdex.h>
+#include <omnicore/omnicore.h>
+#include <omnicore/sp.h>
+#include <omnicore/tally.h>
+#include <omnicore/test/utils_db.h>
+#include <omnicore/undo.h>
+
+#include <crypto/sha256.h>
+#include <test/test_bitcoin.h>
+#include <tinyformat.h>
+#include <uint256.h>
+#include <util/system.h>
+
+#include <stdint.h>
+#include <string>
+
+#include <boost/test/unit_test.hpp>
+
+using namespace mastercore;
+
+namespace
+{
+/** Provides a smart property database and an empty orderbook. */
+struct StateCommitmentTestingSetup : public SmartPropertyTestingSetup
+{
+    StateCommitmentTestingSetup()
+    {
+        ClearTallyMap();
+        ResetOrderbookCommitments();
+    }
+
+    ~StateCommitmentTestingSetup()
+    {
+        ClearTallyMap();
+        metadex.clear();
+        my_offers.clear();
+        ResetOrderbookCommitments();
+    }
+};
+
+/** Removes an order from the orderbook, like a cancellation. */
+void EraseOrder(const CMPMetaDEx& order)
+{
+    RecordMetaDExUndo(order, false);
+    metadex[md_PropertyPair(order.getProperty(), order.getDesProperty())][order.unitPrice()].erase(order);
+}
+}
+
+BOOST_FIXTURE_TEST_SUITE(omnicore_statecommitment_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(accumulator_order_independent)
+{
+    CConsensusAccumulator empty;
+    BOOST_CHECK(empty.GetHash().IsNull());
+
+    CConsensusAccumulator first;
+    first.Add("a|1|100|0|0|0");
+    first.Add("b|1|50|0|0|0");
+    first.Add("c|3|7|0|0|0");
+
+    CConsensusAccumulator second;
+    second.Add("c|3|7|0|0|0");
+    second.Add("a|1|100|0|0|0");
+    second.Add("b|1|50|0|0|0");
+    BOOST_CHECK(first.GetHash() == second.GetHash());
+
+    second.Remove("b|1|50|0|0|0");
+    BOOST_CHECK(first.GetHash() != second.GetHash());
+    second.Add("b|1|50|0|0|0");
+    BOOST_CHECK(first.GetHash() == second.GetHash());
+
+    first.Remove("a|1|100|0|0|0");
+    first.Remove("b|1|50|0|0|0");
+    first.Remove("c|3|7|0|0|0");
+    BOOST_CHECK(first.GetHash() == empty.GetHash());
+}
+
+BOOST_AUTO_TEST_CASE(balance_commitment_follows_tally)
+{
+    ClearTallyMap();
+    BOOST_CHECK(GetBalanceCommitment().IsNull());
+
+    BOOST_CHECK(update_tally_map("alice", 7, 100, BALANCE));
+    BOOST_CHECK(update_tally_map("bob", 7, 50, BALANCE));
+    uint256 hashBefore = GetBalanceCommitment();
+    BOOST_CHECK(!hashBefore.IsNull());
+
+    // pending amounts are not committed to
+    BOOST_CHECK(update_tally_map("alice", 7, -20, PENDING));
+    BOOST_CHECK(GetBalanceCommitment() == hashBefore);
+
+    // reserving changes the commitment, and reverting restores it
+    BOOST_CHECK(update_tally_map("bob", 7, -50, BALANCE));
+    BOOST_CHECK(update_tally_map("bob", 7, 50, METADEX_RESERVE));
+    BOOST_CHECK(GetBalanceCommitment() != hashBefore);
+    BOOST_CHECK(update_tally_map("bob", 7, -50, METADEX_RESERVE));
+    BOOST_CHECK(update_tally_map("bob", 7, 50, BALANCE));
+    BOOST_CHECK(GetBalanceCommitment() == hashBefore);
+
+    // the commitment equals the accumulated consensus strings of all balances
+    CConsensusAccumulator expected;
+    expected.Add("alice|7|100|0|0|0");
+    expected.Add("bob|7|50|0|0|0");
+    BOOST_CHECK(GetBalanceCommitment() == expected.GetHash());
+
+    // empty balances are removed from the commitment
+    BOOST_CHECK(update_tally_map("bob", 7, -50, BALANCE));
+    expected.Remove("bob|7|50|0|0|0");
+    BOOST_CHECK(GetBalanceCommitment() == expected.GetHash());
+
+    ClearTallyMap();
+    BOOST_CHECK(GetBalanceCommitment().IsNull());
+}
+
+BOOST_FIXTURE_TEST_CASE(orderbook_commitment_incremental, StateCommitmentTestingSetup)
+{
+    const uint256 hashEmpty = GetStateCommitment();
+
+    CMPMetaDEx first("alice", 100, 3, 1000, 1, 50, Txid(2), 1, 1);
+    CMPMetaDEx second("bob", 101, 3, 2000, 1, 80, Txid(1), 1, 1);
+    BOOST_CHECK(MetaDEx_INSERT(first));
+    BOOST_CHECK(MetaDEx_INSERT(second));
+    const uint256 hashOrders = GetStateCommitment();
+    BOOST_CHECK(hashOrders != hashEmpty);
+
+    // the incrementally maintained commitment equals one rebuilt from scratch
+    ResetOrderbookCommitments();
+    BOOST_CHECK(GetStateCommitment() == hashOrders);
+
+    const std::string key = STR_SELLOFFER_ADDR_PROP_COMBO("carol", 1);
+    RecordOfferUndo(key);
+    my_offers.insert(std::make_pair(key, CMPOffer(102, 500, 1, 700, 10000, 10, Txid(3))));
+    const uint256 hashOffers = GetStateCommitment();
+    BOOST_CHECK(hashOffers != hashOrders);
+    ResetOrderbookCommitments();
+    BOOST_CHECK(GetStateCommitment() == hashOffers);
+
+    // removing the entries restores the previous commitments
+    RecordOfferUndo(key);
+    my_offers.erase(key);
+    BOOST_CHECK(GetStateCommitment() == hashOrders);
+    EraseOrder(first);
+    EraseOrder(second);
+    BOOST_CHECK(GetStateCommitment() == hashEmpty);
+}
+
+BOOST_FIXTURE_TEST_CASE(orderbook_hash_ordered_by_txid, StateCommitmentTestingSetup)
+{
+    // the orders are added in reverse order of their txids
+    CMPMetaDEx first("alice", 100, 3, 1000, 1, 50, Txid(2), 1, 1);
+    CMPMetaDEx second("bob", 101, 3, 2000, 1, 80, Txid(1), 1, 1);
+    GetMetaDExHash(); // builds the trades stage, which is then updated incrementally
+    BOOST_CHECK(MetaDEx_INSERT(first));
+    BOOST_CHECK(MetaDEx_INSERT(second));
+
+    const std::string strFirst = strprintf("%s|alice|3|1000|1|50|1000", first.getHash().GetHex());
+    const std::string strSecond = strprintf("%s|bob|3|2000|1|80|2000", second.getHash().GetHex());
+    uint256 expected;
+    CSHA256()
+        .Write((const unsigned char*) strSecond.data(), strSecond.size())
+        .Write((const unsigned char*) strFirst.data(), strFirst.size())
+        .Finalize(expected.begin());
+
+    BOOST_CHECK(GetMetaDExHash() == expected);
+    BOOST_CHECK(GetMetaDExHash(3) == expected);
+    ResetOrderbookCommitments();
+    BOOST_CHECK(GetMetaDExHash() == expected);
+
+    EraseOrder(second);
+    BOOST_CHECK(GetMetaDExHash() != expected);
+    BOOST_CHECK(GetMetaDExHash() == GetMetaDExHash(3));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
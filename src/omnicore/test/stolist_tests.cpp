@@ -0,0 +1,106 @@
+#include <omnicore/dbspinfo.h>
+#include <omnicore/dbstolist.h>
+#include <omnicore/omnicore.h>
+#include <omnicore/sp.h>
+#include <omnicore/test/utils_db.h>
+
+#include <test/test_bitcoin.h>
+#include <uint256.h>
+#include <util/system.h>
+
+#include <univalue.h>
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+using namespace mastercore;
+
+BOOST_FIXTURE_TEST_SUITE(omnicore_stolist_tests, OmniDBTestingSetup<CMPSTOList>)
+
+BOOST_AUTO_TEST_CASE(recipients_of_transaction)
+{
+    pDb->recordSTOReceive("alice", Txid(1), 300, 1, 10);
+    pDb->recordSTOReceive("bobby", Txid(1), 300, 1, 20);
+    pDb->recordSTOReceive("carol", Txid(1), 300, 1, 30);
+    pDb->recordSTOReceive("alice", Txid(2), 310, 1, 40);
+
+    UniValue recipients(UniValue::VARR);
+    uint64_t total = 0;
+    uint64_t numRecipients = 0;
+    pDb->getRecipients(Txid(1), "*", &recipients, &total, &numRecipients);
+    BOOST_CHECK_EQUAL(3U, recipients.size());
+    BOOST_CHECK_EQUAL(3U, numRecipients);
+    BOOST_CHECK_EQUAL(60U, total);
+    BOOST_CHECK_EQUAL("alice", recipients[0]["address"].get_str());
+
+    // a page of recipients, all recipients are counted for the fee
+    recipients = UniValue(UniValue::VARR);
+    total = 0;
+    pDb->getRecipients(Txid(1), "*", &recipients, &total, &numRecipients, nullptr, 1, 1);
+    BOOST_CHECK_EQUAL(1U, recipients.size());
+    BOOST_CHECK_EQUAL(3U, numRecipients);
+    BOOST_CHECK_EQUAL(20U, total);
+    BOOST_CHECK_EQUAL("bobby", recipients[0]["address"].get_str());
+
+    // filtered by address
+    recipients = UniValue(UniValue::VARR);
+    total = 0;
+    pDb->getRecipients(Txid(1), "carol", &recipients, &total, &numRecipients);
+    BOOST_CHECK_EQUAL(1U, recipients.size());
+    BOOST_CHECK_EQUAL(3U, numRecipients);
+    BOOST_CHECK_EQUAL(30U, total);
+
+    recipients = UniValue(UniValue::VARR);
+    pDb->getRecipients(Txid(2), "*", &recipients, &total, &numRecipients);
+    BOOST_CHECK_EQUAL(1U, recipients.size());
+    BOOST_CHECK_EQUAL(1U, numRecipients);
+
+    BOOST_CHECK(pDb->exists("alice"));
+    BOOST_CHECK(!pDb->exists("dave"));
+}
+
+BOOST_AUTO_TEST_CASE(recipient_addresses)
+{
+    pDb->recordSTOReceive("carol", Txid(1), 300, 1, 30);
+    pDb->recordSTOReceive("alice", Txid(1), 300, 1, 10);
+    pDb->recordSTOReceive("alice", Txid(2), 310, 1, 40);
+
+    std::vector<std::string> vAddresses = pDb->GetRecipientAddresses(Txid(1));
+    BOOST_CHECK_EQUAL(2U, vAddresses.size());
+    BOOST_CHECK_EQUAL("alice", vAddresses[0]);
+    BOOST_CHECK_EQUAL("carol", vAddresses[1]);
+
+    BOOST_CHECK_EQUAL(1U, pDb->GetRecipientAddresses(Txid(2)).size());
+    BOOST_CHECK(pDb->GetRecipientAddresses(Txid(3)).empty());
+}
+
+BOOST_AUTO_TEST_CASE(rollback_of_receipts)
+{
+    pDb->recordSTOReceive("alice", Txid(1), 300, 1, 10);
+    pDb->recordSTOReceive("bobby", Txid(1), 300, 1, 20);
+    pDb->recordSTOReceive("alice", Txid(2), 310, 1, 40);
+    pDb->recordSTOReceive("carol", Txid(2), 310, 1, 50);
+    pDb->recordSTOReceive("alice", Txid(3), 320, 1, 60);
+
+    BOOST_CHECK_EQUAL(3, pDb->deleteAboveBlock(310));
+
+    UniValue recipients(UniValue::VARR);
+    uint64_t total = 0;
+    uint64_t numRecipients = 0;
+    pDb->getRecipients(Txid(2), "*", &recipients, &total, &numRecipients);
+    BOOST_CHECK_EQUAL(0U, recipients.size());
+    BOOST_CHECK_EQUAL(0U, numRecipients);
+
+    pDb->getRecipients(Txid(1), "*", &recipients, &total, &numRecipients);
+    BOOST_CHECK_EQUAL(2U, recipients.size());
+    BOOST_CHECK_EQUAL(2U, numRecipients);
+
+    BOOST_CHECK(pDb->exists("alice"));
+    BOOST_CHECK(!pDb->exists("carol"));
+    BOOST_CHECK_EQUAL(0, pDb->deleteAboveBlock(310));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -2,7 +2,11 @@
 
 #include <test/test_bitcoin.h>
 
+#include <tinyformat.h>
+
 #include <stdint.h>
+#include <string>
+#include <vector>
 
 #include <boost/test/unit_test.hpp>
 
@@ -318,5 +322,121 @@ BOOST_AUTO_TEST_CASE(tally_overflow)
     BOOST_CHECK_EQUAL(tally.getMoneyReserved(3), int64_t(9223372036854775807LL));
 }
 
+BOOST_AUTO_TEST_CASE(tally_map_interning)
+{
+    CMPTallyMap tallyMap;
+    BOOST_CHECK(tallyMap.empty());
+    BOOST_CHECK_EQUAL(CMPTallyMap::NO_ID, tallyMap.getId("alice"));
+    BOOST_CHECK(tallyMap.find("alice") == nullptr);
+
+    // identifiers are dense and stable, while the hash table grows
+    for (uint32_t n = 0; n < 1000; ++n) {
+        BOOST_CHECK_EQUAL(n, tallyMap.intern(strprintf("address%d", n)));
+    }
+    BOOST_CHECK_EQUAL(1000U, tallyMap.size());
+    for (uint32_t n = 0; n < 1000; ++n) {
+        const std::string address = strprintf("address%d", n);
+        BOOST_CHECK_EQUAL(n, tallyMap.getId(address));
+        BOOST_CHECK_EQUAL(n, tallyMap.intern(address));
+        BOOST_CHECK_EQUAL(address, tallyMap.getAddress(n));
+    }
+    BOOST_CHECK_EQUAL(1000U, tallyMap.size());
+    BOOST_CHECK_EQUAL(CMPTallyMap::NO_ID, tallyMap.getId("alice"));
+
+    BOOST_CHECK(tallyMap.getTally(7).updateMoney(3, 100, BALANCE));
+    BOOST_CHECK(tallyMap.getTally(7).updateMoney(1, 50, METADEX_RESERVE));
+    BOOST_CHECK_EQUAL(100, tallyMap.find("address7")->getMoney(3, BALANCE));
+    BOOST_CHECK_EQUAL(2U, tallyMap.countRecords());
+    BOOST_CHECK(tallyMap.DynamicMemoryUsage() > 0);
+
+    // balance records are sorted by property identifier
+    CMPTally& tally = tallyMap.getTally(7);
+    BOOST_CHECK_EQUAL(1U, tally.init());
+    BOOST_CHECK_EQUAL(1U, tally.next());
+    BOOST_CHECK_EQUAL(3U, tally.next());
+    BOOST_CHECK_EQUAL(0U, tally.next());
+
+    tallyMap.clear();
+    BOOST_CHECK(tallyMap.empty());
+    BOOST_CHECK(tallyMap.find("address7") == nullptr);
+    BOOST_CHECK_EQUAL(0U, tallyMap.intern("bob"));
+    BOOST_CHECK_EQUAL(0, tallyMap.find("bob")->getMoney(3, BALANCE));
+}
+
+BOOST_AUTO_TEST_CASE(tally_map_stable_references)
+{
+    CMPTallyMap tallyMap;
+    CMPTally& tally = tallyMap.getTally(tallyMap.intern("alice"));
+    BOOST_CHECK(tally.updateMoney(1, 100, BALANCE));
+
+    // adding addresses doesn't move existing tallies
+    for (int n = 0; n < 1000; ++n) {
+        tallyMap.intern(strprintf("address%d", n));
+    }
+
+    BOOST_CHECK(&tally == tallyMap.find("alice"));
+    BOOST_CHECK_EQUAL(100, tally.getMoney(1, BALANCE));
+}
+
+BOOST_AUTO_TEST_CASE(tally_map_changes)
+{
+    CMPTallyMap tallyMap;
+    std::vector<uint32_t> vIds;
+
+    // all addresses are considered as changed initially
+    tallyMap.markChanged(tallyMap.intern("alice"));
+    BOOST_CHECK(!tallyMap.takeChanged(vIds));
+    BOOST_CHECK(vIds.empty());
+
+    // afterwards only marked addresses are reported, each once
+    BOOST_CHECK(tallyMap.takeChanged(vIds));
+    BOOST_CHECK(vIds.empty());
+    tallyMap.markChanged(tallyMap.intern("bob"));
+    tallyMap.markChanged(tallyMap.intern("carol"));
+    tallyMap.markChanged(tallyMap.intern("bob"));
+    BOOST_CHECK(tallyMap.takeChanged(vIds));
+    BOOST_CHECK_EQUAL(2U, vIds.size());
+    BOOST_CHECK_EQUAL("bob", tallyMap.getAddress(vIds[0]));
+    BOOST_CHECK_EQUAL("carol", tallyMap.getAddress(vIds[1]));
+
+    vIds.clear();
+    tallyMap.markChanged(tallyMap.intern("bob"));
+    BOOST_CHECK(tallyMap.takeChanged(vIds));
+    BOOST_CHECK_EQUAL(1U, vIds.size());
+
+    // after clearing the map, all addresses are considered as changed again
+    vIds.clear();
+    tallyMap.clear();
+    tallyMap.markChanged(tallyMap.intern("dave"));
+    BOOST_CHECK(!tallyMap.takeChanged(vIds));
+    BOOST_CHECK(vIds.empty());
+}
+
+BOOST_AUTO_TEST_CASE(tally_map_ordered_ids)
+{
+    CMPTallyMap tallyMap;
+    BOOST_CHECK(tallyMap.getOrderedIds().empty());
+
+    tallyMap.intern("dave");
+    tallyMap.intern("bob");
+    BOOST_CHECK_EQUAL(2U, tallyMap.getOrderedIds().size());
+    BOOST_CHECK_EQUAL("bob", tallyMap.getAddress(tallyMap.getOrderedIds()[0]));
+    BOOST_CHECK_EQUAL("dave", tallyMap.getAddress(tallyMap.getOrderedIds()[1]));
+
+    // new addresses are merged into the existing order
+    tallyMap.intern("erin");
+    tallyMap.intern("alice");
+    tallyMap.intern("carol");
+    const std::vector<uint32_t>& vIds = tallyMap.getOrderedIds();
+    BOOST_REQUIRE_EQUAL(5U, vIds.size());
+    BOOST_CHECK_EQUAL("alice", tallyMap.getAddress(vIds[0]));
+    BOOST_CHECK_EQUAL("bob", tallyMap.getAddress(vIds[1]));
+    BOOST_CHECK_EQUAL("carol", tallyMap.getAddress(vIds[2]));
+    BOOST_CHECK_EQUAL("dave", tallyMap.getAddress(vIds[3]));
+    BOOST_CHECK_EQUAL("erin", tallyMap.getAddress(vIds[4]));
+
+    tallyMap.clear();
+    BOOST_CHECK(tallyMap.getOrderedIds().empty());
+}
 
 BOOST_AUTO_TEST_SUITE_END()
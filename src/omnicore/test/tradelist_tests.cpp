@@ -0,0 +1,149 @@
+#include <omnicore/dbspinfo.h>
+#include <omnicore/dbtradelist.h>
+#include <omnicore/omnicore.h>
+#include <omnicore/sp.h>
+#include <omnicore/test/utils_db.h>
+
+#include <test/test_bitcoin.h>
+#include <uint256.h>
+#include <util/system.h>
+
+#include <univalue.h>
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+using namespace mastercore;
+
+BOOST_FIXTURE_TEST_SUITE(omnicore_tradelist_tests, OmniDBTestingSetup<CMPTradeList>)
+
+BOOST_AUTO_TEST_CASE(trades_for_address)
+{
+    pDb->recordNewTrade(Txid(3), "alice", 1, 31, 500, 2);
+    pDb->recordNewTrade(Txid(1), "alice", 1, 3, 400, 7);
+    pDb->recordNewTrade(Txid(2), "alice", 31, 1, 500, 1);
+    pDb->recordNewTrade(Txid(4), "alicea", 1, 3, 450, 1);
+    pDb->recordNewTrade(Txid(5), "bob", 1, 3, 450, 1);
+
+    std::vector<uint256> vTxids;
+    pDb->getTradesForAddress("alice", vTxids);
+    BOOST_CHECK_EQUAL(3U, vTxids.size());
+    BOOST_CHECK(vTxids[0] == Txid(1));
+    BOOST_CHECK(vTxids[1] == Txid(2));
+    BOOST_CHECK(vTxids[2] == Txid(3));
+
+    // filtered by property
+    vTxids.clear();
+    pDb->getTradesForAddress("alice", vTxids, 3);
+    BOOST_CHECK_EQUAL(1U, vTxids.size());
+    BOOST_CHECK(vTxids[0] == Txid(1));
+
+    // most recent first, with count and skip
+    vTxids.clear();
+    pDb->getTradesForAddress("alice", vTxids, 0, 2, 0, true);
+    BOOST_CHECK_EQUAL(2U, vTxids.size());
+    BOOST_CHECK(vTxids[0] == Txid(3));
+    BOOST_CHECK(vTxids[1] == Txid(2));
+    vTxids.clear();
+    pDb->getTradesForAddress("alice", vTxids, 0, 2, 2, true);
+    BOOST_CHECK_EQUAL(1U, vTxids.size());
+    BOOST_CHECK(vTxids[0] == Txid(1));
+
+    // the last address of the index
+    vTxids.clear();
+    pDb->getTradesForAddress("bob", vTxids, 0, 0, 0, true);
+    BOOST_CHECK_EQUAL(1U, vTxids.size());
+
+    vTxids.clear();
+    pDb->getTradesForAddress("carol", vTxids, 0, 0, 0, true);
+    BOOST_CHECK(vTxids.empty());
+
+    BOOST_CHECK_EQUAL(5, pDb->getMPTradeCountTotal());
+}
+
+BOOST_AUTO_TEST_CASE(matching_trades_and_rollback)
+{
+    pDb->recordNewTrade(Txid(1), "alice", 1, 2, 400, 1);
+    pDb->recordNewTrade(Txid(2), "bob", 2, 1, 410, 3);
+    pDb->recordNewTrade(Txid(3), "carol", 2, 1, 420, 5);
+    pDb->recordMatchedTrade(Txid(1), Txid(2), "alice", "bob", 1, 2, 10, 20, 410, 3, 0);
+    pDb->recordMatchedTrade(Txid(1), Txid(3), "alice", "carol", 1, 2, 30, 60, 420, 5, 0);
+
+    UniValue trades(UniValue::VARR);
+    int64_t totalSold = 0;
+    int64_t totalReceived = 0;
+    BOOST_CHECK(pDb->getMatchingTrades(Txid(1), 2, trades, totalSold, totalReceived));
+    BOOST_CHECK_EQUAL(2U, trades.size());
+    BOOST_CHECK_EQUAL(80, totalSold);
+    BOOST_CHECK_EQUAL(40, totalReceived);
+
+    trades = UniValue(UniValue::VARR);
+    BOOST_CHECK(pDb->getMatchingTrades(Txid(3), 2, trades, totalSold, totalReceived));
+    BOOST_CHECK_EQUAL(1U, trades.size());
+    BOOST_CHECK_EQUAL(Txid(1).GetHex(), trades[0]["txid"].get_str());
+
+    BOOST_CHECK_EQUAL(5, pDb->getMPTradeCountTotal());
+
+    // records and index entries of the block and above are removed
+    BOOST_CHECK_EQUAL(2, pDb->deleteAboveBlock(420));
+    trades = UniValue(UniValue::VARR);
+    BOOST_CHECK(!pDb->getMatchingTrades(Txid(3), 2, trades, totalSold, totalReceived));
+    trades = UniValue(UniValue::VARR);
+    BOOST_CHECK(pDb->getMatchingTrades(Txid(1), 2, trades, totalSold, totalReceived));
+    BOOST_CHECK_EQUAL(1U, trades.size());
+
+    std::vector<uint256> vTxids;
+    pDb->getTradesForAddress("carol", vTxids);
+    BOOST_CHECK(vTxids.empty());
+    BOOST_CHECK_EQUAL(3, pDb->getMPTradeCountTotal());
+}
+
+BOOST_AUTO_TEST_CASE(batched_writes)
+{
+    pDb->recordNewTrade(Txid(1), "alice", 1, 3, 400, 1);
+    pDb->recordNewTrade(Txid(3), "alice", 1, 3, 410, 1);
+
+    // pending entries are visible, and merged with stored entries in both directions
+    pDb->BeginBatch();
+    pDb->recordNewTrade(Txid(2), "alice", 1, 3, 420, 1);
+    pDb->recordNewTrade(Txid(4), "alice", 1, 3, 420, 2);
+    pDb->recordNewTrade(Txid(5), "bob", 1, 3, 420, 3);
+
+    std::vector<uint256> vTxids;
+    pDb->getTradesForAddress("alice", vTxids);
+    BOOST_CHECK_EQUAL(4U, vTxids.size());
+    BOOST_CHECK(vTxids[0] == Txid(1));
+    BOOST_CHECK(vTxids[3] == Txid(4));
+
+    vTxids.clear();
+    pDb->getTradesForAddress("alice", vTxids, 0, 0, 0, true);
+    BOOST_CHECK_EQUAL(4U, vTxids.size());
+    BOOST_CHECK(vTxids[0] == Txid(4));
+    BOOST_CHECK(vTxids[1] == Txid(2));
+    BOOST_CHECK(vTxids[2] == Txid(3));
+    BOOST_CHECK(vTxids[3] == Txid(1));
+    BOOST_CHECK_EQUAL(5, pDb->getMPTradeCountTotal());
+
+    // erased entries are hidden, before and after the commit
+    BOOST_CHECK_EQUAL(3, pDb->deleteAboveBlock(420));
+    vTxids.clear();
+    pDb->getTradesForAddress("alice", vTxids, 0, 0, 0, true);
+    BOOST_CHECK_EQUAL(2U, vTxids.size());
+    BOOST_CHECK(vTxids[0] == Txid(3));
+    BOOST_CHECK(vTxids[1] == Txid(1));
+
+    pDb->recordNewTrade(Txid(6), "alice", 1, 3, 430, 1);
+    BOOST_CHECK(pDb->CommitBatch().ok());
+
+    vTxids.clear();
+    pDb->getTradesForAddress("alice", vTxids);
+    BOOST_CHECK_EQUAL(3U, vTxids.size());
+    BOOST_CHECK(vTxids[0] == Txid(1));
+    BOOST_CHECK(vTxids[2] == Txid(6));
+    BOOST_CHECK_EQUAL(3, pDb->getMPTradeCountTotal());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,192 @@
+#include <omnicore/consensushash.h>
+#include <omnicore/dbspinfo.h>
+#include <omnicore/dex.h>
+#include <omnicore/mdex.h>
+#include <omnicore/notifications.h>
+#include <omnicore/omnicore.h>
+#include <omnicore/sp.h>
+#include <omnicore/tally.h>
+#include <omnicore/test/utils_db.h>
+#include <omnicore/undo.h>
+
+#include <chain.h>
+#include <test/test_bitcoin.h>
+#include <uint256.h>
+#include <util/system.h>
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+using namespace mastercore;
+
+namespace
+{
+/** Provides a smart property database and a chain of block indexes. */
+struct UndoTestingSetup : public SmartPropertyTestingSetup
+{
+    std::vector<uint256> vHashes;
+    std::vector<CBlockIndex> vBlocks;
+
+    UndoTestingSetup() : vHashes(4), vBlocks(4)
+    {
+        for (size_t i = 0; i < vBlocks.size(); ++i) {
+            vHashes[i] = BlockHash(i + 1);
+            vBlocks[i].phashBlock = &vHashes[i];
+            vBlocks[i].nHeight = 700000 + i;
+            vBlocks[i].pprev = (i > 0) ? &vBlocks[i - 1] : nullptr;
+        }
+        ClearTallyMap();
+    }
+
+    ~UndoTestingSetup()
+    {
+        ClearTallyMap();
+        ClearFreezeState();
+        ClearAlerts();
+        metadex.clear();
+        my_offers.clear();
+        ResetOrderbookCommitments();
+    }
+
+    void ConnectBlock(int n)
+    {
+        BeginBlockUndo(&vBlocks[n]);
+    }
+};
+}
+
+BOOST_FIXTURE_TEST_SUITE(omnicore_undo_tests, UndoTestingSetup)
+
+BOOST_AUTO_TEST_CASE(revert_tally_updates)
+{
+    ConnectBlock(1);
+    BOOST_CHECK(update_tally_map("alice", 3, 100, BALANCE));
+    EndBlockUndo();
+    const uint256 commitment = GetBalanceCommitment();
+
+    ConnectBlock(2);
+    BOOST_CHECK(update_tally_map("alice", 3, -40, BALANCE));
+    BOOST_CHECK(update_tally_map("bob", 3, 40, BALANCE));
+    EndBlockUndo();
+    ConnectBlock(3);
+    BOOST_CHECK(update_tally_map("bob", 3, -10, BALANCE));
+    BOOST_CHECK(update_tally_map("bob", 3, 10, METADEX_RESERVE));
+    EndBlockUndo();
+
+    BOOST_CHECK(RevertBlocks(vBlocks[2].nHeight, vBlocks[1].GetBlockHash()));
+    BOOST_CHECK_EQUAL(100, GetTokenBalance("alice", 3, BALANCE));
+    BOOST_CHECK_EQUAL(0, GetTokenBalance("bob", 3, BALANCE));
+    BOOST_CHECK_EQUAL(0, GetTokenBalance("bob", 3, METADEX_RESERVE));
+    BOOST_CHECK_EQUAL(1U, GetPropertyHolders(3).size());
+    BOOST_CHECK(GetBalanceCommitment() == commitment);
+
+    // the reverted blocks are no longer available
+    BOOST_CHECK(!RevertBlocks(vBlocks[2].nHeight, vBlocks[1].GetBlockHash()));
+}
+
+BOOST_AUTO_TEST_CASE(revert_requires_matching_fork)
+{
+    ConnectBlock(1);
+    BOOST_CHECK(update_tally_map("alice", 3, 100, BALANCE));
+    EndBlockUndo();
+
+    // block 1 is not built on block 2, and block 0 was never recorded
+    BOOST_CHECK(!RevertBlocks(vBlocks[1].nHeight, vBlocks[2].GetBlockHash()));
+    BOOST_CHECK(!RevertBlocks(vBlocks[0].nHeight, uint256()));
+    BOOST_CHECK_EQUAL(100, GetTokenBalance("alice", 3, BALANCE));
+
+    BOOST_CHECK(RevertBlocks(vBlocks[1].nHeight, vBlocks[0].GetBlockHash()));
+    BOOST_CHECK_EQUAL(0, GetTokenBalance("alice", 3, BALANCE));
+}
+
+BOOST_AUTO_TEST_CASE(revert_credit_to_frozen_address)
+{
+    ConnectBlock(1);
+    enableFreezing(3, 700000);
+    freezeAddress("alice", 3);
+    BOOST_CHECK(update_tally_map("alice", 3, 100, BALANCE));
+    EndBlockUndo();
+
+    BOOST_CHECK(RevertBlocks(vBlocks[1].nHeight, vBlocks[0].GetBlockHash()));
+    BOOST_CHECK_EQUAL(0, GetTokenBalance("alice", 3, BALANCE));
+    BOOST_CHECK(!isAddressFrozen("alice", 3));
+    BOOST_CHECK(!isFreezingEnabled(3, 700000));
+}
+
+BOOST_AUTO_TEST_CASE(revert_alerts)
+{
+    ConnectBlock(1);
+    AddAlert("omnicore", ALERT_BLOCK_EXPIRY, 700002, "alert");
+    EndBlockUndo();
+
+    ConnectBlock(2);
+    CheckExpiredAlerts(700002, 0);
+    EndBlockUndo();
+    BOOST_CHECK(GetOmniCoreAlerts().empty());
+
+    BOOST_CHECK(RevertBlocks(vBlocks[2].nHeight, vBlocks[1].GetBlockHash()));
+    BOOST_REQUIRE_EQUAL(1U, GetOmniCoreAlerts().size());
+    BOOST_CHECK_EQUAL("alert", GetOmniCoreAlerts()[0].alert_message);
+
+    BOOST_CHECK(RevertBlocks(vBlocks[1].nHeight, vBlocks[0].GetBlockHash()));
+    BOOST_CHECK(GetOmniCoreAlerts().empty());
+}
+
+BOOST_AUTO_TEST_CASE(revert_orderbook_changes)
+{
+    CMPMetaDEx order("alice", 700001, 3, 100, 1, 50, Txid(10), 1, 1);
+    CMPMetaDEx updated("alice", 700001, 3, 100, 1, 50, Txid(10), 1, 1, 60);
+    const std::string key = STR_SELLOFFER_ADDR_PROP_COMBO("bob", 1);
+
+    ConnectBlock(1);
+    BOOST_CHECK(MetaDEx_INSERT(order));
+    EndBlockUndo();
+
+    ConnectBlock(2);
+    RecordMetaDExUndo(order, false);
+    get_Indexes(get_Prices(3, 1), order.unitPrice())->erase(order);
+    BOOST_CHECK(MetaDEx_INSERT(updated));
+    RecordOfferUndo(key);
+    my_offers.insert(std::make_pair(key, CMPOffer()));
+    EndBlockUndo();
+
+    BOOST_CHECK(RevertBlocks(vBlocks[2].nHeight, vBlocks[1].GetBlockHash()));
+    BOOST_CHECK(my_offers.empty());
+    const md_Set& indexes = *get_Indexes(get_Prices(3, 1), order.unitPrice());
+    BOOST_CHECK_EQUAL(1U, indexes.size());
+    BOOST_CHECK_EQUAL(100, indexes.begin()->getAmountRemaining());
+
+    BOOST_CHECK(RevertBlocks(vBlocks[1].nHeight, vBlocks[0].GetBlockHash()));
+    BOOST_CHECK(get_Indexes(get_Prices(3, 1), order.unitPrice())->empty());
+}
+
+BOOST_AUTO_TEST_CASE(revert_orders_of_different_pairs)
+{
+    CMPMetaDEx order("alice", 700001, 3, 100, 1, 50, Txid(10), 1, 1);
+    CMPMetaDEx other("alice", 700002, 3, 100, 2, 50, Txid(11), 1, 1);
+
+    ConnectBlock(1);
+    BOOST_CHECK(MetaDEx_INSERT(order));
+    EndBlockUndo();
+
+    // orders at the same price, but for different desired properties, are kept apart
+    ConnectBlock(2);
+    BOOST_CHECK(MetaDEx_INSERT(other));
+    EndBlockUndo();
+    BOOST_CHECK_EQUAL(1U, get_Indexes(get_Prices(3, 1), order.unitPrice())->size());
+    BOOST_CHECK_EQUAL(1U, get_Indexes(get_Prices(3, 2), other.unitPrice())->size());
+    BOOST_CHECK(get_Prices(1, 3) == nullptr);
+    BOOST_CHECK(MetaDEx_isOpen(other.getHash(), 3));
+    BOOST_CHECK(!MetaDEx_isOpen(other.getHash(), 1));
+
+    BOOST_CHECK(RevertBlocks(vBlocks[2].nHeight, vBlocks[1].GetBlockHash()));
+    BOOST_CHECK(get_Indexes(get_Prices(3, 2), other.unitPrice())->empty());
+    BOOST_CHECK_EQUAL(1U, get_Indexes(get_Prices(3, 1), order.unitPrice())->size());
+    BOOST_CHECK(!MetaDEx_isOpen(other.getHash(), 3));
+    BOOST_CHECK(MetaDEx_isOpen(order.getHash(), 0));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,42 @@
+#include <omnicore/test/utils_db.h>
+
+#include <omnicore/dbspinfo.h>
+#include <omnicore/sp.h>
+
+#include <arith_uint256.h>
+#include <test/test_bitcoin.h>
+#include <uint256.h>
+#include <util/system.h>
+
+#include <boost/test/unit_test.hpp>
+
+using namespace mastercore;
+
+uint256 Txid(int n)
+{
+    return ArithToUint256(arith_uint256(n));
+}
+
+uint256 BlockHash(int n)
+{
+    return ArithToUint256(arith_uint256(n));
+}
+
+SmartPropertyTestingSetup::SmartPropertyTestingSetup()
+{
+    pDbSpInfo = new CMPSPInfo(GetDataDir() / "MP_spinfo", true);
+}
+
+SmartPropertyTestingSetup::~SmartPropertyTestingSetup()
+{
+    delete pDbSpInfo;
+    pDbSpInfo = nullptr;
+}
+
+// Added to pacify test script that tries to run all test/ folder contents as tests
+BOOST_FIXTURE_TEST_SUITE(omnicore_db_utility, BasicTestingSetup)
+BOOST_AUTO_TEST_CASE(pacify_script)
+{
+    BOOST_CHECK_EQUAL(true, true);
+}
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,38 @@
+#ifndef BITCOIN_OMNICORE_TEST_UTILS_DB_H
+#define BITCOIN_OMNICORE_TEST_UTILS_DB_H
+
+#include <test/test_bitcoin.h>
+#include <uint256.h>
+#include <util/system.h>
+
+/** Returns a hash with the numeric value n, to be used as txid. */
+uint256 Txid(int n);
+
+/** Returns a hash with the numeric value n, to be used as block hash. */
+uint256 BlockHash(int n);
+
+/** Provides an empty smart property database as pDbSpInfo. */
+struct SmartPropertyTestingSetup : public BasicTestingSetup
+{
+    SmartPropertyTestingSetup();
+    ~SmartPropertyTestingSetup();
+};
+
+/** Provides an empty database of type DB, in addition to the smart property database. */
+template <typename DB>
+struct OmniDBTestingSetup : public SmartPropertyTestingSetup
+{
+    DB* pDb;
+
+    OmniDBTestingSetup()
+    {
+        pDb = new DB(GetDataDir() / "MP_testdb", true);
+    }
+
+    ~OmniDBTestingSetup()
+    {
+        delete pDb;
+    }
+};
+
+#endif // BITCOIN_OMNICORE_TEST_UTILS_DB_H
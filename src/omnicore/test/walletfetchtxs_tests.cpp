@@ -0,0 +1,189 @@
+#include <omnicore/dbstolist.h>
+#include <omnicore/dbtxlist.h>
+#include <omnicore/omnicore.h>
+#include <omnicore/test/utils_db.h>
+#include <omnicore/walletfetchtxs.h>
+
+#include <interfaces/chain.h>
+#include <interfaces/wallet.h>
+#include <key.h>
+#include <key_io.h>
+#include <pubkey.h>
+#include <script/standard.h>
+#include <test/test_bitcoin.h>
+#include <uint256.h>
+#include <validation.h>
+#include <wallet/wallet.h>
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+using namespace mastercore;
+
+namespace
+{
+/** Provides a wallet with the coinbase key. The databases are opened by mastercore_init(), while the chain is mined. */
+struct WalletFetchTestingSetup : public TestChain100Setup
+{
+    std::unique_ptr<interfaces::Chain> m_chain = interfaces::MakeChain();
+    std::shared_ptr<CWallet> wallet;
+    std::unique_ptr<interfaces::Wallet> interface_wallet;
+
+    WalletFetchTestingSetup()
+    {
+        wallet = std::make_shared<CWallet>(*m_chain, WalletLocation(), WalletDatabase::CreateMock());
+        bool firstRun;
+        wallet->LoadWallet(firstRun);
+        {
+            LOCK(wallet->cs_wallet);
+            wallet->AddKeyPubKey(coinbaseKey, coinbaseKey.GetPubKey());
+        }
+        RescanWallet(chainActive.Genesis()->GetBlockHash());
+        AddWallet(wallet);
+        interface_wallet = interfaces::MakeWallet(wallet);
+    }
+
+    ~WalletFetchTestingSetup()
+    {
+        interface_wallet.reset();
+        wallet->NotifyUnload();
+        RemoveWallet(wallet);
+        wallet.reset();
+    }
+
+    /** Adds the transactions of the given block and above to the wallet. */
+    void RescanWallet(const uint256& hashStartBlock)
+    {
+        WalletRescanReserver reserver(wallet.get());
+        reserver.reserve();
+        wallet->ScanForWalletTransactions(hashStartBlock, {}, reserver, false);
+    }
+
+    /** Mines a block, and returns the hash of its coinbase transaction, which is added to the wallet. */
+    uint256 MineBlock()
+    {
+        CBlock block = CreateAndProcessBlock({}, GetScriptForRawPubKey(coinbaseKey.GetPubKey()));
+        RescanWallet(block.GetHash());
+        return block.vtx[0]->GetHash();
+    }
+
+    /** Returns whether a transaction is among the Omni transactions of the wallet. */
+    bool HasWalletTransaction(const uint256& txid)
+    {
+        std::map<std::string, uint256> walletTransactions = FetchWalletOmniTransactions(*interface_wallet, 1000);
+        for (const std::pair<const std::string, uint256>& entry : walletTransactions) {
+            if (entry.second == txid) return true;
+        }
+        return false;
+    }
+
+    /** Records a send to owners transaction with a single recipient. */
+    void RecordSTO(const uint256& txid, int nBlock, const std::string& recipient)
+    {
+        pDbTransactionList->recordTX(txid, true, nBlock, MSC_TYPE_SEND_TO_OWNERS, 0);
+        pDbStoList->recordSTOReceive(recipient, txid, nBlock, 3, 100);
+    }
+};
+
+int GetTipHeight()
+{
+    LOCK(cs_main);
+    return chainActive.Height();
+}
+}
+
+BOOST_FIXTURE_TEST_SUITE(omnicore_walletfetchtxs_tests, WalletFetchTestingSetup)
+
+BOOST_AUTO_TEST_CASE(rebuild_and_incremental_update)
+{
+    const uint256 txid10 = m_coinbase_txns[9]->GetHash();
+    const uint256 txid20 = m_coinbase_txns[19]->GetHash();
+    const uint256 txid30 = m_coinbase_txns[29]->GetHash();
+    pDbTransactionList->recordTX(txid10, true, 10, MSC_TYPE_SIMPLE_SEND, 0);
+    pDbTransactionList->recordTX(txid20, true, 20, MSC_TYPE_SIMPLE_SEND, 0);
+
+    // the index is built from all wallet transactions with the first fetch
+    std::map<std::string, uint256> walletTransactions = FetchWalletOmniTransactions(*interface_wallet, 10);
+    BOOST_CHECK_EQUAL(2U, walletTransactions.size());
+    BOOST_CHECK(walletTransactions.begin()->second == txid10);
+    BOOST_CHECK(walletTransactions.rbegin()->second == txid20);
+
+    // afterwards only transactions signalled by the wallet are evaluated
+    pDbTransactionList->recordTX(txid30, true, 30, MSC_TYPE_SIMPLE_SEND, 0);
+    BOOST_CHECK(!HasWalletTransaction(txid30));
+
+    const uint256 txidNew = MineBlock();
+    pDbTransactionList->recordTX(txidNew, true, GetTipHeight(), MSC_TYPE_SIMPLE_SEND, 0);
+    BOOST_CHECK(HasWalletTransaction(txidNew));
+    BOOST_CHECK_EQUAL(3U, FetchWalletOmniTransactions(*interface_wallet, 10).size());
+
+    // the count and block range are applied to the index
+    walletTransactions = FetchWalletOmniTransactions(*interface_wallet, 1, 0, 20);
+    BOOST_CHECK_EQUAL(1U, walletTransactions.size());
+    BOOST_CHECK(walletTransactions.begin()->second == txid20);
+}
+
+BOOST_AUTO_TEST_CASE(sto_receipts_of_new_blocks)
+{
+    const std::string address = EncodeDestination(coinbaseKey.GetPubKey().GetID());
+    CKey otherKey;
+    otherKey.MakeNewKey(true);
+    const std::string otherAddress = EncodeDestination(otherKey.GetPubKey().GetID());
+
+    RecordSTO(Txid(1), 50, address);
+    BOOST_CHECK(HasWalletTransaction(Txid(1)));
+
+    // the receipts of blocks connected after the last fetch are scanned
+    CreateAndProcessBlock({}, GetScriptForRawPubKey(coinbaseKey.GetPubKey()));
+    CreateAndProcessBlock({}, GetScriptForRawPubKey(coinbaseKey.GetPubKey()));
+    RecordSTO(Txid(2), GetTipHeight() - 1, address);
+    RecordSTO(Txid(3), GetTipHeight(), otherAddress);
+    BOOST_CHECK(HasWalletTransaction(Txid(2)));
+    BOOST_CHECK(!HasWalletTransaction(Txid(3)));
+}
+
+BOOST_AUTO_TEST_CASE(rewind_on_reparse)
+{
+    const std::string address = EncodeDestination(coinbaseKey.GetPubKey().GetID());
+
+    const uint256 txidWallet = MineBlock();
+    const int nBlockWallet = GetTipHeight();
+    pDbTransactionList->recordTX(txidWallet, true, nBlockWallet, MSC_TYPE_SIMPLE_SEND, 0);
+    CreateAndProcessBlock({}, GetScriptForRawPubKey(coinbaseKey.GetPubKey()));
+    RecordSTO(Txid(1), GetTipHeight(), address);
+    BOOST_CHECK(HasWalletTransaction(txidWallet));
+    BOOST_CHECK(HasWalletTransaction(Txid(1)));
+
+    // the blocks are parsed again, and only the wallet transaction is found again
+    pDbTransactionList->isMPinBlockRange(nBlockWallet, GetTipHeight(), true);
+    pDbStoList->deleteAboveBlock(nBlockWallet);
+    RewindWalletTxIndexes(nBlockWallet);
+    pDbTransactionList->recordTX(txidWallet, true, nBlockWallet, MSC_TYPE_SIMPLE_SEND, 0);
+
+    BOOST_CHECK(HasWalletTransaction(txidWallet));
+    BOOST_CHECK(!HasWalletTransaction(Txid(1)));
+}
+
+BOOST_AUTO_TEST_CASE(receipts_of_imported_addresses)
+{
+    CKey key;
+    key.MakeNewKey(true);
+    const CTxDestination dest = key.GetPubKey().GetID();
+
+    RecordSTO(Txid(1), 50, EncodeDestination(dest));
+    BOOST_CHECK(!HasWalletTransaction(Txid(1)));
+
+    // earlier receipts are added, when an address is added to the address book
+    {
+        LOCK(wallet->cs_wallet);
+        wallet->AddKeyPubKey(key, key.GetPubKey());
+    }
+    wallet->SetAddressBook(dest, "imported", "receive");
+    BOOST_CHECK(HasWalletTransaction(Txid(1)));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
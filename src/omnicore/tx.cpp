@@ -16,6 +16,7 @@
 #include <omnicore/rules.h>
 #include <omnicore/sp.h>
 #include <omnicore/sto.h>
+#include <omnicore/undo.h>
 #include <omnicore/utilsbitcoin.h>
 #include <omnicore/version.h>
 
@@ -1023,6 +1024,7 @@ int CMPTransaction::logicHelper_CrowdsaleParticipation(uint256& blockHash)
     }
 
     // Update the crowdsale object
+    RecordCrowdUndo(receiver);
     pcrowdsale->incTokensUserCreated(tokens.first);
     pcrowdsale->incTokensIssuerCreated(tokens.second);
 
@@ -1274,7 +1276,7 @@ int CMPTransaction::logicMath_SendAll()
             ++numberOfPropertiesSent;
             assert(update_tally_map(sender, propertyId, -moneyAvailable, BALANCE));
             assert(update_tally_map(receiver, propertyId, moneyAvailable, BALANCE));
-            pDbTransactionList->recordSendAllSubRecord(txid, numberOfPropertiesSent, propertyId, moneyAvailable);
+            pDbTransactionList->recordSendAllSubRecord(txid, block, numberOfPropertiesSent, propertyId, moneyAvailable);
         }
     }
 
@@ -1769,6 +1771,7 @@ int CMPTransaction::logicMath_CreatePropertyVariable(CBlockIndex* pindex)
 
     const uint32_t propertyId = pDbSpInfo->putSP(ecosystem, newSP);
     assert(propertyId > 0);
+    RecordCrowdUndo(sender);
     my_crowds.insert(std::make_pair(sender, CMPCrowd(propertyId, nValue, property, deadline, early_bird, percentage, 0, 0)));
 
     PrintToLog("CREATED CROWDSALE id: %d value: %d property: %d\n", propertyId, nValue, property);
@@ -1830,6 +1833,7 @@ int CMPTransaction::logicMath_CloseCrowdsale(CBlockIndex* pindex)
     if (missedTokens > 0) {
         assert(update_tally_map(sp.issuer, property, missedTokens, BALANCE));
     }
+    RecordCrowdUndo(sender);
     my_crowds.erase(it);
 
     if (msc_debug_sp) PrintToLog("CLOSED CROWDSALE id: %d=%X\n", property, property);
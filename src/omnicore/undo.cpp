@@ -0,0 +1,393 @@
+/**
+ * @file undo.cpp
+ *
+ * This file contains the per-block undo log of the in-memory state.
+ *
+ * While a block is processed, every update of the tally map, every change of the
+ * MetaDEx orderbook, sell offers, accept orders and crowdsales, as well as changes of
+ * the freeze state, alerts and feature activations are recorded. When blocks are disconnected,
+ * the recorded changes are applied in reverse, which restores the state as of the fork
+ * point without reloading a persisted state and rescanning the blocks in between.
+ *
+ * Only blocks, for which the state is persisted, are recorded, and at most
+ * MAX_STATE_HISTORY blocks are kept.
+ *
+ * The undo logs are kept in memory only. After a restart, blocks connected before
+ * the restart can't be reverted this way. Disconnecting them falls back to loading
+ * the most recent persisted state, which is still part of the active chain, and
+ * parsing the blocks from there on again.
+ *
+ * Modifications of the orderbooks are reported here in any case, and are forwarded
+ * to the orderbook commitments, which are thereby kept up to date incrementally.
+ */
+
+#include <omnicore/undo.h>
+
+#include <omnicore/activation.h>
+#include <omnicore/consensushash.h>
+#include <omnicore/dex.h>
+#include <omnicore/log.h>
+#include <omnicore/mdex.h>
+#include <omnicore/notifications.h>
+#include <omnicore/omnicore.h>
+#include <omnicore/persistence.h>
+#include <omnicore/rules.h>
+#include <omnicore/sp.h>
+#include <omnicore/tally.h>
+
+#include <chain.h>
+#include <sync.h>
+#include <uint256.h>
+
+#include <stdint.h>
+
+#include <deque>
+#include <memory>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+extern int64_t exodus_prev;
+
+namespace mastercore
+{
+/** An update of the tally map. */
+struct CTallyUndo
+{
+    std::string address;
+    uint32_t propertyId;
+    TallyType ttype;
+    int64_t amount;
+};
+
+/** A MetaDEx order, which was added to, or removed from the orderbook. */
+struct CMetaDExUndo
+{
+    CMPMetaDEx order;
+    bool fAdded;
+};
+
+/** The state of a map entry, before it was modified. */
+template <typename T>
+struct CEntryUndo
+{
+    std::string key;
+    bool fExisted;
+    T value;
+};
+
+/** The changes of the in-memory state by a single block. */
+struct CBlockUndo
+{
+    int nBlock;
+    uint256 hashBlock;
+    uint256 hashPrevBlock;
+    int64_t nExodusPrev;
+    uint32_t nNextSPID;
+    uint32_t nNextTestSPID;
+
+    std::vector<CTallyUndo> vTally;
+    std::vector<CMetaDExUndo> vMetaDEx;
+    std::vector<CEntryUndo<CMPOffer> > vOffers;
+    std::vector<CEntryUndo<CMPAccept> > vAccepts;
+    std::vector<CEntryUndo<CMPCrowd> > vCrowds;
+
+    //! Freeze state before the block, if it was modified
+    bool fFreezeState;
+    std::set<std::pair<std::string, uint32_t> > frozenAddresses;
+    std::set<std::pair<uint32_t, int> > freezingEnabledProperties;
+
+    //! Alerts before the block, if they were modified
+    bool fAlerts;
+    std::vector<AlertData> vAlerts;
+
+    //! Activations and consensus parameters before the block, if they were modified
+    std::shared_ptr<CConsensusParams> pConsensusParams;
+    std::vector<FeatureActivation> vPendingActivations;
+    std::vector<FeatureActivation> vCompletedActivations;
+
+    CBlockUndo() : nBlock(0), nExodusPrev(0), nNextSPID(0), nNextTestSPID(0), fFreezeState(false), fAlerts(false) {}
+};
+
+//! Undo logs of the most recent blocks, ordered by height
+static std::deque<CBlockUndo> dequeBlockUndo;
+//! Undo log of the block currently processed, if any
+static CBlockUndo* pBlockUndo = nullptr;
+
+/**
+ * Records the state of a map entry, before it is modified.
+ */
+template <typename Map>
+static void RecordEntry(const Map& map, const std::string& key, std::vector<CEntryUndo<typename Map::mapped_type> >& vUndo)
+{
+    CEntryUndo<typename Map::mapped_type> entry;
+    entry.key = key;
+
+    typename Map::const_iterator it = map.find(key);
+    entry.fExisted = (it != map.end());
+    if (entry.fExisted) entry.value = it->second;
+
+    vUndo.push_back(entry);
+}
+
+/**
+ * Restores the recorded map entries in reverse order.
+ */
+template <typename Map>
+static void RestoreEntries(Map& map, const std::vector<CEntryUndo<typename Map::mapped_type> >& vUndo, void (*markChanged)(const std::string&))
+{
+    typename std::vector<CEntryUndo<typename Map::mapped_type> >::const_reverse_iterator it;
+    for (it = vUndo.rbegin(); it != vUndo.rend(); ++it) {
+        markChanged(it->key);
+        map.erase(it->key);
+        if (it->fExisted) map.insert(std::make_pair(it->key, it->value));
+    }
+}
+
+/**
+ * Removes an order from the MetaDEx orderbook.
+ */
+static bool EraseMetaDExOrder(const CMPMetaDEx& order)
+{
+    md_PricesMap* p_prices = get_Prices(order.getProperty(), order.getDesProperty());
+    if (!p_prices) return false;
+
+    md_Set* p_indexes = get_Indexes(p_prices, order.unitPrice());
+    if (!p_indexes) return false;
+
+    if (p_indexes->erase(order) == 0) return false;
+
+    UpdateMetaDExCommitment(order, false);
+
+    return true;
+}
+
+/**
+ * Starts to record the state changes of a block.
+ *
+ * The undo logs must cover a contiguous range of blocks, so the log is cleared
+ * whenever a block is not recorded, or doesn't follow the previously recorded one.
+ */
+void BeginBlockUndo(const CBlockIndex* pBlockIndex)
+{
+    LOCK(cs_tally);
+
+    pBlockUndo = nullptr;
+
+    if (!IsPersistenceEnabled(pBlockIndex->nHeight) || pBlockIndex->pprev == nullptr) {
+        dequeBlockUndo.clear();
+        return;
+    }
+    if (!dequeBlockUndo.empty() && dequeBlockUndo.back().hashBlock != pBlockIndex->pprev->GetBlockHash()) {
+        dequeBlockUndo.clear();
+    }
+
+    dequeBlockUndo.push_back(CBlockUndo());
+    while (dequeBlockUndo.size() > static_cast<size_t>(MAX_STATE_HISTORY)) {
+        dequeBlockUndo.pop_front();
+    }
+
+    pBlockUndo = &dequeBlockUndo.back();
+    pBlockUndo->nBlock = pBlockIndex->nHeight;
+    pBlockUndo->hashBlock = pBlockIndex->GetBlockHash();
+    pBlockUndo->hashPrevBlock = pBlockIndex->pprev->GetBlockHash();
+    pBlockUndo->nExodusPrev = exodus_prev;
+    pBlockUndo->nNextSPID = pDbSpInfo->peekNextSPID(OMNI_PROPERTY_MSC);
+    pBlockUndo->nNextTestSPID = pDbSpInfo->peekNextSPID(OMNI_PROPERTY_TMSC);
+}
+
+/**
+ * Stops to record state changes, after a block has been processed.
+ */
+void EndBlockUndo()
+{
+    LOCK(cs_tally);
+
+    pBlockUndo = nullptr;
+}
+
+/**
+ * Removes all recorded state changes, for example, when the state is cleared or reloaded.
+ */
+void ClearUndoLog()
+{
+    LOCK(cs_tally);
+
+    pBlockUndo = nullptr;
+    dequeBlockUndo.clear();
+}
+
+void RecordTallyUndo(const std::string& address, uint32_t propertyId, int64_t amount, TallyType ttype)
+{
+    if (pBlockUndo == nullptr) return;
+
+    CTallyUndo entry;
+    entry.address = address;
+    entry.propertyId = propertyId;
+    entry.ttype = ttype;
+    entry.amount = amount;
+    pBlockUndo->vTally.push_back(entry);
+}
+
+void RecordMetaDExUndo(const CMPMetaDEx& order, bool fAdded)
+{
+    UpdateMetaDExCommitment(order, fAdded);
+
+    if (pBlockUndo == nullptr) return;
+
+    CMetaDExUndo entry;
+    entry.order = order;
+    entry.fAdded = fAdded;
+    pBlockUndo->vMetaDEx.push_back(entry);
+}
+
+void RecordOfferUndo(const std::string& key)
+{
+    MarkOfferChanged(key);
+
+    if (pBlockUndo == nullptr) return;
+
+    RecordEntry(my_offers, key, pBlockUndo->vOffers);
+}
+
+void RecordAcceptUndo(const std::string& key)
+{
+    MarkAcceptChanged(key);
+
+    if (pBlockUndo == nullptr) return;
+
+    RecordEntry(my_accepts, key, pBlockUndo->vAccepts);
+}
+
+void RecordCrowdUndo(const std::string& address)
+{
+    MarkCrowdChanged(address);
+
+    if (pBlockUndo == nullptr) return;
+
+    RecordEntry(my_crowds, address, pBlockUndo->vCrowds);
+}
+
+/**
+ * Records the freeze state, when it is modified for the first time within the block.
+ */
+void RecordFreezeUndo()
+{
+    if (pBlockUndo == nullptr || pBlockUndo->fFreezeState) return;
+
+    GetFreezeState(pBlockUndo->frozenAddresses, pBlockUndo->freezingEnabledProperties);
+    pBlockUndo->fFreezeState = true;
+}
+
+/**
+ * Records the active alerts, when they are modified for the first time within the block.
+ */
+void RecordAlertUndo()
+{
+    if (pBlockUndo == nullptr || pBlockUndo->fAlerts) return;
+
+    pBlockUndo->vAlerts = GetOmniCoreAlerts();
+    pBlockUndo->fAlerts = true;
+}
+
+/**
+ * Records the activations and consensus parameters, when they are modified for the first time within the block.
+ */
+void RecordActivationUndo()
+{
+    if (pBlockUndo == nullptr || pBlockUndo->pConsensusParams) return;
+
+    pBlockUndo->vPendingActivations = GetPendingActivations();
+    pBlockUndo->vCompletedActivations = GetCompletedActivations();
+    pBlockUndo->pConsensusParams = std::make_shared<CConsensusParams>(ConsensusParams());
+}
+
+/**
+ * Applies the recorded changes of a block in reverse.
+ */
+static bool RevertBlock(const CBlockUndo& undo)
+{
+    std::vector<CMetaDExUndo>::const_reverse_iterator itMetaDEx;
+    for (itMetaDEx = undo.vMetaDEx.rbegin(); itMetaDEx != undo.vMetaDEx.rend(); ++itMetaDEx) {
+        if (itMetaDEx->fAdded) {
+            if (!EraseMetaDExOrder(itMetaDEx->order)) return false;
+        } else {
+            if (!MetaDEx_INSERT(itMetaDEx->order)) return false;
+        }
+    }
+
+    RestoreEntries(my_offers, undo.vOffers, MarkOfferChanged);
+    RestoreEntries(my_accepts, undo.vAccepts, MarkAcceptChanged);
+    RestoreEntries(my_crowds, undo.vCrowds, MarkCrowdChanged);
+
+    std::vector<CTallyUndo>::const_reverse_iterator itTally;
+    for (itTally = undo.vTally.rbegin(); itTally != undo.vTally.rend(); ++itTally) {
+        if (!revert_tally_map(itTally->address, itTally->propertyId, itTally->amount, itTally->ttype)) return false;
+    }
+
+    if (undo.fFreezeState) {
+        RestoreFreezeState(undo.frozenAddresses, undo.freezingEnabledProperties);
+    }
+    if (undo.fAlerts) {
+        RestoreAlerts(undo.vAlerts);
+    }
+    if (undo.pConsensusParams) {
+        RestoreActivations(undo.vPendingActivations, undo.vCompletedActivations);
+        MutableConsensusParams() = *undo.pConsensusParams;
+    }
+
+    exodus_prev = undo.nExodusPrev;
+    pDbSpInfo->init(undo.nNextSPID, undo.nNextTestSPID);
+
+    return (pDbSpInfo->popBlock(undo.hashBlock) >= 0);
+}
+
+/**
+ * Reverts all recorded blocks at or above the given height.
+ *
+ * The blocks can only be reverted, if the undo logs cover every block from the current
+ * state down to the given height, and the block at the given height is built on the
+ * fork block. Otherwise the state is not modified.
+ *
+ * If reverting a block fails midway, the state is inconsistent and must be reloaded.
+ *
+ * @param nHeight[in]   The first block to revert
+ * @param hashFork[in]  The block below, which becomes the new tip of the state
+ * @return True, if the state was reverted to the fork block
+ */
+bool RevertBlocks(int nHeight, const uint256& hashFork)
+{
+    LOCK(cs_tally);
+
+    pBlockUndo = nullptr;
+
+    if (dequeBlockUndo.empty() || dequeBlockUndo.front().nBlock > nHeight || dequeBlockUndo.back().nBlock < nHeight) {
+        PrintToLog("%s(): no undo log for block %d available\n", __func__, nHeight);
+        return false;
+    }
+
+    std::deque<CBlockUndo>::const_iterator itFork = dequeBlockUndo.begin() + (nHeight - dequeBlockUndo.front().nBlock);
+    if (itFork->nBlock != nHeight || itFork->hashPrevBlock != hashFork) {
+        PrintToLog("%s(): undo log of block %d is not based on block %s\n", __func__, nHeight, hashFork.ToString());
+        return false;
+    }
+
+    int nReverted = 0;
+    while (!dequeBlockUndo.empty() && dequeBlockUndo.back().nBlock >= nHeight) {
+        if (!RevertBlock(dequeBlockUndo.back())) {
+            PrintToLog("%s(): failed to revert block %d\n", __func__, dequeBlockUndo.back().nBlock);
+            dequeBlockUndo.clear();
+            return false;
+        }
+        dequeBlockUndo.pop_back();
+        ++nReverted;
+    }
+
+    pDbSpInfo->setWatermark(hashFork);
+
+    PrintToLog("%s(): reverted %d blocks, state is now at block %d\n", __func__, nReverted, nHeight - 1);
+
+    return true;
+}
+}
@@ -0,0 +1,43 @@
+#ifndef BITCOIN_OMNICORE_UNDO_H
+#define BITCOIN_OMNICORE_UNDO_H
+
+#include <omnicore/tally.h>
+
+#include <stdint.h>
+#include <string>
+
+class CBlockIndex;
+class CMPMetaDEx;
+class uint256;
+
+namespace mastercore
+{
+/** Starts to record the state changes of a block, which allows to revert it. */
+void BeginBlockUndo(const CBlockIndex* pBlockIndex);
+/** Stops to record state changes, after a block has been processed. */
+void EndBlockUndo();
+/** Removes all recorded state changes. */
+void ClearUndoLog();
+
+/** Records an update of the tally map. */
+void RecordTallyUndo(const std::string& address, uint32_t propertyId, int64_t amount, TallyType ttype);
+/** Records that a MetaDEx order was added to, or removed from the orderbook, and updates the MetaDEx commitment. */
+void RecordMetaDExUndo(const CMPMetaDEx& order, bool fAdded);
+/** Records the state of a sell offer, before it is modified, and marks it as changed for its commitment. */
+void RecordOfferUndo(const std::string& key);
+/** Records the state of an accept order, before it is modified, and marks it as changed for its commitment. */
+void RecordAcceptUndo(const std::string& key);
+/** Records the state of a crowdsale, before it is modified, and marks it as changed for its commitment. */
+void RecordCrowdUndo(const std::string& address);
+/** Records the freeze state, before it is modified. */
+void RecordFreezeUndo();
+/** Records the active alerts, before they are modified. */
+void RecordAlertUndo();
+/** Records the feature activations and consensus parameters, before they are modified. */
+void RecordActivationUndo();
+
+/** Reverts all recorded blocks at or above the given height. Returns false, if the blocks can't be reverted. */
+bool RevertBlocks(int nHeight, const uint256& hashFork);
+}
+
+#endif // BITCOIN_OMNICORE_UNDO_H
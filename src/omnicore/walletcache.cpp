@@ -3,6 +3,11 @@
  *
  * Provides a cache of wallet balances and functionality for determining whether
  * Omni state changes affected anything in the wallet.
+ *
+ * Only addresses with changed tallies are evaluated. Whether an address belongs
+ * to the wallet is cached as well. The cached results of single addresses are
+ * discarded, when keys, scripts or address book entries of them change, and all
+ * cached results are discarded, when wallets are loaded or unloaded.
  */
 
 #include <omnicore/walletcache.h>
@@ -16,13 +21,18 @@
 #include <sync.h>
 #include <uint256.h>
 #ifdef ENABLE_WALLET
+#include <key_io.h>
+#include <script/standard.h>
 #include <wallet/wallet.h>
 #endif
 
+#include <boost/signals2/connection.hpp>
+
 #include <stdint.h>
 #include <algorithm>
 #include <list>
 #include <map>
+#include <memory>
 #include <set>
 #include <string>
 #include <utility>
@@ -33,64 +43,228 @@ namespace mastercore
 //! Map of wallet balances
 static std::map<std::string, CMPTally> walletBalancesCache;
 
+//! Map of addresses to the result of IsMyAddressAllWallets(), including addresses not in the wallet
+static std::map<std::string, int> walletOwnershipCache;
+
+#ifdef ENABLE_WALLET
+//! Guards the pending wallet changes, which are signalled while cs_wallet is held
+static CCriticalSection cs_walletChanges;
+
+//! Addresses, whose keys, scripts or address book entries changed since the last update
+static std::set<std::string> setChangedAddresses GUARDED_BY(cs_walletChanges);
+
+//! Whether wallets were loaded or unloaded since the last update
+static bool fWalletsChanged GUARDED_BY(cs_walletChanges) = false;
+
+//! Signal connections of the loaded wallets
+static std::map<CWallet*, std::vector<boost::signals2::connection> > walletConnections;
+
+/** Records a wallet change, which invalidates the whole ownership cache with the next update. */
+static void NotifyWalletOwnershipChanged()
+{
+    LOCK(cs_walletChanges);
+    fWalletsChanged = true;
+}
+
+/** Records changed destinations, whose cached ownership is discarded with the next update. */
+static void NotifyDestinationsChanged(const std::vector<CTxDestination>& destinations)
+{
+    LOCK(cs_walletChanges);
+    for (const CTxDestination& dest : destinations) {
+        setChangedAddresses.insert(EncodeDestination(dest));
+    }
+}
+#endif
+
+/**
+ * Takes the wallet changes since the last update.
+ *
+ * @param changedAddresses[out]  The addresses, whose ownership may have changed
+ * @return True, if the ownership of any address may have changed
+ */
+static bool TakeWalletChanges(std::set<std::string>& changedAddresses)
+{
+#ifdef ENABLE_WALLET
+    LOCK(cs_walletChanges);
+    changedAddresses.swap(setChangedAddresses);
+    setChangedAddresses.clear();
+    bool fChanged = fWalletsChanged;
+    fWalletsChanged = false;
+    return fChanged;
+#else
+    return false;
+#endif
+}
+
+/**
+ * Connects to the signals of newly loaded wallets, and disconnects from unloaded ones.
+ *
+ * Keys and scripts may be added by importing, or by topping up the keypool. Both are
+ * signalled with the destinations they cover, also when no address book entry is added,
+ * so addresses, which were cached as not being in the wallet, are evaluated again.
+ */
+static void UpdateWalletConnections()
+{
+#ifdef ENABLE_WALLET
+    std::set<CWallet*> loadedWallets;
+
+    for (const std::shared_ptr<CWallet>& wallet : GetWallets()) {
+        CWallet* pwallet = wallet.get();
+        loadedWallets.insert(pwallet);
+        if (walletConnections.count(pwallet)) continue;
+
+        std::vector<boost::signals2::connection>& connections = walletConnections[pwallet];
+        connections.push_back(pwallet->NotifyAddressBookChanged.connect(
+                [](CWallet*, const CTxDestination& dest, const std::string&, bool, const std::string&, ChangeType) { NotifyDestinationsChanged({dest}); }));
+        connections.push_back(pwallet->NotifyKeysChanged.connect(&NotifyDestinationsChanged));
+        connections.push_back(pwallet->NotifyUnload.connect(&NotifyWalletOwnershipChanged));
+        NotifyWalletOwnershipChanged();
+        if (msc_debug_walletcache) PrintToLog("WALLETCACHE: Watching wallet %s\n", pwallet->GetName());
+    }
+
+    std::map<CWallet*, std::vector<boost::signals2::connection> >::iterator it = walletConnections.begin();
+    while (it != walletConnections.end()) {
+        if (loadedWallets.count(it->first)) {
+            ++it;
+            continue;
+        }
+        for (boost::signals2::connection& connection : it->second) {
+            connection.disconnect();
+        }
+        it = walletConnections.erase(it);
+        NotifyWalletOwnershipChanged();
+    }
+#endif
+}
+
+/** Returns whether an address is in the wallet (including watch only), using the ownership cache. */
+static int IsMyAddressCached(const std::string& address)
+{
+    std::map<std::string, int>::const_iterator it = walletOwnershipCache.find(address);
+    if (it != walletOwnershipCache.end()) {
+        return it->second;
+    }
+    int addressIsMine = IsMyAddressAllWallets(address, true);
+    walletOwnershipCache.insert(std::make_pair(address, addressIsMine));
+
+    return addressIsMine;
+}
+
+/** Compares the tally of a wallet address with the cache and updates the cache, returning true if there were changes. */
+static bool UpdateCachedBalances(const std::string& address, CMPTally& tally)
+{
+    // check cache for miss on address
+    std::map<std::string, CMPTally>::iterator search_it = walletBalancesCache.find(address);
+    if (search_it == walletBalancesCache.end()) { // cache miss, new address
+        walletBalancesCache.insert(std::make_pair(address, tally));
+        if (msc_debug_walletcache) PrintToLog("WALLETCACHE: *CACHE MISS* - %s not in cache\n", address);
+        return true;
+    }
+
+    // check cache for miss on balance
+    CMPTally& cacheTally = search_it->second;
+    tally.init();
+    uint32_t propertyId;
+    while (0 != (propertyId = (tally.next()))) {
+        if (tally.getMoney(propertyId, BALANCE) != cacheTally.getMoney(propertyId, BALANCE) ||
+                tally.getMoney(propertyId, PENDING) != cacheTally.getMoney(propertyId, PENDING) ||
+                tally.getMoney(propertyId, SELLOFFER_RESERVE) != cacheTally.getMoney(propertyId, SELLOFFER_RESERVE) ||
+                tally.getMoney(propertyId, ACCEPT_RESERVE) != cacheTally.getMoney(propertyId, ACCEPT_RESERVE) ||
+                tally.getMoney(propertyId, METADEX_RESERVE) != cacheTally.getMoney(propertyId, METADEX_RESERVE)) { // cache miss, balance
+            cacheTally = tally;
+            if (msc_debug_walletcache) PrintToLog("WALLETCACHE: *CACHE MISS* - %s balance for property %d differs\n", address, propertyId);
+            return true;
+        }
+    }
+
+    return false;
+}
+
 /**
  * Updates the cache with the latest state, returning true if changes were made to wallet addresses (including watch only).
  *
- * Also prepares a list of addresses that were changed (for future usage).
+ * Only addresses with changed tallies or changed wallet ownership since the last update
+ * are evaluated, unless the tally map was rebuilt or wallets were loaded or unloaded, in
+ * which case all addresses are evaluated.
  */
 int WalletCacheUpdate()
 {
     if (msc_debug_walletcache) PrintToLog("WALLETCACHE: Update requested\n");
     int numChanges = 0;
-    std::set<std::string> changedAddresses;
 
     LOCK(cs_tally);
 
-    for (std::unordered_map<std::string, CMPTally>::iterator my_it = mp_tally_map.begin(); my_it != mp_tally_map.end(); ++my_it) {
-        const std::string& address = my_it->first;
+    UpdateWalletConnections();
 
-        // determine if this address is in the wallet
-        int addressIsMine = IsMyAddressAllWallets(address, true);
-        if (!addressIsMine) {
-            if (msc_debug_walletcache) PrintToLog("WALLETCACHE: Ignoring non-wallet address %s\n", address);
-            continue; // ignore this address, not in wallet
-        }
+    std::vector<uint32_t> vChangedIds;
+    bool fPartial = mp_tally_map.takeChanged(vChangedIds);
 
-        // obtain & init the tally
-        CMPTally& tally = my_it->second;
-        tally.init();
-
-        // check cache for miss on address
-        std::map<std::string, CMPTally>::iterator search_it = walletBalancesCache.find(address);
-        if (search_it == walletBalancesCache.end()) { // cache miss, new address
-            ++numChanges;
-            changedAddresses.insert(address);
-            walletBalancesCache.insert(std::make_pair(address,tally));
-            if (msc_debug_walletcache) PrintToLog("WALLETCACHE: *CACHE MISS* - %s not in cache\n", address);
-            continue;
+    std::set<std::string> changedAddresses;
+    if (TakeWalletChanges(changedAddresses)) {
+        // the ownership of any address may have changed, so the whole state is evaluated again
+        if (msc_debug_walletcache) PrintToLog("WALLETCACHE: Wallets changed, discarding %d cached ownership results\n", walletOwnershipCache.size());
+        walletOwnershipCache.clear();
+        fPartial = false;
+    } else {
+        for (std::set<std::string>::const_iterator it = changedAddresses.begin(); it != changedAddresses.end(); ++it) {
+            walletOwnershipCache.erase(*it);
         }
+    }
 
-        // check cache for miss on balance - TODO TRY AND OPTIMIZE THIS
-        CMPTally &cacheTally = search_it->second;
-        uint32_t propertyId;
-        while (0 != (propertyId = (tally.next()))) {
-            if (tally.getMoney(propertyId, BALANCE) != cacheTally.getMoney(propertyId, BALANCE) ||
-                    tally.getMoney(propertyId, PENDING) != cacheTally.getMoney(propertyId, PENDING) ||
-                    tally.getMoney(propertyId, SELLOFFER_RESERVE) != cacheTally.getMoney(propertyId, SELLOFFER_RESERVE) ||
-                    tally.getMoney(propertyId, ACCEPT_RESERVE) != cacheTally.getMoney(propertyId, ACCEPT_RESERVE) ||
-                    tally.getMoney(propertyId, METADEX_RESERVE) != cacheTally.getMoney(propertyId, METADEX_RESERVE)) { // cache miss, balance
+    if (fPartial) {
+        for (std::vector<uint32_t>::const_iterator it = vChangedIds.begin(); it != vChangedIds.end(); ++it) {
+            const std::string& address = mp_tally_map.getAddress(*it);
+            if (!IsMyAddressCached(address)) continue; // ignore this address, not in wallet
+            if (UpdateCachedBalances(address, mp_tally_map.getTally(*it))) ++numChanges;
+        }
+        // addresses with unchanged tallies may have been added to, or removed from the wallet
+        for (std::set<std::string>::const_iterator it = changedAddresses.begin(); it != changedAddresses.end(); ++it) {
+            CMPTally* ptally = getTally(*it);
+            if (ptally != nullptr && IsMyAddressCached(*it)) {
+                if (UpdateCachedBalances(*it, *ptally)) ++numChanges;
+            } else if (walletBalancesCache.erase(*it)) {
                 ++numChanges;
-                changedAddresses.insert(address);
-                walletBalancesCache.erase(search_it);
-                walletBalancesCache.insert(std::make_pair(address,tally));
-                if (msc_debug_walletcache) PrintToLog("WALLETCACHE: *CACHE MISS* - %s balance for property %d differs\n", address, propertyId);
-                break;
             }
         }
+        if (msc_debug_walletcache) PrintToLog("WALLETCACHE: Update finished - %d changed addresses, %d changed wallet addresses, there were %d changes\n", vChangedIds.size(), changedAddresses.size(), numChanges);
+        return numChanges;
+    }
+
+    // evaluate all addresses, and remove cached balances of addresses, which are no longer part of the wallet
+    std::map<std::string, CMPTally> previousBalances;
+    previousBalances.swap(walletBalancesCache);
+
+    for (CMPTallyMap::iterator my_it = mp_tally_map.begin(); my_it != mp_tally_map.end(); ++my_it) {
+        const std::string& address = my_it->first;
+        if (!IsMyAddressCached(address)) continue; // ignore this address, not in wallet
+
+        std::map<std::string, CMPTally>::iterator search_it = previousBalances.find(address);
+        if (search_it != previousBalances.end()) {
+            walletBalancesCache.insert(*search_it);
+            previousBalances.erase(search_it);
+        }
+        if (UpdateCachedBalances(address, my_it->second)) ++numChanges;
     }
-    if (msc_debug_walletcache) PrintToLog("WALLETCACHE: Update finished - there were %d changes\n", numChanges);
+    numChanges += previousBalances.size();
+
+    if (msc_debug_walletcache) PrintToLog("WALLETCACHE: Full update finished - there were %d changes\n", numChanges);
     return numChanges;
 }
 
+/**
+ * Returns the addresses with cached wallet balances (including watch only).
+ */
+std::vector<std::string> GetWalletCacheAddresses()
+{
+    LOCK(cs_tally);
+
+    std::vector<std::string> vAddresses;
+    vAddresses.reserve(walletBalancesCache.size());
+    for (std::map<std::string, CMPTally>::const_iterator it = walletBalancesCache.begin(); it != walletBalancesCache.end(); ++it) {
+        vAddresses.push_back(it->first);
+    }
+
+    return vAddresses;
+}
 
 } // namespace mastercore
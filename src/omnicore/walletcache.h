@@ -3,12 +3,16 @@
 
 class uint256;
 
+#include <string>
 #include <vector>
 
 namespace mastercore
 {
 /** Updates the cache and returns whether any wallet addresses were changed */
 int WalletCacheUpdate();
+
+/** Returns the addresses with cached wallet balances (including watch only) */
+std::vector<std::string> GetWalletCacheAddresses();
 }
 
 #endif // BITCOIN_OMNICORE_WALLETCACHE_H
@@ -3,6 +3,11 @@
  *
  * The fetch functions provide a sorted list of transaction hashes ordered by block,
  * position in block and position in wallet including STO receipts.
+ *
+ * The Omni transactions and STO receipts of each wallet are kept in an index, which
+ * is ordered by block and position in block. The index is built once per wallet, and
+ * afterwards only the transactions and addresses signalled by the wallet, and the STO
+ * receipts of blocks connected since the last fetch, are evaluated.
  */
 
 #include <omnicore/walletfetchtxs.h>
@@ -12,10 +17,12 @@
 #include <omnicore/log.h>
 #include <omnicore/omnicore.h>
 #include <omnicore/pending.h>
-#include <omnicore/utilsbitcoin.h>
+#include <omnicore/walletutils.h>
 
+#include <chain.h>
 #include <init.h>
 #include <interfaces/wallet.h>
+#include <key_io.h>
 #include <validation.h>
 #include <sync.h>
 #include <tinyformat.h>
@@ -24,10 +31,11 @@
 #include <wallet/wallet.h>
 #endif
 
-#include <boost/algorithm/string.hpp>
+#include <boost/signals2/connection.hpp>
 
 #include <stdint.h>
-#include <list>
+#include <algorithm>
+#include <limits>
 #include <map>
 #include <set>
 #include <string>
@@ -36,6 +44,70 @@
 
 namespace mastercore
 {
+#ifdef ENABLE_WALLET
+namespace {
+//! Block and position in block of a transaction
+typedef std::pair<int, uint32_t> TxPosition;
+
+/** The Omni transactions and STO receipts of a wallet, ordered by block and position in block. */
+struct CWalletTxIndex
+{
+    //! Indexed transactions
+    std::map<TxPosition, uint256> entries;
+    //! Positions of the indexed transactions
+    std::map<uint256, TxPosition> positions;
+    //! Last block, of which the STO receipts were indexed
+    int nBlockScanned;
+    //! Signal connections of the wallet
+    std::vector<boost::signals2::connection> connections;
+
+    CWalletTxIndex() : nBlockScanned(-1) {}
+
+    /** Removes a transaction from the index. */
+    void Remove(const uint256& txid)
+    {
+        std::map<uint256, TxPosition>::iterator it = positions.find(txid);
+        if (it != positions.end()) {
+            entries.erase(it->second);
+            positions.erase(it);
+        }
+    }
+
+    /** Adds a transaction to the index, or moves it to a new position. */
+    void Add(const uint256& txid, int nBlock, uint32_t nPosition)
+    {
+        Remove(txid);
+        entries[TxPosition(nBlock, nPosition)] = txid;
+        positions[txid] = TxPosition(nBlock, nPosition);
+    }
+};
+
+/** Changes of a wallet, which were signalled since the last update of its index. */
+struct CWalletChanges
+{
+    //! Transactions, which were added, updated or removed
+    std::set<uint256> txids;
+    //! Addresses, which were added to the wallet
+    std::set<std::string> addresses;
+    //! Whether the whole index needs to be built again
+    bool fRebuild;
+    //! Whether the wallet is about to be unloaded
+    bool fUnloaded;
+
+    CWalletChanges() : fRebuild(false), fUnloaded(false) {}
+};
+} // anonymous namespace
+
+//! Guards the signalled wallet changes, which are collected while the wallets are locked
+static CCriticalSection cs_walletchanges;
+
+//! Changes of the indexed wallets since their last update
+static std::map<CWallet*, CWalletChanges> walletChanges;
+
+//! Indexes of the Omni transactions of the wallets, guarded by cs_tally
+static std::map<CWallet*, CWalletTxIndex> walletTxIndexes;
+#endif
+
 /**
  * Gets the byte offset of a transaction from the transaction index.
  */
@@ -50,10 +122,194 @@ static unsigned int GetTransactionByteOffset(const uint256& txid)
     return 0;
 }
 
+#ifdef ENABLE_WALLET
+/**
+ * Returns the height of a block, or -1, if the block is not part of the active chain.
+ */
+static int GetActiveHeight(const uint256& hashBlock)
+{
+    AssertLockHeld(cs_main);
+
+    if (hashBlock.IsNull()) return -1;
+    BlockMap::const_iterator it = mapBlockIndex.find(hashBlock);
+    if (it == mapBlockIndex.end() || !chainActive.Contains(it->second)) return -1;
+
+    return it->second->nHeight;
+}
+
+/**
+ * Connects to the signals of a wallet, which is indexed for the first time.
+ *
+ * Keys and watch-only scripts may be added by importing, which are signalled as address
+ * book changes, and may come with earlier STO receipts.
+ */
+static void ConnectWalletSignals(CWallet* pwallet, CWalletTxIndex& index)
+{
+    index.connections.push_back(pwallet->NotifyTransactionChanged.connect(
+            [pwallet](CWallet*, const uint256& txid, ChangeType) {
+                LOCK(cs_walletchanges);
+                walletChanges[pwallet].txids.insert(txid);
+            }));
+    index.connections.push_back(pwallet->NotifyAddressBookChanged.connect(
+            [pwallet](CWallet*, const CTxDestination& dest, const std::string&, bool, const std::string&, ChangeType status) {
+                if (status == CT_DELETED) return;
+                LOCK(cs_walletchanges);
+                walletChanges[pwallet].addresses.insert(EncodeDestination(dest));
+            }));
+    index.connections.push_back(pwallet->NotifyWatchonlyChanged.connect(
+            [pwallet](bool) {
+                LOCK(cs_walletchanges);
+                walletChanges[pwallet].fRebuild = true;
+            }));
+    index.connections.push_back(pwallet->NotifyUnload.connect(
+            [pwallet]() {
+                LOCK(cs_walletchanges);
+                walletChanges[pwallet].fUnloaded = true;
+            }));
+}
+
+/**
+ * Removes the indexes of unloaded wallets.
+ */
+static void PruneWalletTxIndexes()
+{
+    AssertLockHeld(cs_tally);
+
+    std::set<CWallet*> loadedWallets;
+    for (const std::shared_ptr<CWallet>& wallet : GetWallets()) {
+        loadedWallets.insert(wallet.get());
+    }
+
+    std::map<CWallet*, CWalletTxIndex>::iterator it = walletTxIndexes.begin();
+    while (it != walletTxIndexes.end()) {
+        bool fUnloaded = !loadedWallets.count(it->first);
+        {
+            LOCK(cs_walletchanges);
+            fUnloaded |= walletChanges[it->first].fUnloaded;
+            if (fUnloaded) walletChanges.erase(it->first);
+        }
+        if (!fUnloaded) {
+            ++it;
+            continue;
+        }
+        for (boost::signals2::connection& connection : it->second.connections) {
+            connection.disconnect();
+        }
+        it = walletTxIndexes.erase(it);
+    }
+}
+
+/**
+ * Updates the index of a wallet with the signalled changes, and the STO receipts of
+ * blocks connected since the last update.
+ *
+ * The index is built from all wallet transactions and STO receipts, when the wallet
+ * is indexed for the first time, or when watch-only scripts changed.
+ */
+static CWalletTxIndex& UpdateWalletTxIndex(CWallet* pwallet, interfaces::Wallet& iWallet)
+{
+    // no blocks are connected while the index is updated, so the Omni state corresponds to the active chain
+    AssertLockHeld(cs_main);
+
+    CWalletChanges changes;
+    {
+        LOCK(cs_tally);
+        PruneWalletTxIndexes();
+        if (!walletTxIndexes.count(pwallet)) {
+            ConnectWalletSignals(pwallet, walletTxIndexes[pwallet]);
+            LOCK(cs_walletchanges);
+            walletChanges[pwallet].fRebuild = true;
+        }
+        LOCK(cs_walletchanges);
+        std::swap(changes, walletChanges[pwallet]);
+    }
+
+    // heights of the changed wallet transactions, or -1, if not confirmed in the active chain or removed
+    std::vector<std::pair<uint256, int> > vWalletTxs;
+    {
+        LOCK(pwallet->cs_wallet);
+        if (changes.fRebuild) {
+            vWalletTxs.reserve(pwallet->mapWallet.size());
+            for (const std::pair<const uint256, CWalletTx>& entry : pwallet->mapWallet) {
+                vWalletTxs.push_back(std::make_pair(entry.first, GetActiveHeight(entry.second.hashBlock)));
+            }
+        } else {
+            for (const uint256& txid : changes.txids) {
+                const CWalletTx* pwtx = pwallet->GetWalletTx(txid);
+                vWalletTxs.push_back(std::make_pair(txid, pwtx ? GetActiveHeight(pwtx->hashBlock) : -1));
+            }
+        }
+    }
+
+    LOCK(cs_tally);
+    CWalletTxIndex& index = walletTxIndexes[pwallet];
+    const int nHeight = chainActive.Height();
+
+    if (changes.fRebuild) {
+        index.entries.clear();
+        index.positions.clear();
+    }
+
+    for (const std::pair<uint256, int>& walletTx : vWalletTxs) {
+        if (walletTx.second < 0 || !pDbTransactionList->exists(walletTx.first)) {
+            index.Remove(walletTx.first);
+            continue;
+        }
+        index.Add(walletTx.first, walletTx.second, GetTransactionByteOffset(walletTx.first));
+    }
+
+    // insert STO receipts - receiving an STO has no inbound transaction to the wallet
+    if (changes.fRebuild) {
+        for (const std::pair<int, uint256>& receipt : pDbStoList->GetWalletReceipts(iWallet)) {
+            index.Add(receipt.second, receipt.first, GetTransactionByteOffset(receipt.second));
+        }
+        index.nBlockScanned = nHeight;
+    }
+
+    // earlier receipts of added addresses, later ones are found with the new blocks
+    for (const std::string& address : changes.addresses) {
+        if (!IsMyAddress(address, &iWallet)) continue;
+        for (const std::pair<int, uint256>& receipt : pDbStoList->GetWalletReceipts(iWallet, address)) {
+            if (receipt.first > index.nBlockScanned) break;
+            if (index.positions.count(receipt.second)) continue;
+            index.Add(receipt.second, receipt.first, GetTransactionByteOffset(receipt.second));
+        }
+    }
+
+    if (index.nBlockScanned < nHeight) {
+        std::set<uint256> setTxids;
+        pDbTransactionList->GetOmniTxsInBlockRange(index.nBlockScanned + 1, nHeight, setTxids);
+        for (const uint256& txid : setTxids) {
+            bool fValid = false;
+            int nBlock = 0;
+            unsigned int nType = 0;
+            uint64_t nValue = 0;
+            if (!pDbTransactionList->getTX(txid, fValid, nBlock, nType, nValue)) continue;
+            if (nType != MSC_TYPE_SEND_TO_OWNERS || index.positions.count(txid)) continue;
+            for (const std::string& address : pDbStoList->GetRecipientAddresses(txid)) {
+                if (IsMyAddress(address, &iWallet)) {
+                    index.Add(txid, nBlock, GetTransactionByteOffset(txid));
+                    break;
+                }
+            }
+        }
+        index.nBlockScanned = nHeight;
+    }
+
+    if (msc_debug_walletcache) {
+        PrintToLog("WALLETINDEX: %s updated with %d transactions and %d addresses%s, %d entries\n", pwallet->GetName(),
+                vWalletTxs.size(), changes.addresses.size(), changes.fRebuild ? " (rebuilt)" : "", index.entries.size());
+    }
+
+    return index;
+}
+#endif
+
 /**
  * Returns an ordered list of Omni transactions including STO receipts that are relevant to the wallet.
  *
  * Ignores order in the wallet (which can be skewed by watch addresses) and utilizes block height and position within block.
+ * Only the most recent count transactions within the block range are returned, besides pending transactions.
  */
 std::map<std::string, uint256> FetchWalletOmniTransactions(interfaces::Wallet& iWallet, unsigned int count, int startBlock, int endBlock)
 {
@@ -62,57 +318,26 @@ std::map<std::string, uint256> FetchWalletOmniTransactions(interfaces::Wallet& i
     if (!HasWallets()) {
         return mapResponse;
     }
-    std::set<uint256> seenHashes;
-    std::multimap<int64_t, const interfaces::WalletTx*> txOrdered;
-    const std::vector<interfaces::WalletTx>& transactions = iWallet.getWalletTxs();
-    for (const auto& transaction : transactions)
-        txOrdered.insert(std::make_pair(transaction.order_pos, &transaction));
-
-    // Iterate backwards through wallet transactions until we have count items to return:
-    for (std::multimap<int64_t, const interfaces::WalletTx*>::reverse_iterator it = txOrdered.rbegin(); it != txOrdered.rend(); ++it) {
-        const interfaces::WalletTx* pwtx = it->second;
-        const uint256& txHash = pwtx->tx->GetHash();
-        {
-            LOCK(cs_tally);
-            if (!pDbTransactionList->exists(txHash)) continue;
-        }
-        const uint256& blockHash = pwtx->hash_block;
-        if (blockHash.IsNull()) continue;
-        const CBlockIndex* pBlockIndex = GetBlockIndex(blockHash);
-        if (pBlockIndex == nullptr) continue;
-        int blockHeight = pBlockIndex->nHeight;
-        if (blockHeight < startBlock || blockHeight > endBlock) continue;
-        int blockPosition = GetTransactionByteOffset(txHash);
-        std::string sortKey = strprintf("%06d%010d", blockHeight, blockPosition);
-        mapResponse.insert(std::make_pair(sortKey, txHash));
-        seenHashes.insert(txHash);
-        if (mapResponse.size() >= count) break;
+    std::shared_ptr<CWallet> wallet = GetWallet(iWallet.getWalletName());
+    if (!wallet) {
+        return mapResponse;
     }
+    CWallet* pwallet = wallet.get();
 
-    // Insert STO receipts - receiving an STO has no inbound transaction to the wallet, so we will insert these manually into the response
-    std::string mySTOReceipts;
     {
+        LOCK(cs_main);
+        const CWalletTxIndex& index = UpdateWalletTxIndex(pwallet, iWallet);
+
+        // iterate backwards from the end of the block range until we have count items to return
         LOCK(cs_tally);
-        mySTOReceipts = pDbStoList->getMySTOReceipts("", iWallet);
-    }
-    std::vector<std::string> vecReceipts;
-    if (!mySTOReceipts.empty()) {
-        boost::split(vecReceipts, mySTOReceipts, boost::is_any_of(","), boost::token_compress_on);
-    }
-    for (size_t i = 0; i < vecReceipts.size(); i++) {
-        std::vector<std::string> svstr;
-        boost::split(svstr, vecReceipts[i], boost::is_any_of(":"), boost::token_compress_on);
-        if (svstr.size() != 4) {
-            PrintToLog("STODB Error - number of tokens is not as expected (%s)\n", vecReceipts[i]);
-            continue;
+        std::map<TxPosition, uint256>::const_iterator it = index.entries.upper_bound(TxPosition(endBlock, std::numeric_limits<uint32_t>::max()));
+        while (it != index.entries.begin() && mapResponse.size() < count) {
+            --it;
+            const TxPosition& position = it->first;
+            if (position.first < startBlock) break;
+            std::string sortKey = strprintf("%06d%010d", position.first, position.second);
+            mapResponse.insert(std::make_pair(sortKey, it->second));
         }
-        int blockHeight = atoi(svstr[1]);
-        if (blockHeight < startBlock || blockHeight > endBlock) continue;
-        uint256 txHash = uint256S(svstr[0]);
-        if (seenHashes.find(txHash) != seenHashes.end()) continue; // an STO may already be in the wallet if we sent it
-        int blockPosition = GetTransactionByteOffset(txHash);
-        std::string sortKey = strprintf("%06d%010d", blockHeight, blockPosition);
-        mapResponse.insert(std::make_pair(sortKey, txHash));
     }
 
     // Insert pending transactions (sets block as 999999 and position as wallet position)
@@ -124,9 +349,9 @@ std::map<std::string, uint256> FetchWalletOmniTransactions(interfaces::Wallet& i
         if (blockHeight < startBlock || blockHeight > endBlock) continue;
         int blockPosition = 0;
         {
-            for (const auto& transaction : transactions)
-                if (transaction.tx->GetHash() == txHash)
-                    blockPosition = transaction.order_pos;
+            LOCK(pwallet->cs_wallet);
+            const CWalletTx* pwtx = pwallet->GetWalletTx(txHash);
+            if (pwtx != nullptr) blockPosition = pwtx->nOrderPos;
         }
         std::string sortKey = strprintf("%06d%010d", blockHeight, blockPosition);
         mapResponse.insert(std::make_pair(sortKey, txHash));
@@ -135,5 +360,31 @@ std::map<std::string, uint256> FetchWalletOmniTransactions(interfaces::Wallet& i
     return mapResponse;
 }
 
+/**
+ * Removes the indexed wallet transactions and STO receipts in or above the given
+ * block, which is parsed again. The wallet transactions are evaluated again with
+ * the next update.
+ */
+void RewindWalletTxIndexes(int nHeight)
+{
+#ifdef ENABLE_WALLET
+    LOCK(cs_tally);
+
+    for (std::pair<CWallet* const, CWalletTxIndex>& entry : walletTxIndexes) {
+        CWalletTxIndex& index = entry.second;
+        std::set<uint256> setTxids;
+        std::map<TxPosition, uint256>::iterator it = index.entries.lower_bound(TxPosition(nHeight, 0));
+        while (it != index.entries.end()) {
+            setTxids.insert(it->second);
+            index.positions.erase(it->second);
+            it = index.entries.erase(it);
+        }
+        index.nBlockScanned = std::min(index.nBlockScanned, nHeight - 1);
+
+        LOCK(cs_walletchanges);
+        walletChanges[entry.first].txids.insert(setTxids.begin(), setTxids.end());
+    }
+#endif
+}
 
 } // namespace mastercore
@@ -15,6 +15,9 @@ namespace mastercore
 {
 /** Returns an ordered list of Omni transactions that are relevant to the wallet. */
 std::map<std::string, uint256> FetchWalletOmniTransactions(interfaces::Wallet& iWallet, unsigned int count, int startBlock = 0, int endBlock = 999999);
+
+/** Removes indexed wallet transactions in or above the given block, which is parsed again. */
+void RewindWalletTxIndexes(int nHeight);
 }
 
 #endif // BITCOIN_OMNICORE_WALLETFETCHTXS_H
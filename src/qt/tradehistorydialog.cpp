@@ -38,8 +38,6 @@
 #include <uint256.h>
 #include <wallet/wallet.h>
 
-#include <boost/algorithm/string.hpp>
-
 #include <stdint.h>
 #include <map>
 #include <sstream>
@@ -319,16 +317,15 @@ int TradeHistoryDialog::PopulateTradeHistoryMap()
         uint256 hash = it->second;
 
         // use levelDB to perform a fast check on whether it's a bitcoin or Omni tx and whether it's a trade
-        std::string tempStrValue;
+        bool fValid = false;
+        int txBlock = 0;
+        unsigned int txType = 0;
+        uint64_t txValue = 0;
         {
             LOCK(cs_tally);
-            if (!pDbTransactionList->getTX(hash, tempStrValue)) continue;
-        }
-        std::vector<std::string> vstr;
-        boost::split(vstr, tempStrValue, boost::is_any_of(":"), boost::token_compress_on);
-        if (vstr.size() > 2) {
-            if (atoi(vstr[2]) != MSC_TYPE_METADEX_TRADE) continue;
+            if (!pDbTransactionList->getTX(hash, fValid, txBlock, txType, txValue)) continue;
         }
+        if (txType != MSC_TYPE_METADEX_TRADE) continue;
 
         // check historyMap, if this tx exists don't waste resources doing anymore work on it
         TradeHistoryMap::iterator hIter = tradeHistoryMap.find(hash);
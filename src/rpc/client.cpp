@@ -178,6 +178,8 @@ static const CRPCConvertParam vRPCConvertParams[] =
 
 
     /* Omni Core - data retrieval calls */
+    { "omni_getsto", 2, "skip" },
+    { "omni_getsto", 3, "count" },
     { "omni_gettradehistoryforaddress", 1 , "count"},
     { "omni_gettradehistoryforaddress", 2, "propertyid" },
     { "omni_gettradehistoryforpair", 0, "propertyid" },
@@ -188,6 +190,8 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "omni_getcrowdsale", 1, "verbose" },
     { "omni_getgrants", 0, "propertyid" },
     { "omni_getbalance", 1, "propertyid" },
+    { "omni_getbalances", 0, "addresses" },
+    { "omni_getbalances", 1, "propertyids" },
     { "omni_getproperty", 0, "propertyid" },
     { "omni_listtransactions", 1, "count" },
     { "omni_listtransactions", 2, "skip" },
@@ -319,6 +323,8 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "sendtoowners_MP", 1, "propertyid" },
     { "sendtoowners_MP", 4, "distributionproperty" },
     { "getproperty_MP", 0, "propertyid" },
+    { "getsto_MP", 2, "skip" },
+    { "getsto_MP", 3, "count" },
     { "listtransactions_MP", 1, "count" },
     { "listtransactions_MP", 2, "skip" },
     { "listtransactions_MP", 3, "startblock" },
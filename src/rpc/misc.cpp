@@ -10,6 +10,7 @@
 #include <key_io.h>
 #include <validation.h>
 #include <httpserver.h>
+#include <index/addressindex.h>
 #include <net.h>
 #include <netbase.h>
 #include <outputtype.h>
@@ -112,6 +113,31 @@ bool getAddressesFromParams(const UniValue& params, std::vector<std::pair<uint25
     return true;
 }
 
+/** Reads the optional "offset" and "limit" of the history RPCs of the address index. */
+static void getPagingFromParams(const UniValue& params, size_t& offset, size_t& limit)
+{
+    offset = 0;
+    limit = 0;
+    if (!params[0].isObject()) {
+        return;
+    }
+
+    UniValue offsetValue = find_value(params[0].get_obj(), "offset");
+    UniValue limitValue = find_value(params[0].get_obj(), "limit");
+    if (offsetValue.isNum()) {
+        if (offsetValue.get_int() < 0) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Offset is expected to be zero or greater");
+        }
+        offset = offsetValue.get_int();
+    }
+    if (limitValue.isNum()) {
+        if (limitValue.get_int() < 0) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Limit is expected to be zero or greater");
+        }
+        limit = limitValue.get_int();
+    }
+}
+
 bool heightSort(std::pair<CAddressUnspentKey, CAddressUnspentValue> a,
                 std::pair<CAddressUnspentKey, CAddressUnspentValue> b) {
     return a.second.blockHeight < b.second.blockHeight;
@@ -158,6 +184,8 @@ UniValue getaddressdeltas(const JSONRPCRequest& request)
                         {"start", RPCArg::Type::NUM, RPCArg::Optional::OMITTED_NAMED_ARG, "The start block height"},
                         {"end", RPCArg::Type::NUM, RPCArg::Optional::OMITTED_NAMED_ARG, "The end block height"},
                         {"chainInfo", RPCArg::Type::BOOL, RPCArg::Optional::OMITTED_NAMED_ARG, "Include chain info in results, only applies if start and end specified"},
+                        {"offset", RPCArg::Type::NUM, /* default */ "0", "The number of deltas to skip"},
+                        {"limit", RPCArg::Type::NUM, /* default */ "0", "The maximum number of deltas to return (0 for all)"},
                     }
                 }
             },
@@ -180,9 +208,12 @@ UniValue getaddressdeltas(const JSONRPCRequest& request)
             },
         }.ToString());
 
-    if (!fAddressIndex) {
+    if (!g_addressindex) {
         throw JSONRPCError(RPC_MISC_ERROR, "Address index not enabled");
     }
+    if (!g_addressindex->BlockUntilSyncedToCurrentChain()) {
+        throw JSONRPCError(RPC_MISC_ERROR, "address index is still syncing");
+    }
 
     UniValue startValue = find_value(request.params[0].get_obj(), "start");
     UniValue endValue = find_value(request.params[0].get_obj(), "end");
@@ -207,42 +238,56 @@ UniValue getaddressdeltas(const JSONRPCRequest& request)
         }
     }
 
+    size_t offset = 0;
+    size_t limit = 0;
+    getPagingFromParams(request.params, offset, limit);
+
     std::vector<std::pair<uint256, int> > addresses;
 
     if (!getAddressesFromParams(request.params, addresses)) {
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
     }
 
-    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+    UniValue deltas(UniValue::VARR);
+    size_t skipped = 0;
 
-    for (std::vector<std::pair<uint256, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (start > 0 && end > 0) {
-            if (!GetAddressIndex((*it).first, (*it).second, addressIndex, start, end)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-            }
-        } else {
-            if (!GetAddressIndex((*it).first, (*it).second, addressIndex)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-            }
+    // the deltas are added while the address index is read, so only the requested page is held
+    auto visitor = [&](const CAddressIndexKey& key, CAmount amount) {
+        if (skipped < offset) {
+            ++skipped;
+            return true;
         }
-    }
 
-    UniValue deltas(UniValue::VARR);
-
-    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=addressIndex.begin(); it!=addressIndex.end(); it++) {
         std::string address;
-        if (!getAddressFromIndex(it->first.type, it->first.hashBytes, address)) {
+        if (!getAddressFromIndex(key.type, key.hashBytes, address)) {
             throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Unknown address type");
         }
 
         UniValue delta(UniValue::VOBJ);
-        delta.pushKV("satoshis", it->second);
-        delta.pushKV("txid", it->first.txhash.GetHex());
-        delta.pushKV("index", (int)it->first.index);
-        delta.pushKV("blockindex", (int)it->first.txindex);
-        delta.pushKV("height", it->first.blockHeight);
+        delta.pushKV("satoshis", amount);
+        delta.pushKV("txid", key.txhash.GetHex());
+        delta.pushKV("index", (int)key.index);
+        delta.pushKV("blockindex", (int)key.txindex);
+        delta.pushKV("height", key.blockHeight);
         delta.pushKV("address", address);
         deltas.push_back(delta);
+
+        return limit == 0 || deltas.size() < limit;
+    };
+
+    for (std::vector<std::pair<uint256, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
+        if (limit > 0 && deltas.size() >= limit) {
+            break;
+        }
+        if (start > 0 && end > 0) {
+            if (!GetAddressIndex((*it).first, (*it).second, visitor, start, end)) {
+                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+            }
+        } else {
+            if (!GetAddressIndex((*it).first, (*it).second, visitor)) {
+                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+            }
+        }
     }
 
     UniValue result(UniValue::VOBJ);
@@ -300,9 +345,12 @@ UniValue getaddressbalance(const JSONRPCRequest& request)
                 },
             }.ToString());
 
-    if (!fAddressIndex) {
+    if (!g_addressindex) {
         throw JSONRPCError(RPC_MISC_ERROR, "Address index not enabled");
     }
+    if (!g_addressindex->BlockUntilSyncedToCurrentChain()) {
+        throw JSONRPCError(RPC_MISC_ERROR, "address index is still syncing");
+    }
 
     std::vector<std::pair<uint256, int> > addresses;
 
@@ -310,25 +358,38 @@ UniValue getaddressbalance(const JSONRPCRequest& request)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
     }
 
-    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
-
-    for (std::vector<std::pair<uint256, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (!GetAddressIndex((*it).first, (*it).second, addressIndex)) {
-            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-        }
+    int nTipHeight = 0;
+    {
+        LOCK(cs_main);
+        nTipHeight = chainActive.Height();
     }
 
     CAmount balance = 0;
     CAmount received = 0;
     CAmount immature = 0;
 
-    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=addressIndex.begin(); it!=addressIndex.end(); it++) {
-        if (it->second > 0) {
-            received += it->second;
+    // only coinbase outputs of the last blocks can be immature
+    auto immatureVisitor = [&immature](const CAddressIndexKey& key, CAmount amount) {
+        if (key.txindex == 0) {
+            immature += amount;
+        }
+        return true;
+    };
+
+    for (std::vector<std::pair<uint256, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
+        CAddressBalanceValue value;
+        if (!GetAddressBalance((*it).first, (*it).second, value)) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+        }
+        balance += value.balance;
+        received += value.received;
+
+        if (nTipHeight > 0 && value.lastHeight > nTipHeight - COINBASE_MATURITY) {
+            int start = std::max(1, nTipHeight - COINBASE_MATURITY + 1);
+            if (!GetAddressIndex((*it).first, (*it).second, immatureVisitor, start, nTipHeight)) {
+                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+            }
         }
-        balance += it->second;
-        if (it->first.txindex == 0 && ((chainActive.Height() - it->first.blockHeight) < COINBASE_MATURITY))
-            immature += it->second;
     }
 
     UniValue result(UniValue::VOBJ);
@@ -377,9 +438,12 @@ UniValue getaddressutxos(const JSONRPCRequest& request)
                 },
             }.ToString());
 
-    if (!fAddressIndex) {
+    if (!g_addressindex) {
         throw JSONRPCError(RPC_MISC_ERROR, "Address index not enabled");
     }
+    if (!g_addressindex->BlockUntilSyncedToCurrentChain()) {
+        throw JSONRPCError(RPC_MISC_ERROR, "address index is still syncing");
+    }
 
     bool includeChainInfo = false;
     if (request.params[0].isObject()) {
@@ -546,9 +610,12 @@ UniValue getblockhashes(const JSONRPCRequest& request)
                 },
             }.ToString());
 
-    if (!fAddressIndex) {
+    if (!g_addressindex) {
         throw JSONRPCError(RPC_MISC_ERROR, "Address index not enabled");
     }
+    if (!g_addressindex->BlockUntilSyncedToCurrentChain()) {
+        throw JSONRPCError(RPC_MISC_ERROR, "address index is still syncing");
+    }
 
     unsigned int high = request.params[0].get_int();
     unsigned int low = request.params[1].get_int();
@@ -617,9 +684,12 @@ UniValue getspentinfo(const JSONRPCRequest& request)
                 },
             }.ToString());
 
-    if (!fAddressIndex) {
+    if (!g_addressindex) {
         throw JSONRPCError(RPC_MISC_ERROR, "Address index not enabled");
     }
+    if (!g_addressindex->BlockUntilSyncedToCurrentChain()) {
+        throw JSONRPCError(RPC_MISC_ERROR, "address index is still syncing");
+    }
 
     UniValue txidValue = find_value(request.params[0].get_obj(), "txid");
     UniValue indexValue = find_value(request.params[0].get_obj(), "index");
@@ -662,6 +732,8 @@ UniValue getaddresstxids(const JSONRPCRequest& request)
                             },
                             {"start", RPCArg::Type::NUM, RPCArg::Optional::OMITTED_NAMED_ARG, "The start block height"},
                             {"end", RPCArg::Type::NUM, RPCArg::Optional::OMITTED_NAMED_ARG, "The end block height"},
+                            {"offset", RPCArg::Type::NUM, /* default */ "0", "The number of txids to skip"},
+                            {"limit", RPCArg::Type::NUM, /* default */ "0", "The maximum number of txids to return (0 for all)"},
                         }
                     }
                 },
@@ -679,9 +751,12 @@ UniValue getaddresstxids(const JSONRPCRequest& request)
                 },
             }.ToString());
 
-    if (!fAddressIndex) {
+    if (!g_addressindex) {
         throw JSONRPCError(RPC_MISC_ERROR, "Address index not enabled");
     }
+    if (!g_addressindex->BlockUntilSyncedToCurrentChain()) {
+        throw JSONRPCError(RPC_MISC_ERROR, "address index is still syncing");
+    }
 
     std::vector<std::pair<uint256, int> > addresses;
 
@@ -699,41 +774,78 @@ UniValue getaddresstxids(const JSONRPCRequest& request)
             end = endValue.get_int();
         }
     }
+    // the range only applies, if both heights are given
+    if (start <= 0 || end <= 0) {
+        start = 0;
+        end = 0;
+    }
 
-    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+    size_t offset = 0;
+    size_t limit = 0;
+    getPagingFromParams(request.params, offset, limit);
 
-    for (std::vector<std::pair<uint256, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (start > 0 && end > 0) {
-            if (!GetAddressIndex((*it).first, (*it).second, addressIndex, start, end)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+    UniValue result(UniValue::VARR);
+
+    if (addresses.size() == 1) {
+        // the entries of a transaction are adjacent in the address index
+        uint256 lastTxHash;
+        size_t skipped = 0;
+
+        auto visitor = [&](const CAddressIndexKey& key, CAmount amount) {
+            if (key.txhash == lastTxHash) {
+                return true;
             }
-        } else {
-            if (!GetAddressIndex((*it).first, (*it).second, addressIndex)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+            lastTxHash = key.txhash;
+            if (skipped < offset) {
+                ++skipped;
+                return true;
             }
+            result.push_back(key.txhash.GetHex());
+            return limit == 0 || result.size() < limit;
+        };
+
+        const std::pair<uint256, int>& address = addresses.front();
+        if (!GetAddressIndex(address.first, address.second, visitor, start, end)) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
         }
+
+        return result;
     }
 
+    // the txids of several addresses are sorted by height, so with a limit only the
+    // first offset + limit txids are kept, and each address is read up to the height
+    // of the last one
     std::set<std::pair<int, std::string> > txids;
-    UniValue result(UniValue::VARR);
+    const size_t maxTxids = limit > 0 ? offset + limit : 0;
 
-    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=addressIndex.begin(); it!=addressIndex.end(); it++) {
-        int height = it->first.blockHeight;
-        std::string txid = it->first.txhash.GetHex();
-
-        if (addresses.size() > 1) {
-            txids.insert(std::make_pair(height, txid));
-        } else {
-            if (txids.insert(std::make_pair(height, txid)).second) {
-                result.push_back(txid);
+    auto visitor = [&](const CAddressIndexKey& key, CAmount amount) {
+        if (maxTxids > 0 && txids.size() >= maxTxids) {
+            if (key.blockHeight > txids.rbegin()->first) {
+                return false;
             }
+            txids.insert(std::make_pair(key.blockHeight, key.txhash.GetHex()));
+            if (txids.size() > maxTxids) {
+                txids.erase(std::prev(txids.end()));
+            }
+            return true;
+        }
+        txids.insert(std::make_pair(key.blockHeight, key.txhash.GetHex()));
+        return true;
+    };
+
+    for (std::vector<std::pair<uint256, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
+        if (!GetAddressIndex((*it).first, (*it).second, visitor, start, end)) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
         }
     }
 
-    if (addresses.size() > 1) {
-        for (std::set<std::pair<int, std::string> >::const_iterator it=txids.begin(); it!=txids.end(); it++) {
-            result.push_back(it->second);
+    size_t skipped = 0;
+    for (std::set<std::pair<int, std::string> >::const_iterator it=txids.begin(); it!=txids.end(); it++) {
+        if (skipped < offset) {
+            ++skipped;
+            continue;
         }
+        result.push_back(it->second);
     }
 
     return result;
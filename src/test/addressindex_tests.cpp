@@ -0,0 +1,170 @@
+#include <chainparams.h>
+#include <consensus/validation.h>
+#include <index/addressindex.h>
+#include <key.h>
+#include <script/standard.h>
+#include <test/test_bitcoin.h>
+#include <util/time.h>
+#include <validation.h>
+
+#include <boost/test/unit_test.hpp>
+
+/** Gets the hash and type, which identify a destination in the index. */
+static void GetAddressKey(const CTxDestination& dest, uint256& address_hash, int& type)
+{
+    const std::vector<unsigned char> bytes = boost::apply_visitor(DataVisitor(), dest);
+    std::vector<unsigned char> address_bytes(32);
+    std::copy(bytes.begin(), bytes.end(), address_bytes.begin());
+    address_hash = uint256(address_bytes);
+    type = dest.which();
+}
+
+/** Allows the address index to catch up with the block index. */
+static void WaitForSync(AddressIndex& addressindex)
+{
+    constexpr int64_t timeout_ms = 10 * 1000;
+    int64_t time_start = GetTimeMillis();
+    while (!addressindex.BlockUntilSyncedToCurrentChain()) {
+        BOOST_REQUIRE(time_start + timeout_ms > GetTimeMillis());
+        MilliSleep(100);
+    }
+}
+
+BOOST_AUTO_TEST_SUITE(addressindex_tests)
+
+BOOST_FIXTURE_TEST_CASE(addressindex_initial_sync, TestChain100Setup)
+{
+    AddressIndex addressindex(1 << 20, true);
+
+    const CTxDestination dest = coinbaseKey.GetPubKey().GetID();
+    uint256 address_hash;
+    int type;
+    GetAddressKey(dest, address_hash, type);
+
+    CAddressBalanceValue balance;
+
+    // The address should not be found in the index before it is started.
+    BOOST_CHECK(!addressindex.ReadAddressBalance(address_hash, type, balance));
+
+    // BlockUntilSyncedToCurrentChain should return false before the index is started.
+    BOOST_CHECK(!addressindex.BlockUntilSyncedToCurrentChain());
+
+    addressindex.Start();
+    WaitForSync(addressindex);
+
+    // Check that the index has all outputs paid to the coinbase key before it started.
+    CAmount received = 0;
+    for (const auto& txn : m_coinbase_txns) {
+        received += txn->vout[0].nValue;
+    }
+    BOOST_REQUIRE(addressindex.ReadAddressBalance(address_hash, type, balance));
+    BOOST_CHECK_EQUAL(balance.balance, received);
+    BOOST_CHECK_EQUAL(balance.received, received);
+    BOOST_CHECK_EQUAL(balance.txCount, m_coinbase_txns.size());
+    BOOST_CHECK_EQUAL(balance.lastHeight, (int) m_coinbase_txns.size());
+
+    std::vector<std::pair<CAddressIndexKey, CAmount>> address_index;
+    BOOST_CHECK(addressindex.ReadAddressIndex(address_hash, type, address_index));
+    BOOST_CHECK_EQUAL(address_index.size(), m_coinbase_txns.size());
+
+    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue>> unspent_outputs;
+    BOOST_CHECK(addressindex.ReadAddressUnspentIndex(address_hash, type, unspent_outputs));
+    BOOST_CHECK_EQUAL(unspent_outputs.size(), m_coinbase_txns.size());
+
+    // Check that the outputs of new blocks make it into the index.
+    for (int i = 0; i < 10; i++) {
+        CScript coinbase_script_pub_key = GetScriptForDestination(dest);
+        std::vector<CMutableTransaction> no_txns;
+        const CBlock& block = CreateAndProcessBlock(no_txns, coinbase_script_pub_key);
+        received += block.vtx[0]->vout[0].nValue;
+
+        BOOST_CHECK(addressindex.BlockUntilSyncedToCurrentChain());
+        BOOST_REQUIRE(addressindex.ReadAddressBalance(address_hash, type, balance));
+        BOOST_CHECK_EQUAL(balance.balance, received);
+        BOOST_CHECK_EQUAL(balance.txCount, m_coinbase_txns.size() + i + 1);
+    }
+
+    // shutdown sequence (c.f. Shutdown() in init.cpp)
+    addressindex.Stop();
+
+    threadGroup.interrupt_all();
+    threadGroup.join_all();
+
+    // Rest of shutdown sequence and destructors happen in ~TestingSetup()
+}
+
+BOOST_FIXTURE_TEST_CASE(addressindex_reorg, TestChain100Setup)
+{
+    AddressIndex addressindex(1 << 20, true);
+    addressindex.Start();
+    WaitForSync(addressindex);
+
+    const CTxDestination dest = coinbaseKey.GetPubKey().GetID();
+    uint256 address_hash;
+    int type;
+    GetAddressKey(dest, address_hash, type);
+
+    CAddressBalanceValue balance_before;
+    BOOST_REQUIRE(addressindex.ReadAddressBalance(address_hash, type, balance_before));
+
+    // Connect a block paying to the coinbase key, which is disconnected afterwards.
+    const CBlock stale_block = CreateAndProcessBlock({}, GetScriptForDestination(dest));
+    const uint256 stale_txid = stale_block.vtx[0]->GetHash();
+    BOOST_CHECK(addressindex.BlockUntilSyncedToCurrentChain());
+
+    CAddressBalanceValue balance;
+    BOOST_REQUIRE(addressindex.ReadAddressBalance(address_hash, type, balance));
+    BOOST_CHECK_EQUAL(balance.balance, balance_before.balance + stale_block.vtx[0]->vout[0].nValue);
+    BOOST_CHECK_EQUAL(balance.txCount, balance_before.txCount + 1);
+    BOOST_CHECK_EQUAL(balance.lastHeight, balance_before.lastHeight + 1);
+
+    CBlockIndex* pindex_stale;
+    {
+        LOCK(cs_main);
+        pindex_stale = LookupBlockIndex(stale_block.GetHash());
+    }
+    CValidationState state;
+    BOOST_REQUIRE(InvalidateBlock(state, Params(), pindex_stale));
+    BOOST_REQUIRE(ActivateBestChain(state, Params()));
+
+    // The index is rewound, when the competing block is connected.
+    CKey other_key;
+    other_key.MakeNewKey(true);
+    const CTxDestination other_dest = other_key.GetPubKey().GetID();
+    const CBlock competing_block = CreateAndProcessBlock({}, GetScriptForDestination(other_dest));
+    BOOST_CHECK(addressindex.BlockUntilSyncedToCurrentChain());
+
+    BOOST_REQUIRE(addressindex.ReadAddressBalance(address_hash, type, balance));
+    BOOST_CHECK_EQUAL(balance.balance, balance_before.balance);
+    BOOST_CHECK_EQUAL(balance.received, balance_before.received);
+    BOOST_CHECK_EQUAL(balance.txCount, balance_before.txCount);
+    BOOST_CHECK_EQUAL(balance.lastHeight, balance_before.lastHeight);
+
+    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue>> unspent_outputs;
+    BOOST_CHECK(addressindex.ReadAddressUnspentIndex(address_hash, type, unspent_outputs));
+    BOOST_CHECK_EQUAL(unspent_outputs.size(), m_coinbase_txns.size());
+    for (const auto& output : unspent_outputs) {
+        BOOST_CHECK(output.first.txhash != stale_txid);
+    }
+
+    uint256 other_hash;
+    int other_type;
+    GetAddressKey(other_dest, other_hash, other_type);
+    BOOST_REQUIRE(addressindex.ReadAddressBalance(other_hash, other_type, balance));
+    BOOST_CHECK_EQUAL(balance.balance, competing_block.vtx[0]->vout[0].nValue);
+    BOOST_CHECK_EQUAL(balance.txCount, 1U);
+    BOOST_CHECK_EQUAL(balance.lastHeight, balance_before.lastHeight + 1);
+
+    unspent_outputs.clear();
+    BOOST_CHECK(addressindex.ReadAddressUnspentIndex(other_hash, other_type, unspent_outputs));
+    BOOST_REQUIRE_EQUAL(unspent_outputs.size(), 1U);
+    BOOST_CHECK(unspent_outputs[0].first.txhash == competing_block.vtx[0]->GetHash());
+
+    // shutdown sequence (c.f. Shutdown() in init.cpp)
+    addressindex.Stop();
+
+    threadGroup.interrupt_all();
+    threadGroup.join_all();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
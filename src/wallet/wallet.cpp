@@ -311,6 +311,7 @@ bool CWallet::AddKeyPubKeyWithDB(WalletBatch &batch, const CKey& secret, const C
     if (HaveWatchOnly(script)) {
         RemoveWatchOnly(script);
     }
+    NotifyKeysChanged(GetAllDestinationsForKey(pubkey));
 
     if (!IsCrypted()) {
         return batch.WriteKey(pubkey,
@@ -432,6 +433,9 @@ bool CWallet::AddCScript(const CScript& redeemScript)
 {
     if (!CCryptoKeyStore::AddCScript(redeemScript))
         return false;
+    WitnessV0ScriptHash witnessScriptHash;
+    CSHA256().Write(redeemScript.data(), redeemScript.size()).Finalize(witnessScriptHash.begin());
+    NotifyKeysChanged({CScriptID(redeemScript), witnessScriptHash});
     if (WalletBatch(*database).WriteCScript(Hash160(redeemScript), redeemScript)) {
         UnsetWalletFlag(WALLET_FLAG_BLANK_WALLET);
         return true;
@@ -461,6 +465,10 @@ bool CWallet::AddWatchOnly(const CScript& dest)
     const CKeyMetadata& meta = m_script_metadata[CScriptID(dest)];
     UpdateTimeFirstKey(meta.nCreateTime);
     NotifyWatchonlyChanged(true);
+    CTxDestination address;
+    if (ExtractDestination(dest, address)) {
+        NotifyKeysChanged({address});
+    }
     if (WalletBatch(*database).WriteWatchOnly(dest, meta)) {
         UnsetWalletFlag(WALLET_FLAG_BLANK_WALLET);
         return true;
@@ -481,6 +489,10 @@ bool CWallet::RemoveWatchOnly(const CScript &dest)
         return false;
     if (!HaveWatchOnly())
         NotifyWatchonlyChanged(false);
+    CTxDestination address;
+    if (ExtractDestination(dest, address)) {
+        NotifyKeysChanged({address});
+    }
     if (!WalletBatch(*database).EraseWatchOnly(dest))
         return false;
 
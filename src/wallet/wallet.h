@@ -1120,6 +1120,12 @@ public:
     /** Keypool has new keys */
     boost::signals2::signal<void ()> NotifyCanGetAddressesChanged;
 
+    /**
+     * Key, redeem script or watch-only script added or removed, with the destinations it covers.
+     * @note called with lock cs_wallet held.
+     */
+    boost::signals2::signal<void (const std::vector<CTxDestination>& destinations)> NotifyKeysChanged;
+
     /** Inquire whether this wallet broadcasts transactions. */
     bool GetBroadcastTransactions() const { return fBroadcastTransactions; }
     /** Set whether this wallet broadcasts transactions. */
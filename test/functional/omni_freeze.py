@@ -102,6 +102,15 @@ class OmniFreeze(BitcoinTestFramework):
         balance = node.omni_getbalance(freeze_address, 3)['balance']
         assert_equal(balance, "1000")
 
+        # Checking the frozen balance is also reported by the batched balance query...
+        result = node.omni_getbalances([freeze_address, address], [3])
+        assert_equal(result['block'], node.getblockcount())
+        assert_equal(result['blockhash'], node.getbestblockhash())
+        assert_equal(result['addresses'][0]['address'], freeze_address)
+        assert_equal(result['addresses'][0]['balances'][0]['balance'], "1000")
+        assert_equal(result['addresses'][0]['balances'][0]['frozen'], "1000")
+        assert_equal(result['addresses'][1]['address'], address)
+
         # Sending an 'unfreeze' tranasction for the test address
         txid = node.omni_sendunfreeze(address, freeze_address, 3, "1234")
         node.generatetoaddress(1, coinbase_address)